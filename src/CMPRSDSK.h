@@ -0,0 +1,346 @@
+/*
+	CMPRSDSK.h
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	CoMPReSsed DiSK images
+
+	Included by the platform glue. A compressed disk image is
+	split into fixed size chunks, each compressed separately, so
+	that any part of the disk can be read without decompressing
+	everything before it.
+
+	Format (longs are big endian):
+		0  : 'mvCZ'
+		4  : version (1)
+		8  : log2 of the chunk size
+		12 : uncompressed size of the disk image
+		16 : index, (number of chunks + 1) longs, giving the file
+			offset of each chunk, and of the end of the last one.
+	A chunk of length zero is all zeros. A chunk whose length is
+	its uncompressed size is stored as is. Otherwise the chunk
+	is compressed with the LZ scheme below.
+
+	Each LZ sequence is a token byte, with the number of literal
+	bytes in the high nibble, and the match length minus 4 in the
+	low nibble. A nibble of 15 is followed by more bytes that are
+	added to it, up to and including the first byte that isn't
+	255. Then come the literal bytes, and then, except for the
+	last sequence, the two byte (big endian) distance back to the
+	match.
+*/
+
+#define kCmprsSignature 0x6D76435A
+#define kCmprsVersion 1
+
+#define kCmprsOffset_Sig 0
+#define kCmprsOffset_Version 4
+#define kCmprsOffset_Ln2ChunkSz 8
+#define kCmprsOffset_Size 12
+#define kCmprsOffset_Index 16
+#define kCmprsHeaderSz 16
+
+#define kLn2CmprsChunkSz 14
+	/* chunk size used when making compressed images */
+#define kLn2CmprsMaxChunkSz 16
+
+#define kCmprsMinMatch 4
+#define kCmprsMaxDist 0xFFFF
+
+#define kLn2CmprsHashSz 12
+#define kCmprsHashSz (1 << kLn2CmprsHashSz)
+
+#define CmprsHash(p) \
+	(((ui5r)(do_get_mem_long(p) * (ui5r)2654435761UL)) \
+		>> (32 - kLn2CmprsHashSz))
+
+LOCALFUNC blnr CmprsGetLen(ui3p *s, ui3p send, ui5r *L)
+{
+	ui3p p = *s;
+	ui3r b;
+
+	do {
+		if (p >= send) {
+			return falseblnr;
+		}
+		b = *p++;
+		*L += b;
+	} while (255 == b);
+	*s = p;
+
+	return trueblnr;
+}
+
+LOCALFUNC blnr CmprsDecode(ui3p src, ui5r srcLen,
+	ui3p dst, ui5r dstLen)
+{
+	/* checks everything, images may be corrupt */
+	ui3p s = src;
+	ui3p send = src + srcLen;
+	ui3p d = dst;
+	ui3p dend = dst + dstLen;
+	ui3r token;
+	ui5r L;
+	ui5r dist;
+
+	while (s < send) {
+		token = *s++;
+		L = token >> 4;
+		if ((15 == L) && ! CmprsGetLen(&s, send, &L)) {
+			return falseblnr;
+		}
+		if ((L > (ui5r)(send - s)) || (L > (ui5r)(dend - d))) {
+			return falseblnr;
+		}
+		MyMoveBytes(s, d, L);
+		s += L;
+		d += L;
+
+		if (s == send) {
+			break; /* last sequence has no match */
+		}
+
+		if ((ui5r)(send - s) < 2) {
+			return falseblnr;
+		}
+		dist = do_get_mem_word(s);
+		s += 2;
+		L = token & 15;
+		if ((15 == L) && ! CmprsGetLen(&s, send, &L)) {
+			return falseblnr;
+		}
+		L += kCmprsMinMatch;
+		if ((0 == dist) || (dist > (ui5r)(d - dst))
+			|| (L > (ui5r)(dend - d)))
+		{
+			return falseblnr;
+		}
+
+		/* may overlap, so copy forward one byte at a time */
+		{
+			ui3p m = d - dist;
+
+			do {
+				*d++ = *m++;
+			} while (0 != --L);
+		}
+	}
+
+	return d == dend;
+}
+
+LOCALFUNC blnr CmprsPutLen(ui3p *d, ui3p dend, ui5r L)
+{
+	ui3p p = *d;
+
+	while (L >= 255) {
+		if (p >= dend) {
+			return falseblnr;
+		}
+		*p++ = 255;
+		L -= 255;
+	}
+	if (p >= dend) {
+		return falseblnr;
+	}
+	*p++ = L;
+	*d = p;
+
+	return trueblnr;
+}
+
+LOCALFUNC blnr CmprsPutSeq(ui3p *d, ui3p dend,
+	ui3p lit, ui5r litLen, ui5r dist, ui5r matchLen)
+{
+	/* a matchLen of zero means the last sequence */
+	ui3p p = *d;
+	ui5r M = (0 == matchLen) ? 0 : matchLen - kCmprsMinMatch;
+
+	if (p >= dend) {
+		return falseblnr;
+	}
+	*p++ = ((litLen < 15) ? litLen : 15) << 4
+		| ((M < 15) ? M : 15);
+	if ((litLen >= 15) && ! CmprsPutLen(&p, dend, litLen - 15)) {
+		return falseblnr;
+	}
+	if (litLen > (ui5r)(dend - p)) {
+		return falseblnr;
+	}
+	MyMoveBytes(lit, p, litLen);
+	p += litLen;
+	if (0 != matchLen) {
+		if ((ui5r)(dend - p) < 2) {
+			return falseblnr;
+		}
+		do_put_mem_word(p, dist);
+		p += 2;
+		if ((M >= 15) && ! CmprsPutLen(&p, dend, M - 15)) {
+			return falseblnr;
+		}
+	}
+	*d = p;
+
+	return trueblnr;
+}
+
+LOCALFUNC ui5r CmprsEncode(ui3p src, ui5r srcLen,
+	ui3p dst, ui5r dstMax)
+{
+	/*
+		returns the compressed length, or 0 if it
+		would not fit in dstMax bytes.
+	*/
+	ui5r HashTab[kCmprsHashSz];
+	ui3p d = dst;
+	ui3p dend = dst + dstMax;
+	ui5r ip = 0;
+	ui5r anchor = 0;
+	ui5r i;
+
+	for (i = 0; i < kCmprsHashSz; ++i) {
+		HashTab[i] = (ui5r) -1;
+	}
+
+	while (ip + kCmprsMinMatch <= srcLen) {
+		ui5r h = CmprsHash(src + ip);
+		ui5r ref = HashTab[h];
+
+		HashTab[h] = ip;
+		if ((ref < ip) && (ip - ref <= kCmprsMaxDist)
+			&& (do_get_mem_long(src + ref)
+				== do_get_mem_long(src + ip)))
+		{
+			ui5r L = kCmprsMinMatch;
+
+			while ((ip + L < srcLen) && (src[ref + L] == src[ip + L]))
+			{
+				++L;
+			}
+			if (! CmprsPutSeq(&d, dend, src + anchor, ip - anchor,
+				ip - ref, L))
+			{
+				return 0;
+			}
+			ip += L;
+			anchor = ip;
+		} else {
+			++ip;
+		}
+	}
+
+	if (! CmprsPutSeq(&d, dend, src + anchor, srcLen - anchor, 0, 0)) {
+		return 0;
+	}
+
+	return d - dst;
+}
+
+LOCALFUNC blnr CmprsIsZeros(ui3p p, ui5r n)
+{
+	while (0 != n) {
+		if (0 != *p++) {
+			return falseblnr;
+		}
+		--n;
+	}
+
+	return trueblnr;
+}
+
+LOCALFUNC blnr CmprsMakeImage(FILE *src, FILE *dst)
+{
+	/* write a compressed version of disk image src to dst */
+	ui3b Header[kCmprsHeaderSz];
+	ui5r ChunkSz = (ui5r)1 << kLn2CmprsChunkSz;
+	ui5r Size;
+	ui5r nChunks;
+	ui5r i;
+	ui5r offset;
+	ui5r L;
+	ui5r n;
+	long v;
+	ui3p Index = nullpr;
+	ui3p Raw = nullpr;
+	ui3p Packed = nullpr;
+	blnr IsOk = falseblnr;
+
+	if ((0 != fseek(src, 0, SEEK_END))
+		|| ((v = ftell(src)) < 0)
+		|| (0 != fseek(src, 0, SEEK_SET)))
+	{
+		goto label_fail;
+	}
+	Size = v;
+	nChunks = (Size + ChunkSz - 1) >> kLn2CmprsChunkSz;
+
+	Index = (ui3p)malloc((nChunks + 1) * 4);
+	Raw = (ui3p)malloc(ChunkSz);
+	Packed = (ui3p)malloc(ChunkSz);
+	if ((NULL == Index) || (NULL == Raw) || (NULL == Packed)) {
+		goto label_fail;
+	}
+
+	do_put_mem_long(&Header[kCmprsOffset_Sig], kCmprsSignature);
+	do_put_mem_long(&Header[kCmprsOffset_Version], kCmprsVersion);
+	do_put_mem_long(&Header[kCmprsOffset_Ln2ChunkSz],
+		kLn2CmprsChunkSz);
+	do_put_mem_long(&Header[kCmprsOffset_Size], Size);
+
+	/* index is written last, once the offsets are known */
+	offset = kCmprsOffset_Index + (nChunks + 1) * 4;
+	if (0 != fseek(dst, offset, SEEK_SET)) {
+		goto label_fail;
+	}
+
+	for (i = 0; i < nChunks; ++i) {
+		L = Size - (i << kLn2CmprsChunkSz);
+		if (L > ChunkSz) {
+			L = ChunkSz;
+		}
+		if (L != fread(Raw, 1, L, src)) {
+			goto label_fail;
+		}
+		do_put_mem_long(Index + i * 4, offset);
+		if (CmprsIsZeros(Raw, L)) {
+			n = 0;
+		} else {
+			n = CmprsEncode(Raw, L, Packed, L - 1);
+			if (0 == n) {
+				n = L;
+			}
+			if (n != fwrite((n == L) ? Raw : Packed, 1, n, dst)) {
+				goto label_fail;
+			}
+		}
+		offset += n;
+	}
+	do_put_mem_long(Index + nChunks * 4, offset);
+
+	if ((0 == fseek(dst, 0, SEEK_SET))
+		&& (kCmprsHeaderSz == fwrite(Header, 1, kCmprsHeaderSz, dst))
+		&& ((nChunks + 1) * 4
+			== fwrite(Index, 1, (nChunks + 1) * 4, dst)))
+	{
+		IsOk = trueblnr;
+	}
+
+label_fail:
+	free(Packed);
+	free(Raw);
+	free(Index);
+
+	return IsOk;
+}
@@ -14,7 +14,9 @@
 #define LittleEndianUnaligned 1
 #define MayInline inline
 #define MayNotInline __attribute__((noinline))
+#define MustInline inline __attribute__((always_inline))
 #define SmallGlobals 0
+#define EmMultiInstance 1
 #define cIncludeUnused 0
 #define UnusedParam(p) (void) p
 
@@ -75,6 +77,30 @@ typedef si5b si5r;
 #define IncludeSonyGetName 0
 #define IncludeSonyNew 0
 #define IncludeSonyNameNew 0
+#define IncludeSCSIDisks 1
+#define IncludeSaveState 1
+#define IncludeForkServer 1
+#define IncludeRewind 1
+	/* rewind buffer of snapshots, needs IncludeSaveState */
+#define IncludeBench 1
+#define IncludeCPUTest 1
+	/* differential CPU test harness, needs IncludeBench */
+#define IncludeProfile 1
+	/* sampling profiler of the emulated program */
+#define IncludeOpStats 1
+	/* counts of the instructions run, switched on at run time */
+#define IncludeHostTime 1
+	/* host time spent in each part of emulation */
+#define IncludeMemStats 0
+	/* counts of how memory is reached, needs IncludeHostTime */
+#define IncludeTrace 1
+	/* binary trace of device accesses, switched on at run time */
+#define IncludeWatch 1
+	/* watchpoints on guest memory, logged by IncludeTrace */
+#define IncludeCoverage 0
+	/* map of guest code run, costs a store per instruction */
+#define kRewindBudget 0x01000000
+	/* bytes of memory kept for going back in time */
 
 #define vMacScreenHeight 342
 #define vMacScreenWidth 512
@@ -88,5 +114,16 @@ typedef si5b si5r;
 #define EnableMouseMotion 1
 
 #define IncludeHostTextClipExchange 0
+#define IncludeHostFS 0
+	/* host side only, no guest file system uses it yet */
 #define EnableAutoSlow 1
+#define EnableIdleSkip 0
+	/* guess when the guest waits for events, and skip ahead */
+#define EnableTrapAccel 1
+#define WantTrapAccelVerify 0
+	/* checking native traps against emulated, slower */
+#define EnableQDAccel 1
+	/* native QuickDraw rectangle traps, needs EnableTrapAccel */
+#define EnableSCSIAccel 1
+	/* native SCSI Manager blind transfers, needs EnableTrapAccel */
 #define EmLocalTalk 0
@@ -31,6 +31,10 @@
 #define NeedDoAboutMsg 0
 #define UseControlKeys 1
 #define UseActvCode 0
+#define IncludeSonyOverlay 1
+#define IncludeSonyCmprs 1
+#define IncludeSonyRamDisk 1
+#define IncludeSonyWriteBack 1
 
 /* version and other info to display to user */
 
@@ -24,6 +24,10 @@ GLOBALVAR ui3p ROM = nullpr;
 GLOBALVAR ui5b vSonyWritableMask = 0;
 GLOBALVAR ui5b vSonyInsertedMask = 0;
 
+#if IncludeSCSIDisks
+GLOBALVAR ui5b vSCSIDriveMask = 0;
+#endif
+
 #if IncludeSonyRawMode
 GLOBALVAR blnr vSonyRawMode = falseblnr;
 #endif
@@ -83,6 +87,10 @@ GLOBALVAR ui5r QuietTime = 0;
 GLOBALVAR ui5r QuietSubTicks = 0;
 #endif
 
+#if EnableIdleSkip
+GLOBALVAR blnr GuestIdle = falseblnr;
+#endif
+
 #if IncludePbufs
 LOCALVAR ui5b PbufAllocatedMask;
 LOCALVAR ui5b PbufSize[NumPbufs];
@@ -198,6 +206,9 @@ LOCALPROC DiskInsertNotify(tDrive Drive_No, blnr locked)
 LOCALPROC DiskEjectedNotify(tDrive Drive_No)
 {
 	vSonyWritableMask &= ~ ((ui5b)1 << Drive_No);
+#if IncludeSCSIDisks
+	vSCSIDriveMask &= ~ ((ui5b)1 << Drive_No);
+#endif
 	vSonyInsertedMask &= ~ ((ui5b)1 << Drive_No);
 }
 
@@ -599,6 +610,9 @@ GLOBALPROC Screen_OutputFrame(ui3p screencurrentbuff)
 	si4b left;
 	si4b bottom;
 	si4b right;
+#if IncludeHostTime
+	int PrevHostTime = HostTime_Switch(kHostTimeScreenDiff);
+#endif
 
 	if (! EmVideoDisable) {
 		if (ScreenFindChanges(screencurrentbuff, EmLagTime,
@@ -645,6 +659,9 @@ GLOBALPROC Screen_OutputFrame(ui3p screencurrentbuff)
 #endif
 		}
 	}
+#if IncludeHostTime
+	(void) HostTime_Switch(PrevHostTime);
+#endif
 }
 
 #if MayFullScreen
@@ -1177,3 +1194,10 @@ GLOBALPROC WarnMsgAbnormal(void)
 	MacMsg(kStrReportAbnormalTitle,
 		kStrReportAbnormalMessage, falseblnr);
 }
+
+#if EnableTrapAccel && WantTrapAccelVerify
+GLOBALPROC WarnMsgTrapAccel(void)
+{
+	MacMsg(kStrTrapAccelTitle, kStrTrapAccelMessage, falseblnr);
+}
+#endif
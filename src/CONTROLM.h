@@ -425,6 +425,21 @@ enum {
 #if UseActvCode
 	kCntrlMsgRegStrCopied,
 #endif
+#if IncludeSonyWriteBack
+	kCntrlMsgDisksWritten,
+#endif
+#if IncludeSaveState
+	kCntrlMsgStateSaved,
+	kCntrlMsgStateLoaded,
+#endif
+#if IncludeRewind
+	kCntrlMsgRewound,
+	kCntrlMsgRewoundDisks,
+	kCntrlMsgNoRewind,
+#endif
+#if IncludeHostTime
+	kCntrlMsgHostTime,
+#endif
 
 	kNumCntrlMsgs
 };
@@ -470,6 +485,16 @@ FORWARDPROC ToggleWantFullScreen(void);
 #if UseActvCode
 FORWARDPROC CopyRegistrationStr(void);
 #endif
+#if IncludeSonyWriteBack
+FORWARDPROC WriteBackSyncAll(void);
+#endif
+#if IncludeSaveState
+FORWARDFUNC blnr SaveStateNow(void);
+FORWARDFUNC blnr LoadStateNow(void);
+#endif
+#if IncludeHostTime
+FORWARDPROC HostTimeLine(int Phase, char *s);
+#endif
 
 LOCALPROC DoControlModeKey(int key)
 {
@@ -535,6 +560,43 @@ LOCALPROC DoControlModeKey(int key)
 					CopyRegistrationStr();
 					ControlMessage = kCntrlMsgRegStrCopied;
 					break;
+#endif
+#if IncludeSonyWriteBack
+				case MKC_W:
+					WriteBackSyncAll();
+					ControlMessage = kCntrlMsgDisksWritten;
+					break;
+#endif
+#if IncludeSaveState
+				case MKC_V:
+					if (SaveStateNow()) {
+						ControlMessage = kCntrlMsgStateSaved;
+					}
+					break;
+				case MKC_L:
+					if (LoadStateNow()) {
+						ControlMessage = kCntrlMsgStateLoaded;
+					}
+					break;
+#endif
+#if IncludeRewind
+				case MKC_B:
+					if (Rewind_Back()) {
+						NeedWholeScreenDraw = trueblnr;
+						/* disk images aren't rewound */
+						ControlMessage = (0 != (vSonyInsertedMask
+							& vSonyWritableMask))
+							? kCntrlMsgRewoundDisks
+							: kCntrlMsgRewound;
+					} else {
+						ControlMessage = kCntrlMsgNoRewind;
+					}
+					break;
+#endif
+#if IncludeHostTime
+				case MKC_T:
+					ControlMessage = kCntrlMsgHostTime;
+					break;
 #endif
 			}
 			break;
@@ -716,6 +778,19 @@ LOCALPROC DrawCellsControlModeBody(void)
 			DrawCellsKeyCommand("K", kStrCmdCtrlKeyToggle);
 			DrawCellsKeyCommand("R", kStrCmdReset);
 			DrawCellsKeyCommand("I", kStrCmdInterrupt);
+#if IncludeSonyWriteBack
+			DrawCellsKeyCommand("W", kStrCmdWriteDisks);
+#endif
+#if IncludeSaveState
+			DrawCellsKeyCommand("V", kStrCmdSaveState);
+			DrawCellsKeyCommand("L", kStrCmdLoadState);
+#endif
+#if IncludeRewind
+			DrawCellsKeyCommand("B", kStrCmdRewind);
+#endif
+#if IncludeHostTime
+			DrawCellsKeyCommand("T", kStrCmdHostTime);
+#endif
 			DrawCellsKeyCommand("H", kStrCmdHelp);
 			break;
 		case kCntrlMsgSpeedControlStart:
@@ -801,6 +876,45 @@ LOCALPROC DrawCellsControlModeBody(void)
 		case kCntrlMsgEmCntrl:
 			DrawCellsOneLineStr(kStrNewCntrlKey);
 			break;
+#if IncludeSonyWriteBack
+		case kCntrlMsgDisksWritten:
+			DrawCellsOneLineStr(kStrHaveWrittenDisks);
+			break;
+#endif
+#if IncludeSaveState
+		case kCntrlMsgStateSaved:
+			DrawCellsOneLineStr(kStrHaveSavedState);
+			break;
+		case kCntrlMsgStateLoaded:
+			DrawCellsOneLineStr(kStrHaveLoadedState);
+			break;
+#endif
+#if IncludeRewind
+		case kCntrlMsgRewound:
+			DrawCellsOneLineStr(kStrHaveRewound);
+			break;
+		case kCntrlMsgRewoundDisks:
+			DrawCellsOneLineStr(kStrHaveRewoundDisks);
+			break;
+		case kCntrlMsgNoRewind:
+			DrawCellsOneLineStr(kStrNoRewind);
+			break;
+#endif
+#if IncludeHostTime
+		case kCntrlMsgHostTime:
+			{
+				int i;
+				char s[64];
+
+				DrawCellsOneLineStr(kStrHostTimeTitle);
+				DrawCellsBlankLine();
+				for (i = 0; i < kNumHostTimes; ++i) {
+					HostTimeLine(i, s);
+					DrawCellsOneLineStr(s);
+				}
+			}
+			break;
+#endif
 		case kCntrlMsgBaseStart:
 		default:
 			DrawCellsOneLineStr(kStrHowToLeaveControl);
@@ -0,0 +1,48 @@
+/*
+	COVERAGE.h
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	guest code COVERAGE, shared by the emulator and by the
+	COVMERGE tool.
+
+	While running, a map has a byte for each word of memory,
+	set to 1 when an instruction starts there. The file has a
+	bit for each word instead: a header of kCovHeadSz bytes,
+	the magic 'mvCV', kCovVersion and the number of maps, as
+	big endian longs, then for each map the emulated address of
+	its first word and its number of words, then (words + 7) / 8
+	bytes, the most significant bit of each for the lowest word.
+*/
+
+#ifdef COVERAGE_H
+#error "header already included"
+#else
+#define COVERAGE_H
+#endif
+
+#define kCovMagic 0x6D764356 /* 'mvCV' */
+#define kCovVersion 1
+#define kCovHeadSz 12
+
+#define kCovROM 0
+#define kCovRAM 1
+#define kNumCovMaps 2
+
+EXPORTPROC m68k_CovMapInfo(int i, ui5r *Addr, ui5r *Words,
+	ui5r *AllocSz);
+	/* AllocSz is a power of two, at least Words */
+EXPORTPROC m68k_CovSetMap(int i, ui3p Map);
+	/* Map of AllocSz zeroed bytes, or nullpr to stop */
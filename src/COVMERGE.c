@@ -0,0 +1,231 @@
+/*
+	COVMERGE.c
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	COVerage MERGE
+
+	A program by itself, not part of the emulator. For files
+	written by "minivmac --coverage FILE":
+
+		covmerge OUT IN...
+
+	writes to OUT the words run in any of the IN files, and
+
+		covmerge -l IN
+
+	lists the ranges of addresses run in IN. Both print, for
+	each map, how many of its words were run.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SYSDEPNS.h"
+#include "COVERAGE.h"
+
+LOCALVAR ui3p Dat = NULL;
+LOCALVAR long DatSz = 0;
+
+LOCALFUNC ui5r GetLong(ui3p p)
+{
+	return ((ui5r)p[0] << 24) | ((ui5r)p[1] << 16)
+		| ((ui5r)p[2] << 8) | (ui5r)p[3];
+}
+
+LOCALFUNC ui3p ReadCov(char *path, long *n)
+{
+	FILE *f;
+	ui3p p = NULL;
+	ui3p q;
+	ui5r i;
+	ui5r Words;
+	long at;
+
+	if (NULL == (f = fopen(path, "rb"))) {
+		fprintf(stderr, "covmerge: can't open %s\n", path);
+		return NULL;
+	}
+	if ((0 != fseek(f, 0, SEEK_END))
+		|| ((*n = ftell(f)) < kCovHeadSz)
+		|| (0 != fseek(f, 0, SEEK_SET))
+		|| (NULL == (p = (ui3p)malloc(*n)))
+		|| (1 != fread(p, *n, 1, f)))
+	{
+		fprintf(stderr, "covmerge: can't read %s\n", path);
+		free(p);
+		p = NULL;
+	} else
+	if ((kCovMagic != GetLong(p)) || (kCovVersion != GetLong(p + 4)))
+	{
+		fprintf(stderr, "covmerge: %s is not a coverage file\n", path);
+		free(p);
+		p = NULL;
+	} else {
+		/* check the maps fit in the file */
+		at = kCovHeadSz;
+		for (i = 0; i < GetLong(p + 8); ++i) {
+			q = p + at;
+			if ((at + 8 > *n)
+				|| (at + 8 + (long)((GetLong(q + 4) + 7) / 8) > *n))
+			{
+				fprintf(stderr, "covmerge: %s is cut short\n", path);
+				free(p);
+				p = NULL;
+				break;
+			}
+			Words = GetLong(q + 4);
+			at += 8 + (Words + 7) / 8;
+		}
+	}
+	fclose(f);
+
+	return p;
+}
+
+LOCALFUNC int BitCount(ui3r b)
+{
+	int n = 0;
+
+	for (; 0 != b; b &= b - 1) {
+		++n;
+	}
+
+	return n;
+}
+
+LOCALPROC Summary(ui3p p, blnr List)
+{
+	ui5r i;
+	ui5r j;
+	ui5r Addr;
+	ui5r Words;
+	ui5r Run;
+	ui5r Start = 0;
+	blnr InRange;
+	blnr b;
+	ui3p q = p + kCovHeadSz;
+
+	for (i = 0; i < GetLong(p + 8); ++i) {
+		Addr = GetLong(q);
+		Words = GetLong(q + 4);
+		q += 8;
+		Run = 0;
+		for (j = 0; j < (Words + 7) / 8; ++j) {
+			Run += BitCount(q[j]);
+		}
+		printf("map %lu at %08lX: %lu of %lu words run\n",
+			(unsigned long)i, (unsigned long)Addr,
+			(unsigned long)Run, (unsigned long)Words);
+		if (List) {
+			InRange = falseblnr;
+			for (j = 0; j <= Words; ++j) {
+				b = (j < Words)
+					&& (0 != (q[j >> 3] & (0x80 >> (j & 7))));
+				if (b && ! InRange) {
+					Start = j;
+				} else if (InRange && ! b) {
+					printf("  %08lX-%08lX\n",
+						(unsigned long)(Addr + 2 * Start),
+						(unsigned long)(Addr + 2 * j - 1));
+				}
+				InRange = b;
+			}
+		}
+		q += (Words + 7) / 8;
+	}
+}
+
+LOCALFUNC blnr MergeInto(ui3p p, long n, char *path)
+{
+	/* OR the bits of p into Dat, if the maps are the same */
+	ui5r i;
+	ui5r j;
+	ui5r Bytes;
+	ui3p q = p + kCovHeadSz;
+	ui3p d = Dat + kCovHeadSz;
+
+	if ((n != DatSz) || (0 != memcmp(p, Dat, kCovHeadSz))) {
+		goto label_fail;
+	}
+	for (i = 0; i < GetLong(p + 8); ++i) {
+		if (0 != memcmp(q, d, 8)) {
+			goto label_fail;
+		}
+		Bytes = (GetLong(q + 4) + 7) / 8;
+		q += 8;
+		d += 8;
+		for (j = 0; j < Bytes; ++j) {
+			d[j] |= q[j];
+		}
+		q += Bytes;
+		d += Bytes;
+	}
+
+	return trueblnr;
+
+label_fail:
+	fprintf(stderr, "covmerge: %s has other maps\n", path);
+	return falseblnr;
+}
+
+int main(int argc, char **argv)
+{
+	FILE *f;
+	ui3p p;
+	long n;
+	int i;
+
+	if ((3 == argc) && (0 == strcmp(argv[1], "-l"))) {
+		if (NULL == (Dat = ReadCov(argv[2], &DatSz))) {
+			return 1;
+		}
+		Summary(Dat, trueblnr);
+		return 0;
+	}
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: covmerge OUT IN...\n");
+		fprintf(stderr, "       covmerge -l IN\n");
+		return 2;
+	}
+
+	for (i = 2; i < argc; ++i) {
+		if (NULL == (p = ReadCov(argv[i], &n))) {
+			return 1;
+		}
+		if (NULL == Dat) {
+			Dat = p;
+			DatSz = n;
+		} else {
+			if (! MergeInto(p, n, argv[i])) {
+				return 1;
+			}
+			free(p);
+		}
+	}
+
+	if ((NULL == (f = fopen(argv[1], "wb")))
+		|| (1 != fwrite(Dat, DatSz, 1, f)))
+	{
+		fprintf(stderr, "covmerge: can't write %s\n", argv[1]);
+		return 1;
+	}
+	fclose(f);
+	Summary(Dat, falseblnr);
+
+	return 0;
+}
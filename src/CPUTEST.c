@@ -0,0 +1,221 @@
+/*
+	CPUTEST.c
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	CPU TESTing
+
+	For checking a change to the emulated CPU against a build
+	without it. All of the address space is mapped to one small
+	block of memory, so no device can be touched. Each case starts
+	with random memory and registers, from a seed and the case
+	number, then runs a few instructions one at a time. Before
+	each, an instruction is put at the PC, a random one decoded as
+	legal by disp_table, or one taken from a recorded trace. The
+	registers and the memory written are noted after each.
+
+	The platform glue writes these to a trace with one build, and
+	compares against the trace with the other, which is running
+	the same instruction stream from the same state in lockstep.
+*/
+
+#ifndef AllFiles
+#include "SYSDEPNS.h"
+#include "MYOSGLUE.h"
+#include "ENDIANAC.h"
+#include "EMCONFIG.h"
+#include "GLOBGLUE.h"
+#include "M68KITAB.h"
+#include "MINEM68K.h"
+#endif
+
+#include "CPUTEST.h"
+
+#if IncludeCPUTest
+
+#define kCT_MemSize 0x1000
+	/* mirrored through all of the address space */
+#define kCT_Slop 0x10
+	/*
+		the CPU takes memory to be contiguous past the end of a
+		block, for fetching an instruction and for a word or long
+		at its last byte, so the bytes after are part of the test
+		too, seen only in that way.
+	*/
+#define kCT_AllSize (kCT_MemSize + kCT_Slop)
+
+LOCALVAR ui3b CPUTestMem[kCT_AllSize];
+LOCALVAR ui3b CPUTestOld[kCT_AllSize];
+LOCALVAR ATTer CPUTestATT;
+LOCALVAR ui5r CPUTestRand;
+
+LOCALFUNC ui5r CPUTestNext(void)
+{
+	/* xorshift32, so the same on every host */
+	ui5r x = CPUTestRand;
+
+	x ^= (x << 13) & 0xFFFFFFFF;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xFFFFFFFF;
+	CPUTestRand = x;
+	return x;
+}
+
+GLOBALPROC CPUTest_Setup(void)
+{
+	CPUTestATT.Next = nullpr;
+	CPUTestATT.cmpmask = 0;
+	CPUTestATT.cmpvalu = 0;
+	CPUTestATT.Access = kATTA_readwritereadymask;
+	CPUTestATT.usemask = kCT_MemSize - 1;
+	CPUTestATT.usebase = CPUTestMem;
+	CPUTestATT.MMDV = 0;
+	CPUTestATT.Ntfy = 0;
+	SetHeadATTel(&CPUTestATT);
+}
+
+GLOBALPROC CPUTest_Start(ui5r Seed, ui5r Case)
+{
+	ui5r Regs[kCPUTestNRegs];
+	ui5r i;
+
+	CPUTestRand = (Seed ^ ((Case * 0x9E3779B9) & 0xFFFFFFFF))
+		| 0x00010000; /* never 0 */
+	for (i = 0; i < 8; ++i) {
+		(void) CPUTestNext();
+	}
+
+	for (i = 0; i < kCT_AllSize; i += 4) {
+		do_put_mem_long(CPUTestMem + i, CPUTestNext());
+	}
+	for (i = 0; i < kCPUTestNRegs; ++i) {
+		Regs[i] = CPUTestNext();
+	}
+	Regs[kCPUTestPC] &= 0x00FFFFFE;
+	Regs[kCPUTestSR] &= 0x271F; /* no tracing */
+
+	m68k_TestSetRegs(Regs);
+}
+
+GLOBALPROC CPUTest_GetRegs(ui5r *Regs)
+{
+	m68k_TestGetRegs(Regs);
+}
+
+LOCALFUNC ui5r CPUTestKind(ui4r opcode)
+{
+	DecOpR d;
+
+	m68k_TestDecode(opcode, &d.A, &d.B);
+	return GetDcoMainClas(&d);
+}
+
+LOCALFUNC blnr CPUTestOpcodeOk(ui4r opcode)
+{
+	switch (CPUTestKind(opcode)) {
+		case kIKindIllegal:
+		case kIKindA: /* trap dispatch, and native traps */
+		case kIKindF:
+		case kIKindCallMorRtm:
+		case kIKindStop:
+		case kIKindReset:
+			return falseblnr;
+		default:
+			return trueblnr;
+	}
+}
+
+LOCALFUNC ui4r CPUTestExtWord(void)
+{
+	/* mostly small, for displacements that stay nearby */
+	ui5r v = CPUTestNext();
+
+	switch (v & 3) {
+		case 0:
+			return (v >> 8) & 0x003F;
+		case 1:
+			return ((v >> 8) & 0x003F) | 0xFFC0;
+		default:
+			return (v >> 16) & 0xFFFF;
+	}
+}
+
+GLOBALPROC CPUTest_Step(CPUTestR *r, blnr HaveCode)
+{
+	ui5r pc;
+	ui5r h;
+	ui5r i;
+	ui3b v;
+
+	if (! HaveCode) {
+		do {
+			r->Code[0] = CPUTestNext() & 0xFFFF;
+		} while (! CPUTestOpcodeOk(r->Code[0]));
+		for (i = 1; i < kCPUTestCodeLen; ++i) {
+			r->Code[i] = CPUTestExtWord();
+		}
+	}
+
+	m68k_TestGetRegs(r->Regs);
+	pc = r->Regs[kCPUTestPC] & (kCT_MemSize - 1);
+	for (i = 0; i < kCPUTestCodeLen; ++i) {
+		do_put_mem_word(CPUTestMem + pc + 2 * i, r->Code[i]);
+			/* not wrapped, as fetched */
+	}
+	MyMoveBytes((anyp)CPUTestMem, (anyp)CPUTestOld, kCT_AllSize);
+
+	m68k_TestStep();
+
+	m68k_TestGetRegs(r->Regs);
+	r->NWrites = 0;
+	h = 2166136261UL;
+	for (i = 0; i < kCT_AllSize; ++i) {
+		v = CPUTestMem[i];
+		if (v != CPUTestOld[i]) {
+			if (r->NWrites < kCPUTestNWrites) {
+				r->Writes[r->NWrites] = (i << 8) | v;
+			}
+			++r->NWrites;
+		}
+		h = ((h ^ v) * 16777619UL) & 0xFFFFFFFF;
+	}
+	for (i = r->NWrites; i < kCPUTestNWrites; ++i) {
+		r->Writes[i] = 0;
+	}
+	r->MemHash = h;
+}
+
+GLOBALFUNC char *CPUTest_KindName(ui4r opcode)
+{
+	return M68KITAB_KindName(CPUTestKind(opcode));
+}
+
+GLOBALFUNC char *CPUTest_SrcModeName(ui4r opcode)
+{
+	DecOpR d;
+
+	m68k_TestDecode(opcode, &d.A, &d.B);
+	return M68KITAB_ModeName(GetDcoSrcAMd(&d));
+}
+
+GLOBALFUNC char *CPUTest_DstModeName(ui4r opcode)
+{
+	DecOpR d;
+
+	m68k_TestDecode(opcode, &d.A, &d.B);
+	return M68KITAB_ModeName(GetDcoDstAMd(&d));
+}
+
+#endif /* IncludeCPUTest */
@@ -0,0 +1,57 @@
+/*
+	CPUTEST.h
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+#ifdef CPUTEST_H
+#error "header already included"
+#else
+#define CPUTEST_H
+#endif
+
+/* register file, as seen by the test harness */
+
+#define kCPUTestPC 16 /* after D0-D7 and A0-A7 */
+#define kCPUTestSR 17
+#define kCPUTestOSP 18 /* the stack pointer not in A7 */
+#define kCPUTestNRegs 19
+
+#define kCPUTestCodeLen 5 /* longest 68000 instruction, in words */
+#define kCPUTestNWrites 4
+
+struct CPUTestR {
+	ui4r Code[kCPUTestCodeLen];
+	ui5r Regs[kCPUTestNRegs];
+	ui5r NWrites; /* bytes of memory changed */
+	ui5r Writes[kCPUTestNWrites]; /* the first, offset << 8 | value */
+	ui5r MemHash;
+};
+typedef struct CPUTestR CPUTestR;
+
+EXPORTPROC CPUTest_Setup(void);
+	/*
+		map all of the address space to the test memory. the
+		emulated machine can't be run after this.
+	*/
+EXPORTPROC CPUTest_Start(ui5r Seed, ui5r Case);
+	/* random memory and registers, the same for the same Case */
+EXPORTPROC CPUTest_GetRegs(ui5r *Regs);
+EXPORTPROC CPUTest_Step(CPUTestR *r, blnr HaveCode);
+	/*
+		put an instruction at the PC, a random legal one unless
+		HaveCode, run it, and fill in the state after.
+	*/
+EXPORTFUNC char *CPUTest_KindName(ui4r opcode);
+EXPORTFUNC char *CPUTest_SrcModeName(ui4r opcode);
+EXPORTFUNC char *CPUTest_DstModeName(ui4r opcode);
@@ -34,6 +34,7 @@
 #define MaxATTListN 16
 #define IncludeExtnPbufs 1
 #define IncludeExtnHostTextClipExchange 0
+#define IncludeExtnHostFS 0
 
 #define Sony_SupportDC42 1
 #define Sony_SupportTags 0
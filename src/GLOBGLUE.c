@@ -30,10 +30,26 @@
 #include "MYOSGLUE.h"
 #include "ENDIANAC.h"
 #include "EMCONFIG.h"
+#if IncludeSaveState
+#include "SAVESTAT.h"
+#endif
+#if IncludeMemStats
+#include "MEMSTATS.h"
+#endif
+#if IncludeTrace
+#include "TRACE.h"
+#endif
+#if IncludeWatch
+#include "WATCH.h"
+#endif
 #endif
 
 #include "GLOBGLUE.h"
 
+#if IncludeWatch && ! IncludeTrace
+#error "IncludeWatch needs IncludeTrace"
+#endif
+
 IMPORTPROC m68k_reset(void);
 IMPORTPROC IWM_Reset(void);
 IMPORTPROC SCC_Reset(void);
@@ -51,6 +67,9 @@ IMPORTPROC ExtnVideo_Access(CPTR p);
 #endif
 
 IMPORTPROC Sony_SetQuitOnEject(void);
+#if IncludeBench
+IMPORTPROC MicroBench_ExitNtfy(void);
+#endif
 
 IMPORTPROC m68k_IPLchangeNtfy(void);
 IMPORTPROC MINEM68K_Init(
@@ -81,7 +100,10 @@ IMPORTPROC put_vm_byte(CPTR addr, ui3r b);
 IMPORTPROC put_vm_word(CPTR addr, ui4r w);
 IMPORTPROC put_vm_long(CPTR addr, ui5r l);
 
-GLOBALVAR ui5r my_disk_icon_addr;
+GLOBALINSTVAR ui5r my_disk_icon_addr;
+#if IncludeExtnHostFS
+GLOBALINSTVAR ui5r my_hostfs_call_addr = 0;
+#endif
 
 GLOBALPROC customreset(void)
 {
@@ -107,17 +129,17 @@ GLOBALPROC customreset(void)
 #endif
 }
 
-GLOBALVAR ui3p RAM = nullpr;
+GLOBALINSTVAR ui3p RAM = nullpr;
 
 #if EmVidCard
-GLOBALVAR ui3p VidROM = nullpr;
+GLOBALINSTVAR ui3p VidROM = nullpr;
 #endif
 
 #if IncludeVidMem
-GLOBALVAR ui3p VidMem = nullpr;
+GLOBALINSTVAR ui3p VidMem = nullpr;
 #endif
 
-GLOBALVAR ui3b Wires[kNumWires];
+GLOBALINSTVAR ui3b Wires[kNumWires];
 
 
 #if WantDisasm
@@ -143,7 +165,29 @@ GLOBALPROC dbglog_WriteMemArrow(blnr WriteMem)
 }
 #endif
 
-#if dbglog_HAVE
+#if IncludeTrace
+IMPORTFUNC CPTR m68k_SamplePC(void);
+
+GLOBALPROC Trace_Event(ui3r Kind, ui3r Sub, ui5r Id,
+	ui5r Addr, ui5r Data)
+{
+	Trace_Put(GetCuriCount(), TraceInfo(Kind, Sub, Id),
+		Addr, Data, m68k_SamplePC());
+}
+
+#define TraceFlWrite(WriteMem) ((WriteMem) ? kTraceFlWrite : 0)
+#endif
+
+#if IncludeTrace
+GLOBALPROC dbglog_AddrAccess(char *s, ui5r Data,
+	blnr WriteMem, ui5r addr)
+{
+	if (TraceOn) {
+		Trace_Event(kTraceAddrAccess, TraceFlWrite(WriteMem),
+			Trace_NameId(s), addr, Data);
+	}
+}
+#elif dbglog_HAVE
 GLOBALPROC dbglog_AddrAccess(char *s, ui5r Data,
 	blnr WriteMem, ui5r addr)
 {
@@ -158,7 +202,15 @@ GLOBALPROC dbglog_AddrAccess(char *s, ui5r Data,
 }
 #endif
 
-#if dbglog_HAVE
+#if IncludeTrace
+GLOBALPROC dbglog_Access(char *s, ui5r Data, blnr WriteMem)
+{
+	if (TraceOn) {
+		Trace_Event(kTraceAccess, TraceFlWrite(WriteMem),
+			Trace_NameId(s), 0, Data);
+	}
+}
+#elif dbglog_HAVE
 GLOBALPROC dbglog_Access(char *s, ui5r Data, blnr WriteMem)
 {
 	dbglog_StartLine();
@@ -169,7 +221,14 @@ GLOBALPROC dbglog_Access(char *s, ui5r Data, blnr WriteMem)
 }
 #endif
 
-#if dbglog_HAVE
+#if IncludeTrace
+GLOBALPROC dbglog_WriteNote(char *s)
+{
+	if (TraceOn) {
+		Trace_Event(kTraceNote, 0, Trace_NameId(s), 0, 0);
+	}
+}
+#elif dbglog_HAVE
 GLOBALPROC dbglog_WriteNote(char *s)
 {
 	dbglog_StartLine();
@@ -178,7 +237,14 @@ GLOBALPROC dbglog_WriteNote(char *s)
 }
 #endif
 
-#if dbglog_HAVE
+#if IncludeTrace
+GLOBALPROC dbglog_WriteSetBool(char *s, blnr v)
+{
+	if (TraceOn) {
+		Trace_Event(kTraceSetBool, 0, Trace_NameId(s), 0, v);
+	}
+}
+#elif dbglog_HAVE
 GLOBALPROC dbglog_WriteSetBool(char *s, blnr v)
 {
 	dbglog_StartLine();
@@ -193,7 +259,7 @@ GLOBALPROC dbglog_WriteSetBool(char *s, blnr v)
 }
 #endif
 
-LOCALVAR blnr GotOneAbnormal = falseblnr;
+LOCALINSTVAR blnr GotOneAbnormal = falseblnr;
 
 #ifndef ReportAbnormalInterrupt
 #define ReportAbnormalInterrupt 0
@@ -444,6 +510,187 @@ LOCALPROC ExtnHostTextClipExchange_Access(CPTR p)
 }
 #endif
 
+#if IncludeExtnHostFS
+#define kCmndHostFSFeatures 1
+#define kCmndHostFSLookup 2
+#define kCmndHostFSGetInfo 3
+#define kCmndHostFSSetInfo 4
+#define kCmndHostFSTransfer 5
+#define kCmndHostFSSetEOF 6
+#define kCmndHostFSCreate 7
+#define kCmndHostFSDelete 8
+
+#define kHostFSFeatPresent 0x00000001
+#define kHostFSFeatWritable 0x00000002
+#endif
+
+#if IncludeExtnHostFS
+LOCALFUNC tMacErr HostFSGetVMName(CPTR a, ui3p Name)
+{
+	/* copy pascal string from emulated memory */
+	ui3r L = get_vm_byte(a);
+	ui3r i;
+
+	if (L > 31) {
+		return mnvm_paramErr;
+	}
+	for (i = 0; i <= L; ++i) {
+		Name[i] = get_vm_byte(a + i);
+	}
+
+	return mnvm_noErr;
+}
+#endif
+
+#if IncludeExtnHostFS
+LOCALFUNC tMacErr HostFSTransferVM(blnr IsWrite, CPTR Buffera,
+	ui5r NodeID, blnr IsRsrc, ui5r Start, ui5r Count,
+	ui5r *ActCount)
+{
+	tMacErr result = mnvm_noErr;
+	ui5b contig;
+	ui5r n;
+	ui3p Buffer;
+
+	*ActCount = 0;
+	while ((0 != Count) && (mnvm_noErr == result)) {
+		Buffer = get_real_address0(Count, ! IsWrite, Buffera, &contig);
+		if (0 == contig) {
+			result = mnvm_miscErr;
+		} else {
+			result = HostFS_Transfer(IsWrite, Buffer, NodeID, IsRsrc,
+				Start, contig, &n);
+			*ActCount += n;
+			Start += contig;
+			Buffera += contig;
+			Count -= contig;
+		}
+	}
+
+	return result;
+}
+#endif
+
+#if IncludeExtnHostFS
+LOCALPROC ExtnHostFS_Access(CPTR p)
+{
+	tMacErr result = mnvm_controlErr;
+	ui3b Name[32];
+
+	switch (get_vm_word(p + ExtnDat_commnd)) {
+		case kCmndVersion:
+			put_vm_word(p + ExtnDat_version, 1);
+			result = mnvm_noErr;
+			break;
+		case kCmndHostFSFeatures:
+			put_vm_long(p + ExtnDat_params + 0,
+				(HostFS_Present() ? kHostFSFeatPresent : 0)
+				| (HostFS_IsWritable() ? kHostFSFeatWritable : 0));
+			put_vm_long(p + ExtnDat_params + 4, my_hostfs_call_addr);
+			result = mnvm_noErr;
+			break;
+		case kCmndHostFSLookup:
+			{
+				ui5r DirID = get_vm_long(p + ExtnDat_params + 0);
+				CPTR NameA = get_vm_long(p + ExtnDat_params + 4);
+				ui5r NodeID;
+
+				result = HostFSGetVMName(NameA, Name);
+				if (mnvm_noErr == result) {
+					result = HostFS_Lookup(DirID, Name, &NodeID);
+				}
+				if (mnvm_noErr == result) {
+					put_vm_long(p + ExtnDat_params + 8, NodeID);
+				}
+			}
+			break;
+		case kCmndHostFSGetInfo:
+			{
+				ui5r DirID = get_vm_long(p + ExtnDat_params + 0);
+				ui4r Index = get_vm_word(p + ExtnDat_params + 4);
+				/* reserved word at offset 6, should be zero */
+				ui5r NodeID = get_vm_long(p + ExtnDat_params + 8);
+				CPTR InfoA = get_vm_long(p + ExtnDat_params + 12);
+				ui3b Info[kHostFSInfoSz];
+				int i;
+
+				result = HostFS_GetInfo(DirID, Index, &NodeID, Info);
+				if (mnvm_noErr == result) {
+					put_vm_long(p + ExtnDat_params + 8, NodeID);
+					for (i = 0; i < kHostFSInfoSz; ++i) {
+						put_vm_byte(InfoA + i, Info[i]);
+					}
+				}
+			}
+			break;
+		case kCmndHostFSSetInfo:
+			{
+				ui5r NodeID = get_vm_long(p + ExtnDat_params + 0);
+				CPTR FInfoA = get_vm_long(p + ExtnDat_params + 4);
+				ui3b FInfo[kHostFSFInfoSz];
+				int i;
+
+				for (i = 0; i < kHostFSFInfoSz; ++i) {
+					FInfo[i] = get_vm_byte(FInfoA + i);
+				}
+				result = HostFS_SetInfo(NodeID, FInfo);
+			}
+			break;
+		case kCmndHostFSTransfer:
+			{
+				ui5r NodeID = get_vm_long(p + ExtnDat_params + 0);
+				blnr IsRsrc =
+					(get_vm_word(p + ExtnDat_params + 4) != 0);
+				blnr IsWrite =
+					(get_vm_word(p + ExtnDat_params + 6) != 0);
+				ui5r Start = get_vm_long(p + ExtnDat_params + 8);
+				ui5r Count = get_vm_long(p + ExtnDat_params + 12);
+				CPTR Buffera = get_vm_long(p + ExtnDat_params + 16);
+				ui5r ActCount;
+
+				result = HostFSTransferVM(IsWrite, Buffera,
+					NodeID, IsRsrc, Start, Count, &ActCount);
+				put_vm_long(p + ExtnDat_params + 20, ActCount);
+			}
+			break;
+		case kCmndHostFSSetEOF:
+			{
+				ui5r NodeID = get_vm_long(p + ExtnDat_params + 0);
+				blnr IsRsrc =
+					(get_vm_word(p + ExtnDat_params + 4) != 0);
+				/* reserved word at offset 6, should be zero */
+				ui5r Size = get_vm_long(p + ExtnDat_params + 8);
+
+				result = HostFS_SetEOF(NodeID, IsRsrc, Size);
+			}
+			break;
+		case kCmndHostFSCreate:
+			{
+				ui5r DirID = get_vm_long(p + ExtnDat_params + 0);
+				CPTR NameA = get_vm_long(p + ExtnDat_params + 4);
+				blnr IsDir =
+					(get_vm_word(p + ExtnDat_params + 8) != 0);
+				/* reserved word at offset 10, should be zero */
+				ui5r NodeID;
+
+				result = HostFSGetVMName(NameA, Name);
+				if (mnvm_noErr == result) {
+					result = HostFS_Create(DirID, Name, IsDir, &NodeID);
+				}
+				if (mnvm_noErr == result) {
+					put_vm_long(p + ExtnDat_params + 12, NodeID);
+				}
+			}
+			break;
+		case kCmndHostFSDelete:
+			result = HostFS_Delete(get_vm_long(p + ExtnDat_params + 0));
+			break;
+	}
+
+	put_vm_word(p + ExtnDat_result, result);
+}
+#endif
+
 #define kFindExtnExtension 0x64E1F58A
 #define kDiskDriverExtension 0x4C9219E6
 #if IncludeExtnPbufs
@@ -452,6 +699,9 @@ LOCALPROC ExtnHostTextClipExchange_Access(CPTR p)
 #if IncludeExtnHostTextClipExchange
 #define kHostClipExchangeExtension 0x27B130CA
 #endif
+#if IncludeExtnHostFS
+#define kHostFSExtension 0x48465356
+#endif
 
 #define kCmndFindExtnFind 1
 #define kCmndFindExtnId2Code 2
@@ -490,6 +740,12 @@ LOCALPROC ExtnFind_Access(CPTR p)
 						kExtnHostTextClipExchange);
 					result = mnvm_noErr;
 				} else
+#endif
+#if IncludeExtnHostFS
+				if (extn == kHostFSExtension) {
+					put_vm_word(p + kParamFindExtnTheId, kExtnHostFS);
+					result = mnvm_noErr;
+				} else
 #endif
 				if (extn == kFindExtnExtension) {
 					put_vm_word(p + kParamFindExtnTheId,
@@ -523,6 +779,13 @@ LOCALPROC ExtnFind_Access(CPTR p)
 						kHostClipExchangeExtension);
 					result = mnvm_noErr;
 				} else
+#endif
+#if IncludeExtnHostFS
+				if (extn == kExtnHostFS) {
+					put_vm_long(p + kParamFindExtnTheExtn,
+						kHostFSExtension);
+					result = mnvm_noErr;
+				} else
 #endif
 				if (extn == kExtnFindExtn) {
 					put_vm_long(p + kParamFindExtnTheExtn,
@@ -546,8 +809,11 @@ LOCALPROC ExtnFind_Access(CPTR p)
 #define kDSK_Params_Hi 0
 #define kDSK_Params_Lo 1
 #define kDSK_QuitOnEject 3 /* obsolete */
+#if IncludeBench
+#define kDSK_BenchExit 4 /* end of a microbenchmark stub */
+#endif
 
-LOCALVAR ui4b ParamAddrHi;
+LOCALINSTVAR ui4b ParamAddrHi;
 
 LOCALPROC Extn_Access(ui5b Data, CPTR addr)
 {
@@ -582,6 +848,11 @@ LOCALPROC Extn_Access(ui5b Data, CPTR addr)
 						case kExtnHostTextClipExchange:
 							ExtnHostTextClipExchange_Access(p);
 							break;
+#endif
+#if IncludeExtnHostFS
+						case kExtnHostFS:
+							ExtnHostFS_Access(p);
+							break;
 #endif
 						case kExtnDisk:
 							ExtnDisk_Access(p);
@@ -601,6 +872,11 @@ LOCALPROC Extn_Access(ui5b Data, CPTR addr)
 			/* obsolete, kept for compatibility */
 			Sony_SetQuitOnEject();
 			break;
+#if IncludeBench
+		case kDSK_BenchExit:
+			MicroBench_ExitNtfy();
+			break;
+#endif
 	}
 }
 
@@ -660,10 +936,57 @@ enum {
 #endif
 	kMMDV_SCSI,
 	kMMDV_IWM,
+#if IncludeWatch
+	kMMDV_Watch, /* watched memory, not a device */
+#endif
 
 	kNumMMDVs
 };
 
+#if IncludeMemStats
+LOCALINSTVAR ui5b MMDVStatCounts[kNumMMDVs];
+#endif
+
+#if IncludeMemStats || IncludeTrace
+LOCALVAR char *MMDVStatNames[kNumMMDVs] = {
+	"VIA1",
+#if EmVIA2
+	"VIA2",
+#endif
+	"SCC",
+	"Extn",
+#if EmASC
+	"ASC",
+#endif
+	"SCSI",
+	"IWM"
+#if IncludeWatch
+	, "Watch"
+#endif
+};
+#endif
+
+#if IncludeTrace
+LOCALVAR ui5r MMDVTraceIds[kNumMMDVs]; /* 0 until first traced */
+#endif
+
+#if IncludeMemStats
+GLOBALFUNC int MMDV_StatNum(void)
+{
+	return kNumMMDVs;
+}
+
+GLOBALFUNC char *MMDV_StatName(int i)
+{
+	return MMDVStatNames[i];
+}
+
+GLOBALFUNC ui5r MMDV_StatCount(int i)
+{
+	return MMDVStatCounts[i];
+}
+#endif
+
 enum {
 #if CurEmMd >= kEmMd_SE
 	kMAN_OverlayOff,
@@ -673,21 +996,123 @@ enum {
 };
 
 
-LOCALVAR ATTer ATTListA[MaxATTListN];
-LOCALVAR ui4r LastATTel;
+#if IncludeWatch
+#define kMaxWatches 16
+#define kMaxWatchBlocks 256
+#define ATTListSz (MaxATTListN + 512)
+	/* room for the pieces watched memory is carved into */
+#else
+#define ATTListSz MaxATTListN
+#endif
+
+LOCALINSTVAR ATTer ATTListA[ATTListSz];
+LOCALINSTVAR ui4r LastATTel;
 
 
-LOCALPROC AddToATTList(ATTep p)
+LOCALPROC AddOneToATTList(ATTep p)
 {
 	ui4r NewLast = LastATTel + 1;
-	if (NewLast >= MaxATTListN) {
-		ReportAbnormal("MaxATTListN not big enough");
+	if (NewLast >= ATTListSz) {
+		ReportAbnormal("ATTListSz not big enough");
 	} else {
 		ATTListA[LastATTel] = *p;
 		LastATTel = NewLast;
 	}
 }
 
+#if IncludeWatch
+LOCALINSTVAR ui5r WatchLo[kMaxWatches];
+LOCALINSTVAR ui5r WatchHi[kMaxWatches];
+LOCALINSTVAR ui3b WatchKind[kMaxWatches];
+LOCALINSTVAR int NWatches = 0;
+
+/* the watches as aligned blocks, that ATT entries can match */
+LOCALINSTVAR ui5r WatchBlockMask[kMaxWatchBlocks];
+LOCALINSTVAR ui5r WatchBlockValu[kMaxWatchBlocks];
+LOCALINSTVAR ui3b WatchBlockKind[kMaxWatchBlocks];
+LOCALINSTVAR int NWatchBlocks = 0;
+
+LOCALFUNC ui5r WatchAddrMask(void)
+{
+#if (CurEmMd == kEmMd_II) || (CurEmMd == kEmMd_IIx)
+	if (Addr32) {
+		return 0xFFFFFFFF;
+	}
+#endif
+	return 0x00FFFFFF;
+}
+
+LOCALPROC WatchCarve(ATTep p)
+{
+	/*
+		Split p into pieces that are either all in the watched
+		blocks or not in any, so that a MATC set up from a
+		piece never covers watched memory. Watched pieces lose
+		the ready bits of the kinds watched.
+	*/
+	ATTer r;
+	int i;
+	ui5r m;
+	ui5r Free;
+	ui5r Split = 0;
+	ui3r Kind = 0;
+	ui5r AddrMask = WatchAddrMask();
+
+	for (i = 0; i < NWatchBlocks; ++i) {
+		m = WatchBlockMask[i] & AddrMask;
+		if (0 == ((p->cmpvalu ^ WatchBlockValu[i]) & p->cmpmask & m)) {
+			Free = m & ~ p->cmpmask;
+			if (0 == Free) {
+				/* all of p is in this block */
+				Kind |= WatchBlockKind[i];
+			} else {
+				while (0 != (Free & (Free - 1))) {
+					Free &= Free - 1;
+				}
+				if (Free > Split) {
+					Split = Free;
+				}
+			}
+		}
+	}
+
+	if (0 != Split) {
+		r = *p;
+		r.cmpmask |= Split;
+		WatchCarve(&r);
+		r.cmpvalu |= Split;
+		WatchCarve(&r);
+	} else if (0 != Kind) {
+		r = *p;
+		r.Ntfy = p->Access & kATTA_readwritereadymask;
+		r.Access = kATTA_watchmask | kATTA_mmdvmask | r.Ntfy;
+		if (0 != (Kind & kWatchRead)) {
+			r.Access &= ~ kATTA_readreadymask;
+		}
+		if (0 != (Kind & kWatchWrite)) {
+			r.Access &= ~ kATTA_writereadymask;
+		}
+		r.MMDV = kMMDV_Watch;
+		AddOneToATTList(&r);
+	} else {
+		AddOneToATTList(p);
+	}
+}
+#endif
+
+LOCALPROC AddToATTList(ATTep p)
+{
+#if IncludeWatch
+	if ((0 != NWatchBlocks) && (0 != (p->Access & kATTA_readreadymask)))
+	{
+		WatchCarve(p);
+	} else
+#endif
+	{
+		AddOneToATTList(p);
+	}
+}
+
 LOCALPROC InitATTList(void)
 {
 	LastATTel = 0;
@@ -704,7 +1129,7 @@ LOCALPROC FinishATTList(void)
 		r.usemask = 0;
 		r.usebase = nullpr;
 		r.Access = 0;
-		AddToATTList(&r);
+		AddOneToATTList(&r);
 	}
 
 	{
@@ -1255,9 +1680,136 @@ LOCALPROC get_fail_realblock(ATTep p)
 }
 #endif
 
+#if IncludeWatch
+LOCALFUNC ui5b Watch_Access(ATTep p, ui5b Data,
+	blnr WriteMem, blnr ByteSize, CPTR addr)
+{
+	ui3p m = p->usebase + (addr & p->usemask);
+	ui5r a = addr & WatchAddrMask();
+	ui5r b = ByteSize ? a : (a + 1);
+	int i;
+
+	if (WriteMem) {
+		if (0 != (p->Ntfy & kATTA_writereadymask)) {
+#if IncludeRewind
+			if (RewindTracking) {
+				(void) Rewind_WriteNtfy(m);
+			}
+#endif
+			if (ByteSize) {
+				*m = Data;
+			} else {
+				do_put_mem_word(m, Data);
+			}
+		}
+	} else {
+		if (0 == (p->Ntfy & kATTA_readreadymask)) {
+			Data = 0;
+		} else if (ByteSize) {
+			Data = *m;
+		} else {
+			Data = do_get_mem_word(m);
+		}
+	}
+
+	if (TraceOn) {
+		/* the pieces are whole words, look for the bytes accessed */
+		for (i = 0; i < NWatches; ++i) {
+			if ((0 != (WatchKind[i]
+					& (WriteMem ? kWatchWrite : kWatchRead)))
+				&& (a <= WatchHi[i]) && (b >= WatchLo[i]))
+			{
+				Trace_Event(kTraceWatch,
+					TraceFlWrite(WriteMem)
+						| (ByteSize ? kTraceFlByte : 0),
+					i + 1, addr, Data);
+				break;
+			}
+		}
+	}
+
+	return Data;
+}
+
+LOCALPROC WatchSetUpBlocks(void)
+{
+	int i;
+	ui5r lo;
+	ui5r hi;
+	ui5r sz;
+	ui5r sz2;
+
+	NWatchBlocks = 0;
+	for (i = 0; i < NWatches; ++i) {
+		/* whole words, since a word access checks one address */
+		lo = WatchLo[i] & ~ (ui5r)1;
+		hi = WatchHi[i] | 1;
+		for (; ; ) {
+			/* the biggest aligned block starting at lo */
+			sz = 2;
+			for (; ; ) {
+				sz2 = sz << 1;
+				if ((0 == sz2) || (0 != (lo & (sz2 - 1)))
+					|| (hi - lo < sz2 - 1))
+				{
+					break;
+				}
+				sz = sz2;
+			}
+			if (NWatchBlocks >= kMaxWatchBlocks) {
+				ReportAbnormal("kMaxWatchBlocks not big enough");
+				return;
+			}
+			WatchBlockMask[NWatchBlocks] = ~ (sz - 1);
+			WatchBlockValu[NWatchBlocks] = lo;
+			WatchBlockKind[NWatchBlocks] = WatchKind[i];
+			++NWatchBlocks;
+			if (hi - lo == sz - 1) {
+				break;
+			}
+			lo += sz;
+		}
+	}
+}
+
+GLOBALFUNC blnr Watch_Add(ui5r Addr, ui5r Len, ui3r Kind)
+{
+	if ((NWatches >= kMaxWatches) || (0 == Len)
+		|| (Addr + (Len - 1) < Addr))
+	{
+		return falseblnr;
+	}
+
+	WatchLo[NWatches] = Addr;
+	WatchHi[NWatches] = Addr + (Len - 1);
+	WatchKind[NWatches] = Kind;
+	++NWatches;
+	WatchSetUpBlocks();
+	SetUpMemBanks();
+
+	return trueblnr;
+}
+
+GLOBALPROC Watch_ClearAll(void)
+{
+	NWatches = 0;
+	NWatchBlocks = 0;
+	SetUpMemBanks();
+}
+#endif
+
 GLOBALFUNC ui5b MMDV_Access(ATTep p, ui5b Data,
 	blnr WriteMem, blnr ByteSize, CPTR addr)
 {
+#if IncludeMemStats
+	++MMDVStatCounts[p->MMDV];
+#endif
+#if IncludeWatch
+	if (kMMDV_Watch == p->MMDV) {
+		return Watch_Access(p, Data, WriteMem, ByteSize, addr);
+	}
+#endif
+
 	switch (p->MMDV) {
 		case kMMDV_VIA1:
 			if (! ByteSize) {
@@ -1417,7 +1969,9 @@ GLOBALFUNC ui5b MMDV_Access(ATTep p, ui5b Data,
 					ReportAbnormal("access SCSI nonstandard address");
 				}
 #endif
-				Data = SCSI_Access(Data, WriteMem, (addr >> 4) & 0x07);
+				Data = SCSI_Access(Data, WriteMem,
+					((addr >> 4) & 0x07) | ((addr >> 6) & 0x08));
+					/* register, and pseudo DMA (A9) */
 			}
 
 			break;
@@ -1462,6 +2016,19 @@ GLOBALFUNC ui5b MMDV_Access(ATTep p, ui5b Data,
 			break;
 	}
 
+#if IncludeTrace
+	/* after, so a read has the value read */
+	if (TraceOn) {
+		if (0 == MMDVTraceIds[p->MMDV]) {
+			MMDVTraceIds[p->MMDV] =
+				Trace_NameId(MMDVStatNames[p->MMDV]);
+		}
+		Trace_Event(kTraceDevice,
+			TraceFlWrite(WriteMem) | (ByteSize ? kTraceFlByte : 0),
+			MMDVTraceIds[p->MMDV], addr, Data);
+	}
+#endif
+
 	return Data;
 }
 
@@ -1512,7 +2079,16 @@ Label_Retry:
 		(WriteMem ? kATTA_writereadymask : kATTA_readreadymask)))
 	{
 		/* ok */
-	} else {
+	} else
+#if IncludeWatch
+	if ((0 != (p->Access & kATTA_watchmask))
+		&& (0 != (p->Ntfy &
+			(WriteMem ? kATTA_writereadymask : kATTA_readreadymask))))
+	{
+		/* bulk transfers to watched memory aren't seen */
+	} else
+#endif
+	{
 		if (0 != (p->Access & kATTA_ntfymask)) {
 			if (MemAccessNtfy(p)) {
 				goto Label_Retry;
@@ -1580,10 +2156,22 @@ label_1:
 		}
 	}
 
+#if IncludeRewind
+	if (WritableMem && RewindTracking && (0 != *actL)) {
+		/* at least one address in each page written */
+		ui5b i;
+
+		for (i = 0; i < *actL; i += kRewindPageSz) {
+			(void) Rewind_WriteNtfy(p + i);
+		}
+		(void) Rewind_WriteNtfy(p + *actL - 1);
+	}
+#endif
+
 	return p;
 }
 
-GLOBALVAR blnr InterruptButton = falseblnr;
+GLOBALINSTVAR blnr InterruptButton = falseblnr;
 
 GLOBALPROC SetInterruptButton(blnr v)
 {
@@ -1593,7 +2181,7 @@ GLOBALPROC SetInterruptButton(blnr v)
 	}
 }
 
-LOCALVAR ui3b CurIPL = 0;
+LOCALINSTVAR ui3b CurIPL = 0;
 
 GLOBALPROC VIAorSCCinterruptChngNtfy(void)
 {
@@ -1656,7 +2244,7 @@ GLOBALPROC PowerOff_ChangeNtfy(void)
 /* user event queue utilities */
 
 #if HaveMasterMyEvtQLock
-GLOBALVAR ui4r MasterMyEvtQLock = 0;
+GLOBALINSTVAR ui4r MasterMyEvtQLock = 0;
 	/*
 		Takes a few ticks to process button event because
 		of debounce code of Mac. So have this mechanism
@@ -1691,8 +2279,8 @@ GLOBALFUNC blnr FindKeyEvent(int *VirtualKey, blnr *KeyDown)
 #include <stdio.h>
 #endif
 
-GLOBALVAR uimr ICTactive;
-GLOBALVAR iCountt ICTwhen[kNumICTs];
+GLOBALINSTVAR uimr ICTactive;
+GLOBALINSTVAR iCountt ICTwhen[kNumICTs];
 
 GLOBALPROC ICT_Zap(void)
 {
@@ -1705,7 +2293,7 @@ LOCALPROC InsertICT(int taskid, iCountt when)
 	ICTactive |= (1 << taskid);
 }
 
-GLOBALVAR iCountt NextiCount = 0;
+GLOBALINSTVAR iCountt NextiCount = 0;
 
 GLOBALFUNC iCountt GetCuriCount(void)
 {
@@ -1728,3 +2316,24 @@ GLOBALPROC ICT_add(int taskid, ui5b n)
 		NextiCount = when;
 	}
 }
+
+#if IncludeSaveState
+GLOBALPROC AddrSpac_StateXfer(void)
+{
+	StateXferVar(Wires);
+	StateXferVar(CurIPL);
+	StateXferVar(InterruptButton);
+	StateXferVar(ParamAddrHi);
+#if HaveMasterMyEvtQLock
+	StateXferVar(MasterMyEvtQLock);
+#endif
+	StateXferVar(ICTactive);
+	StateXferVar(ICTwhen);
+	StateXferVar(NextiCount);
+
+	if (StateLoading) {
+		/* memory map follows from the wires */
+		SetUpMemBanks();
+	}
+}
+#endif
@@ -34,7 +34,7 @@
 #define RAMSafetyMarginFudge 4
 
 #define kRAM_Size (kRAMa_Size + kRAMb_Size)
-EXPORTVAR(ui3p, RAM)
+EXPORTINSTVAR(ui3p, RAM)
 	/*
 		allocated by MYOSGLUE to be at least
 			kRAM_Size + RAMSafetyMarginFudge
@@ -43,11 +43,11 @@ EXPORTVAR(ui3p, RAM)
 	*/
 
 #if EmVidCard
-EXPORTVAR(ui3p, VidROM)
+EXPORTINSTVAR(ui3p, VidROM)
 #endif
 
 #if IncludeVidMem
-EXPORTVAR(ui3p, VidMem)
+EXPORTINSTVAR(ui3p, VidMem)
 #endif
 
 EXPORTPROC MemOverlay_ChangeNtfy(void);
@@ -78,9 +78,40 @@ EXPORTFUNC ui3p get_real_address0(ui5b L, blnr WritableMem, CPTR addr,
 #define get_ram_word(addr) do_get_mem_word((addr) + RAM)
 #define get_ram_long(addr) do_get_mem_long((addr) + RAM)
 
+#if IncludeRewind
+#define kLn2RewindPageSz 12
+#define kRewindPageSz (1 << kLn2RewindPageSz)
+
+EXPORTINSTVAR(blnr, RewindTracking)
+EXPORTFUNC blnr Rewind_WriteNtfy(ui3p m);
+	/*
+		to be called before writing to host address m, returns
+		true if m is in memory that is tracked for rewinding.
+	*/
+
+#define RewindRAMWrite(addr, n) \
+	if (RewindTracking) { \
+		(void) Rewind_WriteNtfy((addr) + RAM); \
+		(void) Rewind_WriteNtfy((addr) + (n) - 1 + RAM); \
+	}
+
+#define put_ram_byte(addr, b) do { \
+		RewindRAMWrite(addr, 1); \
+		do_put_mem_byte((addr) + RAM, (b)); \
+	} while (0)
+#define put_ram_word(addr, w) do { \
+		RewindRAMWrite(addr, 2); \
+		do_put_mem_word((addr) + RAM, (w)); \
+	} while (0)
+#define put_ram_long(addr, l) do { \
+		RewindRAMWrite(addr, 4); \
+		do_put_mem_long((addr) + RAM, (l)); \
+	} while (0)
+#else
 #define put_ram_byte(addr, b) do_put_mem_byte((addr) + RAM, (b))
 #define put_ram_word(addr, w) do_put_mem_word((addr) + RAM, (w))
 #define put_ram_long(addr, l) do_put_mem_long((addr) + RAM, (l))
+#endif
 
 #define get_ram_address(addr) ((addr) + RAM)
 
@@ -109,9 +140,16 @@ EXPORTPROC dbglog_StartLine(void);
 #define dbglog_StartLine()
 #endif
 
+#if IncludeTrace
+EXPORTPROC Trace_Event(ui3r Kind, ui3r Sub, ui5r Id,
+	ui5r Addr, ui5r Data);
+#endif
+
 #if dbglog_HAVE
 EXPORTPROC dbglog_WriteMemArrow(blnr WriteMem);
+#endif
 
+#if dbglog_HAVE || IncludeTrace
 EXPORTPROC dbglog_WriteNote(char *s);
 EXPORTPROC dbglog_WriteSetBool(char *s, blnr v);
 EXPORTPROC dbglog_AddrAccess(char *s,
@@ -129,7 +167,7 @@ EXPORTPROC DoReportAbnormal(void);
 
 EXPORTPROC VIAorSCCinterruptChngNtfy(void);
 
-EXPORTVAR(blnr, InterruptButton)
+EXPORTINSTVAR(blnr, InterruptButton)
 EXPORTPROC SetInterruptButton(blnr v);
 
 enum {
@@ -150,6 +188,9 @@ enum {
 	kICT_VIA2_Timer1Check,
 	kICT_VIA2_Timer2Check,
 #endif
+#if IncludeProfile
+	kICT_Profile,
+#endif
 
 	kNumICTs
 };
@@ -160,11 +201,11 @@ EXPORTPROC ICT_add(int taskid, ui5b n);
 EXPORTFUNC iCountt GetCuriCount(void);
 EXPORTPROC ICT_Zap(void);
 
-EXPORTVAR(uimr, ICTactive)
-EXPORTVAR(iCountt, ICTwhen[kNumICTs])
-EXPORTVAR(iCountt, NextiCount)
+EXPORTINSTVAR(uimr, ICTactive)
+EXPORTINSTVAR(iCountt, ICTwhen[kNumICTs])
+EXPORTINSTVAR(iCountt, NextiCount)
 
-EXPORTVAR(ui3b, Wires[kNumWires])
+EXPORTINSTVAR(ui3b, Wires[kNumWires])
 
 #define kLn2CycleScale 6
 #define kCycleScale (1 << kLn2CycleScale)
@@ -179,7 +220,7 @@ EXPORTVAR(ui3b, Wires[kNumWires])
 
 #define HaveMasterMyEvtQLock EmClassicKbrd
 #if HaveMasterMyEvtQLock
-EXPORTVAR(ui4r, MasterMyEvtQLock)
+EXPORTINSTVAR(ui4r, MasterMyEvtQLock)
 #endif
 EXPORTFUNC blnr FindKeyEvent(int *VirtualKey, blnr *KeyDown);
 
@@ -209,18 +250,28 @@ enum {
 #if IncludeExtnHostTextClipExchange
 	kExtnHostTextClipExchange,
 #endif
+#if IncludeExtnHostFS
+	kExtnHostFS,
+#endif
 
 	kNumExtns
 };
 
 #define kcom_callcheck 0x5B17
 
-EXPORTVAR(ui5r, my_disk_icon_addr)
+EXPORTINSTVAR(ui5r, my_disk_icon_addr)
+#if IncludeExtnHostFS
+EXPORTINSTVAR(ui5r, my_hostfs_call_addr)
+#endif
 
 EXPORTPROC Memory_Reset(void);
 
 EXPORTPROC Extn_Reset(void);
 
+#if IncludeSaveState
+EXPORTPROC AddrSpac_StateXfer(void);
+#endif
+
 EXPORTPROC customreset(void);
 
 struct ATTer {
@@ -242,6 +293,11 @@ typedef ATTer *ATTep;
 #define kATTA_writereadybit 1
 #define kATTA_mmdvbit 2
 #define kATTA_ntfybit 3
+#define kATTA_watchbit 4
+	/*
+		memory, with accesses of the kinds watched going through
+		MMDV_Access. Ntfy has the ready bits of the memory.
+	*/
 
 #define kATTA_readwritereadymask \
 	((1 << kATTA_readreadybit) | (1 << kATTA_writereadybit))
@@ -249,6 +305,7 @@ typedef ATTer *ATTep;
 #define kATTA_writereadymask (1 << kATTA_writereadybit)
 #define kATTA_mmdvmask (1 << kATTA_mmdvbit)
 #define kATTA_ntfymask (1 << kATTA_ntfybit)
+#define kATTA_watchmask (1 << kATTA_watchbit)
 
 EXPORTFUNC ui5b MMDV_Access(ATTep p, ui5b Data,
 	blnr WriteMem, blnr ByteSize, CPTR addr);
@@ -0,0 +1,922 @@
+/*
+	HOSTFSDV.h
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	HOST File System DeVice
+
+	Included by the platform glue. Presents a host directory to
+	the emulated machine, through the HostFS extension, as an
+	HFS like volume of numbered directories and files.
+
+	Every host file or directory seen gets a node, whose number
+	stays the same for the rest of the session, so the Mac can
+	use it as a directory or file id. Metadata from the host
+	(stat results, directory listings) is cached per node, so
+	that the Finder polling a window doesn't turn into a stream
+	of host system calls.
+
+	The resource fork and Finder info of "dir/name" live in the
+	sidecar files "dir/.rsrc/name" and "dir/.finf/name" (32
+	bytes, FInfo followed by FXInfo), the same layout used by
+	some other emulators, so a shared directory can be used by
+	either. Host names starting with '.' are not shown.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+
+#include "DATE2SEC.h"
+
+#define kHostFSMaxNodes 4096
+#define kHostFSFirstFileID 16
+	/* ids below this (other than the root) are reserved by HFS */
+
+#define kLn2HostFSHashSz 10
+#define kHostFSHashSz (1 << kLn2HostFSHashSz)
+
+#define kHostFSCacheSecs 2
+	/* how long a stat result is trusted */
+
+#define kHostFSMaxDepth 64
+#define kHostFSMaxPath 1024
+
+#define kHostFSNumForks 4
+	/* number of open host files kept around */
+
+LOCALVAR char *HostFSRootPath = NULL;
+LOCALVAR blnr HostFSWritable = falseblnr;
+LOCALVAR ui5r HostFSNumNodes = 0;
+
+/* node table, slot 0 is the root directory */
+LOCALVAR char *HostFSNodeName[kHostFSMaxNodes];
+LOCALVAR ui5r HostFSNodeParent[kHostFSMaxNodes];
+LOCALVAR ui5r HostFSNodeNext[kHostFSMaxNodes];
+LOCALVAR ui5r HostFSHashHead[kHostFSHashSz];
+
+/* metadata cache */
+LOCALVAR time_t HostFSNodeStamp[kHostFSMaxNodes];
+	/* when cached, 0 if not */
+LOCALVAR blnr HostFSNodeIsDir[kHostFSMaxNodes];
+LOCALVAR ui5r HostFSNodeDataLen[kHostFSMaxNodes];
+LOCALVAR ui5r HostFSNodeRsrcLen[kHostFSMaxNodes];
+LOCALVAR ui5r HostFSNodeMdDat[kHostFSMaxNodes];
+LOCALVAR ui3b HostFSNodeFInfo[kHostFSMaxNodes][kHostFSFInfoSz];
+
+/* directory listing cache */
+LOCALVAR ui5r *HostFSDirKids[kHostFSMaxNodes];
+LOCALVAR ui5r HostFSDirNKids[kHostFSMaxNodes];
+LOCALVAR time_t HostFSDirMTime[kHostFSMaxNodes];
+LOCALVAR time_t HostFSDirListTime[kHostFSMaxNodes];
+
+/* open forks */
+LOCALVAR FILE *HostFSForkFile[kHostFSNumForks];
+LOCALVAR ui5r HostFSForkNode[kHostFSNumForks];
+LOCALVAR blnr HostFSForkIsRsrc[kHostFSNumForks];
+LOCALVAR blnr HostFSForkWritable[kHostFSNumForks];
+LOCALVAR ui5r HostFSForkAge[kHostFSNumForks];
+LOCALVAR ui5r HostFSForkClock = 0;
+
+#define HostFSSlot2Id(slot) \
+	((0 == (slot)) ? kHostFSRootID : (slot) + (kHostFSFirstFileID - 1))
+
+LOCALFUNC tMacErr HostFSId2Slot(ui5r id, ui5r *slot)
+{
+	if (kHostFSRootID == id) {
+		*slot = 0;
+	} else if ((id >= kHostFSFirstFileID)
+		&& (id - (kHostFSFirstFileID - 1) < HostFSNumNodes))
+	{
+		*slot = id - (kHostFSFirstFileID - 1);
+	} else {
+		return mnvm_fnfErr;
+	}
+
+	return mnvm_noErr;
+}
+
+LOCALFUNC ui5r HostFSHash(ui5r parent, char *name)
+{
+	ui5r h = parent;
+
+	while (0 != *name) {
+		h = h * 31 + (ui3b)*name++;
+	}
+
+	return (ui5r)(h * (ui5r)2654435761UL) >> (32 - kLn2HostFSHashSz);
+}
+
+LOCALFUNC blnr HostFSGetPath(ui5r slot, char *sub, char *path)
+{
+	/*
+		path of node slot, or if sub is not NULL, of
+		the sidecar file in directory sub for it.
+	*/
+	ui5r chain[kHostFSMaxDepth];
+	int n = 0;
+	size_t L;
+
+	if ((0 == slot) && (NULL != sub)) {
+		return falseblnr;
+	}
+	while (0 != slot) {
+		if (n >= kHostFSMaxDepth) {
+			return falseblnr;
+		}
+		chain[n++] = slot;
+		slot = HostFSNodeParent[slot];
+	}
+
+	L = strlen(HostFSRootPath);
+	if (L >= kHostFSMaxPath) {
+		return falseblnr;
+	}
+	strcpy(path, HostFSRootPath);
+	while (--n >= 0) {
+		char *s = HostFSNodeName[chain[n]];
+
+		if ((0 == n) && (NULL != sub)) {
+			if (L + strlen(sub) + 2 >= kHostFSMaxPath) {
+				return falseblnr;
+			}
+			path[L++] = '/';
+			strcpy(path + L, sub);
+			L += strlen(sub);
+		}
+		if (L + strlen(s) + 2 >= kHostFSMaxPath) {
+			return falseblnr;
+		}
+		path[L++] = '/';
+		strcpy(path + L, s);
+		L += strlen(s);
+	}
+
+	return trueblnr;
+}
+
+LOCALFUNC blnr HostFSMakeSideDir(ui5r slot, char *sub)
+{
+	char path[kHostFSMaxPath];
+	char *p;
+
+	if (! HostFSGetPath(slot, sub, path)) {
+		return falseblnr;
+	}
+	p = strrchr(path, '/');
+	*p = 0;
+	return (0 == mkdir(path, 0777)) || (EEXIST == errno);
+}
+
+LOCALFUNC blnr HostFSName2Mac(char *s, ui3p r)
+{
+	/* to a pascal string, ':' and '/' swap */
+	ui3r L = 0;
+
+	while (0 != *s) {
+		if (L >= 31) {
+			return falseblnr;
+		}
+		r[++L] = (':' == *s) ? '/' : *s;
+		++s;
+	}
+	r[0] = L;
+
+	return (0 != L);
+}
+
+LOCALFUNC blnr HostFSMac2Name(ui3p s, char *r)
+{
+	ui3r L = s[0];
+	ui3r i;
+
+	if ((0 == L) || (L > 31) || ('.' == s[1])) {
+		return falseblnr;
+	}
+	for (i = 1; i <= L; ++i) {
+		if (0 == s[i]) {
+			return falseblnr;
+		}
+		*r++ = ('/' == s[i]) ? ':' : s[i];
+	}
+	*r = 0;
+
+	return trueblnr;
+}
+
+LOCALFUNC blnr HostFSMacNamesEqual(ui3p a, ui3p b)
+{
+	/* the File Manager ignores case */
+	ui3r i;
+
+	if (a[0] != b[0]) {
+		return falseblnr;
+	}
+	for (i = 1; i <= a[0]; ++i) {
+		ui3r c1 = a[i];
+		ui3r c2 = b[i];
+
+		if ((c1 >= 'a') && (c1 <= 'z')) {
+			c1 -= 'a' - 'A';
+		}
+		if ((c2 >= 'a') && (c2 <= 'z')) {
+			c2 -= 'a' - 'A';
+		}
+		if (c1 != c2) {
+			return falseblnr;
+		}
+	}
+
+	return trueblnr;
+}
+
+LOCALFUNC ui5r HostFSMacDate(time_t t)
+{
+	struct tm *tm = localtime(&t);
+
+	if (NULL == tm) {
+		return 0;
+	}
+	return Date2MacSeconds(tm->tm_sec, tm->tm_min, tm->tm_hour,
+		tm->tm_mday, tm->tm_mon + 1, tm->tm_year + 1900);
+}
+
+LOCALPROC HostFSDefaultFInfo(ui5r slot, ui3p p)
+{
+	char *s = HostFSNodeName[slot];
+	size_t L;
+
+	memset(p, 0, kHostFSFInfoSz);
+	if (HostFSNodeIsDir[slot]) {
+		/* no FInfo, Finder fills in DInfo */
+	} else if (((L = strlen(s)) > 4)
+		&& (0 == strcmp(s + L - 4, ".txt")))
+	{
+		do_put_mem_long(p + 0, 0x54455854); /* 'TEXT' */
+		do_put_mem_long(p + 4, 0x74747874); /* 'ttxt' */
+	} else {
+		do_put_mem_long(p + 0, 0x3F3F3F3F); /* '????' */
+		do_put_mem_long(p + 4, 0x3F3F3F3F);
+	}
+}
+
+LOCALFUNC tMacErr HostFSRefresh(ui5r slot)
+{
+	/* make sure the cached metadata for slot is current */
+	char path[kHostFSMaxPath];
+	struct stat st;
+	time_t now = time(NULL);
+	FILE *f;
+
+	if ((0 != HostFSNodeStamp[slot])
+		&& (now - HostFSNodeStamp[slot] < kHostFSCacheSecs))
+	{
+		return mnvm_noErr;
+	}
+
+	if ((! HostFSGetPath(slot, NULL, path))
+		|| (0 != stat(path, &st)))
+	{
+		HostFSNodeStamp[slot] = 0;
+		return mnvm_fnfErr;
+	}
+	HostFSNodeIsDir[slot] = S_ISDIR(st.st_mode);
+	HostFSNodeDataLen[slot] = HostFSNodeIsDir[slot] ? 0
+		: (st.st_size > 0x7FFFFFFF) ? 0x7FFFFFFF : st.st_size;
+	HostFSNodeMdDat[slot] = HostFSMacDate(st.st_mtime);
+
+	HostFSNodeRsrcLen[slot] = 0;
+	if ((0 != slot) && ! HostFSNodeIsDir[slot]
+		&& HostFSGetPath(slot, ".rsrc", path)
+		&& (0 == stat(path, &st)))
+	{
+		HostFSNodeRsrcLen[slot] =
+			(st.st_size > 0x7FFFFFFF) ? 0x7FFFFFFF : st.st_size;
+	}
+
+	if ((0 != slot) && HostFSGetPath(slot, ".finf", path)
+		&& (NULL != (f = fopen(path, "rb"))))
+	{
+		if (kHostFSFInfoSz != fread(HostFSNodeFInfo[slot], 1,
+			kHostFSFInfoSz, f))
+		{
+			HostFSDefaultFInfo(slot, HostFSNodeFInfo[slot]);
+		}
+		fclose(f);
+	} else {
+		HostFSDefaultFInfo(slot, HostFSNodeFInfo[slot]);
+	}
+
+	HostFSNodeStamp[slot] = now;
+
+	return mnvm_noErr;
+}
+
+LOCALFUNC tMacErr HostFSFindNode(ui5r parent, char *name, ui5r *r)
+{
+	/* find or make the node for host file name in parent */
+	ui5r h = HostFSHash(parent, name);
+	ui5r slot = HostFSHashHead[h];
+	char *s;
+
+	while (0 != slot) {
+		if ((HostFSNodeParent[slot] == parent)
+			&& (0 == strcmp(HostFSNodeName[slot], name)))
+		{
+			*r = slot;
+			return mnvm_noErr;
+		}
+		slot = HostFSNodeNext[slot];
+	}
+
+	if (HostFSNumNodes >= kHostFSMaxNodes) {
+		return mnvm_tmfoErr;
+	}
+	s = (char *)malloc(strlen(name) + 1);
+	if (NULL == s) {
+		return mnvm_miscErr;
+	}
+	strcpy(s, name);
+
+	slot = HostFSNumNodes++;
+	HostFSNodeName[slot] = s;
+	HostFSNodeParent[slot] = parent;
+	HostFSNodeStamp[slot] = 0;
+	HostFSDirKids[slot] = NULL;
+	HostFSDirNKids[slot] = 0;
+	HostFSDirListTime[slot] = 0;
+	HostFSNodeNext[slot] = HostFSHashHead[h];
+	HostFSHashHead[h] = slot;
+	*r = slot;
+
+	return mnvm_noErr;
+}
+
+LOCALFUNC int HostFSKidCompare(const void *a, const void *b)
+{
+	return strcmp(HostFSNodeName[*(const ui5r *)a],
+		HostFSNodeName[*(const ui5r *)b]);
+}
+
+LOCALFUNC tMacErr HostFSListDir(ui5r slot)
+{
+	/* make sure the cached listing of directory slot is current */
+	char path[kHostFSMaxPath];
+	struct stat st;
+	DIR *d;
+	struct dirent *e;
+	ui3b MacName[32];
+	ui5r *kids = NULL;
+	ui5r n = 0;
+	ui5r nMax = 0;
+	ui5r kid;
+	time_t now = time(NULL);
+	tMacErr err;
+
+	if ((! HostFSGetPath(slot, NULL, path))
+		|| (0 != stat(path, &st)))
+	{
+		return mnvm_fnfErr;
+	}
+	if (! S_ISDIR(st.st_mode)) {
+		return mnvm_dirNFErr;
+	}
+	if ((0 != HostFSDirListTime[slot])
+		&& (st.st_mtime == HostFSDirMTime[slot])
+		&& (HostFSDirListTime[slot] > st.st_mtime))
+	{
+		/*
+			unchanged, and not listed in the same second
+			as the change, when the time alone can't tell.
+		*/
+		return mnvm_noErr;
+	}
+
+	d = opendir(path);
+	if (NULL == d) {
+		return mnvm_permErr;
+	}
+	while (NULL != (e = readdir(d))) {
+		if (('.' == e->d_name[0])
+			|| ! HostFSName2Mac(e->d_name, MacName))
+		{
+			continue;
+		}
+		err = HostFSFindNode(slot, e->d_name, &kid);
+		if (mnvm_noErr != err) {
+			closedir(d);
+			free(kids);
+			return err;
+		}
+		if (n >= nMax) {
+			ui5r *p;
+
+			nMax = (0 == nMax) ? 32 : 2 * nMax;
+			p = (ui5r *)realloc(kids, nMax * sizeof(ui5r));
+			if (NULL == p) {
+				closedir(d);
+				free(kids);
+				return mnvm_miscErr;
+			}
+			kids = p;
+		}
+		kids[n++] = kid;
+	}
+	closedir(d);
+
+	/* sorted, so that indexes stay put as long as nothing changes */
+	if (0 != n) {
+		qsort(kids, n, sizeof(ui5r), HostFSKidCompare);
+	}
+
+	free(HostFSDirKids[slot]);
+	HostFSDirKids[slot] = kids;
+	HostFSDirNKids[slot] = n;
+	HostFSDirMTime[slot] = st.st_mtime;
+	HostFSDirListTime[slot] = now;
+
+	return mnvm_noErr;
+}
+
+LOCALPROC HostFSInvalidate(ui5r slot)
+{
+	HostFSNodeStamp[slot] = 0;
+	HostFSDirListTime[HostFSNodeParent[slot]] = 0;
+	HostFSNodeStamp[HostFSNodeParent[slot]] = 0;
+}
+
+LOCALPROC HostFSCloseForks(ui5r slot)
+{
+	int i;
+
+	for (i = 0; i < kHostFSNumForks; ++i) {
+		if ((NULL != HostFSForkFile[i]) && (HostFSForkNode[i] == slot)) {
+			fclose(HostFSForkFile[i]);
+			HostFSForkFile[i] = NULL;
+		}
+	}
+}
+
+LOCALFUNC tMacErr HostFSOpenFork(ui5r slot, blnr IsRsrc,
+	blnr NeedWrite, FILE **r)
+{
+	char path[kHostFSMaxPath];
+	int i;
+	int j = 0;
+	FILE *f;
+	blnr Writable = HostFSWritable;
+
+	for (i = 0; i < kHostFSNumForks; ++i) {
+		if ((NULL != HostFSForkFile[i]) && (HostFSForkNode[i] == slot)
+			&& (HostFSForkIsRsrc[i] == IsRsrc))
+		{
+			if (NeedWrite && ! HostFSForkWritable[i]) {
+				return mnvm_wPrErr;
+			}
+			HostFSForkAge[i] = ++HostFSForkClock;
+			*r = HostFSForkFile[i];
+			return mnvm_noErr;
+		}
+	}
+
+	/* reuse a free entry, or else the least recently used */
+	for (i = 1; i < kHostFSNumForks; ++i) {
+		if ((NULL != HostFSForkFile[j])
+			&& ((NULL == HostFSForkFile[i])
+				|| (HostFSForkAge[i] < HostFSForkAge[j])))
+		{
+			j = i;
+		}
+	}
+
+	if (NeedWrite && ! Writable) {
+		return mnvm_wPrErr;
+	}
+	if (! HostFSGetPath(slot, IsRsrc ? ".rsrc" : NULL, path)) {
+		return mnvm_fnfErr;
+	}
+	f = Writable ? fopen(path, "r+b") : NULL;
+	if (NULL == f) {
+		f = fopen(path, "rb");
+		if (NULL != f) {
+			Writable = falseblnr;
+		} else if (IsRsrc && NeedWrite && HostFSMakeSideDir(slot, ".rsrc"))
+		{
+			f = fopen(path, "w+b");
+		}
+	}
+	if (NULL == f) {
+		/* a missing resource fork is just empty */
+		return IsRsrc ? mnvm_eofErr : mnvm_fnfErr;
+	}
+	if (NeedWrite && ! Writable) {
+		fclose(f);
+		return mnvm_wPrErr;
+	}
+
+	if (NULL != HostFSForkFile[j]) {
+		fclose(HostFSForkFile[j]);
+	}
+	HostFSForkFile[j] = f;
+	HostFSForkNode[j] = slot;
+	HostFSForkIsRsrc[j] = IsRsrc;
+	HostFSForkWritable[j] = Writable;
+	HostFSForkAge[j] = ++HostFSForkClock;
+	*r = f;
+
+	return mnvm_noErr;
+}
+
+LOCALPROC HostFSFillInfo(ui5r slot, ui3p Info)
+{
+	memset(Info, 0, kHostFSInfoSz);
+	if (0 == slot) {
+		char *s = strrchr(HostFSRootPath, '/');
+
+		s = ((NULL == s) || (0 == s[1])) ? HostFSRootPath : s + 1;
+		if (! HostFSName2Mac(s, Info + kHostFSInfo_Name)) {
+			HostFSName2Mac("Host", Info + kHostFSInfo_Name);
+		}
+		if (Info[kHostFSInfo_Name] > 27) {
+			Info[kHostFSInfo_Name] = 27; /* volume name limit */
+		}
+	} else {
+		(void) HostFSName2Mac(HostFSNodeName[slot],
+			Info + kHostFSInfo_Name);
+	}
+	do_put_mem_word(Info + kHostFSInfo_Flags,
+		(HostFSNodeIsDir[slot] ? kHostFSFlagDir : 0)
+		| (HostFSWritable ? 0 : kHostFSFlagLocked));
+	do_put_mem_long(Info + kHostFSInfo_Parent,
+		(0 == slot) ? 1 : HostFSSlot2Id(HostFSNodeParent[slot]));
+	do_put_mem_long(Info + kHostFSInfo_NodeID, HostFSSlot2Id(slot));
+	do_put_mem_long(Info + kHostFSInfo_DataLen,
+		HostFSNodeIsDir[slot] ? HostFSDirNKids[slot]
+			: HostFSNodeDataLen[slot]);
+	do_put_mem_long(Info + kHostFSInfo_RsrcLen, HostFSNodeRsrcLen[slot]);
+	do_put_mem_long(Info + kHostFSInfo_CrDat, HostFSNodeMdDat[slot]);
+	do_put_mem_long(Info + kHostFSInfo_MdDat, HostFSNodeMdDat[slot]);
+	MyMoveBytes((anyp)HostFSNodeFInfo[slot],
+		(anyp)(Info + kHostFSInfo_FInfo), kHostFSFInfoSz);
+}
+
+GLOBALFUNC blnr HostFS_Present(void)
+{
+	return NULL != HostFSRootPath;
+}
+
+GLOBALFUNC blnr HostFS_IsWritable(void)
+{
+	return HostFSWritable;
+}
+
+GLOBALFUNC tMacErr HostFS_Lookup(ui5r DirID, ui3p Name, ui5r *NodeID)
+{
+	ui5r slot;
+	ui5r i;
+	ui3b MacName[32];
+	tMacErr err;
+
+	if ((NULL == HostFSRootPath) || (Name[0] > 31)) {
+		return mnvm_fnfErr;
+	}
+	err = HostFSId2Slot(DirID, &slot);
+	if (mnvm_noErr == err) {
+		err = HostFSListDir(slot);
+	}
+	if (mnvm_noErr == err) {
+		err = mnvm_fnfErr;
+		for (i = 0; i < HostFSDirNKids[slot]; ++i) {
+			ui5r kid = HostFSDirKids[slot][i];
+
+			if (HostFSName2Mac(HostFSNodeName[kid], MacName)
+				&& HostFSMacNamesEqual(MacName, Name))
+			{
+				*NodeID = HostFSSlot2Id(kid);
+				err = mnvm_noErr;
+				break;
+			}
+		}
+	}
+
+	return err;
+}
+
+GLOBALFUNC tMacErr HostFS_GetInfo(ui5r DirID, ui4r Index,
+	ui5r *NodeID, ui3p Info)
+{
+	/* by Index (from 1) in directory DirID, or if 0, by NodeID */
+	ui5r slot;
+	tMacErr err;
+
+	if (NULL == HostFSRootPath) {
+		return mnvm_fnfErr;
+	}
+	if (0 != Index) {
+		err = HostFSId2Slot(DirID, &slot);
+		if (mnvm_noErr == err) {
+			err = HostFSListDir(slot);
+		}
+		if (mnvm_noErr == err) {
+			if (Index > HostFSDirNKids[slot]) {
+				err = mnvm_fnfErr;
+			} else {
+				slot = HostFSDirKids[slot][Index - 1];
+			}
+		}
+	} else {
+		err = HostFSId2Slot(*NodeID, &slot);
+	}
+	if (mnvm_noErr == err) {
+		err = HostFSRefresh(slot);
+	}
+	if ((mnvm_noErr == err) && HostFSNodeIsDir[slot]) {
+		/* valence */
+		err = HostFSListDir(slot);
+	}
+	if (mnvm_noErr == err) {
+		*NodeID = HostFSSlot2Id(slot);
+		HostFSFillInfo(slot, Info);
+	}
+
+	return err;
+}
+
+GLOBALFUNC tMacErr HostFS_SetInfo(ui5r NodeID, ui3p FInfo)
+{
+	char path[kHostFSMaxPath];
+	ui5r slot;
+	FILE *f;
+	tMacErr err = HostFSId2Slot(NodeID, &slot);
+
+	if (mnvm_noErr != err) {
+		return err;
+	}
+	if (! HostFSWritable) {
+		return mnvm_vLckdErr;
+	}
+	if (0 == slot) {
+		return mnvm_noErr; /* nowhere to keep it */
+	}
+	if ((! HostFSMakeSideDir(slot, ".finf"))
+		|| (! HostFSGetPath(slot, ".finf", path))
+		|| (NULL == (f = fopen(path, "wb"))))
+	{
+		return mnvm_permErr;
+	}
+	if (kHostFSFInfoSz != fwrite(FInfo, 1, kHostFSFInfoSz, f)) {
+		err = mnvm_miscErr;
+	}
+	if (0 != fclose(f)) {
+		err = mnvm_miscErr;
+	}
+	MyMoveBytes((anyp)FInfo, (anyp)HostFSNodeFInfo[slot],
+		kHostFSFInfoSz);
+
+	return err;
+}
+
+GLOBALFUNC tMacErr HostFS_Transfer(blnr IsWrite, ui3p Buffer,
+	ui5r NodeID, blnr IsRsrc, ui5r Start, ui5r Count,
+	ui5r *ActCount)
+{
+	ui5r slot;
+	FILE *f;
+	ui5r n = 0;
+	tMacErr err = HostFSId2Slot(NodeID, &slot);
+
+	if (mnvm_noErr == err) {
+		err = HostFSOpenFork(slot, IsRsrc, IsWrite, &f);
+	}
+	if (mnvm_noErr == err) {
+		if (0 != fseek(f, Start, SEEK_SET)) {
+			err = mnvm_miscErr;
+		} else if (IsWrite) {
+			n = fwrite(Buffer, 1, Count, f);
+			if ((n != Count) || (0 != fflush(f))) {
+				err = mnvm_miscErr;
+			}
+			HostFSNodeStamp[slot] = 0;
+		} else {
+			n = fread(Buffer, 1, Count, f);
+			if (n != Count) {
+				err = mnvm_eofErr;
+			}
+		}
+	} else if ((mnvm_eofErr == err) && (0 == Count)) {
+		err = mnvm_noErr;
+	}
+
+	if (nullpr != ActCount) {
+		*ActCount = n;
+	}
+
+	return err;
+}
+
+GLOBALFUNC tMacErr HostFS_SetEOF(ui5r NodeID, blnr IsRsrc, ui5r Size)
+{
+	char path[kHostFSMaxPath];
+	ui5r slot;
+	tMacErr err = HostFSId2Slot(NodeID, &slot);
+
+	if (mnvm_noErr != err) {
+		return err;
+	}
+	if (! HostFSWritable) {
+		return mnvm_wPrErr;
+	}
+	if (IsRsrc) {
+		/* make it exist first */
+		FILE *f;
+
+		err = HostFSOpenFork(slot, trueblnr, trueblnr, &f);
+		if (mnvm_noErr != err) {
+			return err;
+		}
+	}
+	HostFSCloseForks(slot);
+	HostFSNodeStamp[slot] = 0;
+	if ((! HostFSGetPath(slot, IsRsrc ? ".rsrc" : NULL, path))
+		|| (0 != truncate(path, Size)))
+	{
+		return mnvm_permErr;
+	}
+
+	return mnvm_noErr;
+}
+
+GLOBALFUNC tMacErr HostFS_Create(ui5r DirID, ui3p Name, blnr IsDir,
+	ui5r *NodeID)
+{
+	char path[kHostFSMaxPath];
+	char s[32];
+	ui5r slot;
+	ui5r kid;
+	size_t L;
+	tMacErr err = HostFSId2Slot(DirID, &slot);
+
+	if (mnvm_noErr != err) {
+		return err;
+	}
+	if (! HostFSWritable) {
+		return mnvm_vLckdErr;
+	}
+	if (! HostFSMac2Name(Name, s)) {
+		return mnvm_paramErr;
+	}
+	if (mnvm_noErr == HostFS_Lookup(DirID, Name, &kid)) {
+		return mnvm_dupFNErr;
+	}
+	if (! HostFSGetPath(slot, NULL, path)) {
+		return mnvm_dirNFErr;
+	}
+	L = strlen(path);
+	if (L + strlen(s) + 2 >= kHostFSMaxPath) {
+		return mnvm_paramErr;
+	}
+	path[L] = '/';
+	strcpy(path + L + 1, s);
+
+	if (IsDir) {
+		if (0 != mkdir(path, 0777)) {
+			return mnvm_permErr;
+		}
+	} else {
+		FILE *f = fopen(path, "wb");
+
+		if (NULL == f) {
+			return mnvm_permErr;
+		}
+		fclose(f);
+	}
+
+	err = HostFSFindNode(slot, s, &kid);
+	if (mnvm_noErr == err) {
+		HostFSInvalidate(kid);
+		*NodeID = HostFSSlot2Id(kid);
+	}
+
+	return err;
+}
+
+GLOBALFUNC tMacErr HostFS_Delete(ui5r NodeID)
+{
+	char path[kHostFSMaxPath];
+	size_t L;
+	ui5r slot;
+	tMacErr err = HostFSId2Slot(NodeID, &slot);
+
+	if (mnvm_noErr != err) {
+		return err;
+	}
+	if (0 == slot) {
+		return mnvm_permErr;
+	}
+	if (! HostFSWritable) {
+		return mnvm_vLckdErr;
+	}
+	err = HostFSRefresh(slot);
+	if (mnvm_noErr != err) {
+		return err;
+	}
+	HostFSCloseForks(slot);
+	if (! HostFSGetPath(slot, NULL, path)) {
+		return mnvm_fnfErr;
+	}
+	if (HostFSNodeIsDir[slot]) {
+		/*
+			the hidden sidecar directories of the folder's own
+			files, if all that is left in them was removed
+		*/
+		L = strlen(path);
+		if (L + 7 < kHostFSMaxPath) {
+			strcpy(path + L, "/.rsrc");
+			(void) rmdir(path);
+			strcpy(path + L, "/.finf");
+			(void) rmdir(path);
+			path[L] = 0;
+		}
+		if (0 != rmdir(path)) {
+			return mnvm_permErr; /* probably not empty */
+		}
+	} else {
+		if (0 != remove(path)) {
+			return mnvm_permErr;
+		}
+		if (HostFSGetPath(slot, ".rsrc", path)) {
+			(void) remove(path);
+		}
+	}
+	if (HostFSGetPath(slot, ".finf", path)) {
+		(void) remove(path);
+	}
+	HostFSInvalidate(slot);
+
+	return mnvm_noErr;
+}
+
+LOCALFUNC blnr HostFS_Init(char *s)
+{
+	struct stat st;
+	size_t L = strlen(s);
+
+	if ((0 == L) || (0 != stat(s, &st)) || ! S_ISDIR(st.st_mode)) {
+		return falseblnr;
+	}
+	while ((L > 1) && ('/' == s[L - 1])) {
+		--L;
+	}
+	HostFSRootPath = (char *)malloc(L + 1);
+	if (NULL == HostFSRootPath) {
+		return falseblnr;
+	}
+	memcpy(HostFSRootPath, s, L);
+	HostFSRootPath[L] = 0;
+	HostFSWritable = (0 == access(HostFSRootPath, W_OK));
+
+	/* the root node */
+	HostFSNodeName[0] = NULL;
+	HostFSNodeParent[0] = 0;
+	HostFSNodeStamp[0] = 0;
+	HostFSDirKids[0] = NULL;
+	HostFSDirNKids[0] = 0;
+	HostFSDirListTime[0] = 0;
+	HostFSNumNodes = 1;
+
+	return trueblnr;
+}
+
+LOCALPROC HostFS_UnInit(void)
+{
+	ui5r i;
+
+	for (i = 0; i < kHostFSNumForks; ++i) {
+		if (NULL != HostFSForkFile[i]) {
+			fclose(HostFSForkFile[i]);
+			HostFSForkFile[i] = NULL;
+		}
+	}
+	for (i = 0; i < HostFSNumNodes; ++i) {
+		free(HostFSNodeName[i]);
+		free(HostFSDirKids[i]);
+	}
+	HostFSNumNodes = 0;
+	free(HostFSRootPath);
+	HostFSRootPath = NULL;
+}
@@ -35,6 +35,9 @@
 #include "MYOSGLUE.h"
 #include "EMCONFIG.h"
 #include "GLOBGLUE.h"
+#if IncludeSaveState
+#include "SAVESTAT.h"
+#endif
 #endif
 
 #include "IWMEMDEV.h"
@@ -77,7 +80,7 @@ typedef struct
 	ui3b Lines;     /* Used to Access Disk Drive Registers */
 } IWM_Ty;
 
-IWM_Ty IWM;
+LOCALINSTVAR IWM_Ty IWM;
 
 GLOBALPROC IWM_Reset(void)
 {
@@ -208,3 +211,10 @@ GLOBALFUNC ui5b IWM_Access(ui5b Data, blnr WriteMem, CPTR addr)
 
 	return Data;
 }
+
+#if IncludeSaveState
+GLOBALPROC IWM_StateXfer(void)
+{
+	StateXferVar(IWM);
+}
+#endif
@@ -21,5 +21,8 @@
 #endif
 
 EXPORTPROC IWM_Reset(void);
+#if IncludeSaveState
+EXPORTPROC IWM_StateXfer(void);
+#endif
 
 EXPORTFUNC ui5b IWM_Access(ui5b Data, blnr WriteMem, CPTR addr);
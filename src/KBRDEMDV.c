@@ -27,6 +27,9 @@
 #include "MYOSGLUE.h"
 #include "EMCONFIG.h"
 #include "GLOBGLUE.h"
+#if IncludeSaveState
+#include "SAVESTAT.h"
+#endif
 #endif
 
 #include "KBRDEMDV.h"
@@ -47,10 +50,10 @@ enum {
 	kKybdStates
 };
 
-LOCALVAR int KybdState = kKybdStateIdle;
+LOCALINSTVAR int KybdState = kKybdStateIdle;
 
-LOCALVAR blnr HaveKeyBoardResult = falseblnr;
-LOCALVAR ui3b KeyBoardResult;
+LOCALINSTVAR blnr HaveKeyBoardResult = falseblnr;
+LOCALINSTVAR ui3b KeyBoardResult;
 
 LOCALPROC GotKeyBoardData(ui3b v)
 {
@@ -63,7 +66,7 @@ LOCALPROC GotKeyBoardData(ui3b v)
 	}
 }
 
-LOCALVAR ui3b InstantCommandData = 0x7B;
+LOCALINSTVAR ui3b InstantCommandData = 0x7B;
 
 LOCALFUNC blnr AttemptToFinishInquiry(void)
 {
@@ -99,7 +102,7 @@ LOCALFUNC blnr AttemptToFinishInquiry(void)
 		to keep connection.
 	*/
 
-LOCALVAR int InquiryCommandTimer = 0;
+LOCALINSTVAR int InquiryCommandTimer = 0;
 
 GLOBALPROC DoKybd_ReceiveCommand(void)
 {
@@ -206,3 +209,14 @@ GLOBALPROC KeyBoard_Update(void)
 		}
 	}
 }
+
+#if IncludeSaveState
+GLOBALPROC KeyBoard_StateXfer(void)
+{
+	StateXferVar(KybdState);
+	StateXferVar(HaveKeyBoardResult);
+	StateXferVar(KeyBoardResult);
+	StateXferVar(InstantCommandData);
+	StateXferVar(InquiryCommandTimer);
+}
+#endif
@@ -25,3 +25,6 @@ EXPORTPROC Kybd_DataLineChngNtfy(void);
 EXPORTPROC DoKybd_ReceiveEndCommand(void);
 EXPORTPROC DoKybd_ReceiveCommand(void);
 EXPORTPROC KeyBoard_Update(void);
+#if IncludeSaveState
+EXPORTPROC KeyBoard_StateXfer(void);
+#endif
@@ -2720,3 +2720,63 @@ GLOBALPROC M68KITAB_setup(DecOpR *p)
 		p[i].B = r.DecOp.B;
 	}
 }
+
+#if IncludeCPUTest || IncludeOpStats
+/* names, for reports */
+
+LOCALVAR char *IKindNames[kNumIKinds] = {
+	"Tst", "CmpB", "CmpW", "CmpL",
+	"BccB", "BccW", "BraB", "BraW",
+	"DBcc", "DBF", "Swap", "MoveL",
+	"MoveW", "MoveB", "MoveAL", "MoveAW",
+	"MoveQ", "AddB", "AddW", "AddL",
+	"SubB", "SubW", "SubL", "Lea",
+	"PEA", "A", "BsrB", "BsrW",
+	"Jsr", "LinkA6", "MOVEMRmML", "MOVEMApRL",
+	"UnlkA6", "Rts", "Jmp", "Clr",
+	"AddA", "AddQA", "SubA", "SubQA",
+	"CmpA", "AddXB", "AddXW", "AddXL",
+	"SubXB", "SubXW", "SubXL", "RolopNM",
+	"RolopND", "RolopDD", "BitOpDD", "BitOpDM",
+	"BitOpND", "BitOpNM", "AndI", "AndEaD",
+	"AndDEa", "OrI", "OrDEa", "OrEaD",
+	"Eor", "EorI", "Not", "Scc",
+	"NegXB", "NegXW", "NegXL", "NegB",
+	"NegW", "NegL", "EXTW", "EXTL",
+	"MulU", "MulS", "DivU", "DivS",
+	"Exgdd", "Exgaa", "Exgda", "MoveCCREa",
+	"MoveEaCCR", "MoveSREa", "MoveEaSR", "BinOpStatusCCR",
+	"MOVEMApRW", "MOVEMRmMW", "MOVEMrm", "MOVEMmr",
+	"Abcdr", "Abcdm", "Sbcdr", "Sbcdm",
+	"Nbcd", "Rte", "Nop", "MoveP",
+	"Illegal", "ChkW", "Trap", "TrapV",
+	"Rtr", "Link", "Unlk", "MoveRUSP",
+	"MoveUSPR", "Tas", "F", "CallMorRtm",
+	"Stop", "Reset",
+#if Use68020
+	"BraL", "BccL", "BsrL", "EXTBL",
+	"TRAPcc", "ChkL", "Bkpt", "DivL",
+	"MulL", "Rtd", "MoveC", "LinkL",
+	"Pack", "Unpk", "CHK2orCMP2", "CAS2",
+	"CAS", "MoveS", "BitField",
+#endif
+};
+
+LOCALVAR char *AMdNames[kNumAMds] = {
+	"Rn", "(An)", "(An)+.b", "(An)+.w",
+	"(An)+.l", "-(An).b", "-(An).w", "-(An).l",
+	"d16(An)", "d8(An,Xn)", "abs.w", "abs.l",
+	"d16(PC)", "d8(PC,Xn)", "#imm.b", "#imm.w",
+	"#imm.l", "#dat4"
+};
+
+GLOBALFUNC char *M68KITAB_KindName(ui5r k)
+{
+	return (k < kNumIKinds) ? IKindNames[k] : "?";
+}
+
+GLOBALFUNC char *M68KITAB_ModeName(ui5r AMd)
+{
+	return (AMd < kNumAMds) ? AMdNames[AMd] : "?";
+}
+#endif
@@ -232,3 +232,7 @@ typedef struct DecOpR DecOpR;
 #define SetDcoCycles(p, x) SetUi5rField((p)->B, 0, 16, x)
 
 EXPORTPROC M68KITAB_setup(DecOpR *p);
+#if IncludeCPUTest || IncludeOpStats
+EXPORTFUNC char *M68KITAB_KindName(ui5r k);
+EXPORTFUNC char *M68KITAB_ModeName(ui5r AMd);
+#endif
@@ -0,0 +1,49 @@
+/*
+	MEMSTATS.h
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+#ifdef MEMSTATS_H
+#error "header already included"
+#else
+#define MEMSTATS_H
+#endif
+
+/*
+	counts of how memory is reached, kept in MINEM68K.c for
+	the MATCs and the ATT, and in GLOBGLUE.c for devices.
+	The counts wrap, so are to be read at least once a second.
+	The word MATCs count words, so a long access counts two.
+*/
+
+#define kMemStatRdB 0 /* MATCrdB */
+#define kMemStatWrB 1
+#define kMemStatRdW 2
+#define kMemStatWrW 3
+#define kMemStatEx 4
+#define kNumMemStatMATCs 5
+
+#define kMemStatWalkBuckets 8 /* the last for walks at least this long */
+
+#define kMemStatHit 0 /* i is the MATC */
+#define kMemStatMiss 1 /* i is the MATC */
+#define kMemStatFind 2 /* calls of FindATTel */
+#define kMemStatStep 3 /* list elements passed over */
+#define kMemStatMove 4 /* elements moved to the front */
+#define kMemStatWalk 5 /* i is the walk length */
+EXPORTFUNC ui5r m68k_MemStatGet(int What, int i);
+
+EXPORTFUNC int MMDV_StatNum(void);
+EXPORTFUNC char *MMDV_StatName(int i);
+EXPORTFUNC ui5r MMDV_StatCount(int i); /* calls of MMDV_Access */
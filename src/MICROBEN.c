@@ -0,0 +1,258 @@
+/*
+	MICROBEN.c
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	MICRO BENchmarks
+
+	For timing the emulated CPU by itself, without needing a Mac
+	ROM. A stub ROM is built, which copies a small loop to RAM
+	(at its address while the overlay is on, as after reset) and
+	runs it a given number of times, then writes to an address
+	in the extension block to say it is done. Each loop mostly
+	uses one kind of instruction.
+
+	The stub starts with kMicroBenchSig where the checksum of a
+	real ROM would be, so ROM_Init knows to leave it alone.
+*/
+
+#ifndef AllFiles
+#include "SYSDEPNS.h"
+#include "MYOSGLUE.h"
+#include "ENDIANAC.h"
+#include "EMCONFIG.h"
+#include "GLOBGLUE.h"
+#include "MINEM68K.h"
+#endif
+
+#include "MICROBEN.h"
+
+#if IncludeBench
+
+#define kMicroBenchSig 0x6D765542 /* 'mvUB' */
+
+#define kMB_RAM 0x00600000 /* RAM, while the overlay is on */
+#define kMB_Code (kMB_RAM + 0x1000)
+#define kMB_Data (kMB_RAM + 0x8000)
+#define kMB_Stack (kMB_RAM + 0x10000)
+#define kMB_Exit (kExtn_Block_Base + 8)
+	/* kDSK_BenchExit in GLOBGLUE.c */
+
+#define kMB_StartOffset 0x0100
+#define kMB_KernelOffset 0x0200
+	/* below the places ROM_Init patches in a real ROM */
+
+/* loop bodies, run with D7 counting down, A6 at kMB_Data */
+
+LOCALVAR const ui4b MicroBenchALU[] = {
+	0xD081, /* add.l d1,d0 */
+	0x9682, /* sub.l d2,d3 */
+	0xC880, /* and.l d0,d4 */
+	0x8A83, /* or.l d3,d5 */
+	0xBB81, /* eor.l d5,d1 */
+	0xE78A, /* lsl.l #3,d2 */
+	0x5A86, /* addq.l #5,d6 */
+	0x4684, /* not.l d4 */
+	0x4485, /* neg.l d5 */
+	0x2400, /* move.l d0,d2 */
+	0xC6C1, /* mulu.w d1,d3 */
+	0x4843, /* swap d3 */
+	0xB280  /* cmp.l d0,d1 */
+};
+
+LOCALVAR const ui4b MicroBenchBranch[] = {
+	0x4A80, /* tst.l d0 */
+	0x6702, /* beq.s +2 */
+	0x5281, /* addq.l #1,d1 */
+	0xB481, /* cmp.l d1,d2 */
+	0x6602, /* bne.s +2 */
+	0x7400, /* moveq #0,d2 */
+	0x5282, /* addq.l #1,d2 */
+	0x0807, 0x0000, /* btst #0,d7 */
+	0x6702, /* beq.s +2 */
+	0x5484, /* addq.l #2,d4 */
+	0x6102, /* bsr.s +2 */
+	0x6004, /* bra.s +4 */
+	0x5283, /* addq.l #1,d3 */
+	0x4E75  /* rts */
+};
+
+LOCALVAR const ui4b MicroBenchMOVEM[] = {
+	0x48E7, 0xFEF8, /* movem.l d0-d6/a0-a4,-(a7) */
+	0x4CDF, 0x1F7F, /* movem.l (a7)+,d0-d6/a0-a4 */
+	0x48D6, 0x000F, /* movem.l d0-d3,(a6) */
+	0x4CD6, 0x000F, /* movem.l (a6),d0-d3 */
+	0x48E7, 0xF000, /* movem.l d0-d3,-(a7) */
+	0x4CDF, 0x000F  /* movem.l (a7)+,d0-d3 */
+};
+
+LOCALVAR const ui4b MicroBenchEA[] = {
+	0x2016, /* move.l (a6),d0 */
+	0x222E, 0x0004, /* move.l 4(a6),d1 */
+	0x2CC1, /* move.l d1,(a6)+ */
+	0x2426, /* move.l -(a6),d2 */
+	0x3636, 0x5008, /* move.w 8(a6,d5.w),d3 */
+	0x2D43, 0x000C, /* move.l d3,12(a6) */
+	0x2039, kMB_Data >> 16, kMB_Data & 0xFFFF,
+		/* move.l (kMB_Data).l,d0 */
+	0x23C0, kMB_Data >> 16, (kMB_Data + 4) & 0xFFFF,
+		/* move.l d0,(kMB_Data+4).l */
+	0x41EE, 0x0010, /* lea 16(a6),a0 */
+	0x2210, /* move.l (a0),d1 */
+	0xD2A8, 0x0004  /* add.l 4(a0),d1 */
+};
+
+LOCALVAR const ui4b MicroBenchDBF[] = {
+	0x303C, 0x0063, /* move.w #99,d0 */
+	0x5281, /* addq.l #1,d1 */
+	0x51C8, 0xFFFC  /* dbf d0,*-2 */
+};
+
+typedef struct {
+	char *Name;
+	const ui4b *Body;
+	ui5r Len; /* in words */
+	ui5r Iters;
+} MicroBenchR;
+
+#define MicroBenchEntry(name, a, iters) \
+	{ name, a, sizeof(a) / sizeof(ui4b), iters }
+
+LOCALVAR const MicroBenchR MicroBenchTab[] = {
+	MicroBenchEntry("alu", MicroBenchALU, 2000000),
+	MicroBenchEntry("branch", MicroBenchBranch, 2000000),
+	MicroBenchEntry("movem", MicroBenchMOVEM, 500000),
+	MicroBenchEntry("ea", MicroBenchEA, 2000000),
+	MicroBenchEntry("dbf", MicroBenchDBF, 100000)
+};
+
+#define kNumMicroBenches (sizeof(MicroBenchTab) / sizeof(MicroBenchR))
+
+LOCALINSTVAR blnr MicroBenchDone = falseblnr;
+LOCALINSTVAR si5r MicroBenchLeft;
+
+GLOBALFUNC int MicroBench_Count(void)
+{
+	return kNumMicroBenches;
+}
+
+GLOBALFUNC char *MicroBench_Name(int Kind)
+{
+	return MicroBenchTab[Kind].Name;
+}
+
+GLOBALFUNC ui5r MicroBench_DefaultIters(int Kind)
+{
+	return MicroBenchTab[Kind].Iters;
+}
+
+LOCALFUNC ui3p MicroBenchPutW(ui3p p, ui4r v)
+{
+	do_put_mem_word(p, v);
+	return p + 2;
+}
+
+LOCALFUNC ui3p MicroBenchPutL(ui3p p, ui5r v)
+{
+	do_put_mem_long(p, v);
+	return p + 4;
+}
+
+GLOBALPROC MicroBench_MakeROM(int Kind, ui5r Iters)
+{
+	const MicroBenchR *k = &MicroBenchTab[Kind];
+	ui3p p;
+	ui3p loop;
+	ui5r i;
+	ui5r n;
+
+	for (i = 0; i < kROM_Size; ++i) {
+		ROM[i] = 0;
+	}
+
+	/* reset vectors, seen at 0 while the overlay is on */
+	p = MicroBenchPutL(ROM, kMicroBenchSig);
+	(void) MicroBenchPutL(p, kROM_Base + kMB_StartOffset);
+
+	/* the loop, to be copied to kMB_Code */
+	p = ROM + kMB_KernelOffset;
+	loop = p;
+	for (i = 0; i < k->Len; ++i) {
+		p = MicroBenchPutW(p, k->Body[i]);
+	}
+	p = MicroBenchPutW(p, 0x5387); /* subq.l #1,d7 */
+	p = MicroBenchPutW(p, 0x6600); /* bne.w loop */
+	p = MicroBenchPutW(p, loop - p);
+	p = MicroBenchPutW(p, 0x33FC); /* move.w #0,(kMB_Exit).l */
+	p = MicroBenchPutW(p, 0x0000);
+	p = MicroBenchPutL(p, kMB_Exit);
+	p = MicroBenchPutW(p, 0x60FE); /* bra.s * */
+	n = (p - loop) >> 1;
+
+	/* start up */
+	p = ROM + kMB_StartOffset;
+	p = MicroBenchPutW(p, 0x2E7C); /* movea.l #kMB_Stack,a7 */
+	p = MicroBenchPutL(p, kMB_Stack);
+	p = MicroBenchPutW(p, 0x2C7C); /* movea.l #kMB_Data,a6 */
+	p = MicroBenchPutL(p, kMB_Data);
+	p = MicroBenchPutW(p, 0x7001); /* moveq #1,d0 */
+	p = MicroBenchPutW(p, 0x7202); /* moveq #2,d1 */
+	p = MicroBenchPutW(p, 0x7403); /* moveq #3,d2 */
+	p = MicroBenchPutW(p, 0x7604); /* moveq #4,d3 */
+	p = MicroBenchPutW(p, 0x7805); /* moveq #5,d4 */
+	p = MicroBenchPutW(p, 0x7A04); /* moveq #4,d5 */
+	p = MicroBenchPutW(p, 0x7C06); /* moveq #6,d6 */
+	p = MicroBenchPutW(p, 0x207C); /* movea.l #loop,a0 */
+	p = MicroBenchPutL(p, kROM_Base + kMB_KernelOffset);
+	p = MicroBenchPutW(p, 0x227C); /* movea.l #kMB_Code,a1 */
+	p = MicroBenchPutL(p, kMB_Code);
+	p = MicroBenchPutW(p, 0x3E3C); /* move.w #n-1,d7 */
+	p = MicroBenchPutW(p, n - 1);
+	p = MicroBenchPutW(p, 0x32D8); /* move.w (a0)+,(a1)+ */
+	p = MicroBenchPutW(p, 0x51CF); /* dbf d7,*-2 */
+	p = MicroBenchPutW(p, 0xFFFC);
+	p = MicroBenchPutW(p, 0x2E3C); /* move.l #Iters,d7 */
+	p = MicroBenchPutL(p, Iters);
+	p = MicroBenchPutW(p, 0x4EF9); /* jmp (kMB_Code).l */
+	(void) MicroBenchPutL(p, kMB_Code);
+
+	MicroBenchDone = falseblnr;
+}
+
+GLOBALFUNC blnr MicroBench_IsStubROM(void)
+{
+	return kMicroBenchSig == do_get_mem_long(ROM);
+}
+
+GLOBALPROC MicroBench_ExitNtfy(void)
+{
+	MicroBenchDone = trueblnr;
+	MicroBenchLeft = GetCyclesRemaining();
+	SetCyclesRemaining(0);
+}
+
+GLOBALFUNC blnr MicroBench_Run(ui5r n, ui5r *Ran)
+{
+	if (MicroBenchDone) {
+		*Ran = 0;
+	} else {
+		MicroBenchLeft = 0;
+		m68k_go_nCycles(n * kCycleScale);
+		*Ran = n - MicroBenchLeft / kCycleScale;
+	}
+	return MicroBenchDone;
+}
+
+#endif /* IncludeBench */
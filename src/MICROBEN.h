@@ -0,0 +1,36 @@
+/*
+	MICROBEN.h
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+#ifdef MICROBEN_H
+#error "header already included"
+#else
+#define MICROBEN_H
+#endif
+
+EXPORTFUNC int MicroBench_Count(void);
+EXPORTFUNC char *MicroBench_Name(int Kind);
+EXPORTFUNC ui5r MicroBench_DefaultIters(int Kind);
+
+EXPORTPROC MicroBench_MakeROM(int Kind, ui5r Iters);
+	/* build a stub ROM in ROM, in place of loading one */
+EXPORTFUNC blnr MicroBench_IsStubROM(void);
+EXPORTPROC MicroBench_ExitNtfy(void);
+	/* the stub has written to its exit address */
+EXPORTFUNC blnr MicroBench_Run(ui5r n, ui5r *Ran);
+	/*
+		emulate up to n cycles, with no devices, and say how
+		many were run. returns true once the stub has exited.
+	*/
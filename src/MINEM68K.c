@@ -43,10 +43,38 @@
 #if WantDisasm
 #include "DISAM68K.h"
 #endif
+#if IncludeSaveState
+#include "SAVESTAT.h"
+#endif
+#if EnableQDAccel
+#include "QDACCEL.h"
+#endif
+#if EnableSCSIAccel
+#include "SCSIEMDV.h"
+#endif
+#if IncludeCPUTest
+#include "CPUTEST.h"
+#endif
+#if IncludeProfile
+#include "PROFILER.h"
+#endif
+#if IncludeOpStats
+#include "OPSTATS.h"
+#endif
+#if IncludeMemStats
+#include "MEMSTATS.h"
+#endif
+#if IncludeCoverage
+#include "COVERAGE.h"
+#endif
 #endif
 
 #include "MINEM68K.h"
 
+#if EmMultiInstance
+#include <pthread.h>
+#endif
+
 typedef unsigned char flagtype;
 
 
@@ -86,7 +114,7 @@ union ArgAddrT {
 };
 typedef union ArgAddrT ArgAddrT;
 
-LOCALVAR struct regstruct
+LOCALINSTVAR struct regstruct
 {
 	ui5r regs[16]; /* Data and Address registers */
 	ui5r pc; /* Program Counter */
@@ -144,6 +172,11 @@ LOCALVAR struct regstruct
 #if USE_POINTER
 	ui3p pc_p;
 	ui3p pc_oldp;
+#endif
+#if IncludeCoverage
+	ui3p CovMap; /* a byte for each word of the memory pc_p is in */
+	ui3p CovBase; /* the start of that memory */
+	ui5r CovMask;
 #endif
 	ui5b opsize;
 	ui5b ArgKind;
@@ -154,14 +187,26 @@ LOCALVAR struct regstruct
 	si5r MoreCyclesToGo;
 	si5r ResidualCycles;
 	ui3b fakeword[2];
+} regs;
 
+/*
+	the same for every instance, so shared. Instances may be
+	started by several threads at once, so with EmMultiInstance
+	it is built under a once guard.
+*/
 #define disp_table_sz (256 * 256)
 #if SmallGlobals
-	DecOpR *disp_table;
+LOCALVAR DecOpR *disp_table = nullpr;
+LOCALINSTVAR DecOpR *disp_table_block = nullpr;
+	/* reserved by each instance, only the first to start uses it */
 #else
-	DecOpR disp_table[disp_table_sz];
+LOCALVAR DecOpR disp_table[disp_table_sz];
+#endif
+#if EmMultiInstance
+LOCALVAR pthread_once_t disp_table_once = PTHREAD_ONCE_INIT;
+#else
+LOCALVAR blnr disp_table_ready = falseblnr;
 #endif
-} regs;
 
 #define ui5r_MSBisSet(x) (((si5r)(x)) < 0)
 
@@ -495,16 +540,66 @@ LOCALFUNC ui5r ALU_SubXL(ui5r srcvalue, ui5r dstvalue)
 #define m68k_logExceptions (dbglog_HAVE && 0)
 
 
+#if IncludeMemStats
+LOCALINSTVAR ui5b MemStatHits[kNumMemStatMATCs];
+LOCALINSTVAR ui5b MemStatMisses[kNumMemStatMATCs];
+LOCALINSTVAR ui5b MemStatFinds = 0;
+LOCALINSTVAR ui5b MemStatSteps = 0;
+LOCALINSTVAR ui5b MemStatMoves = 0;
+LOCALINSTVAR ui5b MemStatWalks[kMemStatWalkBuckets];
+
+#define MemStatHit(i) ++MemStatHits[i]
+#define MemStatMiss(i) ++MemStatMisses[i]
+
+GLOBALFUNC ui5r m68k_MemStatGet(int What, int i)
+{
+	ui5r v;
+
+	switch (What) {
+		case kMemStatHit:
+			v = MemStatHits[i];
+			break;
+		case kMemStatMiss:
+			v = MemStatMisses[i];
+			break;
+		case kMemStatFind:
+			v = MemStatFinds;
+			break;
+		case kMemStatStep:
+			v = MemStatSteps;
+			break;
+		case kMemStatMove:
+			v = MemStatMoves;
+			break;
+		case kMemStatWalk:
+		default:
+			v = MemStatWalks[i];
+			break;
+	}
+
+	return v;
+}
+#else
+#define MemStatHit(i)
+#define MemStatMiss(i)
+#endif
+
 GLOBALFUNC ATTep FindATTel(CPTR addr)
 {
 	ATTep prev;
 	ATTep p;
+#if IncludeMemStats
+	ui5r n = 0;
+#endif
 
 	p = regs.HeadATTel;
 	if ((addr & p->cmpmask) != p->cmpvalu) {
 		do {
 			prev = p;
 			p = p->Next;
+#if IncludeMemStats
+			++n;
+#endif
 		} while ((addr & p->cmpmask) != p->cmpvalu);
 
 		{
@@ -517,10 +612,20 @@ GLOBALFUNC ATTep FindATTel(CPTR addr)
 				prev->Next = next;
 				p->Next = regs.HeadATTel;
 				regs.HeadATTel = p;
+#if IncludeMemStats
+				++MemStatMoves;
+#endif
 			}
 		}
 	}
 
+#if IncludeMemStats
+	++MemStatFinds;
+	MemStatSteps += n;
+	++MemStatWalks[(n < kMemStatWalkBuckets)
+		? n : (kMemStatWalkBuckets - 1)];
+#endif
+
 	return p;
 }
 
@@ -534,6 +639,26 @@ LOCALPROC SetUpMATC(
 	CurMATC->usebase = p->usebase;
 }
 
+#if IncludeRewind
+LOCALPROC SetUpMATCwr(MATCp CurMATC, ATTep p, CPTR addr)
+{
+	/*
+		When tracking for rewind, a write MATC for memory is
+		narrowed to one page, so that the first write to each
+		page since the last snapshot still comes through here.
+	*/
+	SetUpMATC(CurMATC, p);
+	if (RewindTracking
+		&& Rewind_WriteNtfy(p->usebase + (addr & p->usemask)))
+	{
+		CurMATC->cmpmask |= p->usemask & ~ (ui5r)(kRewindPageSz - 1);
+		CurMATC->cmpvalu = addr & CurMATC->cmpmask;
+	}
+}
+#else
+#define SetUpMATCwr(CurMATC, p, addr) SetUpMATC(CurMATC, p)
+#endif
+
 LOCALFUNC ui5r get_byte_ext(CPTR addr)
 {
 	ATTep p;
@@ -570,8 +695,10 @@ LOCALFUNC MayNotInline ui5r get_byte(CPTR addr)
 	ui3p m = (addr & regs.MATCrdB.usemask) + regs.MATCrdB.usebase;
 
 	if ((addr & regs.MATCrdB.cmpmask) == regs.MATCrdB.cmpvalu) {
+		MemStatHit(kMemStatRdB);
 		return ui5r_FromSByte(*m);
 	} else {
+		MemStatMiss(kMemStatRdB);
 		return get_byte_ext(addr);
 	}
 }
@@ -587,7 +714,7 @@ Label_Retry:
 	AccFlags = p->Access;
 
 	if (0 != (AccFlags & kATTA_writereadymask)) {
-		SetUpMATC(&regs.MATCwrB, p);
+		SetUpMATCwr(&regs.MATCwrB, p, addr);
 		m = p->usebase + (addr & p->usemask);
 		*m = b;
 	} else if (0 != (AccFlags & kATTA_mmdvmask)) {
@@ -607,8 +734,10 @@ LOCALPROC MayNotInline put_byte(CPTR addr, ui5r b)
 {
 	ui3p m = (addr & regs.MATCwrB.usemask) + regs.MATCwrB.usebase;
 	if ((addr & regs.MATCwrB.cmpmask) == regs.MATCwrB.cmpvalu) {
+		MemStatHit(kMemStatWrB);
 		*m = b;
 	} else {
+		MemStatMiss(kMemStatWrB);
 		put_byte_ext(addr, b);
 	}
 }
@@ -656,8 +785,10 @@ LOCALFUNC MayNotInline ui5r get_word(CPTR addr)
 {
 	ui3p m = (addr & regs.MATCrdW.usemask) + regs.MATCrdW.usebase;
 	if ((addr & regs.MATCrdW.cmpmask) == regs.MATCrdW.cmpvalu) {
+		MemStatHit(kMemStatRdW);
 		return ui5r_FromSWord(do_get_mem_word(m));
 	} else {
+		MemStatMiss(kMemStatRdW);
 		return get_word_ext(addr);
 	}
 }
@@ -677,7 +808,7 @@ Label_Retry:
 		AccFlags = p->Access;
 
 		if (0 != (AccFlags & kATTA_writereadymask)) {
-			SetUpMATC(&regs.MATCwrW, p);
+			SetUpMATCwr(&regs.MATCwrW, p, addr);
 			regs.MATCwrW.cmpmask |= 0x01;
 			m = p->usebase + (addr & p->usemask);
 			do_put_mem_word(m, w);
@@ -700,8 +831,10 @@ LOCALPROC MayNotInline put_word(CPTR addr, ui5r w)
 {
 	ui3p m = (addr & regs.MATCwrW.usemask) + regs.MATCwrW.usebase;
 	if ((addr & regs.MATCwrW.cmpmask) == regs.MATCwrW.cmpvalu) {
+		MemStatHit(kMemStatWrW);
 		do_put_mem_word(m, w);
 	} else {
+		MemStatMiss(kMemStatWrW);
 		put_word_ext(addr, w);
 	}
 }
@@ -729,6 +862,9 @@ LOCALFUNC MayNotInline ui5r get_long(CPTR addr)
 		ui5r Data = ((hi << 16) & 0xFFFF0000)
 			| (lo & 0x0000FFFF);
 
+		/* two words, in the same unit as get_long_ext counts */
+		MemStatHit(kMemStatRdW);
+		MemStatHit(kMemStatRdW);
 		return ui5r_FromSLong(Data);
 	} else {
 		return get_long_ext(addr);
@@ -749,6 +885,9 @@ LOCALPROC MayNotInline put_long(CPTR addr, ui5r l)
 	if (((addr & regs.MATCwrW.cmpmask) == regs.MATCwrW.cmpvalu)
 		&& ((addr2 & regs.MATCwrW.cmpmask) == regs.MATCwrW.cmpvalu))
 	{
+		/* two words, in the same unit as put_long_ext counts */
+		MemStatHit(kMemStatWrW);
+		MemStatHit(kMemStatWrW);
 		do_put_mem_word(m, l >> 16);
 		do_put_mem_word(m2, l);
 	} else {
@@ -822,8 +961,10 @@ LOCALFUNC MayInline ui4r nextiword(void)
 
 	m = (addr & regs.MATCex.usemask) + regs.MATCex.usebase;
 	if ((addr & regs.MATCex.cmpmask) == regs.MATCex.cmpvalu) {
+		MemStatHit(kMemStatEx);
 		Data = do_get_mem_word(m);
 	} else {
+		MemStatMiss(kMemStatEx);
 		Data = get_pc_word_ext();
 	}
 	regs.pc = addr + 2;
@@ -907,6 +1048,53 @@ LOCALPROC DumpAJump(CPTR toaddr)
 }
 #endif
 
+#if IncludeCoverage
+#if ! USE_POINTER
+#error "IncludeCoverage needs USE_POINTER"
+#endif
+
+LOCALVAR ui3p CovMaps[kNumCovMaps];
+LOCALVAR ui3b CovJunk; /* marked for code not in ROM or RAM */
+
+LOCALFUNC ui5r CovAllocSz(ui5r Words)
+{
+	ui5r n = 1;
+
+	while (n < Words) {
+		n <<= 1;
+	}
+
+	return n;
+}
+
+LOCALPROC CovSetRegion(ui3p m)
+{
+	/*
+		Called when pc_p may have moved to other memory, so the
+		marking in m68k_go_MaxCycles needs no test. An index
+		past the end, from running off the end of memory, wraps.
+	*/
+	if ((nullpr != CovMaps[kCovROM])
+		&& (m >= ROM) && (m < ROM + kROM_Size))
+	{
+		regs.CovMap = CovMaps[kCovROM];
+		regs.CovBase = ROM;
+		regs.CovMask = CovAllocSz(kROM_Size >> 1) - 1;
+	} else
+	if ((nullpr != CovMaps[kCovRAM])
+		&& (m >= RAM) && (m < RAM + kRAM_Size))
+	{
+		regs.CovMap = CovMaps[kCovRAM];
+		regs.CovBase = RAM;
+		regs.CovMask = CovAllocSz(kRAM_Size >> 1) - 1;
+	} else {
+		regs.CovMap = &CovJunk;
+		regs.CovBase = m;
+		regs.CovMask = 0;
+	}
+}
+#endif
+
 #if USE_POINTER
 LOCALFUNC ui3p get_pc_real_address(CPTR addr)
 {
@@ -915,7 +1103,8 @@ LOCALFUNC ui3p get_pc_real_address(CPTR addr)
 
 Label_Retry:
 	p = FindATTel(addr);
-	if (0 == (p->Access & kATTA_readreadymask))
+	/* code may be run from watched memory, fetches aren't seen */
+	if (0 == (p->Access & (kATTA_readreadymask | kATTA_watchmask)))
 	{
 		if (0 != (p->Access & kATTA_ntfymask)) {
 			if (MemAccessNtfy(p)) {
@@ -931,6 +1120,9 @@ Label_Retry:
 		SetUpMATC(&regs.MATCex, p);
 		v = (addr & p->usemask) + p->usebase;
 	}
+#if IncludeCoverage
+	CovSetRegion(v);
+#endif
 
 	return v;
 }
@@ -956,7 +1148,10 @@ LOCALFUNC MayInline void m68k_setpc(CPTR newpc)
 		m = (newpc & regs.MATCex.usemask) + regs.MATCex.usebase;
 		if ((newpc & regs.MATCex.cmpmask) != regs.MATCex.cmpvalu)
 		{
+			MemStatMiss(kMemStatEx);
 			m = get_pc_real_address(newpc);
+		} else {
+			MemStatHit(kMemStatEx);
 		}
 
 		regs.pc_p = regs.pc_oldp = m;
@@ -1699,10 +1894,447 @@ LOCALPROCUSEDONCE DoCodePEA(void)
 	put_long(m68k_areg(7), DstAddr.mem);
 }
 
+#if EnableIdleSkip
+/*
+	The Mac Plus never executes STOP. When there is nothing to
+	do, an application just keeps asking for the next event. If
+	it asks from the same place, soon after getting a null event
+	from there the last time, several times in a row, then it is
+	probably waiting, and there is no point in emulating it
+	asking again until something can have happened, which is at
+	the next scheduled task (interrupt, timer, sub tick).
+
+	This is a guess, not a proof. An application that does work
+	on null events (animation, a terminal or network program
+	polling) looks just the same, and gets run fast forward
+	between polls. So EnableIdleSkip is off by default.
+*/
+
+#define kIdleMinPolls 8
+#define kIdleMaxPollCycles (0x8000UL * kMyClockMult * kCycleScale)
+	/* at most this long between asking, not counting skipped time */
+
+LOCALINSTVAR CPTR IdlePollPC = 0;
+LOCALINSTVAR CPTR IdleEvtPtr = 0;
+LOCALINSTVAR iCountt IdlePolliCount = 0;
+LOCALINSTVAR ui3b IdlePolls = 0;
+
+LOCALFUNC blnr IdleCheckTrap(void)
+{
+	/* called before an A-line trap, returns true if idle */
+	CPTR pc = m68k_getpc();
+	iCountt t = GetCuriCount();
+	CPTR EvtPtr;
+	ui5r EvtOffset;
+
+	switch (regs.opcode & 0xFBFF) { /* not the auto pop bit */
+		case 0xA970: /* _GetNextEvent */
+		case 0xA971: /* _EventAvail */
+			EvtOffset = 0;
+			break;
+		case 0xA860: /* _WaitNextEvent */
+			EvtOffset = 8;
+			break;
+		default:
+			return falseblnr;
+	}
+
+	EvtPtr = IdleEvtPtr & 0x00FFFFFF;
+	if ((pc == IdlePollPC)
+		&& ((ui5r)(t - IdlePolliCount) < kIdleMaxPollCycles)
+		&& (EvtPtr < kRAM_Size - 1)
+		&& (0 == get_ram_word(EvtPtr))) /* was a null event */
+	{
+		if (IdlePolls < kIdleMinPolls) {
+			++IdlePolls;
+		}
+	} else {
+		IdlePolls = 0;
+	}
+	IdlePollPC = pc;
+	IdlePolliCount = t;
+	IdleEvtPtr = get_long(m68k_areg(7) + EvtOffset);
+
+	return IdlePolls >= kIdleMinPolls;
+}
+#endif
+
+#if EnableTrapAccel
+/*
+	Host native versions of some often used traps, working on
+	memory directly, instead of going through the trap dispatcher
+	and the emulated routine in ROM. Each returns false, to have
+	the trap emulated after all, if it can't handle the
+	arguments, such as if they aren't all in plain memory. It
+	must find that out before changing anything.
+
+	In verify mode, the native version writes its result to a
+	copy of the memory it would change, and the trap is emulated,
+	with the result checked once it returns. Only the first
+	block of memory written is checked.
+*/
+
+typedef blnr (*TrapAccelP)(void);
+
+#if WantTrapAccelVerify
+#define kTrapVerifyMaxLen 0x8000
+#define kTrapVerifyScratchLen 0x40
+
+LOCALINSTVAR blnr TrapVerifyNow = falseblnr;
+	/* true while a native trap is only working out the result */
+LOCALINSTVAR blnr TrapVerifyPending = falseblnr;
+LOCALINSTVAR CPTR TrapVerifyPC;
+LOCALINSTVAR ui5r TrapVerifySP;
+LOCALINSTVAR blnr TrapVerifyHaveD0;
+LOCALINSTVAR ui5r TrapVerifyD0;
+LOCALINSTVAR CPTR TrapVerifyAddr;
+LOCALINSTVAR ui5r TrapVerifyLen;
+LOCALINSTVAR ui3b TrapVerifyBuf[kTrapVerifyMaxLen];
+LOCALINSTVAR ui3b TrapVerifyScratch[kTrapVerifyScratchLen];
+LOCALINSTVAR ui5r TrapVerifyFails = 0;
+#endif
+
+LOCALFUNC ui3p TrapAccelMem(CPTR addr, ui5r n, ui5r Access)
+{
+	/*
+		host address of n bytes of plain memory, or nullpr. The
+		bounds are checked so that nothing can wrap around, whatever
+		n the guest passes.
+	*/
+	ATTep p = FindATTel(addr);
+
+	if ((0 != n)
+		&& (Access == (p->Access & Access))
+		&& (n - 1 <= (ui5r)0xFFFFFFFF - addr)
+		&& (((addr + n - 1) & p->cmpmask) == p->cmpvalu)
+		&& (n - 1 <= p->usemask - (addr & p->usemask)))
+	{
+		return p->usebase + (addr & p->usemask);
+	} else {
+		return nullpr;
+	}
+}
+
+GLOBALFUNC ui5r TrapAccel_AReg(int i)
+{
+	return m68k_areg(i);
+}
+
+GLOBALFUNC ui3p TrapAccel_Src(CPTR addr, ui5r n)
+{
+	return TrapAccelMem(addr, n, kATTA_readreadymask);
+}
+
+GLOBALFUNC ui3p TrapAccel_Dst(CPTR addr, ui5r n)
+{
+	ui3p p = TrapAccelMem(addr, n, kATTA_readwritereadymask);
+
+	if (nullpr == p) {
+		/* fail */
+	} else
+#if WantTrapAccelVerify
+	if (TrapVerifyNow) {
+		if (0 == TrapVerifyLen) {
+			if (n > kTrapVerifyMaxLen) {
+				return nullpr;
+			}
+			TrapVerifyAddr = addr;
+			TrapVerifyLen = n;
+			MyMoveBytes((anyp)p, (anyp)TrapVerifyBuf, n);
+			p = TrapVerifyBuf;
+		} else {
+			/* not checked */
+			if (n > kTrapVerifyScratchLen) {
+				return nullpr;
+			}
+			MyMoveBytes((anyp)p, (anyp)TrapVerifyScratch, n);
+			p = TrapVerifyScratch;
+		}
+	} else
+#endif
+	{
+#if IncludeRewind
+		if (RewindTracking) {
+			ui5r i;
+
+			for (i = 0; i < n; i += kRewindPageSz) {
+				(void) Rewind_WriteNtfy(p + i);
+			}
+			(void) Rewind_WriteNtfy(p + n - 1);
+		}
+#endif
+	}
+
+	return p;
+}
+
+GLOBALPROC TrapAccel_SetD0(ui5r v)
+{
+	/* as the trap dispatcher leaves it, TST.W D0 */
+#if WantTrapAccelVerify
+	if (TrapVerifyNow) {
+		TrapVerifyHaveD0 = trueblnr;
+		TrapVerifyD0 = v;
+	} else
+#endif
+	{
+		m68k_dreg(0) = v;
+		NFLG = ((v & 0x8000) != 0);
+		ZFLG = ((v & 0xFFFF) == 0);
+		VFLG = 0;
+		CFLG = 0;
+	}
+}
+
+GLOBALPROC TrapAccel_Done(ui5r Pop, ui5r Cycles)
+{
+	/*
+		Pop bytes of arguments, for a Pascal style trap, and
+		about how many cycles the ROM version would take.
+	*/
+#if WantTrapAccelVerify
+	if (TrapVerifyNow) {
+		TrapVerifySP += Pop;
+	} else
+#endif
+	{
+		m68k_areg(7) += Pop;
+		regs.MaxCyclesToGo -= Cycles * kCycleScale;
+	}
+}
+
+LOCALFUNC blnr TrapAccelBlockMove(void)
+{
+	/*
+		_BlockMove, A0 source, A1 destination, D0 count,
+		overlapping moves allowed. Returns noErr in D0. Like the
+		ROM, a count that isn't above zero moves nothing.
+	*/
+	ui5r n = m68k_dreg(0);
+	ui3p s;
+	ui3p d;
+
+	if ((si5r)n > 0) {
+		s = TrapAccel_Src(m68k_areg(0), n);
+		if (nullpr == s) {
+			return falseblnr;
+		}
+		d = TrapAccel_Dst(m68k_areg(1), n);
+		if (nullpr == d) {
+			return falseblnr;
+		}
+
+		TrapAccel_Done(0, 200 + 2 * n);
+		if ((d + n <= s) || (s + n <= d)) {
+			MyMoveBytes((anyp)s, (anyp)d, n);
+		} else if (d < s) {
+			do {
+				*d++ = *s++;
+			} while (0 != --n);
+		} else {
+			d += n;
+			s += n;
+			do {
+				*--d = *--s;
+			} while (0 != --n);
+		}
+	}
+	TrapAccel_SetD0(0);
+
+	return trueblnr;
+}
+
+typedef struct {
+	ui4r Trap;
+	TrapAccelP Proc;
+} TrapAccelR;
+
+LOCALVAR const TrapAccelR TrapAccelTab[] = {
+	{ 0xA02E, TrapAccelBlockMove }
+#if EnableQDAccel
+	,
+	{ 0xA8A5, QDAccel_FillRect },
+	{ 0xA8A2, QDAccel_PaintRect },
+	{ 0xA8A3, QDAccel_EraseRect },
+	{ 0xA8A4, QDAccel_InvertRect },
+	{ 0xA8EF, QDAccel_ScrollRect },
+	{ 0xA8EC, QDAccel_CopyBits }
+#endif
+#if EnableSCSIAccel
+	,
+	{ 0xA815, SCSI_AccelDispatch }
+#endif
+};
+
+#define kNumTrapAccels (sizeof(TrapAccelTab) / sizeof(TrapAccelR))
+
+LOCALINSTVAR ui3b TrapAccelMode[kNumTrapAccels];
+
+LOCALPROC TrapAccelInit(void)
+{
+	int i;
+
+	for (i = 0; i < kNumTrapAccels; ++i) {
+		TrapAccelMode[i] = TrapAccelWantMode(TrapAccelTab[i].Trap);
+#if ! WantTrapAccelVerify
+		if (kTrapAccelVerify == TrapAccelMode[i]) {
+			TrapAccelMode[i] = kTrapAccelOff;
+		}
+#elif EnableSCSIAccel
+		if ((kTrapAccelVerify == TrapAccelMode[i])
+			&& (SCSI_AccelDispatch == TrapAccelTab[i].Proc))
+		{
+			/* moves data through the device, can't be done twice */
+			TrapAccelMode[i] = kTrapAccelOff;
+		}
+#endif
+	}
+}
+
+LOCALFUNC blnr TrapAccelUnpatched(ui4r Trap)
+{
+	/*
+		true if the trap dispatch table still sends Trap into ROM.
+		If the System, an INIT or a debugger has put in a patch
+		with SetTrapAddress, the trap is left to the dispatcher,
+		so the patch gets run. As in the 128K ROM, the Toolbox
+		table has 512 long entries at 0x0C00, the OS table 256
+		at 0x0400.
+	*/
+	CPTR a;
+
+	if (0 != (Trap & 0x0800)) {
+		a = 0x0C00 + ((Trap & 0x01FF) << 2);
+	} else {
+		a = 0x0400 + ((Trap & 0x00FF) << 2);
+	}
+	a = get_long(a) & 0x00FFFFFF;
+
+	return (a >> kROM_ln2Spc) == (kROM_Base >> kROM_ln2Spc);
+}
+
+LOCALFUNC blnr TrapAccelDo(void)
+{
+	/* returns true if the trap was done natively */
+	ui4r Trap = regs.opcode;
+	int i;
+
+	if (0 != (Trap & 0x0800)) {
+		if (0 != (Trap & 0x0400)) {
+			/* auto pop, rare, left to the dispatcher */
+			return falseblnr;
+		}
+	} else {
+		Trap &= 0xF8FF; /* not the flag bits */
+	}
+
+	for (i = 0; i < kNumTrapAccels; ++i) {
+		if (Trap == TrapAccelTab[i].Trap) {
+			if (! TrapAccelUnpatched(Trap)) {
+				break;
+			}
+			switch (TrapAccelMode[i]) {
+				case kTrapAccelOn:
+					return TrapAccelTab[i].Proc();
+#if WantTrapAccelVerify
+				case kTrapAccelVerify:
+					if (! TrapVerifyPending) {
+						TrapVerifyNow = trueblnr;
+						TrapVerifyHaveD0 = falseblnr;
+						TrapVerifyLen = 0;
+						TrapVerifySP = m68k_areg(7);
+						if (TrapAccelTab[i].Proc()) {
+							TrapVerifyPending = trueblnr;
+							TrapVerifyPC = m68k_getpc();
+						}
+						TrapVerifyNow = falseblnr;
+					}
+					break;
+#endif
+				default:
+					break;
+			}
+			break;
+		}
+	}
+
+	return falseblnr;
+}
+
+#if WantTrapAccelVerify
+LOCALPROC TrapVerifyCheck(void)
+{
+	/* called before each instruction while a check is pending */
+	ui3p m;
+	ui5r i;
+	blnr IsOk;
+
+	if ((m68k_getpc() == TrapVerifyPC)
+		&& (m68k_areg(7) == TrapVerifySP))
+	{
+		/* the emulated trap has returned */
+		TrapVerifyPending = falseblnr;
+		IsOk = (! TrapVerifyHaveD0)
+			|| (TrapVerifyD0 == (m68k_dreg(0) & 0xFFFF));
+		if (IsOk && (0 != TrapVerifyLen)) {
+			m = TrapAccel_Src(TrapVerifyAddr, TrapVerifyLen);
+			if (nullpr == m) {
+				IsOk = falseblnr;
+			} else {
+				for (i = 0; i < TrapVerifyLen; ++i) {
+					if (m[i] != TrapVerifyBuf[i]) {
+						IsOk = falseblnr;
+						break;
+					}
+				}
+			}
+		}
+		if (! IsOk) {
+#if dbglog_HAVE
+			dbglog_StartLine();
+			dbglog_writeCStr("trap accel mismatch before pc ");
+			dbglog_writeHex(TrapVerifyPC);
+			dbglog_writeReturn();
+#endif
+			if (0 == TrapVerifyFails++) {
+				WarnMsgTrapAccel();
+			}
+		}
+	}
+}
+#endif
+#endif
+
 LOCALPROCUSEDONCE DoCodeA(void)
 {
-	BackupPC();
-	Exception(0xA);
+#if EnableIdleSkip
+	blnr Idle;
+#endif
+
+#if IncludeProfile
+	Profile_TrapNtfy(regs.opcode);
+#endif
+#if EnableTrapAccel
+	if (TrapAccelDo()) {
+		/* done, go on to the next instruction */
+	} else
+#endif
+	{
+		BackupPC();
+#if EnableIdleSkip
+		Idle = IdleCheckTrap();
+#endif
+		Exception(0xA);
+#if EnableIdleSkip
+		if (Idle) {
+			/* skip on to the next scheduled task */
+			IdlePolliCount += GetCyclesRemaining();
+			regs.MaxCyclesToGo = 0;
+			regs.MoreCyclesToGo = 0;
+			GuestIdle = trueblnr;
+		}
+#endif
+	}
 }
 
 LOCALPROCUSEDONCE DoCodeBsrB(void)
@@ -4444,7 +5076,7 @@ LOCALPROC DoBitField(void)
 #endif
 
 #if WantDumpTable
-LOCALVAR ui5b DumpTable[kNumIKinds];
+LOCALINSTVAR ui5b DumpTable[kNumIKinds];
 
 LOCALPROC InitDumpTable(void)
 {
@@ -4472,7 +5104,124 @@ GLOBALPROC DoDumpTable(void)
 }
 #endif
 
-LOCALPROC m68k_go_MaxCycles(void)
+#if IncludeBench
+/*
+	Instructions are only counted while a benchmark asks for it,
+	by a copy of the main loop that counts, so the usual one
+	doesn't pay for it.
+*/
+LOCALINSTVAR ui5r InstrCount = 0;
+LOCALINSTVAR blnr InstrCounting = falseblnr;
+
+GLOBALFUNC ui5r m68k_InstrCount(void)
+{
+	/* instructions executed while counting, wraps */
+	return InstrCount;
+}
+
+GLOBALPROC m68k_InstrCountSet(blnr On)
+{
+	InstrCounting = On;
+}
+#endif
+
+#if IncludeOpStats
+/*
+	Counts of what is run, noted after each instruction while
+	counting is on. Each count is in two halves, so as not to wrap.
+*/
+
+struct OpStatR {
+	ui5b Lo;
+	ui5b Hi;
+};
+typedef struct OpStatR OpStatR;
+
+#define OpStatAdd(r, n) \
+	if (((r).Lo += (n)) < (n)) { ++(r).Hi; }
+
+LOCALVAR blnr OpStatsOn = falseblnr;
+LOCALVAR ui5r OpStatsPrev = kNumIKinds; /* kind run before, if any */
+LOCALVAR OpStatR OpStatsKinds[kNumIKinds];
+LOCALVAR OpStatR OpStatsCycles[kNumIKinds];
+LOCALVAR OpStatR OpStatsModes[kNumIKinds][kNumAMds][kNumAMds];
+LOCALVAR OpStatR OpStatsPairs[kNumIKinds][kNumIKinds];
+
+LOCALPROC OpStatsNote(void)
+{
+	ui5r k = GetDcoMainClas(&regs.CurDecOp);
+	ui5r s = GetDcoSrcAMd(&regs.CurDecOp);
+	ui5r d = GetDcoDstAMd(&regs.CurDecOp);
+	ui5b c = GetDcoCycles(&regs.CurDecOp);
+
+	OpStatAdd(OpStatsKinds[k], 1);
+	OpStatAdd(OpStatsCycles[k], c);
+	if ((s < kNumAMds) && (d < kNumAMds)) {
+		OpStatAdd(OpStatsModes[k][s][d], 1);
+	}
+	if (OpStatsPrev < kNumIKinds) {
+		OpStatAdd(OpStatsPairs[OpStatsPrev][k], 1);
+	}
+	OpStatsPrev = k;
+}
+
+GLOBALPROC m68k_OpStatsSet(blnr On)
+{
+	OpStatsOn = On;
+	OpStatsPrev = kNumIKinds;
+}
+
+GLOBALFUNC ui5r m68k_OpStatsNumKinds(void)
+{
+	return kNumIKinds;
+}
+
+GLOBALFUNC ui5r m68k_OpStatsNumModes(void)
+{
+	return kNumAMds;
+}
+
+GLOBALFUNC char *m68k_OpStatsKindName(ui5r k)
+{
+	return M68KITAB_KindName(k);
+}
+
+GLOBALFUNC char *m68k_OpStatsModeName(ui5r m)
+{
+	return M68KITAB_ModeName(m);
+}
+
+GLOBALFUNC ui5r m68k_OpStatsCycleScale(void)
+{
+	return kCycleScale;
+}
+
+GLOBALFUNC ui5r m68k_OpStatsGet(int What, ui5r a, ui5r b, ui5r c,
+	ui5r *Hi)
+{
+	OpStatR *r;
+
+	switch (What) {
+		case kOpStatKind:
+			r = &OpStatsKinds[a];
+			break;
+		case kOpStatCycles:
+			r = &OpStatsCycles[a];
+			break;
+		case kOpStatModes:
+			r = &OpStatsModes[a][b][c];
+			break;
+		case kOpStatPair:
+		default:
+			r = &OpStatsPairs[a][b];
+			break;
+	}
+	*Hi = r->Hi;
+	return r->Lo;
+}
+#endif
+
+LOCALFUNC MustInline void m68k_go_MaxCycles0(blnr Counting)
 {
 	/*
 		Main loop of emulator.
@@ -4482,15 +5231,34 @@ LOCALPROC m68k_go_MaxCycles(void)
 		Needed for trace flag to work.
 	*/
 
+#if ! IncludeBench
+	UnusedParam(Counting);
+#endif
+
 	do {
 
 #if WantDisasm
 		DisasmOneOrSave(m68k_getpc());
 #endif
 
+#if EnableTrapAccel && WantTrapAccelVerify
+		if (TrapVerifyPending) {
+			TrapVerifyCheck();
+		}
+#endif
+
+#if IncludeCoverage
+		regs.CovMap[((ui5r)(regs.pc_p - regs.CovBase) >> 1)
+			& regs.CovMask] = 1;
+#endif
 		regs.opcode = nextiword();
+#if IncludeBench
+		if (Counting) {
+			++InstrCount;
+		}
+#endif
 
-		regs.CurDecOp = regs.disp_table[regs.opcode];
+		regs.CurDecOp = disp_table[regs.opcode];
 #if WantDumpTable
 		DumpTable[GetDcoMainClas(&regs.CurDecOp)] ++;
 #endif
@@ -4912,6 +5680,18 @@ LOCALPROC m68k_go_MaxCycles(void)
 	} while (regs.MaxCyclesToGo > 0);
 }
 
+LOCALPROC m68k_go_MaxCycles(void)
+{
+	m68k_go_MaxCycles0(falseblnr);
+}
+
+#if IncludeBench
+LOCALPROC m68k_go_MaxCyclesCounting(void)
+{
+	m68k_go_MaxCycles0(trueblnr);
+}
+#endif
+
 GLOBALFUNC si5r GetCyclesRemaining(void)
 {
 	return regs.MoreCyclesToGo + regs.MaxCyclesToGo;
@@ -4957,6 +5737,16 @@ GLOBALPROC put_vm_long(CPTR addr, ui5r l)
 	put_long(addr, ui5r_FromSLong(l));
 }
 
+#if IncludeRewind
+GLOBALPROC m68k_WriteMATCsReset(void)
+{
+	regs.MATCwrB.cmpmask = 0;
+	regs.MATCwrB.cmpvalu = 0xFFFFFFFF;
+	regs.MATCwrW.cmpmask = 0;
+	regs.MATCwrW.cmpvalu = 0xFFFFFFFF;
+}
+#endif
+
 GLOBALPROC SetHeadATTel(ATTep p)
 {
 	regs.MATCrdB.cmpmask = 0;
@@ -5057,20 +5847,99 @@ GLOBALPROC m68k_reset(void)
 #endif
 }
 
+#if IncludeSaveState
+GLOBALPROC m68k_StateXfer(void)
+{
+	/*
+		only the architectural state, taken between
+		instructions. Pointers into memory and the
+		translation caches are worked out again on load.
+	*/
+	CPTR pc = m68k_getpc();
+
+	StateXferVar(regs.regs);
+	StateXferVar(pc);
+	StateXferVar(regs.usp);
+	StateXferVar(regs.isp);
+#if Use68020
+	StateXferVar(regs.msp);
+#endif
+	StateXferVar(regs.intmask);
+	StateXferVar(regs.t1);
+#if Use68020
+	StateXferVar(regs.t0);
+#endif
+	StateXferVar(regs.s);
+#if Use68020
+	StateXferVar(regs.m);
+#endif
+	StateXferVar(regs.x);
+	StateXferVar(regs.n);
+	StateXferVar(regs.z);
+	StateXferVar(regs.v);
+	StateXferVar(regs.c);
+	StateXferVar(regs.TracePending);
+	StateXferVar(regs.ExternalInterruptPending);
+#if Use68020
+	StateXferVar(regs.sfc);
+	StateXferVar(regs.dfc);
+	StateXferVar(regs.vbr);
+	StateXferVar(regs.cacr);
+	StateXferVar(regs.caar);
+#endif
+	StateXferVar(regs.ResidualCycles);
+#if EnableIdleSkip
+	StateXferVar(IdlePollPC);
+	StateXferVar(IdleEvtPtr);
+	StateXferVar(IdlePolliCount);
+	StateXferVar(IdlePolls);
+#endif
+
+	if (StateLoading) {
+		regs.MaxCyclesToGo = 0;
+		regs.MoreCyclesToGo = 0;
+		m68k_setpc(pc);
+	}
+}
+#endif
+
 #if SmallGlobals
 GLOBALPROC MINEM68K_ReserveAlloc(void)
 {
-	ReserveAllocOneBlock((ui3p *)&regs.disp_table,
-		disp_table_sz * 8, 6, falseblnr);
+	ui3p p;
+
+	ReserveAllocOneBlock(&p, disp_table_sz * 8, 6, falseblnr);
+	disp_table_block = (DecOpR *)p;
 }
 #endif
 
+LOCALPROC disp_table_setup(void)
+{
+#if SmallGlobals
+	disp_table = disp_table_block;
+#endif
+	M68KITAB_setup(disp_table);
+}
+
 GLOBALPROC MINEM68K_Init(
 	ui3b *fIPL)
 {
 	regs.fIPL = fIPL;
+#if IncludeCoverage
+	CovSetRegion(regs.fakeword);
+#endif
+#if EnableTrapAccel
+	TrapAccelInit();
+#endif
 
-	M68KITAB_setup(regs.disp_table);
+#if EmMultiInstance
+	(void) pthread_once(&disp_table_once, disp_table_setup);
+#else
+	if (! disp_table_ready) {
+		disp_table_setup();
+		disp_table_ready = trueblnr;
+	}
+#endif
 }
 
 GLOBALPROC m68k_go_nCycles(ui5b n)
@@ -5097,7 +5966,29 @@ GLOBALPROC m68k_go_nCycles(ui5b n)
 		if (regs.t1) {
 			do_trace();
 		}
-		m68k_go_MaxCycles();
+#if IncludeOpStats
+		if (OpStatsOn) {
+			/*
+				one instruction at a time, so the main loop
+				stays free of counting when it is off.
+			*/
+			regs.MoreCyclesToGo += regs.MaxCyclesToGo - 1;
+			regs.MaxCyclesToGo = 1;
+		}
+#endif
+#if IncludeBench
+		if (InstrCounting) {
+			m68k_go_MaxCyclesCounting();
+		} else
+#endif
+		{
+			m68k_go_MaxCycles();
+		}
+#if IncludeOpStats
+		if (OpStatsOn) {
+			OpStatsNote();
+		}
+#endif
 		regs.MaxCyclesToGo += regs.MoreCyclesToGo;
 		regs.MoreCyclesToGo = 0;
 	}
@@ -5105,3 +5996,98 @@ GLOBALPROC m68k_go_nCycles(ui5b n)
 	regs.ResidualCycles = regs.MaxCyclesToGo;
 	regs.MaxCyclesToGo = 0;
 }
+
+#if IncludeProfile || IncludeTrace
+GLOBALFUNC CPTR m68k_SamplePC(void)
+{
+	return m68k_getpc();
+}
+#endif
+
+#if IncludeProfile
+GLOBALFUNC ui5r m68k_SampleAReg(int i)
+{
+	return m68k_areg(i);
+}
+#endif
+
+#if IncludeCoverage
+GLOBALPROC m68k_CovMapInfo(int i, ui5r *Addr, ui5r *Words,
+	ui5r *AllocSz)
+{
+	ui5r n;
+
+	if (kCovROM == i) {
+		*Addr = kROM_Base;
+		n = kROM_Size >> 1;
+	} else {
+		*Addr = 0;
+		n = kRAM_Size >> 1;
+	}
+	*Words = n;
+	*AllocSz = CovAllocSz(n);
+}
+
+GLOBALPROC m68k_CovSetMap(int i, ui3p Map)
+{
+	CovMaps[i] = Map;
+	CovSetRegion(regs.pc_p);
+}
+#endif
+
+#if IncludeCPUTest
+GLOBALPROC m68k_TestGetRegs(ui5r *r)
+{
+	int i;
+
+	for (i = 0; i < 16; ++i) {
+		r[i] = regs.regs[i];
+	}
+	r[kCPUTestPC] = m68k_getpc();
+	r[kCPUTestSR] = m68k_getSR();
+	r[kCPUTestOSP] = regs.s ? regs.usp : regs.isp;
+}
+
+GLOBALPROC m68k_TestSetRegs(ui5r *r)
+{
+	ui5r sr = r[kCPUTestSR];
+	int i;
+
+	for (i = 0; i < 16; ++i) {
+		regs.regs[i] = r[i];
+	}
+	regs.t1 = (sr >> 15) & 1;
+#if Use68020
+	regs.t0 = 0;
+	regs.m = 0;
+#endif
+	regs.s = (sr >> 13) & 1;
+	regs.intmask = (sr >> 8) & 7;
+	m68k_setCR(sr);
+	if (regs.s) {
+		regs.usp = r[kCPUTestOSP];
+	} else {
+		regs.isp = r[kCPUTestOSP];
+	}
+	regs.TracePending = falseblnr;
+	regs.ExternalInterruptPending = falseblnr;
+	m68k_setpc(r[kCPUTestPC]);
+}
+
+GLOBALPROC m68k_TestDecode(ui4r opcode, ui5r *A, ui5r *B)
+{
+	*A = disp_table[opcode].A;
+	*B = disp_table[opcode].B;
+}
+
+GLOBALPROC m68k_TestStep(void)
+{
+	/* one instruction, after any trace exception left pending */
+	m68k_setpc(m68k_getpc());
+		/* fetching may have run past the end of the test memory */
+	regs.MaxCyclesToGo = 0;
+	regs.MoreCyclesToGo = 0;
+	regs.ResidualCycles = 0;
+	m68k_go_nCycles(1);
+}
+#endif
@@ -29,11 +29,18 @@ EXPORTPROC MINEM68K_ReserveAlloc(void);
 EXPORTPROC m68k_IPLchangeNtfy(void);
 EXPORTPROC DiskInsertedPsuedoException(CPTR newpc, ui5b data);
 EXPORTPROC m68k_reset(void);
+#if IncludeSaveState
+EXPORTPROC m68k_StateXfer(void);
+#endif
 
 EXPORTFUNC si5r GetCyclesRemaining(void);
 EXPORTPROC SetCyclesRemaining(si5r n);
 
 EXPORTPROC m68k_go_nCycles(ui5b n);
+#if IncludeBench
+EXPORTFUNC ui5r m68k_InstrCount(void);
+EXPORTPROC m68k_InstrCountSet(blnr On);
+#endif
 
 /*
 	general purpose access of address space
@@ -50,4 +57,33 @@ EXPORTPROC put_vm_word(CPTR addr, ui4r w);
 EXPORTPROC put_vm_long(CPTR addr, ui5r l);
 
 EXPORTPROC SetHeadATTel(ATTep p);
+#if IncludeRewind
+EXPORTPROC m68k_WriteMATCsReset(void);
+#endif
 EXPORTFUNC ATTep FindATTel(CPTR addr);
+
+#if EnableTrapAccel
+/* for host native versions of traps */
+EXPORTFUNC ui5r TrapAccel_AReg(int i);
+EXPORTFUNC ui3p TrapAccel_Src(CPTR addr, ui5r n);
+EXPORTFUNC ui3p TrapAccel_Dst(CPTR addr, ui5r n);
+	/* where to write n bytes for addr, or nullpr if can't */
+EXPORTPROC TrapAccel_SetD0(ui5r v);
+EXPORTPROC TrapAccel_Done(ui5r Pop, ui5r Cycles);
+#endif
+
+#if IncludeProfile || IncludeTrace
+/* for sampling from a scheduled task, between instructions */
+EXPORTFUNC CPTR m68k_SamplePC(void);
+#endif
+#if IncludeProfile
+EXPORTFUNC ui5r m68k_SampleAReg(int i);
+#endif
+
+#if IncludeCPUTest
+/* for the differential test harness, see CPUTEST.h */
+EXPORTPROC m68k_TestGetRegs(ui5r *r);
+EXPORTPROC m68k_TestSetRegs(ui5r *r);
+EXPORTPROC m68k_TestDecode(ui4r opcode, ui5r *A, ui5r *B);
+EXPORTPROC m68k_TestStep(void);
+#endif
@@ -21,6 +21,10 @@
 	SDL Library should go here.
 */
 
+#ifdef __linux__
+#define _GNU_SOURCE /* for sched_setaffinity */
+#endif
+
 #include "CNFGRAPI.h"
 #include "SYSDEPNS.h"
 #include "ENDIANAC.h"
@@ -91,8 +95,715 @@ LOCALPROC dbglog_close0(void)
 
 #include "COMOSGLU.h"
 
+#if IncludeSaveState
+#include "SAVESTAT.h"
+#endif
+
+#if IncludeBench
+#include "MICROBEN.h"
+#endif
+#if IncludeCPUTest
+#include "CPUTEST.h"
+#endif
+#if IncludeProfile
+#include "PROFILER.h"
+#endif
+#if IncludeOpStats
+#include "OPSTATS.h"
+#endif
+#if IncludeMemStats
+#include "MEMSTATS.h"
+#endif
+#if IncludeTrace
+#include "TRACE.h"
+#endif
+#if IncludeCoverage
+#include "COVERAGE.h"
+#endif
+#if IncludeWatch
+#include "WATCH.h"
+#endif
+
 #include "CONTROLM.h"
 
+#if IncludeSonyCmprs
+#include "CMPRSDSK.h"
+#endif
+
+#if IncludeHostFS
+#include "HOSTFSDV.h"
+#endif
+
+/* --- save states --- */
+
+#if IncludeSaveState
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+LOCALVAR char *StateFilePath = "minivmac.sav";
+LOCALVAR blnr WantLoadState = falseblnr;
+
+LOCALFUNC blnr SaveStateNow(void)
+{
+	/*
+		the header is built in a buffer, and written along
+		with RAM straight from where it is, in one call.
+	*/
+	ui3p ChunkP[kStateMaxChunks];
+	ui5r ChunkN[kStateMaxChunks];
+	struct iovec iov[kStateMaxChunks];
+	ssize_t total = 0;
+	int n;
+	int i;
+	int fd;
+	blnr IsOk = falseblnr;
+	ui3p Hdr = (ui3p)malloc(SaveState_HeaderSize());
+
+	if (NULL != Hdr) {
+		n = SaveState_Save(Hdr, ChunkP, ChunkN);
+		for (i = 0; i < n; ++i) {
+			iov[i].iov_base = (void *)ChunkP[i];
+			iov[i].iov_len = ChunkN[i];
+			total += ChunkN[i];
+		}
+
+		fd = open(StateFilePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd >= 0) {
+			if (total == writev(fd, iov, n)) {
+				IsOk = trueblnr;
+			}
+			if (0 != close(fd)) {
+				IsOk = falseblnr;
+			}
+		}
+		free(Hdr);
+	}
+
+	if (! IsOk) {
+		MacMsg(kStrStateSaveFailTitle, kStrStateSaveFailMessage,
+			falseblnr);
+	}
+
+	return IsOk;
+}
+
+LOCALFUNC blnr LoadStateNow(void)
+{
+	/* mapped rather than read, only the header is looked at twice */
+	struct stat st;
+	void *p;
+	int fd;
+	blnr IsOk = falseblnr;
+
+	fd = open(StateFilePath, O_RDONLY);
+	if (fd >= 0) {
+		if ((0 == fstat(fd, &st)) && (st.st_size > 0)
+			&& (st.st_size <= 0x7FFFFFFF))
+		{
+			p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (MAP_FAILED != p) {
+				IsOk = SaveState_Load((ui3p)p, st.st_size);
+				(void) munmap(p, st.st_size);
+			}
+		}
+		(void) close(fd);
+	}
+
+	if (IsOk) {
+		NeedWholeScreenDraw = trueblnr;
+	} else {
+		MacMsg(kStrStateLoadFailTitle, kStrStateLoadFailMessage,
+			falseblnr);
+	}
+
+	return IsOk;
+}
+
+#endif
+
+/* --- benchmark --- */
+
+#if IncludeBench
+LOCALVAR ui5r BenchTicks = 0;
+	/* if not zero, run this many ticks all out, report, and quit */
+LOCALVAR char *BenchOutPath = NULL;
+LOCALVAR double BenchFrames;
+LOCALVAR double BenchDiskBytes;
+LOCALVAR int MicroBenchKind = -1;
+	/* if not negative, run this microbenchmark instead of a ROM */
+LOCALVAR ui5r MicroBenchIters = 0;
+#if EmMultiInstance
+#define kMaxMicroBenchInsts 64
+LOCALVAR int MicroBenchInsts = 1;
+	/* Macs running the microbenchmark at once, a thread each */
+#endif
+
+#define kBenchMacDate 0xB492F400
+	/* 1 January 2000, emulated clock starts here when benchmarking */
+#endif
+
+#if IncludeCPUTest
+LOCALVAR ui5r CPUTestCases = 0;
+	/* if not zero, run this many CPU test cases, and quit */
+LOCALVAR ui5r CPUTestSeed = 1;
+LOCALVAR ui5r CPUTestSteps = 8; /* instructions in each case */
+LOCALVAR char *CPUTestRecordPath = NULL;
+LOCALVAR char *CPUTestCheckPath = NULL;
+
+#define CPUTestWanted() \
+	((0 != CPUTestCases) || (NULL != CPUTestCheckPath))
+#endif
+
+/* --- profiler --- */
+
+#if IncludeProfile
+LOCALVAR char *ProfileOutPath = NULL; /* report of hot code and traps */
+LOCALVAR char *ProfileFoldedPath = NULL; /* stacks, for flamegraph.pl */
+LOCALVAR ui5r ProfileEvery = 4096; /* emulated cycles between samples */
+LOCALVAR blnr ProfileStarted = falseblnr;
+
+#define ProfileWanted() \
+	((NULL != ProfileOutPath) || (NULL != ProfileFoldedPath))
+#endif
+
+/* --- instruction counts --- */
+
+#if IncludeOpStats
+LOCALVAR char *OpStatsOutPath = NULL; /* counts, written on quitting */
+#endif
+
+/* --- host time accounting --- */
+
+#if IncludeHostTime
+LOCALVAR char *HostTimeOutPath = NULL; /* rewritten every so often */
+LOCALVAR ui5r HostTimeEvery = 10; /* seconds between writes */
+#endif
+
+/* --- binary trace --- */
+
+#if IncludeTrace
+
+/*
+	Each thread that runs the emulation puts records in a ring of
+	its own, with no locking. A thread of our own takes them out
+	and writes them to the file. When a ring is full, records are
+	dropped and counted, and the count is put in the ring as a
+	kTraceLost record once there is room again.
+*/
+
+#define kLn2TraceRingSz 16 /* records in each ring */
+#define kTraceRingSz PowOf2(kLn2TraceRingSz)
+#define kTraceDelay 20 /* milliseconds between writes to the file */
+#define kTraceMaxNames 4096
+#define kTraceNameHashSz 8192
+#define kTraceBufRecs 256
+
+struct TraceRingR {
+	ui5b *Recs;
+	SDL_atomic_t Head; /* records put, only changed by the owner */
+	SDL_atomic_t Tail; /* records written, only by the trace thread */
+	ui5r Lost;
+	struct TraceRingR *Next;
+};
+typedef struct TraceRingR TraceRingR;
+
+GLOBALVAR blnr TraceOn = falseblnr;
+
+LOCALVAR char *TraceOutPath = NULL;
+LOCALVAR FILE *TraceFile = NULL;
+LOCALINSTVAR TraceRingR *TraceMyRing = NULL;
+LOCALVAR TraceRingR *TraceRings = NULL;
+LOCALVAR SDL_mutex *TraceLock = NULL; /* the list of rings, the names */
+LOCALVAR SDL_Thread *TraceThread = NULL;
+LOCALVAR SDL_atomic_t TraceQuit;
+LOCALVAR char *TraceNames[kTraceMaxNames]; /* by id, 0 not used */
+LOCALVAR ui4r TraceNameHash[kTraceNameHashSz];
+LOCALVAR ui5r TraceNNames = 0;
+
+LOCALFUNC TraceRingR *TraceNewRing(void)
+{
+	TraceRingR *r = (TraceRingR *)calloc(1, sizeof(TraceRingR));
+
+	if (NULL != r) {
+		r->Recs = (ui5b *)malloc(kTraceRingSz * kTraceRecSz);
+		if (NULL == r->Recs) {
+			free(r);
+			r = NULL;
+		} else {
+			SDL_LockMutex(TraceLock);
+			r->Next = TraceRings;
+			TraceRings = r;
+			SDL_UnlockMutex(TraceLock);
+		}
+	}
+
+	return r;
+}
+
+LOCALFUNC blnr TracePutRec(TraceRingR *r,
+	ui5r Time, ui5r Info, ui5r Addr, ui5r Data, ui5r PC)
+{
+	ui5b *p;
+	ui5r h = (ui5r)SDL_AtomicGet(&r->Head);
+	ui5r t = (ui5r)SDL_AtomicGet(&r->Tail);
+
+	/* don't reuse a slot before the trace thread is done with it */
+	SDL_MemoryBarrierAcquire();
+	if ((ui5r)(h - t) >= kTraceRingSz) {
+		return falseblnr;
+	}
+
+	p = r->Recs + (h & (kTraceRingSz - 1)) * kTraceRecWords;
+	p[0] = Time;
+	p[1] = Info;
+	p[2] = Addr;
+	p[3] = Data;
+	p[4] = PC;
+	/* publish the record to the trace thread */
+	SDL_MemoryBarrierRelease();
+	(void) SDL_AtomicSet(&r->Head, (int)(h + 1));
+
+	return trueblnr;
+}
+
+GLOBALPROC Trace_Put(ui5r Time, ui5r Info, ui5r Addr, ui5r Data,
+	ui5r PC)
+{
+	TraceRingR *r = TraceMyRing;
+
+	if (NULL == r) {
+		if (NULL == (r = TraceNewRing())) {
+			return;
+		}
+		TraceMyRing = r;
+	}
+	if (0 != r->Lost) {
+		if (TracePutRec(r, Time, TraceInfo(kTraceLost, 0, 0),
+			0, r->Lost, PC))
+		{
+			r->Lost = 0;
+		}
+	}
+	if (! TracePutRec(r, Time, Info, Addr, Data, PC)) {
+		++r->Lost;
+	}
+}
+
+LOCALFUNC ui5r TraceNameChars(char *s, int n)
+{
+	/* up to 4 chars, big endian, padded with zeros */
+	ui5r v = 0;
+	int i;
+
+	for (i = 0; i < 4; ++i) {
+		v <<= 8;
+		if (i < n) {
+			v |= (ui3b)s[i];
+		}
+	}
+
+	return v;
+}
+
+GLOBALFUNC ui5r Trace_NameId(char *s)
+{
+	/* names are interned by address, they must be constant */
+	ui5r h = (ui5r)(((unsigned long)s) >> 2) & (kTraceNameHashSz - 1);
+	ui5r id;
+	blnr IsNew = falseblnr;
+
+	SDL_LockMutex(TraceLock);
+	while ((0 != (id = TraceNameHash[h])) && (TraceNames[id] != s)) {
+		h = (h + 1) & (kTraceNameHashSz - 1);
+	}
+	if ((0 == id) && (TraceNNames + 1 < kTraceMaxNames)) {
+		id = ++TraceNNames;
+		TraceNames[id] = s;
+		TraceNameHash[h] = id;
+		IsNew = trueblnr;
+	}
+	SDL_UnlockMutex(TraceLock);
+
+	if (IsNew) {
+		int n = strlen(s);
+		int k;
+
+		for (k = 0; (k == 0) || (8 * k < n); ++k) {
+			char *p = s + 8 * k;
+			int m = n - 8 * k;
+
+			Trace_Put(n, TraceInfo(kTraceName, k, id),
+				TraceNameChars(p, m), TraceNameChars(p + 4, m - 4), 0);
+		}
+	}
+
+	return id;
+}
+
+LOCALPROC TracePutLong(ui3p p, ui5r v)
+{
+	p[0] = (v >> 24) & 0xFF;
+	p[1] = (v >> 16) & 0xFF;
+	p[2] = (v >> 8) & 0xFF;
+	p[3] = v & 0xFF;
+}
+
+LOCALPROC TraceDrain(void)
+{
+	ui3b Buf[kTraceBufRecs * kTraceRecSz];
+	TraceRingR *r;
+	ui5b *p;
+	ui5r t;
+	ui5r h;
+	int n;
+	int i;
+
+	SDL_LockMutex(TraceLock);
+	r = TraceRings;
+	SDL_UnlockMutex(TraceLock);
+
+	/* new rings only go on the front, so the rest can be walked */
+	for (; NULL != r; r = r->Next) {
+		t = (ui5r)SDL_AtomicGet(&r->Tail);
+		h = (ui5r)SDL_AtomicGet(&r->Head);
+		/* see the records up to h, not older contents */
+		SDL_MemoryBarrierAcquire();
+		while (t != h) {
+			n = 0;
+			while ((t != h) && (n < kTraceBufRecs)) {
+				p = r->Recs + (t & (kTraceRingSz - 1)) * kTraceRecWords;
+				for (i = 0; i < kTraceRecWords; ++i) {
+					TracePutLong(Buf + n * kTraceRecSz + 4 * i, p[i]);
+				}
+				++n;
+				++t;
+			}
+			(void) fwrite(Buf, kTraceRecSz, n, TraceFile);
+			/* done reading the slots, the owner may reuse them */
+			SDL_MemoryBarrierRelease();
+			(void) SDL_AtomicSet(&r->Tail, (int)t);
+		}
+	}
+	(void) fflush(TraceFile);
+}
+
+LOCALFUNC int SDLCALL TraceThreadMain(void *data)
+{
+	blnr Quit;
+
+	do {
+		/* look before draining, so the last drain gets everything */
+		Quit = (0 != SDL_AtomicGet(&TraceQuit));
+		TraceDrain();
+		if (! Quit) {
+			SDL_Delay(kTraceDelay);
+		}
+	} while (! Quit);
+
+	return 0;
+}
+
+LOCALFUNC blnr TraceStart(void)
+{
+	ui3b Head[kTraceHeadSz];
+
+	TracePutLong(Head, kTraceMagic);
+	TracePutLong(Head + 4, kTraceVersion);
+	TracePutLong(Head + 8, kTraceRecSz);
+	TracePutLong(Head + 12, 0);
+
+	if ((NULL == (TraceFile = fopen(TraceOutPath, "wb")))
+		|| (1 != fwrite(Head, kTraceHeadSz, 1, TraceFile))
+		|| (NULL == (TraceLock = SDL_CreateMutex())))
+	{
+		return falseblnr;
+	}
+
+	SDL_AtomicSet(&TraceQuit, 0);
+	if (NULL == (TraceThread = SDL_CreateThread(TraceThreadMain,
+		"Trace", NULL)))
+	{
+		return falseblnr;
+	}
+
+	TraceOn = trueblnr;
+
+	return trueblnr;
+}
+
+LOCALPROC TraceStop(void)
+{
+	TraceOn = falseblnr;
+	if (NULL != TraceThread) {
+		SDL_AtomicSet(&TraceQuit, 1);
+		SDL_WaitThread(TraceThread, NULL);
+		TraceThread = NULL;
+	}
+	if (NULL != TraceFile) {
+		fclose(TraceFile);
+		TraceFile = NULL;
+	}
+}
+
+#if IncludeForkServer
+LOCALVAR char TraceChildPath[1024];
+
+LOCALPROC TraceForkChild(int k)
+{
+	/*
+		The trace thread, the file and the lock belong to the
+		parent, and records still in the rings are for it to
+		write. Each child lets go of them without touching them,
+		and starts a trace of its own, in FILE.<k>, with the
+		names put in again.
+	*/
+	TraceOn = falseblnr;
+	TraceThread = NULL;
+	TraceFile = NULL;
+	TraceLock = NULL;
+	TraceRings = NULL;
+	TraceMyRing = NULL;
+	TraceNNames = 0;
+	(void) memset(TraceNameHash, 0, sizeof(TraceNameHash));
+
+	if (NULL != TraceOutPath) {
+		(void) snprintf(TraceChildPath, sizeof(TraceChildPath),
+			"%s.%d", TraceOutPath, k);
+		TraceOutPath = TraceChildPath;
+		if (! TraceStart()) {
+			TraceStop();
+			MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+		}
+	}
+}
+#endif
+
+#endif /* IncludeTrace */
+
+/* --- code coverage --- */
+
+#if IncludeCoverage
+
+#include <signal.h>
+
+LOCALVAR char *CovOutPath = NULL; /* written on quitting, or SIGUSR1 */
+LOCALVAR char CovChildPath[1024];
+LOCALVAR ui3p CovMapDat[kNumCovMaps];
+LOCALVAR volatile sig_atomic_t CovWriteWanted = 0;
+
+LOCALPROC CovSignal(int sig)
+{
+	UnusedParam(sig);
+	CovWriteWanted = 1;
+}
+
+LOCALFUNC blnr CovStart(void)
+{
+	int i;
+	ui5r Addr;
+	ui5r Words;
+	ui5r AllocSz;
+
+	for (i = 0; i < kNumCovMaps; ++i) {
+		m68k_CovMapInfo(i, &Addr, &Words, &AllocSz);
+		if (NULL == (CovMapDat[i] = (ui3p)calloc(1, AllocSz))) {
+			return falseblnr;
+		}
+	}
+	for (i = 0; i < kNumCovMaps; ++i) {
+		m68k_CovSetMap(i, CovMapDat[i]);
+	}
+	(void) signal(SIGUSR1, CovSignal);
+
+	return trueblnr;
+}
+
+LOCALPROC CovPutLong(FILE *f, ui5r v)
+{
+	(void) putc((v >> 24) & 0xFF, f);
+	(void) putc((v >> 16) & 0xFF, f);
+	(void) putc((v >> 8) & 0xFF, f);
+	(void) putc(v & 0xFF, f);
+}
+
+LOCALPROC CovWrite(void)
+{
+	FILE *f;
+	int i;
+	ui5r j;
+	ui5r Addr;
+	ui5r Words;
+	ui5r AllocSz;
+	ui3p p;
+	ui3r b;
+	char TempPath[1024];
+
+	/* write then rename, so a reader never sees half a file */
+	sprintf(TempPath, "%.1000s.tmp", CovOutPath);
+	if (NULL == (f = fopen(TempPath, "wb"))) {
+		MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+		return;
+	}
+
+	CovPutLong(f, kCovMagic);
+	CovPutLong(f, kCovVersion);
+	CovPutLong(f, kNumCovMaps);
+	for (i = 0; i < kNumCovMaps; ++i) {
+		m68k_CovMapInfo(i, &Addr, &Words, &AllocSz);
+		CovPutLong(f, Addr);
+		CovPutLong(f, Words);
+		p = CovMapDat[i];
+		for (j = 0; j < Words; j += 8) {
+			b = 0;
+			/* the map holds only 0 or 1 */
+			b |= p[j] << 7;
+			b |= p[j + 1] << 6;
+			b |= p[j + 2] << 5;
+			b |= p[j + 3] << 4;
+			b |= p[j + 4] << 3;
+			b |= p[j + 5] << 2;
+			b |= p[j + 6] << 1;
+			b |= p[j + 7];
+			(void) putc(b, f);
+		}
+	}
+	fclose(f);
+	(void) rename(TempPath, CovOutPath);
+}
+
+#if IncludeForkServer
+LOCALPROC CovForkChild(int k)
+{
+	/* each child writes a file of its own, to be merged after */
+	if (NULL != CovOutPath) {
+		(void) snprintf(CovChildPath, sizeof(CovChildPath),
+			"%s.%d", CovOutPath, k);
+		CovOutPath = CovChildPath;
+	}
+}
+#endif
+
+#endif /* IncludeCoverage */
+
+/* --- watchpoints --- */
+
+#if IncludeWatch
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define kMaxWatchArgs 16
+
+LOCALVAR char *WatchArgs[kMaxWatchArgs]; /* from --watch */
+LOCALVAR int NWatchArgs = 0;
+LOCALVAR char *ControlPath = NULL; /* named pipe of commands */
+LOCALVAR int ControlFd = -1;
+LOCALVAR char ControlLine[256];
+LOCALVAR int ControlLineLen = 0;
+
+#define WatchIsSep(c) ((',' == (c)) || (' ' == (c)) || ('\t' == (c)))
+
+LOCALFUNC blnr WatchParse(char *s)
+{
+	/* "ADDR,LEN[,KIND]", KIND r, w (the default) or rw */
+	char *p;
+	ui5r Addr;
+	ui5r Len;
+	ui3r Kind = 0;
+
+	Addr = strtoul(s, &p, 0);
+	if ((p == s) || ! WatchIsSep(*p)) {
+		return falseblnr;
+	}
+	while (WatchIsSep(*p)) {
+		++p;
+	}
+	s = p;
+	Len = strtoul(s, &p, 0);
+	if (p == s) {
+		return falseblnr;
+	}
+	while (WatchIsSep(*p)) {
+		++p;
+	}
+	for (; 0 != *p; ++p) {
+		if ('r' == *p) {
+			Kind |= kWatchRead;
+		} else if ('w' == *p) {
+			Kind |= kWatchWrite;
+		} else {
+			return falseblnr;
+		}
+	}
+	if (0 == Kind) {
+		Kind = kWatchWrite;
+	}
+
+	return Watch_Add(Addr, Len, Kind);
+}
+
+LOCALPROC ControlCommand(char *s)
+{
+	if (0 == strncmp(s, "watch ", 6)) {
+		if (! WatchParse(s + 6)) {
+			fprintf(stderr, "bad watch: %s\n", s + 6);
+		}
+	} else if (0 == strcmp(s, "unwatch")) {
+		Watch_ClearAll();
+	} else if (0 != *s) {
+		fprintf(stderr, "unknown command: %s\n", s);
+	}
+}
+
+LOCALPROC ControlStart(void)
+{
+	int i;
+
+	for (i = 0; i < NWatchArgs; ++i) {
+		if (! WatchParse(WatchArgs[i])) {
+			fprintf(stderr, "bad watch: %s\n", WatchArgs[i]);
+		}
+	}
+
+	if (NULL != ControlPath) {
+		if ((0 != mkfifo(ControlPath, 0600)) && (EEXIST != errno)) {
+			/* fail */
+		} else {
+			/* not blocked by there being no writer */
+			ControlFd = open(ControlPath, O_RDONLY | O_NONBLOCK);
+		}
+		if (ControlFd < 0) {
+			MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+		}
+	}
+}
+
+LOCALPROC ControlPoll(void)
+{
+	/* between instructions, so the ATT can be changed */
+	char c;
+
+	while (1 == read(ControlFd, &c, 1)) {
+		if ('\n' == c) {
+			ControlLine[ControlLineLen] = 0;
+			ControlCommand(ControlLine);
+			ControlLineLen = 0;
+		} else if (ControlLineLen < (int)sizeof(ControlLine) - 1) {
+			ControlLine[ControlLineLen++] = c;
+		}
+	}
+}
+
+#endif /* IncludeWatch */
+
 /* --- parameter buffers --- */
 
 #if IncludePbufs
@@ -190,7 +901,113 @@ LOCALPROC NativeStrFromCStr(char *r, char *s)
 
 LOCALVAR FILE *Drives[NumDrives]; /* open disk image files */
 
-LOCALPROC InitDrives(void)
+#if IncludeForkServer
+LOCALVAR char *DrivePath[NumDrives];
+	/* so that a forked child can open its own copy */
+#endif
+
+#if IncludeSonyOverlay
+/*
+	Copy on write overlays. The disk image in Drives[i] is
+	opened read only, and is never changed. Blocks written by
+	the emulated machine go to a delta, either a sparse file
+	or blocks allocated in memory, and a bitmap records which
+	blocks are in the delta.
+
+	Format of a delta file (longs are big endian):
+		0  : 'mvOV'
+		4  : version (1)
+		8  : log2 of the block size
+		12 : size of the base image
+		16 : bitmap, one bit per block, high bit first
+	followed, at the next block boundary, by the block data,
+	with each block at the same position as in the base image.
+	Blocks never written are left as holes in the file.
+*/
+
+#define kLn2OvlBlockSz 9
+#define kOvlBlockSz (1 << kLn2OvlBlockSz)
+
+#define kOvlSignature 0x6D764F56
+#define kOvlVersion 1
+
+#define kOvlOffset_Sig 0
+#define kOvlOffset_Version 4
+#define kOvlOffset_Ln2BlockSz 8
+#define kOvlOffset_BaseSize 12
+#define kOvlOffset_Map 16
+#define kOvlHeaderSz 16
+
+LOCALVAR blnr DriveHasOverlay[NumDrives];
+LOCALVAR FILE *DriveDelta[NumDrives];
+	/* delta file, or NotAfileRef if delta kept in memory */
+LOCALVAR ui3p *DriveDeltaMem[NumDrives];
+	/* blocks of in memory delta, nullpr where never written */
+LOCALVAR ui3p DriveDeltaMap[NumDrives];
+LOCALVAR ui5r DriveDeltaBlocks[NumDrives];
+LOCALVAR ui5r DriveBaseSize[NumDrives];
+LOCALVAR ui5r DriveDeltaDataOffset[NumDrives];
+
+/* overlay wanted for next disk image from command line */
+LOCALVAR char *OverlayPathWanted = NULL;
+LOCALVAR blnr OverlayInMemWanted = falseblnr;
+
+#define OvlHasBlock(Drive_No, block) \
+	((DriveDeltaMap[Drive_No][(block) >> 3] \
+		& (0x80 >> ((block) & 7))) != 0)
+#endif
+
+#if IncludeSonyCmprs
+/*
+	Compressed disk images, see CMPRSDSK.h. Decompressed
+	chunks are kept in a small cache for each drive, since
+	the emulated machine usually reads a few blocks at a time.
+*/
+
+#define kCmprsCacheSz 4
+
+LOCALVAR blnr DriveIsCmprs[NumDrives];
+LOCALVAR ui5r DriveCmprsSize[NumDrives];
+LOCALVAR ui5r DriveCmprsLn2ChunkSz[NumDrives];
+LOCALVAR ui3p DriveCmprsIndex[NumDrives];
+LOCALVAR ui3p DriveCmprsPacked[NumDrives];
+LOCALVAR ui3p DriveCmprsCache[NumDrives][kCmprsCacheSz];
+LOCALVAR ui5r DriveCmprsCacheChunk[NumDrives][kCmprsCacheSz];
+LOCALVAR ui5r DriveCmprsCacheAge[NumDrives][kCmprsCacheSz];
+LOCALVAR ui5r CmprsCacheClock = 0;
+
+#define kCmprsNoChunk ((ui5r) -1)
+#endif
+
+#if IncludeSonyRamDisk
+/*
+	RAM disks live entirely in host memory, with no disk
+	image file (Drives[i] is NotAfileRef). The contents may
+	be loaded from a disk image, and saved to a file when
+	the RAM disk is ejected.
+*/
+
+LOCALVAR ui3p DriveRamData[NumDrives];
+LOCALVAR ui5r DriveRamSize[NumDrives];
+LOCALVAR char *DriveRamSavePath[NumDrives];
+
+/* save file for next RAM disk from command line */
+LOCALVAR char *RamDiskSavePathWanted = NULL;
+
+#define kRamDiskMaxSize 0x80000000UL /* 2048M */
+#endif
+
+#if IncludeSonyWriteBack
+LOCALVAR blnr DriveWbOn[NumDrives];
+LOCALVAR ui5r DriveWbSize[NumDrives];
+#endif
+
+#if IncludeSCSIDisks
+/* next disk image from command line goes on SCSI bus */
+LOCALVAR blnr SCSIDiskWanted = falseblnr;
+#endif
+
+LOCALPROC InitDrives(void)
 {
 	/*
 		This isn't really needed, Drives[i] and DriveNames[i]
@@ -200,15 +1017,28 @@ LOCALPROC InitDrives(void)
 
 	for (i = 0; i < NumDrives; ++i) {
 		Drives[i] = NotAfileRef;
+#if IncludeForkServer
+		DrivePath[i] = NULL;
+#endif
+#if IncludeSonyWriteBack
+		DriveWbOn[i] = falseblnr;
+#endif
+#if IncludeSonyRamDisk
+		DriveRamData[i] = nullpr;
+#endif
+#if IncludeSonyCmprs
+		DriveIsCmprs[i] = falseblnr;
+#endif
+#if IncludeSonyOverlay
+		DriveHasOverlay[i] = falseblnr;
+#endif
 	}
 }
 
-GLOBALFUNC tMacErr vSonyTransfer(blnr IsWrite, ui3p Buffer,
-	tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count,
-	ui5r *Sony_ActCount)
+LOCALFUNC tMacErr FileTransfer(FILE *refnum, blnr IsWrite, ui3p Buffer,
+	ui5r Sony_Start, ui5r Sony_Count, ui5r *Sony_ActCount)
 {
 	tMacErr err = mnvm_miscErr;
-	FILE *refnum = Drives[Drive_No];
 	ui5r NewSony_Count = 0;
 
 	if (0 == fseek(refnum, Sony_Start, SEEK_SET)) {
@@ -230,1768 +1060,5317 @@ GLOBALFUNC tMacErr vSonyTransfer(blnr IsWrite, ui3p Buffer,
 	return err; /*& figure out what really to return &*/
 }
 
-GLOBALFUNC tMacErr vSonyGetSize(tDrive Drive_No, ui5r *Sony_Count)
+#if IncludeSonyCmprs
+LOCALFUNC tMacErr CmprsGetChunk(tDrive Drive_No, ui5r chunk, ui3p *p)
 {
-	tMacErr err = mnvm_miscErr;
-	FILE *refnum = Drives[Drive_No];
-	long v;
+	ui5r Ln2ChunkSz = DriveCmprsLn2ChunkSz[Drive_No];
+	ui5r ChunkSz = DriveCmprsSize[Drive_No] - (chunk << Ln2ChunkSz);
+	ui3p Index = DriveCmprsIndex[Drive_No];
+	ui5r offset = do_get_mem_long(Index + chunk * 4);
+	ui5r L = do_get_mem_long(Index + chunk * 4 + 4) - offset;
+	ui3p buf;
+	int i;
+	int j = 0;
 
-	if (0 == fseek(refnum, 0, SEEK_END)) {
-		v = ftell(refnum);
-		if (v >= 0) {
-			*Sony_Count = v;
-			err = mnvm_noErr;
+	for (i = 0; i < kCmprsCacheSz; ++i) {
+		if (chunk == DriveCmprsCacheChunk[Drive_No][i]) {
+			DriveCmprsCacheAge[Drive_No][i] = ++CmprsCacheClock;
+			*p = DriveCmprsCache[Drive_No][i];
+			return mnvm_noErr;
+		}
+		if (DriveCmprsCacheAge[Drive_No][i]
+			< DriveCmprsCacheAge[Drive_No][j])
+		{
+			j = i;
 		}
 	}
 
-	return err; /*& figure out what really to return &*/
+	/* not cached, replace least recently used */
+	if (ChunkSz > ((ui5r)1 << Ln2ChunkSz)) {
+		ChunkSz = (ui5r)1 << Ln2ChunkSz;
+	}
+	buf = DriveCmprsCache[Drive_No][j];
+	DriveCmprsCacheChunk[Drive_No][j] = kCmprsNoChunk;
+	DriveCmprsCacheAge[Drive_No][j] = 0;
+
+	if (0 == L) {
+		(void) memset(buf, 0, ChunkSz);
+	} else if (L == ChunkSz) {
+		if (mnvm_noErr != FileTransfer(Drives[Drive_No], falseblnr,
+			buf, offset, L, nullpr))
+		{
+			return mnvm_miscErr;
+		}
+	} else if ((L > ChunkSz)
+		|| (mnvm_noErr != FileTransfer(Drives[Drive_No], falseblnr,
+			DriveCmprsPacked[Drive_No], offset, L, nullpr))
+		|| ! CmprsDecode(DriveCmprsPacked[Drive_No], L, buf, ChunkSz))
+	{
+		return mnvm_miscErr;
+	}
+
+	DriveCmprsCacheChunk[Drive_No][j] = chunk;
+	DriveCmprsCacheAge[Drive_No][j] = ++CmprsCacheClock;
+	*p = buf;
+
+	return mnvm_noErr;
 }
+#endif
 
-LOCALFUNC tMacErr vSonyEject0(tDrive Drive_No, blnr deleteit)
+#if IncludeSonyCmprs
+LOCALFUNC tMacErr CmprsTransfer(blnr IsWrite, ui3p Buffer,
+	tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count,
+	ui5r *Sony_ActCount)
 {
-	FILE *refnum = Drives[Drive_No];
+	tMacErr err = mnvm_noErr;
+	ui5r Size = DriveCmprsSize[Drive_No];
+	ui5r Ln2ChunkSz = DriveCmprsLn2ChunkSz[Drive_No];
+	ui5r n = 0;
 
-	DiskEjectedNotify(Drive_No);
+	if (IsWrite) {
+		/* writes only possible through an overlay */
+		Sony_Count = 0;
+		err = mnvm_wPrErr;
+	} else if (Sony_Start > Size) {
+		Sony_Count = 0;
+		err = mnvm_eofErr;
+	} else if (Sony_Count > Size - Sony_Start) {
+		Sony_Count = Size - Sony_Start;
+		err = mnvm_eofErr;
+	}
 
-	fclose(refnum);
-	Drives[Drive_No] = NotAfileRef; /* not really needed */
+	while (n < Sony_Count) {
+		ui5r offset = Sony_Start + n;
+		ui5r chunk = offset >> Ln2ChunkSz;
+		ui5r inchunk = offset & (((ui5r)1 << Ln2ChunkSz) - 1);
+		ui5r L = ((ui5r)1 << Ln2ChunkSz) - inchunk;
+		ui3p p;
+		tMacErr err2 = CmprsGetChunk(Drive_No, chunk, &p);
 
-	return mnvm_noErr;
-}
+		if (mnvm_noErr != err2) {
+			err = err2;
+			break;
+		}
+		if (L > Sony_Count - n) {
+			L = Sony_Count - n;
+		}
+		MyMoveBytes(p + inchunk, Buffer + n, L);
+		n += L;
+	}
 
-GLOBALFUNC tMacErr vSonyEject(tDrive Drive_No)
-{
-	return vSonyEject0(Drive_No, falseblnr);
+	if (nullpr != Sony_ActCount) {
+		*Sony_ActCount = n;
+	}
+
+	return err;
 }
+#endif
 
-LOCALPROC UnInitDrives(void)
+#if IncludeSonyCmprs
+LOCALPROC CmprsDetach(tDrive Drive_No)
 {
-	tDrive i;
+	if (DriveIsCmprs[Drive_No]) {
+		int i;
 
-	for (i = 0; i < NumDrives; ++i) {
-		if (vSonyIsInserted(i)) {
-			(void) vSonyEject(i);
+		for (i = 0; i < kCmprsCacheSz; ++i) {
+			free(DriveCmprsCache[Drive_No][i]);
+			DriveCmprsCache[Drive_No][i] = nullpr;
 		}
+		free(DriveCmprsPacked[Drive_No]);
+		DriveCmprsPacked[Drive_No] = nullpr;
+		free(DriveCmprsIndex[Drive_No]);
+		DriveCmprsIndex[Drive_No] = nullpr;
+		DriveIsCmprs[Drive_No] = falseblnr;
 	}
 }
+#endif
 
-LOCALFUNC blnr Sony_Insert0(FILE *refnum, blnr locked,
-	char *drivepath)
+#if IncludeSonyCmprs
+LOCALFUNC blnr CmprsAttach(tDrive Drive_No)
 {
-	tDrive Drive_No;
-	blnr IsOk = falseblnr;
+	/*
+		returns trueblnr if the image isn't compressed,
+		or is a valid compressed image.
+	*/
+	FILE *refnum = Drives[Drive_No];
+	ui3b Header[kCmprsHeaderSz];
+	ui5r Ln2ChunkSz;
+	ui5r Size;
+	ui5r nChunks;
+	ui5r IndexSz;
+	ui5r i;
+	ui3p Index;
+
+	if ((mnvm_noErr != FileTransfer(refnum, falseblnr, Header,
+			0, kCmprsHeaderSz, nullpr))
+		|| (kCmprsSignature != do_get_mem_long(&Header[kCmprsOffset_Sig])))
+	{
+		return trueblnr; /* ordinary disk image */
+	}
 
-	if (! FirstFreeDisk(&Drive_No)) {
-		MacMsg(kStrTooManyImagesTitle, kStrTooManyImagesMessage,
-			falseblnr);
-	} else {
-		/* printf("Sony_Insert0 %d\n", (int)Drive_No); */
+	Ln2ChunkSz = do_get_mem_long(&Header[kCmprsOffset_Ln2ChunkSz]);
+	Size = do_get_mem_long(&Header[kCmprsOffset_Size]);
+	if ((kCmprsVersion
+			!= do_get_mem_long(&Header[kCmprsOffset_Version]))
+		|| (Ln2ChunkSz < 9) || (Ln2ChunkSz > kLn2CmprsMaxChunkSz))
+	{
+		return falseblnr;
+	}
+	nChunks = (Size >> Ln2ChunkSz)
+		+ ((0 != (Size & (((ui5r)1 << Ln2ChunkSz) - 1))) ? 1 : 0);
+	IndexSz = (nChunks + 1) * 4;
+
+	DriveIsCmprs[Drive_No] = trueblnr;
+	DriveCmprsSize[Drive_No] = Size;
+	DriveCmprsLn2ChunkSz[Drive_No] = Ln2ChunkSz;
+	DriveCmprsIndex[Drive_No] = Index = (ui3p)malloc(IndexSz);
+	DriveCmprsPacked[Drive_No] = (ui3p)malloc((ui5r)1 << Ln2ChunkSz);
+	for (i = 0; i < kCmprsCacheSz; ++i) {
+		DriveCmprsCache[Drive_No][i] =
+			(ui3p)malloc((ui5r)1 << Ln2ChunkSz);
+		DriveCmprsCacheChunk[Drive_No][i] = kCmprsNoChunk;
+		DriveCmprsCacheAge[Drive_No][i] = 0;
+	}
 
-		{
-			Drives[Drive_No] = refnum;
-			DiskInsertNotify(Drive_No, locked);
+	if ((NULL == Index) || (NULL == DriveCmprsPacked[Drive_No])) {
+		goto label_fail;
+	}
+	for (i = 0; i < kCmprsCacheSz; ++i) {
+		if (NULL == DriveCmprsCache[Drive_No][i]) {
+			goto label_fail;
+		}
+	}
+	if (mnvm_noErr != FileTransfer(refnum, falseblnr, Index,
+		kCmprsOffset_Index, IndexSz, nullpr))
+	{
+		goto label_fail;
+	}
 
-			IsOk = trueblnr;
+	/* offsets must not decrease */
+	for (i = 0; i < nChunks; ++i) {
+		if (do_get_mem_long(Index + i * 4)
+			> do_get_mem_long(Index + i * 4 + 4))
+		{
+			goto label_fail;
 		}
 	}
 
-	if (! IsOk) {
-		fclose(refnum);
+	return trueblnr;
+
+label_fail:
+	CmprsDetach(Drive_No);
+	return falseblnr;
+}
+#endif
+
+#if IncludeSonyWriteBack
+/*
+	Write back cache. Writes to disk image files go into a pool
+	of dirty blocks, and a background thread writes them out a
+	little later, merging adjacent blocks into one write. Reads
+	see the dirty blocks. Everything is written out on eject,
+	on quit, and by the Control Mode 'W' command.
+
+	WbLock protects the pool. WbIOLock protects the disk image
+	files, which are shared with the flusher thread. WbFlushLock
+	is held for a whole flush, so that only one happens at a
+	time. Locks are only acquired while holding another in the
+	orders WbFlushLock then WbLock or WbIOLock, and WbLock then
+	WbIOLock.
+*/
+
+#define kLn2WbBlockSz 9
+#define kWbBlockSz (1 << kLn2WbBlockSz)
+#define kWbPoolSz 4096 /* blocks in pool */
+#define kWbHashSz 1024
+#define kWbMaxRun 256 /* most blocks in one write */
+#define kWbDelay 250 /* milliseconds to wait for more writes */
+
+#define kWbNone (-1)
+
+LOCALVAR ui3p WbData = nullpr;
+LOCALVAR ui3p WbRunBuf = nullpr;
+LOCALVAR ui5r WbBlock[kWbPoolSz];
+LOCALVAR tDrive WbDrive[kWbPoolSz];
+LOCALVAR ui5r WbGen[kWbPoolSz];
+LOCALVAR int WbNext[kWbPoolSz]; /* hash chain, or free list */
+LOCALVAR int WbHash[kWbHashSz];
+LOCALVAR int WbFree;
+LOCALVAR int WbNDirty = 0;
+LOCALVAR ui5r WbCurGen = 0;
+LOCALVAR int WbOrder[kWbPoolSz];
+LOCALVAR ui5r WbRunGen[kWbMaxRun];
+LOCALVAR blnr WbQuit = falseblnr;
+
+LOCALVAR SDL_mutex *WbLock = NULL;
+LOCALVAR SDL_mutex *WbIOLock = NULL;
+LOCALVAR SDL_mutex *WbFlushLock = NULL;
+LOCALVAR SDL_cond *WbCond = NULL;
+LOCALVAR SDL_Thread *WbThread = NULL;
+
+#define WbHashOf(Drive_No, block) \
+	(((block) + (Drive_No) * 7919) & (kWbHashSz - 1))
+#define WbBlockData(i) (WbData + ((i) << kLn2WbBlockSz))
+
+LOCALFUNC int WbLookup(tDrive Drive_No, ui5r block)
+{
+	int i = WbHash[WbHashOf(Drive_No, block)];
+
+	while ((kWbNone != i)
+		&& ((WbBlock[i] != block) || (WbDrive[i] != Drive_No)))
+	{
+		i = WbNext[i];
 	}
 
-	return IsOk;
+	return i;
 }
 
-LOCALFUNC blnr Sony_Insert1(char *drivepath, blnr silentfail)
+LOCALFUNC int WbAlloc(tDrive Drive_No, ui5r block)
 {
-	blnr locked = falseblnr;
-	/* printf("Sony_Insert1 %s\n", drivepath); */
-	FILE *refnum = fopen(drivepath, "rb+");
-	if (NULL == refnum) {
-		locked = trueblnr;
-		refnum = fopen(drivepath, "rb");
+	int i = WbFree;
+
+	if (kWbNone != i) {
+		int h = WbHashOf(Drive_No, block);
+
+		WbFree = WbNext[i];
+		WbBlock[i] = block;
+		WbDrive[i] = Drive_No;
+		WbNext[i] = WbHash[h];
+		WbHash[h] = i;
+		++WbNDirty;
 	}
-	if (NULL == refnum) {
-		if (! silentfail) {
-			MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
-		}
-	} else {
-		return Sony_Insert0(refnum, locked, drivepath);
+
+	return i;
+}
+
+LOCALPROC WbRemove(int i)
+{
+	int *p = &WbHash[WbHashOf(WbDrive[i], WbBlock[i])];
+
+	while (*p != i) {
+		p = &WbNext[*p];
 	}
-	return falseblnr;
+	*p = WbNext[i];
+	WbNext[i] = WbFree;
+	WbFree = i;
+	--WbNDirty;
 }
 
-LOCALFUNC blnr Sony_Insert2(char *s)
+LOCALFUNC int WbOrderCompare(const void *a, const void *b)
 {
-	return Sony_Insert1(s, trueblnr);
+	int i = *(const int *)a;
+	int j = *(const int *)b;
+
+	if (WbDrive[i] != WbDrive[j]) {
+		return (WbDrive[i] < WbDrive[j]) ? -1 : 1;
+	}
+	return (WbBlock[i] < WbBlock[j]) ? -1
+		: ((WbBlock[i] > WbBlock[j]) ? 1 : 0);
 }
 
-LOCALFUNC blnr LoadInitialImages(void)
+LOCALFUNC tMacErr WbFlush0(blnr AllDrives, tDrive Drive_No)
 {
-	if (! AnyDiskInserted()) {
-		int n = NumDrives > 9 ? 9 : NumDrives;
-		int i;
-		char s[] = "disk?.dsk";
+	/* WbFlushLock must be held */
+	tMacErr err = mnvm_noErr;
+	blnr RunOk;
+	int n = 0;
+	int i;
+	int j;
+	int k;
 
-		for (i = 1; i <= n; ++i) {
-			s[4] = '0' + i;
-			if (! Sony_Insert2(s)) {
-				/* stop on first error (including file not found) */
-				return trueblnr;
+	/*
+		entries are only removed by a flush, so the list stays
+		valid after WbLock is released.
+	*/
+	SDL_LockMutex(WbLock);
+	for (i = 0; i < kWbHashSz; ++i) {
+		for (j = WbHash[i]; kWbNone != j; j = WbNext[j]) {
+			if (AllDrives || (WbDrive[j] == Drive_No)) {
+				WbOrder[n++] = j;
 			}
 		}
 	}
+	SDL_UnlockMutex(WbLock);
 
-	return trueblnr;
-}
+	qsort(WbOrder, n, sizeof(int), WbOrderCompare);
 
-/* --- ROM --- */
+	for (i = 0; i < n; i = j) {
+		int first = WbOrder[i];
+		tDrive d = WbDrive[first];
+		ui5r offset = WbBlock[first] << kLn2WbBlockSz;
+		ui5r L;
 
-LOCALVAR char *rom_path = NULL;
+		/* find a run of adjacent blocks */
+		j = i + 1;
+		while ((j < n) && (j - i < kWbMaxRun)
+			&& (WbDrive[WbOrder[j]] == d)
+			&& (WbBlock[WbOrder[j]] == WbBlock[first] + (j - i)))
+		{
+			++j;
+		}
 
-LOCALFUNC tMacErr LoadMacRomFrom(char *path)
-{
-	tMacErr err;
-	FILE *ROM_File;
-	int File_Size;
+		SDL_LockMutex(WbLock);
+		for (k = i; k < j; ++k) {
+			MyMoveBytes(WbBlockData(WbOrder[k]),
+				WbRunBuf + ((k - i) << kLn2WbBlockSz), kWbBlockSz);
+			WbRunGen[k - i] = WbGen[WbOrder[k]];
+		}
+		SDL_UnlockMutex(WbLock);
 
-	ROM_File = fopen(path, "rb");
-	if (NULL == ROM_File) {
-		err = mnvm_fnfErr;
-	} else {
-		File_Size = fread(ROM, 1, kROM_Size, ROM_File);
-		if (File_Size != kROM_Size) {
-			if (feof(ROM_File)) {
-				err = mnvm_eofErr;
-			} else {
-				err = mnvm_miscErr;
-			}
+		L = (j - i) << kLn2WbBlockSz;
+		if (L > DriveWbSize[d] - offset) {
+			L = DriveWbSize[d] - offset;
+		}
+
+		/*
+			stdio may take the write into its buffer, and only
+			fail when flushing it, so that counts as failing too.
+		*/
+		SDL_LockMutex(WbIOLock);
+		RunOk = (mnvm_noErr == FileTransfer(Drives[d], trueblnr,
+				WbRunBuf, offset, L, nullpr))
+			&& (0 == fflush(Drives[d]));
+		SDL_UnlockMutex(WbIOLock);
+
+		if (! RunOk) {
+			/* the blocks stay dirty, later runs go on */
+			err = mnvm_miscErr;
 		} else {
-			err = mnvm_noErr;
+			/* blocks written again meanwhile are still dirty */
+			SDL_LockMutex(WbLock);
+			for (k = i; k < j; ++k) {
+				if (WbGen[WbOrder[k]] == WbRunGen[k - i]) {
+					WbRemove(WbOrder[k]);
+				}
+			}
+			SDL_UnlockMutex(WbLock);
 		}
-		fclose(ROM_File);
 	}
 
 	return err;
 }
 
-LOCALFUNC blnr LoadMacRom(void)
+LOCALFUNC tMacErr WbFlush(blnr AllDrives, tDrive Drive_No)
 {
 	tMacErr err;
 
-	if ((NULL == rom_path)
-		|| (mnvm_fnfErr == (err = LoadMacRomFrom(rom_path))))
-	if (mnvm_fnfErr == (err = LoadMacRomFrom(RomFileName)))
-	{
+	SDL_LockMutex(WbFlushLock);
+	err = WbFlush0(AllDrives, Drive_No);
+	SDL_UnlockMutex(WbFlushLock);
+
+	return err;
+}
+
+LOCALPROC WriteBackSyncAll(void)
+{
+	(void) WbFlush(trueblnr, 0);
+}
+
+LOCALPROC WbDetach(tDrive Drive_No)
+{
+	/*
+		write out the blocks of a drive being ejected, then forget
+		any that couldn't be written, telling the user. WbFlushLock
+		is held throughout, so the flusher thread can't be working
+		from a list of blocks that are being removed.
+	*/
+	int i;
+	int j;
+	int next;
+
+	SDL_LockMutex(WbFlushLock);
+	if (mnvm_noErr != WbFlush0(falseblnr, Drive_No)) {
+		MacMsg(kStrWriteBackFailTitle, kStrWriteBackFailMessage,
+			falseblnr);
 	}
 
-	if (mnvm_noErr != err) {
-		if (mnvm_fnfErr == err) {
-			MacMsg(kStrNoROMTitle, kStrNoROMMessage, trueblnr);
-		} else if (mnvm_eofErr == err) {
-			MacMsg(kStrShortROMTitle, kStrShortROMMessage,
-				trueblnr);
+	SDL_LockMutex(WbLock);
+	for (i = 0; i < kWbHashSz; ++i) {
+		for (j = WbHash[i]; kWbNone != j; j = next) {
+			next = WbNext[j];
+			if (WbDrive[j] == Drive_No) {
+				WbRemove(j);
+			}
+		}
+	}
+	SDL_UnlockMutex(WbLock);
+	SDL_UnlockMutex(WbFlushLock);
+}
+
+LOCALFUNC int SDLCALL WbThreadMain(void *data)
+{
+	SDL_LockMutex(WbLock);
+	while (! WbQuit) {
+		if (0 == WbNDirty) {
+			SDL_CondWait(WbCond, WbLock);
 		} else {
-			MacMsg(kStrNoReadROMTitle, kStrNoReadROMMessage,
-				trueblnr);
+			/* give more writes a chance to arrive */
+			(void) SDL_CondWaitTimeout(WbCond, WbLock, kWbDelay);
+			SDL_UnlockMutex(WbLock);
+			(void) WbFlush(trueblnr, 0);
+			SDL_LockMutex(WbLock);
 		}
-		SpeedStopped = trueblnr;
 	}
+	SDL_UnlockMutex(WbLock);
 
-	return trueblnr; /* keep launching Mini vMac, regardless */
+	return 0;
 }
 
-/* --- video out --- */
+LOCALFUNC blnr WbFillBlock(int i)
+{
+	/* new block only partly written, get the rest from the file */
+	ui5r offset = WbBlock[i] << kLn2WbBlockSz;
+	ui5r L = DriveWbSize[WbDrive[i]] - offset;
+	blnr IsOk;
 
-#if VarFullScreen
-LOCALVAR blnr UseFullScreen = (WantInitFullScreen != 0);
-#endif
+	if (L > kWbBlockSz) {
+		L = kWbBlockSz;
+	}
+	(void) memset(WbBlockData(i), 0, kWbBlockSz);
+	SDL_LockMutex(WbIOLock);
+	IsOk = (mnvm_noErr == FileTransfer(Drives[WbDrive[i]], falseblnr,
+		WbBlockData(i), offset, L, nullpr));
+	SDL_UnlockMutex(WbIOLock);
 
-#if EnableMagnify
-LOCALVAR blnr UseMagnify = (WantInitMagnify != 0);
-#endif
+	return IsOk;
+}
 
-LOCALVAR blnr gBackgroundFlag = falseblnr;
-LOCALVAR blnr gTrueBackgroundFlag = falseblnr;
-LOCALVAR blnr CurSpeedStopped = trueblnr;
+LOCALFUNC tMacErr WbTransfer(blnr IsWrite, ui3p Buffer,
+	tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count,
+	ui5r *Sony_ActCount)
+{
+	tMacErr err = mnvm_noErr;
+	ui5r Size = DriveWbSize[Drive_No];
+	ui5r n = 0;
+
+	if (Sony_Start > Size) {
+		Sony_Count = 0;
+		err = mnvm_eofErr;
+	} else if (Sony_Count > Size - Sony_Start) {
+		Sony_Count = Size - Sony_Start;
+		err = mnvm_eofErr;
+	}
 
-#if EnableMagnify
-#define MaxScale MyWindowScale
-#else
-#define MaxScale 1
-#endif
+	SDL_LockMutex(WbLock);
 
+	if (! IsWrite) {
+		SDL_LockMutex(WbIOLock);
+		if (mnvm_noErr != FileTransfer(Drives[Drive_No], falseblnr,
+			Buffer, Sony_Start, Sony_Count, nullpr))
+		{
+			err = mnvm_miscErr;
+			Sony_Count = 0;
+		}
+		SDL_UnlockMutex(WbIOLock);
+	}
 
-LOCALVAR SDL_Surface *my_surface = nullpr;
+	while (n < Sony_Count) {
+		ui5r block = (Sony_Start + n) >> kLn2WbBlockSz;
+		ui5r inblock = (Sony_Start + n) & (kWbBlockSz - 1);
+		ui5r L = kWbBlockSz - inblock;
+		int i = WbLookup(Drive_No, block);
 
-LOCALVAR ui3p ScalingBuff = nullpr;
+		if (L > Sony_Count - n) {
+			L = Sony_Count - n;
+		}
 
-LOCALVAR ui3p CLUT_final;
+		if (! IsWrite) {
+			if (kWbNone != i) {
+				MyMoveBytes(WbBlockData(i) + inblock, Buffer + n, L);
+			}
+		} else {
+			if (kWbNone == i) {
+				i = WbAlloc(Drive_No, block);
+				if (kWbNone == i) {
+					/* pool full, have to wait for the disk */
+					SDL_UnlockMutex(WbLock);
+					(void) WbFlush(trueblnr, 0);
+					SDL_LockMutex(WbLock);
+					i = WbAlloc(Drive_No, block);
+				}
+				if ((kWbNone != i) && (L != kWbBlockSz)
+					&& ! WbFillBlock(i))
+				{
+					WbRemove(i);
+					i = kWbNone;
+				}
+				if (kWbNone == i) {
+					err = mnvm_miscErr;
+					break;
+				}
+			}
+			MyMoveBytes(Buffer + n, WbBlockData(i) + inblock, L);
+			WbGen[i] = ++WbCurGen;
+		}
+		n += L;
+	}
 
-#define CLUT_finalsz (256 * 8 * 4 * MaxScale)
-	/*
-		256 possible values of one byte
-		8 pixels per byte maximum (when black and white)
-		4 bytes per destination pixel maximum
-			multiplied by MyWindowScale if EnableMagnify
-	*/
+	if (IsWrite) {
+		SDL_CondSignal(WbCond);
+	}
 
-#define ScrnMapr_DoMap UpdateBWDepth3Copy
-#define ScrnMapr_Src GetCurDrawBuff()
-#define ScrnMapr_Dst ScalingBuff
-#define ScrnMapr_SrcDepth 0
-#define ScrnMapr_DstDepth 3
-#define ScrnMapr_Map CLUT_final
+	SDL_UnlockMutex(WbLock);
 
-#include "SCRNMAPR.h"
+	if (nullpr != Sony_ActCount) {
+		*Sony_ActCount = n;
+	}
 
-#define ScrnMapr_DoMap UpdateBWDepth4Copy
-#define ScrnMapr_Src GetCurDrawBuff()
-#define ScrnMapr_Dst ScalingBuff
-#define ScrnMapr_SrcDepth 0
-#define ScrnMapr_DstDepth 4
-#define ScrnMapr_Map CLUT_final
+	return err;
+}
 
-#include "SCRNMAPR.h"
+LOCALFUNC blnr WbInit(void)
+{
+	int i;
 
-#define ScrnMapr_DoMap UpdateBWDepth5Copy
-#define ScrnMapr_Src GetCurDrawBuff()
-#define ScrnMapr_Dst ScalingBuff
-#define ScrnMapr_SrcDepth 0
-#define ScrnMapr_DstDepth 5
-#define ScrnMapr_Map CLUT_final
+	WbData = (ui3p)malloc(kWbPoolSz << kLn2WbBlockSz);
+	WbRunBuf = (ui3p)malloc(kWbMaxRun << kLn2WbBlockSz);
+	if ((NULL == WbData) || (NULL == WbRunBuf)) {
+		MacMsg(kStrOutOfMemTitle, kStrOutOfMemMessage, trueblnr);
+		return falseblnr;
+	}
 
-#include "SCRNMAPR.h"
+	for (i = 0; i < kWbHashSz; ++i) {
+		WbHash[i] = kWbNone;
+	}
+	for (i = 0; i < kWbPoolSz; ++i) {
+		WbNext[i] = i + 1;
+	}
+	WbNext[kWbPoolSz - 1] = kWbNone;
+	WbFree = 0;
+
+	if ((NULL == (WbLock = SDL_CreateMutex()))
+		|| (NULL == (WbIOLock = SDL_CreateMutex()))
+		|| (NULL == (WbFlushLock = SDL_CreateMutex()))
+		|| (NULL == (WbCond = SDL_CreateCond()))
+		|| (NULL == (WbThread = SDL_CreateThread(WbThreadMain,
+			"WriteBack", NULL))))
+	{
+		return falseblnr;
+	}
 
-#define ScrnMapr_DoMap UpdateBWDepth3ScaledCopy
-#define ScrnMapr_Src GetCurDrawBuff()
-#define ScrnMapr_Dst ScalingBuff
-#define ScrnMapr_SrcDepth 0
-#define ScrnMapr_DstDepth 3
-#define ScrnMapr_Map CLUT_final
-#define ScrnMapr_Scale MyWindowScale
+	return trueblnr;
+}
 
-#include "SCRNMAPR.h"
+LOCALPROC WbUnInit(void)
+{
+	if (NULL != WbThread) {
+		SDL_LockMutex(WbLock);
+		WbQuit = trueblnr;
+		SDL_CondSignal(WbCond);
+		SDL_UnlockMutex(WbLock);
+		SDL_WaitThread(WbThread, NULL);
+		WbThread = NULL;
+	}
+	if (NULL != WbCond) {
+		SDL_DestroyCond(WbCond);
+		WbCond = NULL;
+	}
+	if (NULL != WbFlushLock) {
+		SDL_DestroyMutex(WbFlushLock);
+		WbFlushLock = NULL;
+	}
+	if (NULL != WbIOLock) {
+		SDL_DestroyMutex(WbIOLock);
+		WbIOLock = NULL;
+	}
+	if (NULL != WbLock) {
+		SDL_DestroyMutex(WbLock);
+		WbLock = NULL;
+	}
+	free(WbRunBuf);
+	WbRunBuf = nullpr;
+	free(WbData);
+	WbData = nullpr;
+}
 
-#define ScrnMapr_DoMap UpdateBWDepth4ScaledCopy
-#define ScrnMapr_Src GetCurDrawBuff()
-#define ScrnMapr_Dst ScalingBuff
-#define ScrnMapr_SrcDepth 0
-#define ScrnMapr_DstDepth 4
-#define ScrnMapr_Map CLUT_final
-#define ScrnMapr_Scale MyWindowScale
+#if IncludeForkServer
+LOCALFUNC blnr WbForkChild(void)
+{
+	/*
+		In a forked child, the flusher thread is the parent's,
+		and may have been holding one of the locks at the fork.
+		Let go of the copies without touching them, and start
+		afresh, so a writable disk image given to the child is
+		written back by a thread of its own.
+	*/
+	WbThread = NULL;
+	WbCond = NULL;
+	WbFlushLock = NULL;
+	WbIOLock = NULL;
+	WbLock = NULL;
+	WbQuit = falseblnr;
+	WbNDirty = 0;
+	free(WbRunBuf);
+	WbRunBuf = nullpr;
+	free(WbData);
+	WbData = nullpr;
+
+	return WbInit();
+}
+#endif
+#endif
 
-#include "SCRNMAPR.h"
+LOCALFUNC tMacErr DriveRawTransfer(blnr IsWrite, ui3p Buffer,
+	tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count,
+	ui5r *Sony_ActCount)
+{
+	/* transfer to the disk image, not counting any overlay */
+#if IncludeSonyRamDisk
+	if (nullpr != DriveRamData[Drive_No]) {
+		tMacErr err = mnvm_noErr;
+		ui5r Size = DriveRamSize[Drive_No];
+
+		if (Sony_Start > Size) {
+			Sony_Count = 0;
+			err = mnvm_eofErr;
+		} else if (Sony_Count > Size - Sony_Start) {
+			Sony_Count = Size - Sony_Start;
+			err = mnvm_eofErr;
+		}
+		if (IsWrite) {
+			MyMoveBytes(Buffer, DriveRamData[Drive_No] + Sony_Start,
+				Sony_Count);
+		} else {
+			MyMoveBytes(DriveRamData[Drive_No] + Sony_Start, Buffer,
+				Sony_Count);
+		}
+		if (nullpr != Sony_ActCount) {
+			*Sony_ActCount = Sony_Count;
+		}
 
-#define ScrnMapr_DoMap UpdateBWDepth5ScaledCopy
-#define ScrnMapr_Src GetCurDrawBuff()
-#define ScrnMapr_Dst ScalingBuff
-#define ScrnMapr_SrcDepth 0
-#define ScrnMapr_DstDepth 5
-#define ScrnMapr_Map CLUT_final
-#define ScrnMapr_Scale MyWindowScale
+		return err;
+	}
+#endif
+#if IncludeSonyCmprs
+	if (DriveIsCmprs[Drive_No]) {
+		return CmprsTransfer(IsWrite, Buffer, Drive_No,
+			Sony_Start, Sony_Count, Sony_ActCount);
+	}
+#endif
+#if IncludeSonyWriteBack
+	if (DriveWbOn[Drive_No]) {
+		return WbTransfer(IsWrite, Buffer, Drive_No,
+			Sony_Start, Sony_Count, Sony_ActCount);
+	}
+#endif
 
-#include "SCRNMAPR.h"
+	return FileTransfer(Drives[Drive_No], IsWrite, Buffer,
+		Sony_Start, Sony_Count, Sony_ActCount);
+}
 
+#if IncludeSonyOverlay
+LOCALFUNC tMacErr OvlBaseRead(tDrive Drive_No, ui3p Buffer,
+	ui5r Sony_Start, ui5r Sony_Count)
+{
+	/* reads past the end of the base image give zeros */
+	ui5r BaseSize = DriveBaseSize[Drive_No];
+	ui5r L = 0;
+	tMacErr err = mnvm_noErr;
+
+	if (Sony_Start < BaseSize) {
+		L = BaseSize - Sony_Start;
+		if (L > Sony_Count) {
+			L = Sony_Count;
+		}
+		err = DriveRawTransfer(falseblnr, Buffer, Drive_No,
+			Sony_Start, L, nullpr);
+	}
+	if (L < Sony_Count) {
+		(void) memset(Buffer + L, 0, Sony_Count - L);
+	}
 
-#if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
+	return err;
+}
+#endif
 
-#define ScrnMapr_DoMap UpdateColorDepth3Copy
-#define ScrnMapr_Src GetCurDrawBuff()
-#define ScrnMapr_Dst ScalingBuff
-#define ScrnMapr_SrcDepth vMacScreenDepth
-#define ScrnMapr_DstDepth 3
-#define ScrnMapr_Map CLUT_final
+#if IncludeSonyOverlay
+LOCALFUNC tMacErr OvlDeltaTransfer(tDrive Drive_No, blnr IsWrite,
+	ui3p Buffer, ui5r Sony_Start, ui5r Sony_Count)
+{
+	/* all blocks in range must already be in delta, if reading */
+	tMacErr err = mnvm_noErr;
+	FILE *refnum = DriveDelta[Drive_No];
+
+	if (NotAfileRef != refnum) {
+		err = FileTransfer(refnum, IsWrite, Buffer,
+			DriveDeltaDataOffset[Drive_No] + Sony_Start, Sony_Count,
+			nullpr);
+	} else {
+		ui5r n = Sony_Count;
+		ui5r offset = Sony_Start;
 
-#include "SCRNMAPR.h"
+		while (0 != n) {
+			ui5r block = offset >> kLn2OvlBlockSz;
+			ui5r inblock = offset & (kOvlBlockSz - 1);
+			ui5r L = kOvlBlockSz - inblock;
+			ui3p p = DriveDeltaMem[Drive_No][block];
 
-#define ScrnMapr_DoMap UpdateColorDepth4Copy
-#define ScrnMapr_Src GetCurDrawBuff()
-#define ScrnMapr_Dst ScalingBuff
-#define ScrnMapr_SrcDepth vMacScreenDepth
-#define ScrnMapr_DstDepth 4
-#define ScrnMapr_Map CLUT_final
+			if (L > n) {
+				L = n;
+			}
+			if (nullpr == p) {
+				p = (ui3p)calloc(1, kOvlBlockSz);
+				if (NULL == p) {
+					err = mnvm_miscErr;
+					break;
+				}
+				DriveDeltaMem[Drive_No][block] = p;
+			}
+			if (IsWrite) {
+				MyMoveBytes(Buffer, p + inblock, L);
+			} else {
+				MyMoveBytes(p + inblock, Buffer, L);
+			}
+			Buffer += L;
+			offset += L;
+			n -= L;
+		}
+	}
 
-#include "SCRNMAPR.h"
+	return err;
+}
+#endif
 
-#define ScrnMapr_DoMap UpdateColorDepth5Copy
-#define ScrnMapr_Src GetCurDrawBuff()
-#define ScrnMapr_Dst ScalingBuff
-#define ScrnMapr_SrcDepth vMacScreenDepth
-#define ScrnMapr_DstDepth 5
-#define ScrnMapr_Map CLUT_final
+#if IncludeSonyOverlay
+LOCALFUNC tMacErr OvlSaveMap(tDrive Drive_No,
+	ui5r firstblock, ui5r lastblock)
+{
+	tMacErr err = mnvm_noErr;
+	FILE *refnum = DriveDelta[Drive_No];
 
-#include "SCRNMAPR.h"
+	if (NotAfileRef != refnum) {
+		ui5r i0 = firstblock >> 3;
+		ui5r i1 = lastblock >> 3;
 
-#define ScrnMapr_DoMap UpdateColorDepth3ScaledCopy
-#define ScrnMapr_Src GetCurDrawBuff()
-#define ScrnMapr_Dst ScalingBuff
-#define ScrnMapr_SrcDepth vMacScreenDepth
-#define ScrnMapr_DstDepth 3
-#define ScrnMapr_Map CLUT_final
-#define ScrnMapr_Scale MyWindowScale
+		err = FileTransfer(refnum, trueblnr,
+			DriveDeltaMap[Drive_No] + i0,
+			kOvlOffset_Map + i0, i1 - i0 + 1, nullpr);
+	}
 
-#include "SCRNMAPR.h"
+	return err;
+}
+#endif
 
-#define ScrnMapr_DoMap UpdateColorDepth4ScaledCopy
-#define ScrnMapr_Src GetCurDrawBuff()
-#define ScrnMapr_Dst ScalingBuff
-#define ScrnMapr_SrcDepth vMacScreenDepth
-#define ScrnMapr_DstDepth 4
-#define ScrnMapr_Map CLUT_final
-#define ScrnMapr_Scale MyWindowScale
+#if IncludeSonyOverlay
+LOCALFUNC tMacErr OvlCopyUpBlock(tDrive Drive_No, ui5r block)
+{
+	/* copy a base block into delta, before partially writing it */
+	ui3b Temp[kOvlBlockSz];
+	ui5r offset = block << kLn2OvlBlockSz;
+	tMacErr err = OvlBaseRead(Drive_No, Temp, offset, kOvlBlockSz);
+
+	if (mnvm_noErr == err) {
+		err = OvlDeltaTransfer(Drive_No, trueblnr, Temp,
+			offset, kOvlBlockSz);
+	}
 
-#include "SCRNMAPR.h"
+	return err;
+}
+#endif
 
-#define ScrnMapr_DoMap UpdateColorDepth5ScaledCopy
-#define ScrnMapr_Src GetCurDrawBuff()
-#define ScrnMapr_Dst ScalingBuff
-#define ScrnMapr_SrcDepth vMacScreenDepth
-#define ScrnMapr_DstDepth 5
-#define ScrnMapr_Map CLUT_final
-#define ScrnMapr_Scale MyWindowScale
+#if IncludeSonyOverlay
+LOCALFUNC tMacErr OvlTransfer(blnr IsWrite, ui3p Buffer,
+	tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count,
+	ui5r *Sony_ActCount)
+{
+	tMacErr err = mnvm_noErr;
+	ui5r BaseSize = DriveBaseSize[Drive_No];
+	ui5r n = 0;
+
+	if (Sony_Start > BaseSize) {
+		Sony_Count = 0;
+		err = mnvm_eofErr;
+	} else if (Sony_Count > BaseSize - Sony_Start) {
+		Sony_Count = BaseSize - Sony_Start;
+		err = mnvm_eofErr;
+	}
 
-#include "SCRNMAPR.h"
+	if (0 != Sony_Count) {
+		ui5r firstblock = Sony_Start >> kLn2OvlBlockSz;
+		ui5r lastblock = (Sony_Start + Sony_Count - 1) >> kLn2OvlBlockSz;
+		tMacErr err2 = mnvm_noErr;
 
-#endif
+		if (IsWrite) {
+			ui5r block;
 
+			/* partially written blocks need base contents first */
+			if ((0 != (Sony_Start & (kOvlBlockSz - 1)))
+				&& ! OvlHasBlock(Drive_No, firstblock))
+			{
+				err2 = OvlCopyUpBlock(Drive_No, firstblock);
+			}
+			if ((mnvm_noErr == err2)
+				&& (lastblock != firstblock
+					|| 0 == (Sony_Start & (kOvlBlockSz - 1)))
+				&& (0 != ((Sony_Start + Sony_Count) & (kOvlBlockSz - 1)))
+				&& ((Sony_Start + Sony_Count) != BaseSize)
+				&& ! OvlHasBlock(Drive_No, lastblock))
+			{
+				err2 = OvlCopyUpBlock(Drive_No, lastblock);
+			}
+			if (mnvm_noErr == err2) {
+				err2 = OvlDeltaTransfer(Drive_No, trueblnr, Buffer,
+					Sony_Start, Sony_Count);
+			}
+			if (mnvm_noErr == err2) {
+				for (block = firstblock; block <= lastblock; ++block) {
+					DriveDeltaMap[Drive_No][block >> 3] |=
+						(0x80 >> (block & 7));
+				}
+				err2 = OvlSaveMap(Drive_No, firstblock, lastblock);
+				n = Sony_Count;
+			}
+		} else {
+			/* read runs of blocks that are all in the same place */
+			ui5r block = firstblock;
+			ui5r offset = Sony_Start;
 
-LOCALPROC HaveChangedScreenBuff(ui4r top, ui4r left,
-	ui4r bottom, ui4r right)
-{
-	int i;
-	int j;
-	ui3b *p;
-	Uint32 pixel;
-#if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
-	Uint32 CLUT_pixel[CLUT_size];
-#endif
-	Uint32 BWLUT_pixel[2];
-	ui5r top2 = top;
-	ui5r left2 = left;
-	ui5r bottom2 = bottom;
-	ui5r right2 = right;
+			while ((mnvm_noErr == err2) && (block <= lastblock)) {
+				blnr InDelta = OvlHasBlock(Drive_No, block);
+				ui5r endblock = block + 1;
+				ui5r L;
 
-#if EnableMagnify
-	if (UseMagnify) {
-		top2 *= MyWindowScale;
-		left2 *= MyWindowScale;
-		bottom2 *= MyWindowScale;
-		right2 *= MyWindowScale;
-	}
-#endif
+				while ((endblock <= lastblock)
+					&& (InDelta == OvlHasBlock(Drive_No, endblock)))
+				{
+					++endblock;
+				}
+				L = (endblock << kLn2OvlBlockSz) - offset;
+				if (L > Sony_Count - n) {
+					L = Sony_Count - n;
+				}
+				if (InDelta) {
+					err2 = OvlDeltaTransfer(Drive_No, falseblnr,
+						Buffer + n, offset, L);
+				} else {
+					err2 = OvlBaseRead(Drive_No, Buffer + n, offset, L);
+				}
+				if (mnvm_noErr == err2) {
+					n += L;
+					offset += L;
+				}
+				block = endblock;
+			}
+		}
 
-	if (SDL_MUSTLOCK(my_surface)) {
-		if (SDL_LockSurface(my_surface) < 0) {
-			return;
+		if (mnvm_noErr != err2) {
+			err = err2;
 		}
 	}
 
-	{
+	if (nullpr != Sony_ActCount) {
+		*Sony_ActCount = n;
+	}
 
-	int bpp = my_surface->format->BytesPerPixel;
-	ui5r ExpectedPitch = vMacScreenWidth * bpp;
+	return err;
+}
+#endif
 
-#if EnableMagnify
-	if (UseMagnify) {
-		ExpectedPitch *= MyWindowScale;
-	}
+GLOBALFUNC tMacErr vSonyTransfer(blnr IsWrite, ui3p Buffer,
+	tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count,
+	ui5r *Sony_ActCount)
+{
+	tMacErr err;
+#if IncludeHostTime
+	int PrevHostTime = HostTime_Switch(kHostTimeSony);
 #endif
 
-#if 0 != vMacScreenDepth
-	if (UseColorMode) {
-#if vMacScreenDepth < 4
-		for (i = 0; i < CLUT_size; ++i) {
-			CLUT_pixel[i] = SDL_MapRGB(my_surface->format,
-				CLUT_reds[i] >> 8,
-				CLUT_greens[i] >> 8,
-				CLUT_blues[i] >> 8);
-		}
-#endif
+#if IncludeSonyOverlay
+	if (DriveHasOverlay[Drive_No]) {
+		err = OvlTransfer(IsWrite, Buffer, Drive_No,
+			Sony_Start, Sony_Count, Sony_ActCount);
 	} else
 #endif
 	{
-		BWLUT_pixel[1] = SDL_MapRGB(my_surface->format, 0, 0, 0); /* black */
-		BWLUT_pixel[0] = SDL_MapRGB(my_surface->format, 255, 255, 255); /* white */
+		err = DriveRawTransfer(IsWrite, Buffer, Drive_No,
+			Sony_Start, Sony_Count, Sony_ActCount);
 	}
 
-	if ((0 == ((bpp - 1) & bpp)) /* a power of 2 */
-		&& (my_surface->pitch == ExpectedPitch)
-#if (vMacScreenDepth > 3)
-		&& ! UseColorMode
-#endif
-		)
-	{
-		int k;
-		Uint32 v;
-#if EnableMagnify
-		int a;
+#if IncludeBench
+	if (nullpr != Sony_ActCount) {
+		BenchDiskBytes += *Sony_ActCount;
+	}
 #endif
-		int PixPerByte =
-#if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
-			UseColorMode ? (1 << (3 - vMacScreenDepth)) :
+#if IncludeHostTime
+	(void) HostTime_Switch(PrevHostTime);
 #endif
-			8;
-		Uint8 *p4 = (Uint8 *)CLUT_final;
 
-		for (i = 0; i < 256; ++i) {
-			for (k = PixPerByte; --k >= 0; ) {
+	return err;
+}
 
-#if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
-				if (UseColorMode) {
-					v = CLUT_pixel[
-#if 3 == vMacScreenDepth
-						i
-#else
-						(i >> (k << vMacScreenDepth))
-							& (CLUT_size - 1)
-#endif
-						];
-				} else
-#endif
-				{
-					v = BWLUT_pixel[(i >> k) & 1];
-				}
+LOCALFUNC tMacErr FileGetSize(FILE *refnum, ui5r *Sony_Count)
+{
+	tMacErr err = mnvm_miscErr;
+	long v;
 
-#if EnableMagnify
-				for (a = UseMagnify ? MyWindowScale : 1; --a >= 0; )
-#endif
-				{
-					switch (bpp) {
-						case 1: /* Assuming 8-bpp */
-							*p4++ = v;
-							break;
-						case 2: /* Probably 15-bpp or 16-bpp */
-							*(Uint16 *)p4 = v;
-							p4 += 2;
-							break;
-						case 4: /* Probably 32-bpp */
-							*(Uint32 *)p4 = v;
-							p4 += 4;
-							break;
-					}
-				}
-			}
+	if (0 == fseek(refnum, 0, SEEK_END)) {
+		v = ftell(refnum);
+		if (v >= 0) {
+			*Sony_Count = v;
+			err = mnvm_noErr;
 		}
+	}
 
-		ScalingBuff = (ui3p)my_surface->pixels;
+	return err; /*& figure out what really to return &*/
+}
 
-#if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
-		if (UseColorMode) {
-#if EnableMagnify
-			if (UseMagnify) {
-				switch (bpp) {
-					case 1:
-						UpdateColorDepth3ScaledCopy(top, left, bottom, right);
-						break;
-					case 2:
-						UpdateColorDepth4ScaledCopy(top, left, bottom, right);
-						break;
-					case 4:
-						UpdateColorDepth5ScaledCopy(top, left, bottom, right);
-						break;
-				}
-			} else
+LOCALFUNC tMacErr DriveRawGetSize(tDrive Drive_No, ui5r *Sony_Count)
+{
+#if IncludeSonyRamDisk
+	if (nullpr != DriveRamData[Drive_No]) {
+		*Sony_Count = DriveRamSize[Drive_No];
+		return mnvm_noErr;
+	}
 #endif
-			{
-				switch (bpp) {
-					case 1:
-						UpdateColorDepth3Copy(top, left, bottom, right);
-						break;
-					case 2:
-						UpdateColorDepth4Copy(top, left, bottom, right);
-						break;
-					case 4:
-						UpdateColorDepth5Copy(top, left, bottom, right);
-						break;
-				}
-			}
-		} else
+#if IncludeSonyCmprs
+	if (DriveIsCmprs[Drive_No]) {
+		*Sony_Count = DriveCmprsSize[Drive_No];
+		return mnvm_noErr;
+	}
 #endif
-		{
-#if EnableMagnify
-			if (UseMagnify) {
-				switch (bpp) {
-					case 1:
-						UpdateBWDepth3ScaledCopy(top, left, bottom, right);
-						break;
-					case 2:
-						UpdateBWDepth4ScaledCopy(top, left, bottom, right);
-						break;
-					case 4:
-						UpdateBWDepth5ScaledCopy(top, left, bottom, right);
-						break;
-				}
-			} else
+#if IncludeSonyWriteBack
+	if (DriveWbOn[Drive_No]) {
+		*Sony_Count = DriveWbSize[Drive_No];
+		return mnvm_noErr;
+	}
 #endif
-			{
-				switch (bpp) {
-					case 1:
-						UpdateBWDepth3Copy(top, left, bottom, right);
-						break;
-					case 2:
-						UpdateBWDepth4Copy(top, left, bottom, right);
-						break;
-					case 4:
-						UpdateBWDepth5Copy(top, left, bottom, right);
-						break;
-				}
-			}
-		}
-
-	} else {
-		ui3b *the_data = (ui3b *)GetCurDrawBuff();
-
-		/* adapted from putpixel in SDL documentation */
 
-		for (i = top2; i < bottom2; ++i) {
-			for (j = left2; j < right2; ++j) {
-				int i0 = i;
-				int j0 = j;
-				Uint8 *bufp = (Uint8 *)my_surface->pixels
-					+ i * my_surface->pitch + j * bpp;
+	return FileGetSize(Drives[Drive_No], Sony_Count);
+}
 
-#if EnableMagnify
-				if (UseMagnify) {
-					i0 /= MyWindowScale;
-					j0 /= MyWindowScale;
-				}
+GLOBALFUNC tMacErr vSonyGetSize(tDrive Drive_No, ui5r *Sony_Count)
+{
+#if IncludeSonyOverlay
+	if (DriveHasOverlay[Drive_No]) {
+		*Sony_Count = DriveBaseSize[Drive_No];
+		return mnvm_noErr;
+	}
 #endif
 
-#if 0 != vMacScreenDepth
-				if (UseColorMode) {
-#if vMacScreenDepth < 4
-					p = the_data + ((i0 * vMacScreenWidth + j0) >> (3 - vMacScreenDepth));
-					{
-						ui3r k = (*p >> (((~ j0) & ((1 << (3 - vMacScreenDepth)) - 1))
-							<< vMacScreenDepth)) & (CLUT_size - 1);
-						pixel = CLUT_pixel[k];
-					}
-#elif 4 == vMacScreenDepth
-					p = the_data + ((i0 * vMacScreenWidth + j0) << 1);
-					{
-						ui4r t0 = do_get_mem_word(p);
-						pixel = SDL_MapRGB(my_surface->format,
-							((t0 & 0x7C00) >> 7) | ((t0 & 0x7000) >> 12),
-							((t0 & 0x03E0) >> 2) | ((t0 & 0x0380) >> 7),
-							((t0 & 0x001F) << 3) | ((t0 & 0x001C) >> 2));
-					}
-#elif 5 == vMacScreenDepth
-					p = the_data + ((i0 * vMacScreenWidth + j0) << 2);
-					pixel = SDL_MapRGB(my_surface->format,
-						p[1],
-						p[2],
-						p[3]);
-#endif
-				} else
-#endif
-				{
-					p = the_data + ((i0 * vMacScreenWidth + j0) / 8);
-					pixel = BWLUT_pixel[(*p >> ((~ j0) & 0x7)) & 1];
-				}
+	return DriveRawGetSize(Drive_No, Sony_Count);
+}
 
-				switch (bpp) {
-					case 1: /* Assuming 8-bpp */
-						*bufp = pixel;
-						break;
-					case 2: /* Probably 15-bpp or 16-bpp */
-						*(Uint16 *)bufp = pixel;
-						break;
-					case 3:
-						/* Slow 24-bpp mode, usually not used */
-						if (SDL_BYTEORDER == SDL_BIG_ENDIAN) {
-							bufp[0] = (pixel >> 16) & 0xff;
-							bufp[1] = (pixel >> 8) & 0xff;
-							bufp[2] = pixel & 0xff;
-						} else {
-							bufp[0] = pixel & 0xff;
-							bufp[1] = (pixel >> 8) & 0xff;
-							bufp[2] = (pixel >> 16) & 0xff;
-						}
-						break;
-					case 4: /* Probably 32-bpp */
-						*(Uint32 *)bufp = pixel;
-						break;
-				}
+#if IncludeSonyOverlay
+LOCALPROC OvlDetach(tDrive Drive_No)
+{
+	if (DriveHasOverlay[Drive_No]) {
+		if (NotAfileRef != DriveDelta[Drive_No]) {
+			fclose(DriveDelta[Drive_No]);
+			DriveDelta[Drive_No] = NotAfileRef;
+		}
+		if (nullpr != DriveDeltaMem[Drive_No]) {
+			ui5r i;
+
+			for (i = 0; i < DriveDeltaBlocks[Drive_No]; ++i) {
+				free(DriveDeltaMem[Drive_No][i]);
 			}
+			free(DriveDeltaMem[Drive_No]);
+			DriveDeltaMem[Drive_No] = nullpr;
 		}
+		free(DriveDeltaMap[Drive_No]);
+		DriveDeltaMap[Drive_No] = nullpr;
+		DriveHasOverlay[Drive_No] = falseblnr;
 	}
+}
+#endif
+
+#if IncludeSonyOverlay
+LOCALFUNC blnr OvlOpenDeltaFile(tDrive Drive_No, char *path)
+{
+	ui3b Header[kOvlHeaderSz];
+	ui5r MapSize = (DriveDeltaBlocks[Drive_No] + 7) >> 3;
+	FILE *refnum = fopen(path, "rb+");
+	blnr IsOk = falseblnr;
 
+	if (NULL != refnum) {
+		/* existing delta, check it belongs to this base */
+		if ((mnvm_noErr == FileTransfer(refnum, falseblnr, Header,
+				0, kOvlHeaderSz, nullpr))
+			&& (kOvlSignature ==
+				do_get_mem_long(&Header[kOvlOffset_Sig]))
+			&& (kOvlVersion ==
+				do_get_mem_long(&Header[kOvlOffset_Version]))
+			&& (kLn2OvlBlockSz ==
+				do_get_mem_long(&Header[kOvlOffset_Ln2BlockSz]))
+			&& (DriveBaseSize[Drive_No] ==
+				do_get_mem_long(&Header[kOvlOffset_BaseSize]))
+			&& (mnvm_noErr == FileTransfer(refnum, falseblnr,
+				DriveDeltaMap[Drive_No], kOvlOffset_Map, MapSize,
+				nullpr)))
+		{
+			IsOk = trueblnr;
+		}
+	} else {
+		refnum = fopen(path, "wb+");
+		if (NULL != refnum) {
+			do_put_mem_long(&Header[kOvlOffset_Sig], kOvlSignature);
+			do_put_mem_long(&Header[kOvlOffset_Version], kOvlVersion);
+			do_put_mem_long(&Header[kOvlOffset_Ln2BlockSz],
+				kLn2OvlBlockSz);
+			do_put_mem_long(&Header[kOvlOffset_BaseSize],
+				DriveBaseSize[Drive_No]);
+			if ((mnvm_noErr == FileTransfer(refnum, trueblnr, Header,
+					0, kOvlHeaderSz, nullpr))
+				&& (mnvm_noErr == FileTransfer(refnum, trueblnr,
+					DriveDeltaMap[Drive_No], kOvlOffset_Map, MapSize,
+					nullpr)))
+			{
+				IsOk = trueblnr;
+			}
+		}
 	}
 
-	if (SDL_MUSTLOCK(my_surface)) {
-		SDL_UnlockSurface(my_surface);
+	if (IsOk) {
+		DriveDelta[Drive_No] = refnum;
+	} else if (NULL != refnum) {
+		fclose(refnum);
 	}
 
-	// SDL2 screen update block
-	SDL_UpdateTexture(texture, NULL, my_surface->pixels, vMacScreenWidth * sizeof (Uint32));
-	SDL_RenderClear(renderer);
-	SDL_RenderCopy(renderer, texture, &src_rect, &dst_rect); //&src_rect, &dst_rect
-	SDL_RenderPresent(renderer);
-	//
+	return IsOk;
 }
+#endif
 
-LOCALPROC MyDrawChangesAndClear(void)
+#if IncludeSonyOverlay
+LOCALFUNC blnr OvlAttach(tDrive Drive_No, char *path, blnr InMem)
 {
-	if (ScreenChangedBottom > ScreenChangedTop) {
-		HaveChangedScreenBuff(ScreenChangedTop, ScreenChangedLeft,
-			ScreenChangedBottom, ScreenChangedRight);
-		ScreenClearChanges();
+	ui5r BaseSize;
+	ui5r nBlocks;
+	blnr IsOk = falseblnr;
+
+	DriveDelta[Drive_No] = NotAfileRef;
+	DriveDeltaMem[Drive_No] = nullpr;
+
+	if (mnvm_noErr == DriveRawGetSize(Drive_No, &BaseSize)) {
+		nBlocks = (BaseSize + kOvlBlockSz - 1) >> kLn2OvlBlockSz;
+		DriveBaseSize[Drive_No] = BaseSize;
+		DriveDeltaBlocks[Drive_No] = nBlocks;
+		DriveDeltaDataOffset[Drive_No] =
+			(kOvlOffset_Map + ((nBlocks + 7) >> 3) + kOvlBlockSz - 1)
+				& ~ (kOvlBlockSz - 1);
+		DriveDeltaMap[Drive_No] = (ui3p)calloc(1, (nBlocks + 7) >> 3);
+		if (nullpr != DriveDeltaMap[Drive_No]) {
+			DriveHasOverlay[Drive_No] = trueblnr;
+			if (InMem) {
+				DriveDeltaMem[Drive_No] =
+					(ui3p *)calloc(nBlocks, sizeof(ui3p));
+				IsOk = (nullpr != DriveDeltaMem[Drive_No]);
+			} else {
+				IsOk = OvlOpenDeltaFile(Drive_No, path);
+			}
+			if (! IsOk) {
+				OvlDetach(Drive_No);
+			}
+		}
 	}
-}
 
-/* --- mouse --- */
-
-/* cursor hiding */
-
-LOCALVAR blnr HaveCursorHidden = falseblnr;
-LOCALVAR blnr WantCursorHidden = falseblnr;
+	return IsOk;
+}
+#endif
 
-LOCALPROC ForceShowCursor(void)
+LOCALFUNC blnr DriveAttach(tDrive Drive_No, blnr *locked)
 {
-	if (HaveCursorHidden) {
-		HaveCursorHidden = falseblnr;
-		(void) SDL_ShowCursor(SDL_ENABLE);
-	}
-}
+	/* set up whatever sits between a new disk image and the Mac */
+#if IncludeSonyOverlay
+	char *path = OverlayPathWanted;
+	blnr InMem = OverlayInMemWanted;
+#endif
 
-/* cursor moving */
+#if IncludeSonyCmprs
+	if (! CmprsAttach(Drive_No)) {
+		return falseblnr;
+	}
+	if (DriveIsCmprs[Drive_No]) {
+#if IncludeSonyOverlay
+		if (NULL == path) {
+			InMem = trueblnr;
+		}
+#else
+		*locked = trueblnr;
+#endif
+	}
+#endif
 
-LOCALFUNC blnr MyMoveMouse(si4b h, si4b v)
-{
-#if EnableMagnify
-	if (UseMagnify) {
-		h *= MyWindowScale;
-		v *= MyWindowScale;
+#if IncludeSonyOverlay
+	if ((NULL != path) || InMem) {
+		if (! OvlAttach(Drive_No, path, InMem)) {
+#if IncludeSonyCmprs
+			CmprsDetach(Drive_No);
+#endif
+			return falseblnr;
+		}
+		*locked = falseblnr;
 	}
 #endif
 
-	SDL_WarpMouseInWindow(window, h, v);
+#if IncludeSonyWriteBack
+	if (! *locked
+#if IncludeSonyOverlay
+		&& ! DriveHasOverlay[Drive_No]
+#endif
+		&& (mnvm_noErr == FileGetSize(Drives[Drive_No],
+			&DriveWbSize[Drive_No])))
+	{
+		DriveWbOn[Drive_No] = trueblnr;
+	}
+#endif
 
 	return trueblnr;
 }
 
-/* cursor state */
+#if IncludeSonyRamDisk
+LOCALPROC RamDiskDetach(tDrive Drive_No)
+{
+	char *path = DriveRamSavePath[Drive_No];
+
+	if (NULL != path) {
+		FILE *refnum = fopen(path, "wb");
+		blnr IsOk = falseblnr;
+
+		if (NULL != refnum) {
+			IsOk = (DriveRamSize[Drive_No] == fwrite(
+				DriveRamData[Drive_No], 1, DriveRamSize[Drive_No],
+				refnum));
+			if (0 != fclose(refnum)) {
+				IsOk = falseblnr;
+			}
+		}
+		if (! IsOk) {
+			MacMsg(kStrSaveFailTitle, kStrSaveFailMessage, falseblnr);
+		}
+	}
 
-LOCALPROC MousePositionNotify(int NewMousePosh, int NewMousePosv)
+	free(DriveRamData[Drive_No]);
+	DriveRamData[Drive_No] = nullpr;
+}
+#endif
+
+LOCALFUNC tMacErr vSonyEject0(tDrive Drive_No, blnr deleteit)
 {
-	blnr ShouldHaveCursorHidden = trueblnr;
+	FILE *refnum = Drives[Drive_No];
 
-#if EnableMagnify
-	if (UseMagnify) {
-		NewMousePosh /= MyWindowScale;
-		NewMousePosv /= MyWindowScale;
+	DiskEjectedNotify(Drive_No);
+
+#if IncludeSonyWriteBack
+	if (DriveWbOn[Drive_No]) {
+		WbDetach(Drive_No);
+		DriveWbOn[Drive_No] = falseblnr;
 	}
 #endif
-
-#if EnableMouseMotion && MayFullScreen
-	if (HaveMouseMotion) {
-		MyMousePositionSetDelta(NewMousePosh - SavedMouseH,
-			NewMousePosv - SavedMouseV);
-		SavedMouseH = NewMousePosh;
-		SavedMouseV = NewMousePosv;
+#if IncludeSonyOverlay
+	OvlDetach(Drive_No);
+#endif
+#if IncludeSonyCmprs
+	CmprsDetach(Drive_No);
+#endif
+#if IncludeSonyRamDisk
+	if (nullpr != DriveRamData[Drive_No]) {
+		RamDiskDetach(Drive_No);
 	} else
 #endif
 	{
-		if (NewMousePosh < 0) {
-			NewMousePosh = 0;
-			ShouldHaveCursorHidden = falseblnr;
-		} else if (NewMousePosh >= vMacScreenWidth) {
-			NewMousePosh = vMacScreenWidth - 1;
-			ShouldHaveCursorHidden = falseblnr;
+#if IncludeSonyWriteBack
+		SDL_LockMutex(WbIOLock);
+#endif
+		fclose(refnum);
+#if IncludeSonyWriteBack
+		SDL_UnlockMutex(WbIOLock);
+#endif
+	}
+	Drives[Drive_No] = NotAfileRef; /* not really needed */
+#if IncludeForkServer
+	free(DrivePath[Drive_No]);
+	DrivePath[Drive_No] = NULL;
+#endif
+
+	return mnvm_noErr;
+}
+
+GLOBALFUNC tMacErr vSonyEject(tDrive Drive_No)
+{
+	return vSonyEject0(Drive_No, falseblnr);
+}
+
+LOCALPROC UnInitDrives(void)
+{
+	tDrive i;
+
+	for (i = 0; i < NumDrives; ++i) {
+		if (vSonyIsInserted(i)) {
+			(void) vSonyEject(i);
 		}
-		if (NewMousePosv < 0) {
-			NewMousePosv = 0;
-			ShouldHaveCursorHidden = falseblnr;
-		} else if (NewMousePosv >= vMacScreenHeight) {
-			NewMousePosv = vMacScreenHeight - 1;
-			ShouldHaveCursorHidden = falseblnr;
+	}
+}
+
+LOCALFUNC blnr Sony_Insert0(FILE *refnum, blnr locked,
+	char *drivepath)
+{
+	tDrive Drive_No;
+	blnr IsOk = falseblnr;
+
+	if (! FirstFreeDisk(&Drive_No)) {
+		MacMsg(kStrTooManyImagesTitle, kStrTooManyImagesMessage,
+			falseblnr);
+	} else {
+		/* printf("Sony_Insert0 %d\n", (int)Drive_No); */
+
+		Drives[Drive_No] = refnum;
+		if (! DriveAttach(Drive_No, &locked)) {
+			MacMsg(kStrOpenFailTitle, kStrOpenFailMessage,
+				falseblnr);
+			Drives[Drive_No] = NotAfileRef;
+		} else
+		{
+#if IncludeSCSIDisks
+			if (SCSIDiskWanted) {
+				vSCSIDriveMask |= ((ui5b)1 << Drive_No);
+			}
+#endif
+#if IncludeForkServer
+			DrivePath[Drive_No] = strdup(drivepath);
+#endif
+			DiskInsertNotify(Drive_No, locked);
+
+			IsOk = trueblnr;
 		}
+	}
 
-#if VarFullScreen
-		if (UseFullScreen)
+	if (! IsOk) {
+		fclose(refnum);
+	}
+
+	return IsOk;
+}
+
+LOCALFUNC blnr Sony_Insert1(char *drivepath, blnr silentfail)
+{
+	blnr locked = falseblnr;
+	/* printf("Sony_Insert1 %s\n", drivepath); */
+	FILE *refnum = NULL;
+
+#if IncludeSonyOverlay
+	if ((NULL == OverlayPathWanted) && ! OverlayInMemWanted)
 #endif
-#if MayFullScreen
+	{
+		refnum = fopen(drivepath, "rb+");
+	}
+	if (NULL == refnum) {
+		locked = trueblnr;
+		refnum = fopen(drivepath, "rb");
+	}
+	if (NULL == refnum) {
+		if (! silentfail) {
+			MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+		}
+	} else {
+		return Sony_Insert0(refnum, locked, drivepath);
+	}
+	return falseblnr;
+}
+
+#if IncludeSonyRamDisk
+LOCALFUNC blnr RamDisk_Insert(char *s)
+{
+	/*
+		s is either a size, in bytes or with a K or M suffix,
+		for an empty RAM disk, or a disk image to copy.
+	*/
+	tDrive Drive_No;
+	char *p = s;
+	ui5r Size = 0;
+	ui5r d;
+	int Shift = 0;
+	blnr TooBig = falseblnr;
+	ui3p Data = nullpr;
+	FILE *refnum = NULL;
+	blnr IsOk = falseblnr;
+
+	/* checked before each step, so a big number can't wrap */
+	while ((*p >= '0') && (*p <= '9')) {
+		d = *p++ - '0';
+		if (Size > (kRamDiskMaxSize - d) / 10) {
+			TooBig = trueblnr;
+		} else {
+			Size = Size * 10 + d;
+		}
+	}
+	if (('K' == *p) || ('k' == *p)) {
+		Shift = 10;
+		++p;
+	} else if (('M' == *p) || ('m' == *p)) {
+		Shift = 20;
+		++p;
+	}
+	if (Size > (kRamDiskMaxSize >> Shift)) {
+		TooBig = trueblnr;
+	} else {
+		Size <<= Shift;
+	}
+	if ((p != s) && (0 == *p)) {
+		if (TooBig || (0 == Size)) {
+			MacMsg(kStrBadArgTitle, kStrRamDiskSizeMessage, falseblnr);
+			goto label_fail;
+		}
+	} else {
+		/* not a size, so a disk image */
+		refnum = fopen(s, "rb");
+		if ((NULL == refnum)
+			|| (mnvm_noErr != FileGetSize(refnum, &Size)))
 		{
-			ShouldHaveCursorHidden = trueblnr;
+			MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+			goto label_fail;
 		}
-#endif
+	}
 
-		/* if (ShouldHaveCursorHidden || CurMouseButton) */
-		/*
-			for a game like arkanoid, would like mouse to still
-			move even when outside window in one direction
-		*/
-		MyMousePositionSet(NewMousePosh, NewMousePosv);
+	if (! FirstFreeDisk(&Drive_No)) {
+		MacMsg(kStrTooManyImagesTitle, kStrTooManyImagesMessage,
+			falseblnr);
+	} else if ((0 == Size)
+		|| (NULL == (Data = (ui3p)calloc(1, Size))))
+	{
+		MacMsg(kStrOutOfMemTitle, kStrOutOfMemMessage, falseblnr);
+	} else if ((NULL != refnum) && (mnvm_noErr != FileTransfer(refnum,
+		falseblnr, Data, 0, Size, nullpr)))
+	{
+		MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+		free(Data);
+	} else {
+		Drives[Drive_No] = NotAfileRef;
+		DriveRamData[Drive_No] = Data;
+		DriveRamSize[Drive_No] = Size;
+		DriveRamSavePath[Drive_No] = RamDiskSavePathWanted;
+		DiskInsertNotify(Drive_No, falseblnr);
+		IsOk = trueblnr;
 	}
 
-	WantCursorHidden = ShouldHaveCursorHidden;
+label_fail:
+	if (NULL != refnum) {
+		fclose(refnum);
+	}
+	RamDiskSavePathWanted = NULL;
+
+	return IsOk;
 }
+#endif
 
-LOCALPROC MousePositionNotifyRelative(int deltah, int deltav)
+LOCALFUNC blnr Sony_Insert2(char *s)
 {
-	blnr ShouldHaveCursorHidden = trueblnr;
+	return Sony_Insert1(s, trueblnr);
+}
 
-#if EnableMagnify
-	if (UseMagnify) {
-		deltah /= MyWindowScale;
-		deltav /= MyWindowScale;
+LOCALFUNC blnr LoadInitialImages(void)
+{
+	if (! AnyDiskInserted()) {
+		int n = NumDrives > 9 ? 9 : NumDrives;
+		int i;
+		char s[] = "disk?.dsk";
+
+		for (i = 1; i <= n; ++i) {
+			s[4] = '0' + i;
+			if (! Sony_Insert2(s)) {
+				/* stop on first error (including file not found) */
+				return trueblnr;
+			}
+		}
 	}
-#endif
-	MyMousePositionSetDelta(deltah,
-		deltav);
 
-	WantCursorHidden = ShouldHaveCursorHidden;
+	return trueblnr;
 }
 
-LOCALPROC CheckMouseState(void)
+/* --- fork server --- */
+
+#if IncludeForkServer
+/*
+	Boot once, then fork a number of children, each going on
+	from the same point, sharing memory copy on write. The disk
+	images are shared too, so each must be locked, or have an in
+	memory overlay, so that writes stay in the child. A child
+	can be given its own disk image, with "%d" in the name
+	replaced by the child number, for its input and output.
+	The parent passes on what the children print, each line
+	prefixed by the child number, and exits with the first non
+	zero exit status.
+
+	The children don't pace themselves. The parent hands out
+	quanta of emulated ticks, to no more children at once than
+	there are processors in the pool, see "fork scheduler" below.
+*/
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sched.h>
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define kMaxForkChildren 256
+#define kMaxForkQuantum 1024
+
+LOCALVAR int ForkCount = 0; /* 0 if not forking, or in a child */
+LOCALVAR ui5b ForkAtTime = 0; /* in emulated ticks */
+LOCALVAR char *ForkDiskPattern = NULL;
+LOCALVAR int ForkExitStatus = 0;
+LOCALVAR int ForkCores = 0; /* 0 for all the processors available */
+LOCALVAR ui5b ForkQuantum = 8; /* emulated ticks */
+LOCALVAR char *ForkSpeedList = NULL;
+LOCALVAR int ForkCtlFd = -1; /* in a child, where quanta come from */
+
+#define kForkSpeedOne 256 /* real time, in ForkSpeed */
+#define kForkSpeedMax 1000.0
+
+LOCALFUNC blnr ForkSpeedGet(char *s, char **p, ui5r *v)
 {
 	/*
-		this doesn't work as desired, doesn't get mouse movements
-		when outside of our window.
+		one speed target, a multiple of real time such as "0.5",
+		or "0" for as fast as possible. False if it isn't a number
+		from 0 to kForkSpeedMax, or is followed by anything but a
+		comma or the end.
 	*/
-	int x;
-	int y;
+	double d = strtod(s, p);
 
-	(void) SDL_GetMouseState(&x, &y);
-	MousePositionNotify(x, y);
+	if ((*p == s) || ((',' != **p) && ('\0' != **p))
+		|| ! ((d >= 0.0) && (d <= kForkSpeedMax)))
+	{
+		return falseblnr;
+	}
+	*v = (ui5r)(d * kForkSpeedOne + 0.5);
+	if ((0 == *v) && (d > 0.0)) {
+		*v = 1; /* slowest there is, not unlimited */
+	}
+
+	return trueblnr;
 }
 
-/* --- keyboard input --- */
+LOCALFUNC blnr ForkSpeedListOk(char *s)
+{
+	char *p;
+	ui5r v;
 
-LOCALFUNC int SDLKey2MacKeyCode(SDL_Keycode i)
+	for (; ; ) {
+		if (! ForkSpeedGet(s, &p, &v)) {
+			return falseblnr;
+		}
+		if ('\0' == *p) {
+			return trueblnr;
+		}
+		s = p + 1;
+	}
+}
+
+LOCALFUNC blnr ForkDrivesOk(void)
 {
-	int v = -1;
+	tDrive i;
 
-	switch (i) {
-		case SDLK_BACKSPACE: v = MKC_BackSpace; break;
-		case SDLK_TAB: v = MKC_Tab; break;
-		case SDLK_CLEAR: v = MKC_Clear; break;
-		case SDLK_RETURN: v = MKC_Return; break;
-		case SDLK_PAUSE: v = MKC_Pause; break;
-		case SDLK_ESCAPE: v = MKC_Escape; break;
-		case SDLK_SPACE: v = MKC_Space; break;
-		case SDLK_EXCLAIM: /* ? */ break;
-		case SDLK_QUOTEDBL: /* ? */ break;
-		case SDLK_HASH: /* ? */ break;
-		case SDLK_DOLLAR: /* ? */ break;
-		case SDLK_AMPERSAND: /* ? */ break;
-		case SDLK_QUOTE: v = MKC_SingleQuote; break;
-		case SDLK_LEFTPAREN: /* ? */ break;
-		case SDLK_RIGHTPAREN: /* ? */ break;
-		case SDLK_ASTERISK: /* ? */ break;
-		case SDLK_PLUS: /* ? */ break;
-		case SDLK_COMMA: v = MKC_Comma; break;
-		case SDLK_MINUS: v = MKC_Minus; break;
-		case SDLK_PERIOD: v = MKC_Period; break;
-		case SDLK_SLASH: v = MKC_Slash; break;
-		case SDLK_0: v = MKC_0; break;
-		case SDLK_1: v = MKC_1; break;
-		case SDLK_2: v = MKC_2; break;
-		case SDLK_3: v = MKC_3; break;
-		case SDLK_4: v = MKC_4; break;
-		case SDLK_5: v = MKC_5; break;
-		case SDLK_6: v = MKC_6; break;
-		case SDLK_7: v = MKC_7; break;
-		case SDLK_8: v = MKC_8; break;
-		case SDLK_9: v = MKC_9; break;
-		case SDLK_COLON: /* ? */ break;
-		case SDLK_SEMICOLON: v = MKC_SemiColon; break;
-		case SDLK_LESS: /* ? */ break;
-		case SDLK_EQUALS: v = MKC_Equal; break;
-		case SDLK_GREATER: /* ? */ break;
-		case SDLK_QUESTION: /* ? */ break;
-		case SDLK_AT: /* ? */ break;
+	for (i = 0; i < NumDrives; ++i) {
+		if (vSonyIsInserted(i)
+			&& ((vSonyWritableMask & ((ui5b)1 << i)) != 0)
+#if IncludeSonyOverlay
+			&& ! (DriveHasOverlay[i]
+				&& (NotAfileRef == DriveDelta[i]))
+#endif
+#if IncludeSonyRamDisk
+			&& ! ((nullpr != DriveRamData[i])
+				&& (NULL == DriveRamSavePath[i]))
+#endif
+			)
+		{
+			return falseblnr;
+		}
+	}
 
-		case SDLK_LEFTBRACKET: v = MKC_LeftBracket; break;
-		case SDLK_BACKSLASH: v = MKC_BackSlash; break;
-		case SDLK_RIGHTBRACKET: v = MKC_RightBracket; break;
-		case SDLK_CARET: /* ? */ break;
-		case SDLK_UNDERSCORE: /* ? */ break;
-		case SDLK_BACKQUOTE: v = MKC_Grave; break;
+	return trueblnr;
+}
 
-		case SDLK_a: v = MKC_A; break;
-		case SDLK_b: v = MKC_B; break;
-		case SDLK_c: v = MKC_C; break;
-		case SDLK_d: v = MKC_D; break;
-		case SDLK_e: v = MKC_E; break;
-		case SDLK_f: v = MKC_F; break;
-		case SDLK_g: v = MKC_G; break;
-		case SDLK_h: v = MKC_H; break;
-		case SDLK_i: v = MKC_I; break;
-		case SDLK_j: v = MKC_J; break;
-		case SDLK_k: v = MKC_K; break;
-		case SDLK_l: v = MKC_L; break;
-		case SDLK_m: v = MKC_M; break;
-		case SDLK_n: v = MKC_N; break;
-		case SDLK_o: v = MKC_O; break;
-		case SDLK_p: v = MKC_P; break;
-		case SDLK_q: v = MKC_Q; break;
-		case SDLK_r: v = MKC_R; break;
-		case SDLK_s: v = MKC_S; break;
-		case SDLK_t: v = MKC_T; break;
-		case SDLK_u: v = MKC_U; break;
-		case SDLK_v: v = MKC_V; break;
-		case SDLK_w: v = MKC_W; break;
-		case SDLK_x: v = MKC_X; break;
-		case SDLK_y: v = MKC_Y; break;
-		case SDLK_z: v = MKC_Z; break;
+LOCALFUNC blnr ForkChildStart(int k)
+{
+	/*
+		open the disk images again, since a FILE shared with
+		the other children would share the file position too.
+	*/
+	tDrive i;
+	FILE *refnum;
+	char *p;
+	char s[1024];
 
-		case SDLK_KP_0: v = MKC_KP0; break;
-		case SDLK_KP_1: v = MKC_KP1; break;
-		case SDLK_KP_2: v = MKC_KP2; break;
-		case SDLK_KP_3: v = MKC_KP3; break;
-		case SDLK_KP_4: v = MKC_KP4; break;
-		case SDLK_KP_5: v = MKC_KP5; break;
-		case SDLK_KP_6: v = MKC_KP6; break;
-		case SDLK_KP_7: v = MKC_KP7; break;
-		case SDLK_KP_8: v = MKC_KP8; break;
-		case SDLK_KP_9: v = MKC_KP9; break;
+#if IncludeSonyWriteBack
+	if (! WbForkChild()) {
+		return falseblnr;
+	}
+#endif
 
-		case SDLK_KP_PERIOD: v = MKC_Decimal; break;
-		case SDLK_KP_DIVIDE: v = MKC_KPDevide; break;
-		case SDLK_KP_MULTIPLY: v = MKC_KPMultiply; break;
-		case SDLK_KP_MINUS: v = MKC_KPSubtract; break;
-		case SDLK_KP_PLUS: v = MKC_KPAdd; break;
-		case SDLK_KP_ENTER: v = MKC_Enter; break;
-		case SDLK_KP_EQUALS: v = MKC_KPEqual; break;
+	for (i = 0; i < NumDrives; ++i) {
+		if (vSonyIsInserted(i) && (NotAfileRef != Drives[i])) {
+			refnum = fopen(DrivePath[i], "rb");
+			if (NULL == refnum) {
+				return falseblnr;
+			}
+			fclose(Drives[i]);
+			Drives[i] = refnum;
+		}
+	}
 
-		case SDLK_UP: v = MKC_Up; break;
-		case SDLK_DOWN: v = MKC_Down; break;
-		case SDLK_RIGHT: v = MKC_Right; break;
-		case SDLK_LEFT: v = MKC_Left; break;
-		case SDLK_INSERT: v = MKC_Help; break;
-		case SDLK_HOME: v = MKC_Home; break;
-		case SDLK_END: v = MKC_End; break;
-		case SDLK_PAGEUP: v = MKC_PageUp; break;
-		case SDLK_PAGEDOWN: v = MKC_PageDown; break;
+	if (NULL != ForkDiskPattern) {
+		p = strstr(ForkDiskPattern, "%d");
+		if (NULL == p) {
+			(void) snprintf(s, sizeof(s), "%s", ForkDiskPattern);
+		} else {
+			(void) snprintf(s, sizeof(s), "%.*s%d%s",
+				(int)(p - ForkDiskPattern), ForkDiskPattern, k, p + 2);
+		}
+		if (! Sony_Insert1(s, falseblnr)) {
+			return falseblnr;
+		}
+	}
 
-		case SDLK_F1: v = MKC_F1; break;
-		case SDLK_F2: v = MKC_F2; break;
-		case SDLK_F3: v = MKC_F3; break;
-		case SDLK_F4: v = MKC_F4; break;
-		case SDLK_F5: v = MKC_F5; break;
-		case SDLK_F6: v = MKC_F6; break;
-		case SDLK_F7: v = MKC_F7; break;
-		case SDLK_F8: v = MKC_F8; break;
-		case SDLK_F9: v = MKC_F9; break;
-		case SDLK_F10: v = MKC_F10; break;
-		case SDLK_F11: v = MKC_F11; break;
-		case SDLK_F12: v = MKC_F11; break;
+	return trueblnr;
+}
 
-		case SDLK_F13: /* ? */ break;
-		case SDLK_F14: /* ? */ break;
-		case SDLK_F15: /* ? */ break;
+LOCALPROC ForkRelay(int k, char *p, ssize_t n, blnr *AtLineStart)
+{
+	ssize_t L;
 
-		case SDLK_NUMLOCKCLEAR: v = MKC_ForwardDel; break;
-		case SDLK_CAPSLOCK: v = MKC_CapsLock; break;
-		case SDLK_SCROLLLOCK: v = MKC_ScrollLock; break;
-		case SDLK_RSHIFT: v = MKC_Shift; break;
-		case SDLK_LSHIFT: v = MKC_Shift; break;
-		case SDLK_RCTRL: v = MKC_Control; break;
-		case SDLK_LCTRL: v = MKC_Control; break;
-		case SDLK_RALT: v = MKC_Option; break;
-		case SDLK_LALT: v = MKC_Option; break;
-		case SDLK_RGUI: v = MKC_Command; break;
-		case SDLK_LGUI: v = MKC_Command; break;
-		//case SDLK_LSUPER: v = MKC_Option; break;
-		//case SDLK_RSUPER: v = MKC_Option; break;
+	while (n > 0) {
+		if (*AtLineStart) {
+			printf("[%d] ", k);
+			*AtLineStart = falseblnr;
+		}
+		for (L = 0; (L < n) && ('\n' != p[L]); ++L) {
+		}
+		if (L < n) {
+			++L;
+			*AtLineStart = trueblnr;
+		}
+		(void) fwrite(p, 1, L, stdout);
+		p += L;
+		n -= L;
+	}
+	(void) fflush(stdout);
+}
+#endif
+
+/* --- ROM --- */
+
+LOCALVAR char *rom_path = NULL;
+
+LOCALFUNC tMacErr LoadMacRomFrom(char *path)
+{
+	tMacErr err;
+	FILE *ROM_File;
+	int File_Size;
+
+	ROM_File = fopen(path, "rb");
+	if (NULL == ROM_File) {
+		err = mnvm_fnfErr;
+	} else {
+		File_Size = fread(ROM, 1, kROM_Size, ROM_File);
+		if (File_Size != kROM_Size) {
+			if (feof(ROM_File)) {
+				err = mnvm_eofErr;
+			} else {
+				err = mnvm_miscErr;
+			}
+		} else {
+			err = mnvm_noErr;
+		}
+		fclose(ROM_File);
+	}
+
+	return err;
+}
+
+LOCALFUNC blnr LoadMacRom(void)
+{
+	tMacErr err;
+
+#if IncludeBench
+	if (MicroBenchKind >= 0) {
+		MicroBench_MakeROM(MicroBenchKind, (0 != MicroBenchIters)
+			? MicroBenchIters : MicroBench_DefaultIters(MicroBenchKind));
+		return trueblnr;
+	}
+#endif
+#if IncludeCPUTest
+	if (CPUTestWanted()) {
+		/* never run, just so the machine can be set up */
+		MicroBench_MakeROM(0, 1);
+		return trueblnr;
+	}
+#endif
+
+	if ((NULL == rom_path)
+		|| (mnvm_fnfErr == (err = LoadMacRomFrom(rom_path))))
+	if (mnvm_fnfErr == (err = LoadMacRomFrom(RomFileName)))
+	{
+	}
+
+	if (mnvm_noErr != err) {
+		if (mnvm_fnfErr == err) {
+			MacMsg(kStrNoROMTitle, kStrNoROMMessage, trueblnr);
+		} else if (mnvm_eofErr == err) {
+			MacMsg(kStrShortROMTitle, kStrShortROMMessage,
+				trueblnr);
+		} else {
+			MacMsg(kStrNoReadROMTitle, kStrNoReadROMMessage,
+				trueblnr);
+		}
+		SpeedStopped = trueblnr;
+	}
+
+	return trueblnr; /* keep launching Mini vMac, regardless */
+}
+
+/* --- video out --- */
+
+#if VarFullScreen
+LOCALVAR blnr UseFullScreen = (WantInitFullScreen != 0);
+#endif
+
+#if EnableMagnify
+LOCALVAR blnr UseMagnify = (WantInitMagnify != 0);
+#endif
+
+LOCALVAR blnr gBackgroundFlag = falseblnr;
+LOCALVAR blnr gTrueBackgroundFlag = falseblnr;
+LOCALVAR blnr CurSpeedStopped = trueblnr;
+
+#if EnableMagnify
+#define MaxScale MyWindowScale
+#else
+#define MaxScale 1
+#endif
+
+
+LOCALVAR SDL_Surface *my_surface = nullpr;
+
+LOCALVAR ui3p ScalingBuff = nullpr;
+
+LOCALVAR ui3p CLUT_final;
+
+#define CLUT_finalsz (256 * 8 * 4 * MaxScale)
+	/*
+		256 possible values of one byte
+		8 pixels per byte maximum (when black and white)
+		4 bytes per destination pixel maximum
+			multiplied by MyWindowScale if EnableMagnify
+	*/
+
+#define ScrnMapr_DoMap UpdateBWDepth3Copy
+#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_SrcDepth 0
+#define ScrnMapr_DstDepth 3
+#define ScrnMapr_Map CLUT_final
+
+#include "SCRNMAPR.h"
+
+#define ScrnMapr_DoMap UpdateBWDepth4Copy
+#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_SrcDepth 0
+#define ScrnMapr_DstDepth 4
+#define ScrnMapr_Map CLUT_final
+
+#include "SCRNMAPR.h"
+
+#define ScrnMapr_DoMap UpdateBWDepth5Copy
+#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_SrcDepth 0
+#define ScrnMapr_DstDepth 5
+#define ScrnMapr_Map CLUT_final
+
+#include "SCRNMAPR.h"
+
+#define ScrnMapr_DoMap UpdateBWDepth3ScaledCopy
+#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_SrcDepth 0
+#define ScrnMapr_DstDepth 3
+#define ScrnMapr_Map CLUT_final
+#define ScrnMapr_Scale MyWindowScale
+
+#include "SCRNMAPR.h"
+
+#define ScrnMapr_DoMap UpdateBWDepth4ScaledCopy
+#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_SrcDepth 0
+#define ScrnMapr_DstDepth 4
+#define ScrnMapr_Map CLUT_final
+#define ScrnMapr_Scale MyWindowScale
+
+#include "SCRNMAPR.h"
+
+#define ScrnMapr_DoMap UpdateBWDepth5ScaledCopy
+#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_SrcDepth 0
+#define ScrnMapr_DstDepth 5
+#define ScrnMapr_Map CLUT_final
+#define ScrnMapr_Scale MyWindowScale
+
+#include "SCRNMAPR.h"
+
+
+#if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
+
+#define ScrnMapr_DoMap UpdateColorDepth3Copy
+#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_SrcDepth vMacScreenDepth
+#define ScrnMapr_DstDepth 3
+#define ScrnMapr_Map CLUT_final
+
+#include "SCRNMAPR.h"
+
+#define ScrnMapr_DoMap UpdateColorDepth4Copy
+#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_SrcDepth vMacScreenDepth
+#define ScrnMapr_DstDepth 4
+#define ScrnMapr_Map CLUT_final
+
+#include "SCRNMAPR.h"
+
+#define ScrnMapr_DoMap UpdateColorDepth5Copy
+#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_SrcDepth vMacScreenDepth
+#define ScrnMapr_DstDepth 5
+#define ScrnMapr_Map CLUT_final
+
+#include "SCRNMAPR.h"
+
+#define ScrnMapr_DoMap UpdateColorDepth3ScaledCopy
+#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_SrcDepth vMacScreenDepth
+#define ScrnMapr_DstDepth 3
+#define ScrnMapr_Map CLUT_final
+#define ScrnMapr_Scale MyWindowScale
+
+#include "SCRNMAPR.h"
+
+#define ScrnMapr_DoMap UpdateColorDepth4ScaledCopy
+#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_SrcDepth vMacScreenDepth
+#define ScrnMapr_DstDepth 4
+#define ScrnMapr_Map CLUT_final
+#define ScrnMapr_Scale MyWindowScale
+
+#include "SCRNMAPR.h"
+
+#define ScrnMapr_DoMap UpdateColorDepth5ScaledCopy
+#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_SrcDepth vMacScreenDepth
+#define ScrnMapr_DstDepth 5
+#define ScrnMapr_Map CLUT_final
+#define ScrnMapr_Scale MyWindowScale
+
+#include "SCRNMAPR.h"
+
+#endif
+
+
+LOCALPROC HaveChangedScreenBuff(ui4r top, ui4r left,
+	ui4r bottom, ui4r right)
+{
+	int i;
+	int j;
+	ui3b *p;
+	Uint32 pixel;
+#if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
+	Uint32 CLUT_pixel[CLUT_size];
+#endif
+	Uint32 BWLUT_pixel[2];
+	ui5r top2 = top;
+	ui5r left2 = left;
+	ui5r bottom2 = bottom;
+	ui5r right2 = right;
+#if IncludeHostTime
+	int PrevHostTime;
+#endif
+
+#if EnableMagnify
+	if (UseMagnify) {
+		top2 *= MyWindowScale;
+		left2 *= MyWindowScale;
+		bottom2 *= MyWindowScale;
+		right2 *= MyWindowScale;
+	}
+#endif
+
+	if (SDL_MUSTLOCK(my_surface)) {
+		if (SDL_LockSurface(my_surface) < 0) {
+			return;
+		}
+	}
+
+#if IncludeHostTime
+	PrevHostTime = HostTime_Switch(kHostTimeConvert);
+#endif
+
+	{
+
+	int bpp = my_surface->format->BytesPerPixel;
+	ui5r ExpectedPitch = vMacScreenWidth * bpp;
+
+#if EnableMagnify
+	if (UseMagnify) {
+		ExpectedPitch *= MyWindowScale;
+	}
+#endif
+
+#if 0 != vMacScreenDepth
+	if (UseColorMode) {
+#if vMacScreenDepth < 4
+		for (i = 0; i < CLUT_size; ++i) {
+			CLUT_pixel[i] = SDL_MapRGB(my_surface->format,
+				CLUT_reds[i] >> 8,
+				CLUT_greens[i] >> 8,
+				CLUT_blues[i] >> 8);
+		}
+#endif
+	} else
+#endif
+	{
+		BWLUT_pixel[1] = SDL_MapRGB(my_surface->format, 0, 0, 0); /* black */
+		BWLUT_pixel[0] = SDL_MapRGB(my_surface->format, 255, 255, 255); /* white */
+	}
+
+	if ((0 == ((bpp - 1) & bpp)) /* a power of 2 */
+		&& (my_surface->pitch == ExpectedPitch)
+#if (vMacScreenDepth > 3)
+		&& ! UseColorMode
+#endif
+		)
+	{
+		int k;
+		Uint32 v;
+#if EnableMagnify
+		int a;
+#endif
+		int PixPerByte =
+#if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
+			UseColorMode ? (1 << (3 - vMacScreenDepth)) :
+#endif
+			8;
+		Uint8 *p4 = (Uint8 *)CLUT_final;
+
+		for (i = 0; i < 256; ++i) {
+			for (k = PixPerByte; --k >= 0; ) {
+
+#if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
+				if (UseColorMode) {
+					v = CLUT_pixel[
+#if 3 == vMacScreenDepth
+						i
+#else
+						(i >> (k << vMacScreenDepth))
+							& (CLUT_size - 1)
+#endif
+						];
+				} else
+#endif
+				{
+					v = BWLUT_pixel[(i >> k) & 1];
+				}
+
+#if EnableMagnify
+				for (a = UseMagnify ? MyWindowScale : 1; --a >= 0; )
+#endif
+				{
+					switch (bpp) {
+						case 1: /* Assuming 8-bpp */
+							*p4++ = v;
+							break;
+						case 2: /* Probably 15-bpp or 16-bpp */
+							*(Uint16 *)p4 = v;
+							p4 += 2;
+							break;
+						case 4: /* Probably 32-bpp */
+							*(Uint32 *)p4 = v;
+							p4 += 4;
+							break;
+					}
+				}
+			}
+		}
+
+		ScalingBuff = (ui3p)my_surface->pixels;
+
+#if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
+		if (UseColorMode) {
+#if EnableMagnify
+			if (UseMagnify) {
+				switch (bpp) {
+					case 1:
+						UpdateColorDepth3ScaledCopy(top, left, bottom, right);
+						break;
+					case 2:
+						UpdateColorDepth4ScaledCopy(top, left, bottom, right);
+						break;
+					case 4:
+						UpdateColorDepth5ScaledCopy(top, left, bottom, right);
+						break;
+				}
+			} else
+#endif
+			{
+				switch (bpp) {
+					case 1:
+						UpdateColorDepth3Copy(top, left, bottom, right);
+						break;
+					case 2:
+						UpdateColorDepth4Copy(top, left, bottom, right);
+						break;
+					case 4:
+						UpdateColorDepth5Copy(top, left, bottom, right);
+						break;
+				}
+			}
+		} else
+#endif
+		{
+#if EnableMagnify
+			if (UseMagnify) {
+				switch (bpp) {
+					case 1:
+						UpdateBWDepth3ScaledCopy(top, left, bottom, right);
+						break;
+					case 2:
+						UpdateBWDepth4ScaledCopy(top, left, bottom, right);
+						break;
+					case 4:
+						UpdateBWDepth5ScaledCopy(top, left, bottom, right);
+						break;
+				}
+			} else
+#endif
+			{
+				switch (bpp) {
+					case 1:
+						UpdateBWDepth3Copy(top, left, bottom, right);
+						break;
+					case 2:
+						UpdateBWDepth4Copy(top, left, bottom, right);
+						break;
+					case 4:
+						UpdateBWDepth5Copy(top, left, bottom, right);
+						break;
+				}
+			}
+		}
+
+	} else {
+		ui3b *the_data = (ui3b *)GetCurDrawBuff();
+
+		/* adapted from putpixel in SDL documentation */
+
+		for (i = top2; i < bottom2; ++i) {
+			for (j = left2; j < right2; ++j) {
+				int i0 = i;
+				int j0 = j;
+				Uint8 *bufp = (Uint8 *)my_surface->pixels
+					+ i * my_surface->pitch + j * bpp;
+
+#if EnableMagnify
+				if (UseMagnify) {
+					i0 /= MyWindowScale;
+					j0 /= MyWindowScale;
+				}
+#endif
+
+#if 0 != vMacScreenDepth
+				if (UseColorMode) {
+#if vMacScreenDepth < 4
+					p = the_data + ((i0 * vMacScreenWidth + j0) >> (3 - vMacScreenDepth));
+					{
+						ui3r k = (*p >> (((~ j0) & ((1 << (3 - vMacScreenDepth)) - 1))
+							<< vMacScreenDepth)) & (CLUT_size - 1);
+						pixel = CLUT_pixel[k];
+					}
+#elif 4 == vMacScreenDepth
+					p = the_data + ((i0 * vMacScreenWidth + j0) << 1);
+					{
+						ui4r t0 = do_get_mem_word(p);
+						pixel = SDL_MapRGB(my_surface->format,
+							((t0 & 0x7C00) >> 7) | ((t0 & 0x7000) >> 12),
+							((t0 & 0x03E0) >> 2) | ((t0 & 0x0380) >> 7),
+							((t0 & 0x001F) << 3) | ((t0 & 0x001C) >> 2));
+					}
+#elif 5 == vMacScreenDepth
+					p = the_data + ((i0 * vMacScreenWidth + j0) << 2);
+					pixel = SDL_MapRGB(my_surface->format,
+						p[1],
+						p[2],
+						p[3]);
+#endif
+				} else
+#endif
+				{
+					p = the_data + ((i0 * vMacScreenWidth + j0) / 8);
+					pixel = BWLUT_pixel[(*p >> ((~ j0) & 0x7)) & 1];
+				}
+
+				switch (bpp) {
+					case 1: /* Assuming 8-bpp */
+						*bufp = pixel;
+						break;
+					case 2: /* Probably 15-bpp or 16-bpp */
+						*(Uint16 *)bufp = pixel;
+						break;
+					case 3:
+						/* Slow 24-bpp mode, usually not used */
+						if (SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+							bufp[0] = (pixel >> 16) & 0xff;
+							bufp[1] = (pixel >> 8) & 0xff;
+							bufp[2] = pixel & 0xff;
+						} else {
+							bufp[0] = pixel & 0xff;
+							bufp[1] = (pixel >> 8) & 0xff;
+							bufp[2] = (pixel >> 16) & 0xff;
+						}
+						break;
+					case 4: /* Probably 32-bpp */
+						*(Uint32 *)bufp = pixel;
+						break;
+				}
+			}
+		}
+	}
+
+	}
+
+	if (SDL_MUSTLOCK(my_surface)) {
+		SDL_UnlockSurface(my_surface);
+	}
+
+#if IncludeHostTime
+	(void) HostTime_Switch(kHostTimePresent);
+#endif
+
+	// SDL2 screen update block
+	SDL_UpdateTexture(texture, NULL, my_surface->pixels, vMacScreenWidth * sizeof (Uint32));
+	SDL_RenderClear(renderer);
+	SDL_RenderCopy(renderer, texture, &src_rect, &dst_rect); //&src_rect, &dst_rect
+	SDL_RenderPresent(renderer);
+	//
+#if IncludeHostTime
+	(void) HostTime_Switch(PrevHostTime);
+#endif
+}
+
+LOCALPROC MyDrawChangesAndClear(void)
+{
+	if (ScreenChangedBottom > ScreenChangedTop) {
+		HaveChangedScreenBuff(ScreenChangedTop, ScreenChangedLeft,
+			ScreenChangedBottom, ScreenChangedRight);
+		ScreenClearChanges();
+#if IncludeBench
+		BenchFrames += 1;
+#endif
+	}
+}
+
+/* --- mouse --- */
+
+/* cursor hiding */
+
+LOCALVAR blnr HaveCursorHidden = falseblnr;
+LOCALVAR blnr WantCursorHidden = falseblnr;
+
+LOCALPROC ForceShowCursor(void)
+{
+	if (HaveCursorHidden) {
+		HaveCursorHidden = falseblnr;
+		(void) SDL_ShowCursor(SDL_ENABLE);
+	}
+}
+
+/* cursor moving */
+
+LOCALFUNC blnr MyMoveMouse(si4b h, si4b v)
+{
+#if EnableMagnify
+	if (UseMagnify) {
+		h *= MyWindowScale;
+		v *= MyWindowScale;
+	}
+#endif
+
+	SDL_WarpMouseInWindow(window, h, v);
+
+	return trueblnr;
+}
+
+/* cursor state */
+
+LOCALPROC MousePositionNotify(int NewMousePosh, int NewMousePosv)
+{
+	blnr ShouldHaveCursorHidden = trueblnr;
+
+#if EnableMagnify
+	if (UseMagnify) {
+		NewMousePosh /= MyWindowScale;
+		NewMousePosv /= MyWindowScale;
+	}
+#endif
+
+#if EnableMouseMotion && MayFullScreen
+	if (HaveMouseMotion) {
+		MyMousePositionSetDelta(NewMousePosh - SavedMouseH,
+			NewMousePosv - SavedMouseV);
+		SavedMouseH = NewMousePosh;
+		SavedMouseV = NewMousePosv;
+	} else
+#endif
+	{
+		if (NewMousePosh < 0) {
+			NewMousePosh = 0;
+			ShouldHaveCursorHidden = falseblnr;
+		} else if (NewMousePosh >= vMacScreenWidth) {
+			NewMousePosh = vMacScreenWidth - 1;
+			ShouldHaveCursorHidden = falseblnr;
+		}
+		if (NewMousePosv < 0) {
+			NewMousePosv = 0;
+			ShouldHaveCursorHidden = falseblnr;
+		} else if (NewMousePosv >= vMacScreenHeight) {
+			NewMousePosv = vMacScreenHeight - 1;
+			ShouldHaveCursorHidden = falseblnr;
+		}
+
+#if VarFullScreen
+		if (UseFullScreen)
+#endif
+#if MayFullScreen
+		{
+			ShouldHaveCursorHidden = trueblnr;
+		}
+#endif
+
+		/* if (ShouldHaveCursorHidden || CurMouseButton) */
+		/*
+			for a game like arkanoid, would like mouse to still
+			move even when outside window in one direction
+		*/
+		MyMousePositionSet(NewMousePosh, NewMousePosv);
+	}
+
+	WantCursorHidden = ShouldHaveCursorHidden;
+}
+
+LOCALPROC MousePositionNotifyRelative(int deltah, int deltav)
+{
+	blnr ShouldHaveCursorHidden = trueblnr;
+
+#if EnableMagnify
+	if (UseMagnify) {
+		deltah /= MyWindowScale;
+		deltav /= MyWindowScale;
+	}
+#endif
+	MyMousePositionSetDelta(deltah,
+		deltav);
+
+	WantCursorHidden = ShouldHaveCursorHidden;
+}
+
+LOCALPROC CheckMouseState(void)
+{
+	/*
+		this doesn't work as desired, doesn't get mouse movements
+		when outside of our window.
+	*/
+	int x;
+	int y;
+
+	(void) SDL_GetMouseState(&x, &y);
+	MousePositionNotify(x, y);
+}
+
+/* --- keyboard input --- */
+
+LOCALFUNC int SDLKey2MacKeyCode(SDL_Keycode i)
+{
+	int v = -1;
+
+	switch (i) {
+		case SDLK_BACKSPACE: v = MKC_BackSpace; break;
+		case SDLK_TAB: v = MKC_Tab; break;
+		case SDLK_CLEAR: v = MKC_Clear; break;
+		case SDLK_RETURN: v = MKC_Return; break;
+		case SDLK_PAUSE: v = MKC_Pause; break;
+		case SDLK_ESCAPE: v = MKC_Escape; break;
+		case SDLK_SPACE: v = MKC_Space; break;
+		case SDLK_EXCLAIM: /* ? */ break;
+		case SDLK_QUOTEDBL: /* ? */ break;
+		case SDLK_HASH: /* ? */ break;
+		case SDLK_DOLLAR: /* ? */ break;
+		case SDLK_AMPERSAND: /* ? */ break;
+		case SDLK_QUOTE: v = MKC_SingleQuote; break;
+		case SDLK_LEFTPAREN: /* ? */ break;
+		case SDLK_RIGHTPAREN: /* ? */ break;
+		case SDLK_ASTERISK: /* ? */ break;
+		case SDLK_PLUS: /* ? */ break;
+		case SDLK_COMMA: v = MKC_Comma; break;
+		case SDLK_MINUS: v = MKC_Minus; break;
+		case SDLK_PERIOD: v = MKC_Period; break;
+		case SDLK_SLASH: v = MKC_Slash; break;
+		case SDLK_0: v = MKC_0; break;
+		case SDLK_1: v = MKC_1; break;
+		case SDLK_2: v = MKC_2; break;
+		case SDLK_3: v = MKC_3; break;
+		case SDLK_4: v = MKC_4; break;
+		case SDLK_5: v = MKC_5; break;
+		case SDLK_6: v = MKC_6; break;
+		case SDLK_7: v = MKC_7; break;
+		case SDLK_8: v = MKC_8; break;
+		case SDLK_9: v = MKC_9; break;
+		case SDLK_COLON: /* ? */ break;
+		case SDLK_SEMICOLON: v = MKC_SemiColon; break;
+		case SDLK_LESS: /* ? */ break;
+		case SDLK_EQUALS: v = MKC_Equal; break;
+		case SDLK_GREATER: /* ? */ break;
+		case SDLK_QUESTION: /* ? */ break;
+		case SDLK_AT: /* ? */ break;
+
+		case SDLK_LEFTBRACKET: v = MKC_LeftBracket; break;
+		case SDLK_BACKSLASH: v = MKC_BackSlash; break;
+		case SDLK_RIGHTBRACKET: v = MKC_RightBracket; break;
+		case SDLK_CARET: /* ? */ break;
+		case SDLK_UNDERSCORE: /* ? */ break;
+		case SDLK_BACKQUOTE: v = MKC_Grave; break;
+
+		case SDLK_a: v = MKC_A; break;
+		case SDLK_b: v = MKC_B; break;
+		case SDLK_c: v = MKC_C; break;
+		case SDLK_d: v = MKC_D; break;
+		case SDLK_e: v = MKC_E; break;
+		case SDLK_f: v = MKC_F; break;
+		case SDLK_g: v = MKC_G; break;
+		case SDLK_h: v = MKC_H; break;
+		case SDLK_i: v = MKC_I; break;
+		case SDLK_j: v = MKC_J; break;
+		case SDLK_k: v = MKC_K; break;
+		case SDLK_l: v = MKC_L; break;
+		case SDLK_m: v = MKC_M; break;
+		case SDLK_n: v = MKC_N; break;
+		case SDLK_o: v = MKC_O; break;
+		case SDLK_p: v = MKC_P; break;
+		case SDLK_q: v = MKC_Q; break;
+		case SDLK_r: v = MKC_R; break;
+		case SDLK_s: v = MKC_S; break;
+		case SDLK_t: v = MKC_T; break;
+		case SDLK_u: v = MKC_U; break;
+		case SDLK_v: v = MKC_V; break;
+		case SDLK_w: v = MKC_W; break;
+		case SDLK_x: v = MKC_X; break;
+		case SDLK_y: v = MKC_Y; break;
+		case SDLK_z: v = MKC_Z; break;
+
+		case SDLK_KP_0: v = MKC_KP0; break;
+		case SDLK_KP_1: v = MKC_KP1; break;
+		case SDLK_KP_2: v = MKC_KP2; break;
+		case SDLK_KP_3: v = MKC_KP3; break;
+		case SDLK_KP_4: v = MKC_KP4; break;
+		case SDLK_KP_5: v = MKC_KP5; break;
+		case SDLK_KP_6: v = MKC_KP6; break;
+		case SDLK_KP_7: v = MKC_KP7; break;
+		case SDLK_KP_8: v = MKC_KP8; break;
+		case SDLK_KP_9: v = MKC_KP9; break;
+
+		case SDLK_KP_PERIOD: v = MKC_Decimal; break;
+		case SDLK_KP_DIVIDE: v = MKC_KPDevide; break;
+		case SDLK_KP_MULTIPLY: v = MKC_KPMultiply; break;
+		case SDLK_KP_MINUS: v = MKC_KPSubtract; break;
+		case SDLK_KP_PLUS: v = MKC_KPAdd; break;
+		case SDLK_KP_ENTER: v = MKC_Enter; break;
+		case SDLK_KP_EQUALS: v = MKC_KPEqual; break;
+
+		case SDLK_UP: v = MKC_Up; break;
+		case SDLK_DOWN: v = MKC_Down; break;
+		case SDLK_RIGHT: v = MKC_Right; break;
+		case SDLK_LEFT: v = MKC_Left; break;
+		case SDLK_INSERT: v = MKC_Help; break;
+		case SDLK_HOME: v = MKC_Home; break;
+		case SDLK_END: v = MKC_End; break;
+		case SDLK_PAGEUP: v = MKC_PageUp; break;
+		case SDLK_PAGEDOWN: v = MKC_PageDown; break;
+
+		case SDLK_F1: v = MKC_F1; break;
+		case SDLK_F2: v = MKC_F2; break;
+		case SDLK_F3: v = MKC_F3; break;
+		case SDLK_F4: v = MKC_F4; break;
+		case SDLK_F5: v = MKC_F5; break;
+		case SDLK_F6: v = MKC_F6; break;
+		case SDLK_F7: v = MKC_F7; break;
+		case SDLK_F8: v = MKC_F8; break;
+		case SDLK_F9: v = MKC_F9; break;
+		case SDLK_F10: v = MKC_F10; break;
+		case SDLK_F11: v = MKC_F11; break;
+		case SDLK_F12: v = MKC_F11; break;
+
+		case SDLK_F13: /* ? */ break;
+		case SDLK_F14: /* ? */ break;
+		case SDLK_F15: /* ? */ break;
+
+		case SDLK_NUMLOCKCLEAR: v = MKC_ForwardDel; break;
+		case SDLK_CAPSLOCK: v = MKC_CapsLock; break;
+		case SDLK_SCROLLLOCK: v = MKC_ScrollLock; break;
+		case SDLK_RSHIFT: v = MKC_Shift; break;
+		case SDLK_LSHIFT: v = MKC_Shift; break;
+		case SDLK_RCTRL: v = MKC_Control; break;
+		case SDLK_LCTRL: v = MKC_Control; break;
+		case SDLK_RALT: v = MKC_Option; break;
+		case SDLK_LALT: v = MKC_Option; break;
+		case SDLK_RGUI: v = MKC_Command; break;
+		case SDLK_LGUI: v = MKC_Command; break;
+		//case SDLK_LSUPER: v = MKC_Option; break;
+		//case SDLK_RSUPER: v = MKC_Option; break;
+
+		case SDLK_MODE: /* ? */ break;
+		//case SDLK_COMPOSE: /* ? */ break;
+
+		case SDLK_HELP: v = MKC_Help; break;
+		case SDLK_PRINTSCREEN: v = MKC_Print; break;
+
+		case SDLK_SYSREQ: /* ? */ break;
+		//case SDLK_BREAK: /* ? */ break;
+		case SDLK_MENU: /* ? */ break;
+		case SDLK_POWER: /* ? */ break;
+		//case SDLK_EURO: /* ? */ break;
+		case SDLK_UNDO: /* ? */ break;
+
+		default:
+			break;
+	}
+
+	return v;
+}
+
+LOCALPROC DoKeyCode(SDL_Keycode r, blnr down)
+{
+	int v = SDLKey2MacKeyCode(r);
+	if (v >= 0) {
+		Keyboard_UpdateKeyMap2(v, down);
+	}
+}
+
+LOCALPROC DisableKeyRepeat(void)
+{
+}
+
+LOCALPROC RestoreKeyRepeat(void)
+{
+}
+
+LOCALPROC ReconnectKeyCodes3(void)
+{
+}
+
+LOCALPROC DisconnectKeyCodes3(void)
+{
+	DisconnectKeyCodes2();
+	MyMouseButtonSet(falseblnr);
+}
+
+/* --- time, date, location --- */
+
+LOCALVAR ui5b TrueEmulatedTime = 0;
+LOCALVAR ui5b CurEmulatedTime = 0;
+
+#define MyInvTimeDivPow 16
+#define MyInvTimeDiv (1 << MyInvTimeDivPow)
+#define MyInvTimeDivMask (MyInvTimeDiv - 1)
+#define MyInvTimeStep 1089590 /* 1000 / 60.14742 * MyInvTimeDiv */
+
+LOCALVAR Uint32 LastTime;
+
+LOCALVAR Uint32 NextIntTime;
+LOCALVAR ui5b NextFracTime;
+
+LOCALPROC IncrNextTime(void)
+{
+	NextFracTime += MyInvTimeStep;
+	NextIntTime += (NextFracTime >> MyInvTimeDivPow);
+	NextFracTime &= MyInvTimeDivMask;
+}
+
+LOCALPROC InitNextTime(void)
+{
+	NextIntTime = LastTime;
+	NextFracTime = 0;
+	IncrNextTime();
+}
+
+LOCALVAR ui5b NewMacDateInSeconds;
+
+LOCALFUNC blnr UpdateTrueEmulatedTime(void)
+{
+	Uint32 LatestTime;
+	si5b TimeDiff;
+
+	LatestTime = SDL_GetTicks();
+	if (LatestTime != LastTime) {
+
+		NewMacDateInSeconds = LatestTime / 1000;
+			/* no date and time api in SDL */
+
+		LastTime = LatestTime;
+		TimeDiff = (LatestTime - NextIntTime);
+			/* this should work even when time wraps */
+		if (TimeDiff >= 0) {
+			if (TimeDiff > 64) {
+				/* emulation interrupted, forget it */
+				++TrueEmulatedTime;
+				InitNextTime();
+			} else {
+				do {
+					++TrueEmulatedTime;
+					IncrNextTime();
+					TimeDiff = (LatestTime - NextIntTime);
+				} while (TimeDiff >= 0);
+			}
+			return trueblnr;
+		} else {
+			if (TimeDiff < -20) {
+				/* clock goofed if ever get here, reset */
+				InitNextTime();
+			}
+		}
+	}
+	return falseblnr;
+}
+
+
+LOCALFUNC blnr CheckDateTime(void)
+{
+	if (CurMacDateInSeconds != NewMacDateInSeconds) {
+		CurMacDateInSeconds = NewMacDateInSeconds;
+		return trueblnr;
+	} else {
+		return falseblnr;
+	}
+}
+
+LOCALPROC StartUpTimeAdjust(void)
+{
+	LastTime = SDL_GetTicks();
+	InitNextTime();
+}
+
+LOCALFUNC blnr InitLocationDat(void)
+{
+	LastTime = SDL_GetTicks();
+	InitNextTime();
+	NewMacDateInSeconds = LastTime / 1000;
+	CurMacDateInSeconds = NewMacDateInSeconds;
+#if IncludeBench
+	if (0 != BenchTicks) {
+		CurMacDateInSeconds = kBenchMacDate;
+	}
+#endif
+
+	return trueblnr;
+}
+
+/* --- sound --- */
+
+#if MySoundEnabled
+
+#define kLn2SoundBuffers 4 /* kSoundBuffers must be a power of two */
+#define kSoundBuffers (1 << kLn2SoundBuffers)
+#define kSoundBuffMask (kSoundBuffers - 1)
+
+#define DesiredMinFilledSoundBuffs 3
+	/*
+		if too big then sound lags behind emulation.
+		if too small then sound will have pauses.
+	*/
+
+#define kLnOneBuffLen 9
+#define kLnAllBuffLen (kLn2SoundBuffers + kLnOneBuffLen)
+#define kOneBuffLen (1UL << kLnOneBuffLen)
+#define kAllBuffLen (1UL << kLnAllBuffLen)
+#define kLnOneBuffSz (kLnOneBuffLen + kLn2SoundSampSz - 3)
+#define kLnAllBuffSz (kLnAllBuffLen + kLn2SoundSampSz - 3)
+#define kOneBuffSz (1UL << kLnOneBuffSz)
+#define kAllBuffSz (1UL << kLnAllBuffSz)
+#define kOneBuffMask (kOneBuffLen - 1)
+#define kAllBuffMask (kAllBuffLen - 1)
+#define dbhBufferSize (kAllBuffSz + kOneBuffSz)
+
+LOCALVAR tpSoundSamp TheSoundBuffer = nullpr;
+LOCALVAR ui4b ThePlayOffset;
+LOCALVAR ui4b TheFillOffset;
+LOCALVAR ui4b TheWriteOffset;
+LOCALVAR ui4b MinFilledSoundBuffs;
+
+LOCALPROC MySound_Start0(void)
+{
+	/* Reset variables */
+	ThePlayOffset = 0;
+	TheFillOffset = 0;
+	TheWriteOffset = 0;
+	MinFilledSoundBuffs = kSoundBuffers + 1;
+}
+
+GLOBALFUNC tpSoundSamp MySound_BeginWrite(ui4r n, ui4r *actL)
+{
+	ui4b ToFillLen = kAllBuffLen - (TheWriteOffset - ThePlayOffset);
+	ui4b WriteBuffContig =
+		kOneBuffLen - (TheWriteOffset & kOneBuffMask);
+
+	if (WriteBuffContig < n) {
+		n = WriteBuffContig;
+	}
+	if (ToFillLen < n) {
+		/* overwrite previous buffer */
+		TheWriteOffset -= kOneBuffLen;
+	}
+
+	*actL = n;
+	return TheSoundBuffer + (TheWriteOffset & kAllBuffMask);
+}
+
+LOCALFUNC blnr MySound_EndWrite0(ui4r actL)
+{
+	blnr v;
+
+	TheWriteOffset += actL;
+
+	if (0 != (TheWriteOffset & kOneBuffMask)) {
+		v = falseblnr;
+	} else {
+		/* just finished a block */
+
+		TheFillOffset = TheWriteOffset;
+
+		v = trueblnr;
+	}
+
+	return v;
+}
+
+LOCALPROC MySound_SecondNotify0(void)
+{
+	if (MinFilledSoundBuffs <= kSoundBuffers) {
+		if (MinFilledSoundBuffs > DesiredMinFilledSoundBuffs) {
+			/* fprintf(stderr, "MinFilledSoundBuffs too high\n"); */
+			++CurEmulatedTime;
+		} else if (MinFilledSoundBuffs < DesiredMinFilledSoundBuffs) {
+			/* fprintf(stderr, "MinFilledSoundBuffs too low\n"); */
+			--CurEmulatedTime;
+		}
+		MinFilledSoundBuffs = kSoundBuffers + 1;
+	}
+}
+
+#define SOUND_SAMPLERATE 22255 /* = round(7833600 * 2 / 704) */
+
+LOCALVAR blnr HaveSoundOut = falseblnr;
+LOCALVAR blnr HaveStartedPlaying = falseblnr;
+
+LOCALPROC MySound_Start(void)
+{
+	if (HaveSoundOut) {
+		MySound_Start0();
+		SDL_PauseAudio(0);
+	}
+}
+
+LOCALPROC MySound_Stop(void)
+{
+	if (HaveSoundOut) {
+		SDL_PauseAudio(1);
+		HaveStartedPlaying = falseblnr;
+	}
+}
+
+static void my_audio_callback(void *udata, Uint8 *stream, int len)
+{
+	int i;
+
+label_retry:
+	{
+		ui4b ToPlayLen = TheFillOffset - ThePlayOffset;
+		ui4b FilledSoundBuffs = ToPlayLen >> kLnOneBuffLen;
+
+		if (! HaveStartedPlaying) {
+			if ((ToPlayLen >> kLnOneBuffLen) < 12) {
+				ToPlayLen = 0;
+			} else {
+				HaveStartedPlaying = trueblnr;
+			}
+		}
+
+		if (0 == len) {
+			/* done */
+
+			if (FilledSoundBuffs < MinFilledSoundBuffs) {
+				MinFilledSoundBuffs = FilledSoundBuffs;
+			}
+		} else if (ToPlayLen == 0) {
+			/* under run */
+
+			/* fprintf(stderr, "under run\n"); */
+
+			for (i = 0; i < len; ++i) {
+				*stream++ = 0x80;
+			}
+			MinFilledSoundBuffs = 0;
+		} else {
+			ui4b PlayBuffContig = kAllBuffLen
+				- (ThePlayOffset & kAllBuffMask);
+			tpSoundSamp p = TheSoundBuffer
+				+ (ThePlayOffset & kAllBuffMask);
+
+			if (ToPlayLen > PlayBuffContig) {
+				ToPlayLen = PlayBuffContig;
+			}
+			if (ToPlayLen > len) {
+				ToPlayLen = len;
+			}
+
+			for (i = 0; i < ToPlayLen; ++i) {
+				*stream++ = *p++;
+			}
+
+			ThePlayOffset += ToPlayLen;
+			len -= ToPlayLen;
+
+			goto label_retry;
+		}
+	}
+}
+
+LOCALFUNC blnr MySound_Init(void)
+{
+	SDL_AudioSpec desired;
+
+#if IncludeForkServer
+	if (0 != ForkCount) {
+		return trueblnr; /* the audio thread doesn't survive fork */
+	}
+#endif
+
+	desired.freq = SOUND_SAMPLERATE;
+	desired.format = AUDIO_U8;
+	desired.channels = 1;
+	desired.samples = 1024;
+	desired.callback = my_audio_callback;
+	desired.userdata = NULL;
+
+	/* Open the audio device */
+	if (SDL_OpenAudio(&desired, NULL) < 0) {
+		fprintf(stderr, "Couldn't open audio: %s\n", SDL_GetError());
+	} else {
+		HaveSoundOut = trueblnr;
+	}
+
+	return trueblnr; /* keep going, even if no sound */
+}
+
+LOCALPROC MySound_UnInit(void)
+{
+	if (HaveSoundOut) {
+		SDL_CloseAudio();
+	}
+}
+
+GLOBALPROC MySound_EndWrite(ui4r actL)
+{
+	if (MySound_EndWrite0(actL)) {
+	}
+}
+
+LOCALPROC MySound_SecondNotify(void)
+{
+	if (HaveSoundOut) {
+		MySound_SecondNotify0();
+	}
+}
+
+#endif
+
+/* --- basic dialogs --- */
+
+LOCALPROC CheckSavedMacMsg(void)
+{
+	/* called only on quit, if error saved but not yet reported */
+
+	if (nullpr != SavedBriefMsg) {
+		char briefMsg0[ClStrMaxLength + 1];
+		char longMsg0[ClStrMaxLength + 1];
+
+		NativeStrFromCStr(briefMsg0, SavedBriefMsg);
+		NativeStrFromCStr(longMsg0, SavedLongMsg);
+
+		fprintf(stderr, "%s\n", briefMsg0);
+		fprintf(stderr, "%s\n", longMsg0);
+
+		SavedBriefMsg = nullpr;
+	}
+}
+
+/* --- clipboard --- */
+
+#define UseMotionEvents 1
+
+#if UseMotionEvents
+LOCALVAR blnr CaughtMouse = falseblnr;
+#endif
+
+/* --- event handling for main window --- */
+
+LOCALPROC HandleTheEvent(SDL_Event *event)
+{
+	switch (event->type) {
+		case SDL_QUIT:
+			RequestMacOff = trueblnr;
+			break;
+		case SDL_WINDOWEVENT:
+			switch (event->window.event) {
+				case SDL_WINDOWEVENT_FOCUS_GAINED:
+					// Window window gained keyboard focus
+					//gTrueBackgroundFlag = (0 == event->active.gain);
+					gTrueBackgroundFlag = 0;
+					break;
+				case SDL_WINDOWEVENT_FOCUS_LOST:
+					// Window window gained keyboard focus
+					//gTrueBackgroundFlag = (0 == event->active.gain);
+					gTrueBackgroundFlag = 0;
+					break;
+				case SDL_WINDOWEVENT_ENTER:
+					// Mouse has entered the window Window
+					CaughtMouse = 1;
+					break;
+				case SDL_WINDOWEVENT_LEAVE:
+					// Mouse has entered the window Window
+					CaughtMouse = 1;
+					break;
+			}
+			break;
+		case SDL_MOUSEMOTION:
+			MousePositionNotifyRelative(
+				event->motion.xrel, event->motion.yrel);
+			break;
+		case SDL_MOUSEBUTTONDOWN:
+			/* any mouse button, we don't care which */
+			MyMouseButtonSet(trueblnr);
+			break;
+		case SDL_MOUSEBUTTONUP:
+			MyMouseButtonSet(falseblnr);
+			break;
+		case SDL_KEYDOWN:
+			DoKeyCode(event->key.keysym.sym, trueblnr);
+			break;
+		case SDL_KEYUP:
+			DoKeyCode(event->key.keysym.sym, falseblnr);
+			break;
+#if 0
+		case Expose: /* SDL doesn't have an expose event */
+			int x0 = event->expose.x;
+			int y0 = event->expose.y;
+			int x1 = x0 + event->expose.width;
+			int y1 = y0 + event->expose.height;
+
+			if (x0 < 0) {
+				x0 = 0;
+			}
+			if (x1 > vMacScreenWidth) {
+				x1 = vMacScreenWidth;
+			}
+			if (y0 < 0) {
+				y0 = 0;
+			}
+			if (y1 > vMacScreenHeight) {
+				y1 = vMacScreenHeight;
+			}
+			if ((x0 < x1) && (y0 < y1)) {
+				HaveChangedScreenBuff(y0, x0, y1, x1);
+			}
+			break;
+#endif
+	}
+}
+
+/* --- main window creation and disposal --- */
+
+LOCALVAR int my_argc;
+LOCALVAR char **my_argv;
+
+LOCALFUNC blnr Screen_Init(void)
+{
+	blnr v = falseblnr;
+
+	InitKeyCodes();
+
+	if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0)
+	{
+		fprintf(stderr, "Unable to init SDL: %s\n", SDL_GetError());
+	} else {
+		//SDL_WM_SetCaption(kStrAppName, NULL);
+		v = trueblnr;
+	}
+
+	return v;
+}
+
+#if MayFullScreen
+LOCALVAR blnr GrabMachine = falseblnr;
+#endif
+
+#if MayFullScreen
+LOCALPROC GrabTheMachine(void)
+{
+	//(void) SDL_WM_GrabInput(SDL_GRAB_ON);
+	SDL_SetWindowGrab(window, SDL_TRUE);
+
+
+#if EnableMouseMotion
+	/*
+		if magnification changes, need to reset,
+		even if HaveMouseMotion already true
+	*/
+	if (MyMoveMouse(ViewHStart + (ViewHSize / 2),
+		ViewVStart + (ViewVSize / 2)))
+	{
+		SavedMouseH = ViewHStart + (ViewHSize / 2);
+		SavedMouseV = ViewVStart + (ViewVSize / 2);
+		HaveMouseMotion = trueblnr;
+	}
+#endif
+}
+#endif
+
+#if MayFullScreen
+LOCALPROC UngrabMachine(void)
+{
+#if EnableMouseMotion
+	if (HaveMouseMotion) {
+		(void) MyMoveMouse(CurMouseH, CurMouseV);
+		HaveMouseMotion = falseblnr;
+	}
+#endif
+
+	//(void) SDL_WM_GrabInput(SDL_GRAB_OFF);
+	SDL_SetWindowGrab(window, SDL_FALSE);
+}
+#endif
+
+#if EnableMouseMotion && MayFullScreen
+LOCALPROC MyMouseConstrain(void)
+{
+	si4b shiftdh;
+	si4b shiftdv;
+
+	if (SavedMouseH < ViewHStart + (ViewHSize / 4)) {
+		shiftdh = ViewHSize / 2;
+	} else if (SavedMouseH > ViewHStart + ViewHSize - (ViewHSize / 4)) {
+		shiftdh = - ViewHSize / 2;
+	} else {
+		shiftdh = 0;
+	}
+	if (SavedMouseV < ViewVStart + (ViewVSize / 4)) {
+		shiftdv = ViewVSize / 2;
+	} else if (SavedMouseV > ViewVStart + ViewVSize - (ViewVSize / 4)) {
+		shiftdv = - ViewVSize / 2;
+	} else {
+		shiftdv = 0;
+	}
+	if ((shiftdh != 0) || (shiftdv != 0)) {
+		SavedMouseH += shiftdh;
+		SavedMouseV += shiftdv;
+		if (! MyMoveMouse(SavedMouseH, SavedMouseV)) {
+			HaveMouseMotion = falseblnr;
+		}
+	}
+}
+#endif
+
+LOCALFUNC blnr CreateMainWindow(void)
+{
+	int NewWindowHeight = vMacScreenHeight;
+	int NewWindowWidth = vMacScreenWidth;
+	Uint32 flags = SDL_SWSURFACE;
+	blnr v = falseblnr;
+
+#if EnableMagnify && 1
+	if (UseMagnify) {
+		NewWindowHeight *= MyWindowScale;
+		NewWindowWidth *= MyWindowScale;
+	}
+#endif
+
+#if VarFullScreen
+	if (UseFullScreen)
+#endif
+#if MayFullScreen
+	{
+		/* We don't want physical screen mode to be changed in modern displays,
+		 * so we pass this _DESKTOP flag. */
+		flags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
+	}
+#endif
+
+	ViewHStart = 0;
+	ViewVStart = 0;
+	ViewHSize = vMacScreenWidth;
+	ViewVSize = vMacScreenHeight;
+
+	/* We support 8bpp too: on SDL1.x, we would create a 8bpp surface here using SetVideoMode(),
+	 * but now we create a 32bpp surface that WILL be used to render 8bpp graphics using this trick.
+	 * Reminder: 8bpp is active when vMacScreenDepth is 0, defined in CNFGGLOB.h.
+	 * So setting a different mask we can do 32bpp or 8bpp using a 32bpp surface, and there will be
+	 * no conversion before uploading texture because we are already using a 32bpp texture.*/
+	my_surface= SDL_CreateRGBSurface(0, vMacScreenWidth, vMacScreenHeight, 32,
+#if 0 != vMacScreenDepth
+		0,0,0,0
+#else
+		0x00FF0000,
+                0x0000FF00,
+                0x000000FF,
+                0xFF000000
+#endif
+		);
+	
+	if (NULL == my_surface) {
+		fprintf(stderr, "SDL_CreateRGBSurface fails: %s\n",
+			SDL_GetError());
+	} else {
+#if 0 != vMacScreenDepth
+		ColorModeWorks = trueblnr;
+#endif
+		v = trueblnr;
+	}
+
+#if VarFullScreen
+	if (UseFullScreen)
+#endif
+#if MayFullScreen
+	{
+		SDL_DisplayMode info;
+		SDL_GetCurrentDisplayMode(0, &info);
+		
+		displayWidth  = info.w; 
+		displayHeight = info.h;
+
+		dst_rect.w = displayHeight * ((float)vMacScreenWidth / (float)vMacScreenHeight);
+		dst_rect.h = displayHeight;
+		dst_rect.x = (displayWidth - dst_rect.w) / 2;
+		dst_rect.y = 0;
+
+		/* We don't want physical screen mode to be changed in modern displays,
+		 * so we pass this _DESKTOP flag. */
+		flags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
+	}
+	else {
+		dst_rect.w = vMacScreenWidth;
+		dst_rect.h = vMacScreenHeight;
+		dst_rect.x = 0;
+		dst_rect.y = 0;
+	}
+#else
+	dst_rect.w = vMacScreenWidth;
+	dst_rect.h = vMacScreenHeight;
+	dst_rect.x = 0;
+	dst_rect.y = 0;
+#endif
+
+	src_rect.w = vMacScreenWidth;
+	src_rect.h = vMacScreenHeight;	
+	src_rect.x = 0;
+	src_rect.y = 0;
+
+	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear"); 
+	SDL_ShowCursor(SDL_DISABLE);
+	SDL_SetRelativeMouseMode(SDL_ENABLE);
+
+	/* Remember: width and height values will be ignored when we use fullscreen. */
+	window = SDL_CreateWindow(
+        	"Mini vMac", 0, 0, NewWindowWidth, NewWindowHeight, 
+        	flags);
+
+	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED|SDL_RENDERER_PRESENTVSYNC);
+	
+	texture = SDL_CreateTexture(renderer,
+                               SDL_PIXELFORMAT_ARGB8888,
+                               SDL_TEXTUREACCESS_STREAMING,
+                               vMacScreenWidth, vMacScreenHeight);
+
+	return v;
+}
+
+LOCALFUNC blnr ReCreateMainWindow(void)
+{
+	ForceShowCursor(); /* hide/show cursor api is per window */
+
+#if MayFullScreen
+	if (GrabMachine) {
+		GrabMachine = falseblnr;
+		UngrabMachine();
+	}
+#endif
+
+#if EnableMagnify
+	UseMagnify = WantMagnify;
+#endif
+#if VarFullScreen
+	UseFullScreen = WantFullScreen;
+#endif
+
+	/* First things first, we destroy the window before creating a new one. 
+	   We're not in SetVideoMode() land anymore. */
+	SDL_DestroyTexture(texture);
+	SDL_DestroyRenderer(renderer);
+	SDL_DestroyWindow(window);
+
+	(void) CreateMainWindow();
+
+	if (HaveCursorHidden) {
+		(void) MyMoveMouse(CurMouseH, CurMouseV);
+	}
+
+	return trueblnr;
+}
+
+LOCALPROC ZapWinStateVars(void)
+{
+}
+
+#if VarFullScreen
+LOCALPROC ToggleWantFullScreen(void)
+{
+	WantFullScreen = ! WantFullScreen;
+}
+#endif
+
+/* --- SavedTasks --- */
+
+LOCALPROC LeaveBackground(void)
+{
+	ReconnectKeyCodes3();
+	DisableKeyRepeat();
+}
+
+LOCALPROC EnterBackground(void)
+{
+	RestoreKeyRepeat();
+	DisconnectKeyCodes3();
+
+	ForceShowCursor();
+}
+
+LOCALPROC LeaveSpeedStopped(void)
+{
+#if MySoundEnabled
+	MySound_Start();
+#endif
+
+	StartUpTimeAdjust();
+}
+
+LOCALPROC EnterSpeedStopped(void)
+{
+#if MySoundEnabled
+	MySound_Stop();
+#endif
+}
+
+LOCALPROC CheckForSavedTasks(void)
+{
+	if (MyEvtQNeedRecover) {
+		MyEvtQNeedRecover = falseblnr;
+
+		/* attempt cleanup, MyEvtQNeedRecover may get set again */
+		MyEvtQTryRecoverFromFull();
+	}
+
+#if EnableMouseMotion && MayFullScreen
+	if (HaveMouseMotion) {
+		MyMouseConstrain();
+	}
+#endif
+
+	if (RequestMacOff) {
+		RequestMacOff = falseblnr;
+		if (AnyDiskInserted()) {
+			MacMsgOverride(kStrQuitWarningTitle,
+				kStrQuitWarningMessage);
+		} else {
+			ForceMacOff = trueblnr;
+		}
+	}
+
+	if (ForceMacOff) {
+		return;
+	}
+
+#if IncludeWatch
+	if (ControlFd >= 0) {
+		ControlPoll();
+	}
+#endif
+#if IncludeCoverage
+	if (0 != CovWriteWanted) {
+		CovWriteWanted = 0;
+		if (NULL != CovOutPath) {
+			CovWrite();
+		}
+	}
+#endif
+
+	if (gTrueBackgroundFlag != gBackgroundFlag) {
+		gBackgroundFlag = gTrueBackgroundFlag;
+		if (gTrueBackgroundFlag) {
+			EnterBackground();
+		} else {
+			LeaveBackground();
+		}
+	}
+
+	if (CurSpeedStopped != (SpeedStopped ||
+		(gBackgroundFlag && ! RunInBackground
+#if EnableAutoSlow && 0
+			&& (QuietSubTicks >= 4092)
+#endif
+		)))
+	{
+		CurSpeedStopped = ! CurSpeedStopped;
+		if (CurSpeedStopped) {
+			EnterSpeedStopped();
+		} else {
+			LeaveSpeedStopped();
+		}
+	}
+
+	if ((nullpr != SavedBriefMsg) & ! MacMsgDisplayed) {
+		MacMsgDisplayOn();
+	}
+
+#if EnableMagnify || VarFullScreen
+	if (0
+#if EnableMagnify
+		|| (UseMagnify != WantMagnify)
+#endif
+#if VarFullScreen
+		|| (UseFullScreen != WantFullScreen)
+#endif
+		)
+	{
+		(void) ReCreateMainWindow();
+	}
+#endif
+
+#if MayFullScreen
+	if (GrabMachine != (
+#if VarFullScreen
+		UseFullScreen &&
+#endif
+		! (gTrueBackgroundFlag || CurSpeedStopped)))
+	{
+		GrabMachine = ! GrabMachine;
+		if (GrabMachine) {
+			GrabTheMachine();
+		} else {
+			UngrabMachine();
+		}
+	}
+#endif
+
+	if (NeedWholeScreenDraw) {
+		NeedWholeScreenDraw = falseblnr;
+		ScreenChangedAll();
+	}
+
+	MyDrawChangesAndClear();
+
+	if (HaveCursorHidden != (WantCursorHidden
+		&& ! (gTrueBackgroundFlag || CurSpeedStopped)))
+	{
+		HaveCursorHidden = ! HaveCursorHidden;
+		(void) SDL_ShowCursor(
+			HaveCursorHidden ? SDL_DISABLE : SDL_ENABLE);
+	}
+}
+
+/* --- native traps --- */
+
+#if EnableTrapAccel
+#define kMaxTrapAccelWanted 16
+
+LOCALVAR ui4r TrapAccelWantedTrap[kMaxTrapAccelWanted];
+	/* 0 for all traps */
+LOCALVAR ui3b TrapAccelWantedMode[kMaxTrapAccelWanted];
+LOCALVAR int TrapAccelNumWanted = 0;
+
+GLOBALFUNC ui3r TrapAccelWantMode(ui4r Trap)
+{
+	int i;
+	ui3r v = kTrapAccelOn;
+
+	/* the last one given wins */
+	for (i = 0; i < TrapAccelNumWanted; ++i) {
+		if ((0 == TrapAccelWantedTrap[i])
+			|| (Trap == TrapAccelWantedTrap[i]))
+		{
+			v = TrapAccelWantedMode[i];
+		}
+	}
+
+	return v;
+}
+
+LOCALFUNC blnr TrapAccelWant(char *s)
+{
+	/* like "A02E=off", or "all=verify" */
+	char *p;
+	ui5r Trap;
+	ui3r Mode;
+
+	if (0 == strncmp(s, "all=", 4)) {
+		Trap = 0;
+		p = s + 3;
+	} else {
+		Trap = strtoul(s, &p, 16);
+		if ((p == s) || ('=' != *p) || (0xA000 != (Trap & 0xF000))) {
+			return falseblnr;
+		}
+	}
+	++p;
+	if (0 == strcmp(p, "off")) {
+		Mode = kTrapAccelOff;
+	} else if (0 == strcmp(p, "on")) {
+		Mode = kTrapAccelOn;
+	} else if (0 == strcmp(p, "verify")) {
+		Mode = kTrapAccelVerify;
+	} else {
+		return falseblnr;
+	}
+	if (TrapAccelNumWanted >= kMaxTrapAccelWanted) {
+		return falseblnr;
+	}
+	TrapAccelWantedTrap[TrapAccelNumWanted] = Trap;
+	TrapAccelWantedMode[TrapAccelNumWanted] = Mode;
+	++TrapAccelNumWanted;
+
+	return trueblnr;
+}
+#endif
+
+/* --- command line parsing --- */
+
+LOCALFUNC blnr ScanCommandLine(void)
+{
+	char *pa;
+	int i = 1;
+
+label_retry:
+	if (i < my_argc) {
+		pa = my_argv[i++];
+		if ('-' == pa[0]) {
+			if ((0 == strcmp(pa, "--rom"))
+				|| (0 == strcmp(pa, "-r")))
+			{
+				if (i < my_argc) {
+					rom_path = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+#if IncludeSonyOverlay
+			if (0 == strcmp(pa, "--overlay")) {
+				/* applies to the next disk image */
+				if (i < my_argc) {
+					OverlayPathWanted = my_argv[i++];
+					OverlayInMemWanted = falseblnr;
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--overlay-mem")) {
+				OverlayPathWanted = NULL;
+				OverlayInMemWanted = trueblnr;
+				goto label_retry;
+			} else
+#endif
+#if IncludeHostFS
+			if (0 == strcmp(pa, "--hostfs")) {
+				/* host directory to share with the Mac */
+				if (i < my_argc) {
+					if (! HostFS_Init(my_argv[i++])) {
+						MacMsg(kStrOpenFailTitle, kStrOpenFailMessage,
+							falseblnr);
+					}
+					goto label_retry;
+				}
+			} else
+#endif
+#if IncludeSaveState
+			if (0 == strcmp(pa, "--state")) {
+				/* file for saving and loading the state */
+				if (i < my_argc) {
+					StateFilePath = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--load-state")) {
+				/* start from a saved state */
+				if (i < my_argc) {
+					StateFilePath = my_argv[i++];
+					WantLoadState = trueblnr;
+					goto label_retry;
+				}
+			} else
+#endif
+#if IncludeRewind
+			if (0 == strcmp(pa, "--rewind")) {
+				/*
+					keep snapshots, this many ticks apart. Only
+					memory and devices go back, not disk images or
+					a HostFS folder, so mount disks locked, or the
+					guest's cache and the image may not match.
+				*/
+				if (i < my_argc) {
+					Rewind_Start(strtoul(my_argv[i++], NULL, 0));
+					goto label_retry;
+				}
+			} else
+#endif
+#if IncludeForkServer
+			if (0 == strcmp(pa, "--fork")) {
+				/* number of children to fork once booted */
+				if (i < my_argc) {
+					ForkCount = atoi(my_argv[i++]);
+					if (ForkCount > kMaxForkChildren) {
+						ForkCount = kMaxForkChildren;
+					}
+					if (ForkCount > 0) {
+						/* children can't share a window */
+						(void) setenv("SDL_VIDEODRIVER", "dummy", 0);
+					}
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--fork-at")) {
+				/* emulated ticks from starting, to fork at */
+				if (i < my_argc) {
+					ForkAtTime = strtoul(my_argv[i++], NULL, 0);
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--fork-disk")) {
+				/* disk image for each child */
+				if (i < my_argc) {
+					ForkDiskPattern = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--fork-cores")) {
+				/* most children to run at once */
+				if (i < my_argc) {
+					ForkCores = atoi(my_argv[i++]);
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--fork-quantum")) {
+				/* emulated ticks a child runs at a time */
+				if (i < my_argc) {
+					ForkQuantum = strtoul(my_argv[i++], NULL, 0);
+					if (0 == ForkQuantum) {
+						ForkQuantum = 1;
+					} else if (ForkQuantum > kMaxForkQuantum) {
+						ForkQuantum = kMaxForkQuantum;
+					}
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--fork-speed")) {
+				/* for each child, like "1,0.5,4,0", 0 for all out */
+				if (i < my_argc) {
+					pa = my_argv[i++];
+					if (ForkSpeedListOk(pa)) {
+						ForkSpeedList = pa;
+					} else {
+						MacMsg(kStrBadArgTitle, kStrBadArgMessage,
+							falseblnr);
+					}
+					goto label_retry;
+				}
+			} else
+#endif
+#if IncludeBench
+			if (0 == strcmp(pa, "--bench")) {
+				/* run this many ticks as fast as possible, then quit */
+				if (i < my_argc) {
+					BenchTicks = strtoul(my_argv[i++], NULL, 0);
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--bench-out")) {
+				/* file for the benchmark report, else stdout */
+				if (i < my_argc) {
+					BenchOutPath = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--microbench")) {
+				/* like "alu", time the CPU with a stub ROM, then quit */
+				if (i < my_argc) {
+					int k;
+
+					pa = my_argv[i++];
+					for (k = MicroBench_Count(); --k >= 0; ) {
+						if (0 == strcmp(pa, MicroBench_Name(k))) {
+							break;
+						}
+					}
+					if (k < 0) {
+						MacMsg(kStrBadArgTitle, kStrBadArgMessage,
+							falseblnr);
+					}
+					MicroBenchKind = k;
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--microbench-iters")) {
+				/* times round the microbenchmark loop */
+				if (i < my_argc) {
+					MicroBenchIters = strtoul(my_argv[i++], NULL, 0);
+					goto label_retry;
+				}
+			} else
+#if EmMultiInstance
+			if (0 == strcmp(pa, "--microbench-instances")) {
+				/* this many Macs in this process, one per thread */
+				if (i < my_argc) {
+					ui5r v;
+					char *p;
+
+					pa = my_argv[i++];
+					v = strtoul(pa, &p, 0);
+					if ((p == pa) || ('\0' != *p) || (0 == v)) {
+						MacMsg(kStrBadArgTitle, kStrBadArgMessage,
+							falseblnr);
+					} else {
+						MicroBenchInsts = (v > kMaxMicroBenchInsts)
+							? kMaxMicroBenchInsts : v;
+					}
+					goto label_retry;
+				}
+			} else
+#endif
+#endif
+#if IncludeProfile
+			if (0 == strcmp(pa, "--profile")) {
+				/* sample the emulated PC, report on quitting */
+				if (i < my_argc) {
+					ProfileOutPath = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--profile-folded")) {
+				/* call stacks, in the folded form flamegraph.pl reads */
+				if (i < my_argc) {
+					ProfileFoldedPath = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--profile-every")) {
+				if (i < my_argc) {
+					ProfileEvery = strtoul(my_argv[i++], NULL, 0);
+					goto label_retry;
+				}
+			} else
+#endif
+#if IncludeOpStats
+			if (0 == strcmp(pa, "--op-stats")) {
+				/* count instructions run, by kind, modes and pairs */
+				if (i < my_argc) {
+					OpStatsOutPath = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+#endif
+#if IncludeHostTime
+			if (0 == strcmp(pa, "--host-time")) {
+				/* host time spent in each part, written to a file */
+				if (i < my_argc) {
+					HostTimeOutPath = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--host-time-every")) {
+				if (i < my_argc) {
+					HostTimeEvery = strtoul(my_argv[i++], NULL, 0);
+					goto label_retry;
+				}
+			} else
+#endif
+#if IncludeTrace
+			if (0 == strcmp(pa, "--trace")) {
+				/*
+					binary trace of device accesses, see TRACEDEC.
+					Fork server children each write FILE.<n>.
+				*/
+				if (i < my_argc) {
+					TraceOutPath = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+#endif
+#if IncludeCoverage
+			if (0 == strcmp(pa, "--coverage")) {
+				/* map of the guest code run, see COVMERGE */
+				if (i < my_argc) {
+					CovOutPath = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+#endif
+#if IncludeWatch
+			if (0 == strcmp(pa, "--watch")) {
+				/* ADDR,LEN[,KIND], logged to the --trace file */
+				if (i < my_argc) {
+					if (NWatchArgs < kMaxWatchArgs) {
+						WatchArgs[NWatchArgs++] = my_argv[i];
+					}
+					++i;
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--control")) {
+				/* named pipe, of commands such as watch */
+				if (i < my_argc) {
+					ControlPath = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+#endif
+#if IncludeCPUTest
+			if (0 == strcmp(pa, "--cpu-test")) {
+				/* run this many random CPU test cases, then quit */
+				if (i < my_argc) {
+					CPUTestCases = strtoul(my_argv[i++], NULL, 0);
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--cpu-test-seed")) {
+				if (i < my_argc) {
+					CPUTestSeed = strtoul(my_argv[i++], NULL, 0);
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--cpu-test-steps")) {
+				if (i < my_argc) {
+					CPUTestSteps = strtoul(my_argv[i++], NULL, 0);
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--cpu-test-record")) {
+				/* write a trace, to check another build against */
+				if (i < my_argc) {
+					CPUTestRecordPath = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--cpu-test-check")) {
+				/* run the cases in a trace, and compare */
+				if (i < my_argc) {
+					CPUTestCheckPath = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+#endif
+#if EnableTrapAccel
+			if (0 == strcmp(pa, "--trap-accel")) {
+				/* like "A02E=off", modes off, on, verify */
+				if (i < my_argc) {
+					if (! TrapAccelWant(my_argv[i++])) {
+						MacMsg(kStrBadArgTitle, kStrBadArgMessage,
+							falseblnr);
+					}
+					goto label_retry;
+				}
+			} else
+#endif
+#if IncludeSCSIDisks
+			if (0 == strcmp(pa, "--scsi")) {
+				/* next disk image is a SCSI hard disk */
+				SCSIDiskWanted = trueblnr;
+				goto label_retry;
+			} else
+#endif
+#if IncludeSonyRamDisk
+			if (0 == strcmp(pa, "--ramdisk")) {
+				if (i < my_argc) {
+					(void) RamDisk_Insert(my_argv[i++]);
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--ramdisk-save")) {
+				/* applies to the next RAM disk */
+				if (i < my_argc) {
+					RamDiskSavePathWanted = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+#endif
+#if IncludeSonyCmprs
+			if (0 == strcmp(pa, "--compress")) {
+				/* make compressed disk image, then quit */
+				if (i + 1 < my_argc) {
+					FILE *src = fopen(my_argv[i], "rb");
+					FILE *dst = fopen(my_argv[i + 1], "wb");
+					blnr IsOk = (NULL != src) && (NULL != dst)
+						&& CmprsMakeImage(src, dst);
+
+					if (NULL != src) {
+						fclose(src);
+					}
+					if ((NULL != dst) && (0 != fclose(dst))) {
+						IsOk = falseblnr;
+					}
+					if (! IsOk) {
+						MacMsg(kStrOpenFailTitle, kStrOpenFailMessage,
+							falseblnr);
+					}
+					return falseblnr;
+				}
+			} else
+#endif
+			{
+				MacMsg(kStrBadArgTitle, kStrBadArgMessage, falseblnr);
+			}
+		} else {
+			(void) Sony_Insert1(pa, falseblnr);
+#if IncludeSonyOverlay
+			OverlayPathWanted = NULL;
+			OverlayInMemWanted = falseblnr;
+#endif
+#if IncludeSCSIDisks
+			SCSIDiskWanted = falseblnr;
+#endif
+			goto label_retry;
+		}
+	}
+
+	return trueblnr;
+}
+
+/* --- main program flow --- */
+
+LOCALVAR ui5b OnTrueTime = 0;
+
+GLOBALFUNC blnr ExtraTimeNotOver(void)
+{
+	UpdateTrueEmulatedTime();
+	return TrueEmulatedTime == OnTrueTime;
+}
 
-		case SDLK_MODE: /* ? */ break;
-		//case SDLK_COMPOSE: /* ? */ break;
+/* --- platform independent code can be thought of as going here --- */
 
-		case SDLK_HELP: v = MKC_Help; break;
-		case SDLK_PRINTSCREEN: v = MKC_Print; break;
+#include "PROGMAIN.h"
 
-		case SDLK_SYSREQ: /* ? */ break;
-		//case SDLK_BREAK: /* ? */ break;
-		case SDLK_MENU: /* ? */ break;
-		case SDLK_POWER: /* ? */ break;
-		//case SDLK_EURO: /* ? */ break;
-		case SDLK_UNDO: /* ? */ break;
+/* --- fork scheduler --- */
 
-		default:
-			break;
+#if IncludeForkServer
+/*
+	Each child waits for the parent to grant it a quantum, a
+	number of emulated ticks and the processor to run them on,
+	runs them, and says how many it ran. The parent grants
+	quanta to no more children at once than there are
+	processors in the pool, and each child has a speed target,
+	a multiple of real time, or 0 for as fast as possible. A
+	child that is behind its target goes before any child that
+	has no target, and the one furthest behind goes first.
+	Children with no target share what is left, the one that
+	has run the fewest ticks going first. A child goes back to
+	the processor it last ran on if that is free, so that its
+	memory is still in that processor's caches.
+*/
+
+LOCALVAR int ForkCpu[kMaxForkChildren];
+	/* processors in the pool, -1 if can't pin */
+LOCALVAR int ForkCpuChild[kMaxForkChildren]; /* or -1 if free */
+LOCALVAR int ForkNCpus;
+LOCALVAR int ForkCurCpu = -1; /* in a child */
+
+LOCALVAR ui5r ForkSpeed[kMaxForkChildren];
+	/* in 1/kForkSpeedOne of real time, 0 for as fast as possible */
+LOCALVAR Uint32 ForkNextIntTime[kMaxForkChildren];
+LOCALVAR ui5b ForkNextFracTime[kMaxForkChildren];
+LOCALVAR ui5b ForkTicksRun[kMaxForkChildren];
+LOCALVAR int ForkLastCpu[kMaxForkChildren];
+LOCALVAR int ForkOnCpu[kMaxForkChildren]; /* or -1 if waiting */
+
+LOCALFUNC blnr ForkReadAll(int fd, void *p, size_t n)
+{
+	ssize_t L;
+
+	while (n > 0) {
+		L = read(fd, p, n);
+		if (L > 0) {
+			p = (char *)p + L;
+			n -= L;
+		} else if ((L < 0) && (EINTR == errno)) {
+			/* try again */
+		} else {
+			return falseblnr;
+		}
 	}
 
-	return v;
+	return trueblnr;
 }
 
-LOCALPROC DoKeyCode(SDL_Keycode r, blnr down)
+LOCALFUNC blnr ForkWriteAll(int fd, void *p, size_t n)
 {
-	int v = SDLKey2MacKeyCode(r);
-	if (v >= 0) {
-		Keyboard_UpdateKeyMap2(v, down);
+	ssize_t L;
+
+	while (n > 0) {
+		L = write(fd, p, n);
+		if (L > 0) {
+			p = (char *)p + L;
+			n -= L;
+		} else if ((L < 0) && (EINTR == errno)) {
+			/* try again */
+		} else {
+			return falseblnr;
+		}
 	}
-}
 
-LOCALPROC DisableKeyRepeat(void)
-{
+	return trueblnr;
 }
 
-LOCALPROC RestoreKeyRepeat(void)
+LOCALPROC ForkSetCpu(int cpu)
 {
+#ifdef __linux__
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	(void) sched_setaffinity(0, sizeof(set), &set);
+#else
+	UnusedParam(cpu);
+#endif
 }
 
-LOCALPROC ReconnectKeyCodes3(void)
+LOCALPROC ForkInitCpus(void)
 {
+	int n = 0;
+	int i;
+
+#ifdef __linux__
+	cpu_set_t set;
+
+	if (0 == sched_getaffinity(0, sizeof(set), &set)) {
+		for (i = 0; (i < CPU_SETSIZE) && (n < kMaxForkChildren); ++i)
+		{
+			if (CPU_ISSET(i, &set)) {
+				ForkCpu[n++] = i;
+			}
+		}
+	}
+#endif
+	if (0 == n) {
+		long v = sysconf(_SC_NPROCESSORS_ONLN);
+
+		n = (v < 1) ? 1
+			: (v > kMaxForkChildren) ? kMaxForkChildren : v;
+		for (i = 0; i < n; ++i) {
+			ForkCpu[i] = -1;
+		}
+	}
+	if ((ForkCores > 0) && (ForkCores < n)) {
+		n = ForkCores;
+	}
+	for (i = 0; i < n; ++i) {
+		ForkCpuChild[i] = -1;
+	}
+	ForkNCpus = n;
 }
 
-LOCALPROC DisconnectKeyCodes3(void)
+LOCALFUNC ui5r ForkSpeedOf(int k)
 {
-	DisconnectKeyCodes2();
-	MyMouseButtonSet(falseblnr);
-}
+	/* from a list like "1,0.5,4,0", the last repeating */
+	char *s = ForkSpeedList;
+	char *p;
+	ui5r v = kForkSpeedOne;
+
+	if (NULL != s) {
+		/* checked by ForkSpeedListOk */
+		while (ForkSpeedGet(s, &p, &v) && (',' == *p) && (--k >= 0)) {
+			s = p + 1;
+		}
+	}
 
-/* --- time, date, location --- */
+	return v;
+}
 
-LOCALVAR ui5b TrueEmulatedTime = 0;
-LOCALVAR ui5b CurEmulatedTime = 0;
+LOCALPROC ForkRunQuantum(void)
+{
+	/* in a child */
+	ui5b g[2]; /* ticks, processor */
+	ui5b n = 0;
 
-#define MyInvTimeDivPow 16
-#define MyInvTimeDiv (1 << MyInvTimeDivPow)
-#define MyInvTimeDivMask (MyInvTimeDiv - 1)
-#define MyInvTimeStep 1089590 /* 1000 / 60.14742 * MyInvTimeDiv */
+	if (! ForkReadAll(ForkCtlFd, g, sizeof(g))) {
+		ForceMacOff = trueblnr; /* the parent has gone */
+		return;
+	}
+	if ((int)g[1] != ForkCurCpu) {
+		ForkCurCpu = g[1];
+		if (ForkCurCpu >= 0) {
+			ForkSetCpu(ForkCurCpu);
+		}
+	}
 
-LOCALVAR Uint32 LastTime;
+	if (UpdateTrueEmulatedTime()) {
+		(void) CheckDateTime();
+	}
 
-LOCALVAR Uint32 NextIntTime;
-LOCALVAR ui5b NextFracTime;
+	EmVideoDisable = trueblnr; /* no one to see it */
+	while ((n < g[0]) && ! ForceMacOff) {
+		DoEmulateOneTick();
+		++CurEmulatedTime;
+		++n;
+	}
+	EmVideoDisable = falseblnr;
 
-LOCALPROC IncrNextTime(void)
-{
-	NextFracTime += MyInvTimeStep;
-	NextIntTime += (NextFracTime >> MyInvTimeDivPow);
-	NextFracTime &= MyInvTimeDivMask;
+	(void) ForkWriteAll(ForkCtlFd, &n, sizeof(n));
 }
 
-LOCALPROC InitNextTime(void)
+LOCALFUNC int ForkPickChild(int *ctls, int n, Uint32 Now)
 {
-	NextIntTime = LastTime;
-	NextFracTime = 0;
-	IncrNextTime();
-}
+	/* returns -1 if no child is ready to run */
+	int k;
+	int best = -1;
+	blnr BestPaced = falseblnr;
+	si5b TimeDiff;
 
-LOCALVAR ui5b NewMacDateInSeconds;
+	for (k = 0; k < n; ++k) {
+		if ((ctls[k] >= 0) && (ForkOnCpu[k] < 0)) {
+			if (0 != ForkSpeed[k]) {
+				TimeDiff = Now - ForkNextIntTime[k];
+				if (TimeDiff >= 0) {
+					if (TimeDiff > 64) {
+						/* too far behind, forget it */
+						ForkNextIntTime[k] = Now;
+						ForkNextFracTime[k] = 0;
+					}
+					if ((! BestPaced)
+						|| ((si5b)(ForkNextIntTime[k]
+							- ForkNextIntTime[best]) < 0))
+					{
+						best = k;
+						BestPaced = trueblnr;
+					}
+				}
+			} else if ((! BestPaced)
+				&& ((best < 0)
+					|| (ForkTicksRun[k] < ForkTicksRun[best])))
+			{
+				best = k;
+			}
+		}
+	}
 
-LOCALFUNC blnr UpdateTrueEmulatedTime(void)
+	return best;
+}
+
+LOCALFUNC int ForkTimeToWait(int *ctls, int n, Uint32 Now)
 {
-	Uint32 LatestTime;
+	/* ms until a waiting child is due, -1 for no limit */
+	int k;
 	si5b TimeDiff;
+	int v = -1;
 
-	LatestTime = SDL_GetTicks();
-	if (LatestTime != LastTime) {
-
-		NewMacDateInSeconds = LatestTime / 1000;
-			/* no date and time api in SDL */
+	for (k = 0; k < ForkNCpus; ++k) {
+		if (ForkCpuChild[k] < 0) {
+			break;
+		}
+	}
+	if (k == ForkNCpus) {
+		return -1; /* wait for a quantum to end */
+	}
 
-		LastTime = LatestTime;
-		TimeDiff = (LatestTime - NextIntTime);
-			/* this should work even when time wraps */
-		if (TimeDiff >= 0) {
-			if (TimeDiff > 64) {
-				/* emulation interrupted, forget it */
-				++TrueEmulatedTime;
-				InitNextTime();
-			} else {
-				do {
-					++TrueEmulatedTime;
-					IncrNextTime();
-					TimeDiff = (LatestTime - NextIntTime);
-				} while (TimeDiff >= 0);
+	for (k = 0; k < n; ++k) {
+		if ((ctls[k] >= 0) && (ForkOnCpu[k] < 0)
+			&& (0 != ForkSpeed[k]))
+		{
+			TimeDiff = ForkNextIntTime[k] - Now;
+			if (TimeDiff < 1) {
+				TimeDiff = 1;
 			}
-			return trueblnr;
-		} else {
-			if (TimeDiff < -20) {
-				/* clock goofed if ever get here, reset */
-				InitNextTime();
+			if ((v < 0) || (TimeDiff < v)) {
+				v = TimeDiff;
 			}
 		}
 	}
-	return falseblnr;
-}
 
-
-LOCALFUNC blnr CheckDateTime(void)
-{
-	if (CurMacDateInSeconds != NewMacDateInSeconds) {
-		CurMacDateInSeconds = NewMacDateInSeconds;
-		return trueblnr;
-	} else {
-		return falseblnr;
-	}
+	return v;
 }
 
-LOCALPROC StartUpTimeAdjust(void)
+LOCALPROC ForkGrant(int *ctls, int k, int c)
 {
-	LastTime = SDL_GetTicks();
-	InitNextTime();
+	ui5b g[2];
+
+	g[0] = ForkQuantum;
+	g[1] = ForkCpu[c];
+	(void) ForkWriteAll(ctls[k], g, sizeof(g));
+		/* if the child has gone, poll will say so */
+	ForkCpuChild[c] = k;
+	ForkOnCpu[k] = c;
+	ForkLastCpu[k] = c;
+	if (0 != ForkSpeed[k]) {
+		Uint64 t = ForkNextFracTime[k]
+			+ (Uint64)ForkQuantum * MyInvTimeStep * kForkSpeedOne
+				/ ForkSpeed[k];
+
+		ForkNextIntTime[k] += (Uint32)(t >> MyInvTimeDivPow);
+		ForkNextFracTime[k] = (ui5b)t & MyInvTimeDivMask;
+	}
 }
 
-LOCALFUNC blnr InitLocationDat(void)
+LOCALPROC ForkSchedule(int *ctls, int n)
 {
-	LastTime = SDL_GetTicks();
-	InitNextTime();
-	NewMacDateInSeconds = LastTime / 1000;
-	CurMacDateInSeconds = NewMacDateInSeconds;
+	/* hand out quanta, while there are free processors */
+	int c;
+	int k;
 
-	return trueblnr;
+	for (; ; ) {
+		for (c = 0; (c < ForkNCpus) && (ForkCpuChild[c] >= 0); ++c) {
+		}
+		if (c == ForkNCpus) {
+			break;
+		}
+		k = ForkPickChild(ctls, n, SDL_GetTicks());
+		if (k < 0) {
+			break;
+		}
+		if ((ForkLastCpu[k] >= 0) && (ForkCpuChild[ForkLastCpu[k]] < 0))
+		{
+			c = ForkLastCpu[k];
+		}
+		ForkGrant(ctls, k, c);
+	}
 }
 
-/* --- sound --- */
-
-#if MySoundEnabled
-
-#define kLn2SoundBuffers 4 /* kSoundBuffers must be a power of two */
-#define kSoundBuffers (1 << kLn2SoundBuffers)
-#define kSoundBuffMask (kSoundBuffers - 1)
-
-#define DesiredMinFilledSoundBuffs 3
-	/*
-		if too big then sound lags behind emulation.
-		if too small then sound will have pauses.
-	*/
-
-#define kLnOneBuffLen 9
-#define kLnAllBuffLen (kLn2SoundBuffers + kLnOneBuffLen)
-#define kOneBuffLen (1UL << kLnOneBuffLen)
-#define kAllBuffLen (1UL << kLnAllBuffLen)
-#define kLnOneBuffSz (kLnOneBuffLen + kLn2SoundSampSz - 3)
-#define kLnAllBuffSz (kLnAllBuffLen + kLn2SoundSampSz - 3)
-#define kOneBuffSz (1UL << kLnOneBuffSz)
-#define kAllBuffSz (1UL << kLnAllBuffSz)
-#define kOneBuffMask (kOneBuffLen - 1)
-#define kAllBuffMask (kAllBuffLen - 1)
-#define dbhBufferSize (kAllBuffSz + kOneBuffSz)
-
-LOCALVAR tpSoundSamp TheSoundBuffer = nullpr;
-LOCALVAR ui4b ThePlayOffset;
-LOCALVAR ui4b TheFillOffset;
-LOCALVAR ui4b TheWriteOffset;
-LOCALVAR ui4b MinFilledSoundBuffs;
-
-LOCALPROC MySound_Start0(void)
+LOCALPROC ForkDone(int k)
 {
-	/* Reset variables */
-	ThePlayOffset = 0;
-	TheFillOffset = 0;
-	TheWriteOffset = 0;
-	MinFilledSoundBuffs = kSoundBuffers + 1;
+	/* a quantum is over, or the child has gone */
+	if (ForkOnCpu[k] >= 0) {
+		ForkCpuChild[ForkOnCpu[k]] = -1;
+		ForkOnCpu[k] = -1;
+	}
 }
 
-GLOBALFUNC tpSoundSamp MySound_BeginWrite(ui4r n, ui4r *actL)
+LOCALPROC ForkCollect(int *fds, int *ctls, pid_t *pids, int n)
 {
-	ui4b ToFillLen = kAllBuffLen - (TheWriteOffset - ThePlayOffset);
-	ui4b WriteBuffContig =
-		kOneBuffLen - (TheWriteOffset & kOneBuffMask);
-
-	if (WriteBuffContig < n) {
-		n = WriteBuffContig;
+	struct pollfd pfd[2 * kMaxForkChildren];
+	blnr AtLineStart[kMaxForkChildren];
+	char buf[4096];
+	int nOpen = 2 * n;
+	ssize_t L;
+	ui5b r;
+	int status;
+	int code;
+	int k;
+
+	ForkInitCpus();
+	for (k = 0; k < n; ++k) {
+		pfd[k].fd = fds[k];
+		pfd[k].events = POLLIN;
+		AtLineStart[k] = trueblnr;
+		pfd[n + k].fd = ctls[k];
+		pfd[n + k].events = POLLIN;
+		ForkSpeed[k] = ForkSpeedOf(k);
+		ForkNextIntTime[k] = SDL_GetTicks();
+		ForkNextFracTime[k] = 0;
+		ForkTicksRun[k] = 0;
+		ForkLastCpu[k] = -1;
+		ForkOnCpu[k] = -1;
 	}
-	if (ToFillLen < n) {
-		/* overwrite previous buffer */
-		TheWriteOffset -= kOneBuffLen;
+
+	while (nOpen > 0) {
+		ForkSchedule(ctls, n);
+		if (poll(pfd, 2 * n, ForkTimeToWait(ctls, n, SDL_GetTicks())) < 0)
+		{
+			if (EINTR == errno) {
+				continue;
+			}
+			break;
+		}
+		for (k = 0; k < n; ++k) {
+			if ((pfd[k].fd >= 0) && (0 != pfd[k].revents)) {
+				L = read(pfd[k].fd, buf, sizeof(buf));
+				if (L > 0) {
+					ForkRelay(k, buf, L, &AtLineStart[k]);
+				} else if ((L < 0) && (EINTR == errno)) {
+					/* try again */
+				} else {
+					if (! AtLineStart[k]) {
+						ForkRelay(k, "\n", 1, &AtLineStart[k]);
+					}
+					(void) close(pfd[k].fd);
+					pfd[k].fd = -1;
+					--nOpen;
+				}
+			}
+			if ((pfd[n + k].fd >= 0) && (0 != pfd[n + k].revents)) {
+				if (ForkReadAll(ctls[k], &r, sizeof(r))) {
+					ForkTicksRun[k] += r;
+				} else {
+					(void) close(ctls[k]);
+					ctls[k] = -1;
+					pfd[n + k].fd = -1;
+					--nOpen;
+				}
+				ForkDone(k);
+			}
+		}
 	}
 
-	*actL = n;
-	return TheSoundBuffer + (TheWriteOffset & kAllBuffMask);
+	for (k = 0; k < n; ++k) {
+		if (pids[k] != waitpid(pids[k], &status, 0)) {
+			code = 1;
+		} else if (WIFEXITED(status)) {
+			code = WEXITSTATUS(status);
+		} else {
+			code = 128 + WTERMSIG(status);
+		}
+		printf("[%d] exit %d, %u ticks\n", k, code,
+			(unsigned int)ForkTicksRun[k]);
+		if ((0 == ForkExitStatus) && (0 != code)) {
+			ForkExitStatus = code;
+		}
+	}
+	(void) fflush(stdout);
 }
 
-LOCALFUNC blnr MySound_EndWrite0(ui4r actL)
+LOCALPROC ForkServer(void)
 {
-	blnr v;
-
-	TheWriteOffset += actL;
-
-	if (0 != (TheWriteOffset & kOneBuffMask)) {
-		v = falseblnr;
-	} else {
-		/* just finished a block */
+	int fds[kMaxForkChildren];
+	int ctls[kMaxForkChildren];
+	pid_t pids[kMaxForkChildren];
+	int p[2];
+	int q[2];
+	pid_t pid;
+	int j;
+	int k;
 
-		TheFillOffset = TheWriteOffset;
+	ForceMacOff = trueblnr;
+	if (! ForkDrivesOk()) {
+		MacMsg(kStrForkFailTitle, kStrForkDisksMessage, falseblnr);
+		ForkExitStatus = 1;
+		return;
+	}
 
-		v = trueblnr;
+	(void) fflush(stdout);
+	(void) fflush(stderr);
+	for (k = 0; k < ForkCount; ++k) {
+		if (0 != pipe(p)) {
+			break;
+		}
+		if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, q)) {
+			(void) close(p[0]);
+			(void) close(p[1]);
+			break;
+		}
+		pid = fork();
+		if (pid < 0) {
+			(void) close(p[0]);
+			(void) close(p[1]);
+			(void) close(q[0]);
+			(void) close(q[1]);
+			break;
+		}
+		if (0 == pid) {
+			for (j = 0; j < k; ++j) {
+				(void) close(fds[j]);
+				(void) close(ctls[j]);
+			}
+			(void) close(p[0]);
+			(void) close(q[0]);
+			ForkCtlFd = q[1];
+			(void) dup2(p[1], 1);
+			(void) dup2(p[1], 2);
+			(void) close(p[1]);
+			(void) setvbuf(stdout, NULL, _IOLBF, 0);
+
+			ForkCount = 0;
+#if IncludeTrace
+			TraceForkChild(k);
+#endif
+#if IncludeCoverage
+			CovForkChild(k);
+#endif
+			if (ForkChildStart(k)) {
+				ForceMacOff = falseblnr;
+			} else {
+				ForkExitStatus = 1;
+			}
+			return;
+		}
+		(void) close(p[1]);
+		(void) close(q[1]);
+		fds[k] = p[0];
+		ctls[k] = q[0];
+		pids[k] = pid;
 	}
 
-	return v;
+	ForkCollect(fds, ctls, pids, k);
+	if (k < ForkCount) {
+		MacMsg(kStrForkFailTitle, kStrForkFailMessage, falseblnr);
+		ForkExitStatus = 1;
+	}
+	ForkCount = 0;
 }
+#endif
 
-LOCALPROC MySound_SecondNotify0(void)
+#if IncludeBench
+#if IncludeSaveState
+LOCALFUNC ui5r BenchStateHash(void)
 {
-	if (MinFilledSoundBuffs <= kSoundBuffers) {
-		if (MinFilledSoundBuffs > DesiredMinFilledSoundBuffs) {
-			/* fprintf(stderr, "MinFilledSoundBuffs too high\n"); */
-			++CurEmulatedTime;
-		} else if (MinFilledSoundBuffs < DesiredMinFilledSoundBuffs) {
-			/* fprintf(stderr, "MinFilledSoundBuffs too low\n"); */
-			--CurEmulatedTime;
+	/* FNV-1a of the saved state, to check runs are the same */
+	ui3p ChunkP[kStateMaxChunks];
+	ui5r ChunkN[kStateMaxChunks];
+	ui5r h = 2166136261UL;
+	ui5r j;
+	int n;
+	int i;
+	ui3p Hdr = (ui3p)malloc(SaveState_HeaderSize());
+
+	if (NULL != Hdr) {
+		n = SaveState_Save(Hdr, ChunkP, ChunkN);
+		for (i = 0; i < n; ++i) {
+			for (j = 0; j < ChunkN[i]; ++j) {
+				h = (ui5r)((h ^ ChunkP[i][j]) * 16777619UL);
+			}
 		}
-		MinFilledSoundBuffs = kSoundBuffers + 1;
+		free(Hdr);
 	}
+
+	return h;
 }
+#endif
 
-#define SOUND_SAMPLERATE 22255 /* = round(7833600 * 2 / 704) */
+LOCALFUNC FILE *BenchOpen(void)
+{
+	FILE *f = stdout;
 
-LOCALVAR blnr HaveSoundOut = falseblnr;
-LOCALVAR blnr HaveStartedPlaying = falseblnr;
+	if ((NULL != BenchOutPath)
+		&& (NULL == (f = fopen(BenchOutPath, "w"))))
+	{
+		MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+	}
+	return f;
+}
 
-LOCALPROC MySound_Start(void)
+LOCALPROC BenchClose(FILE *f)
 {
-	if (HaveSoundOut) {
-		MySound_Start0();
-		SDL_PauseAudio(0);
+	if (stdout == f) {
+		fflush(f);
+	} else if (0 != fclose(f)) {
+		MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
 	}
 }
 
-LOCALPROC MySound_Stop(void)
+LOCALPROC BenchReport(ui5r Ticks, double Secs, double Instrs)
 {
-	if (HaveSoundOut) {
-		SDL_PauseAudio(1);
-		HaveStartedPlaying = falseblnr;
+	FILE *f;
+	double Cycles = (double)Ticks * ProgMain_CyclesPerTick();
+	double EmSecs = (double)Ticks * MyInvTimeStep
+		/ ((double)MyInvTimeDiv * 1000.0);
+
+	if (Secs <= 0.0) {
+		Secs = 1e-9;
+	}
+	if (NULL == (f = BenchOpen())) {
+		return;
 	}
+	fprintf(f, "{\n");
+	fprintf(f, "  \"ticks\": %lu,\n", (unsigned long)Ticks);
+	fprintf(f, "  \"host_seconds\": %.6f,\n", Secs);
+	fprintf(f, "  \"emulated_seconds\": %.6f,\n", EmSecs);
+	fprintf(f, "  \"speed\": %.3f,\n", EmSecs / Secs);
+	fprintf(f, "  \"instructions\": %.0f,\n", Instrs);
+	fprintf(f, "  \"mips\": %.3f,\n", Instrs / Secs / 1e6);
+	fprintf(f, "  \"cycles\": %.0f,\n", Cycles);
+	fprintf(f, "  \"cycles_per_second\": %.0f,\n", Cycles / Secs);
+	fprintf(f, "  \"frames\": %.0f,\n", BenchFrames);
+	fprintf(f, "  \"disk_bytes\": %.0f", BenchDiskBytes);
+#if IncludeSaveState
+	fprintf(f, ",\n  \"state_hash\": \"%08lx\"",
+		(unsigned long)BenchStateHash());
+#endif
+	fprintf(f, "\n}\n");
+	BenchClose(f);
 }
 
-static void my_audio_callback(void *udata, Uint8 *stream, int len)
-{
-	int i;
+#if IncludeMemStats
+FORWARDPROC MemStatsFold(void);
+#endif
 
-label_retry:
-	{
-		ui4b ToPlayLen = TheFillOffset - ThePlayOffset;
-		ui4b FilledSoundBuffs = ToPlayLen >> kLnOneBuffLen;
+LOCALPROC BenchRun(void)
+{
+	/*
+		Whole ticks only, with no host input, and the date
+		following the emulated ticks rather than the host clock,
+		so that every run with the same start does the same.
+	*/
+	SDL_Event event;
+	Uint64 t0;
+	double Secs;
+	double Instrs = 0;
+	ui5r n = 0;
+	ui5r c;
+	ui5r c0;
+
+#if IncludeSaveState
+	if (WantLoadState) {
+		WantLoadState = falseblnr;
+		if (! LoadStateNow()) {
+			ForceMacOff = trueblnr;
+			return;
+		}
+	}
+#endif
 
-		if (! HaveStartedPlaying) {
-			if ((ToPlayLen >> kLnOneBuffLen) < 12) {
-				ToPlayLen = 0;
-			} else {
-				HaveStartedPlaying = trueblnr;
+	BenchFrames = 0;
+	BenchDiskBytes = 0;
+	ProgMain_InstrCountSet(trueblnr);
+	c0 = ProgMain_InstrCount();
+	t0 = SDL_GetPerformanceCounter();
+	while ((n < BenchTicks) && ! ForceMacOff) {
+		while (SDL_PollEvent(&event)) {
+			if (SDL_QUIT == event.type) {
+				ForceMacOff = trueblnr;
 			}
 		}
+		CurMacDateInSeconds = kBenchMacDate
+			+ (ui5b)((double)n * MyInvTimeStep
+				/ ((double)MyInvTimeDiv * 1000.0));
 
-		if (0 == len) {
-			/* done */
+		DoEmulateOneTick();
+		++CurEmulatedTime;
+		MyDrawChangesAndClear();
 
-			if (FilledSoundBuffs < MinFilledSoundBuffs) {
-				MinFilledSoundBuffs = FilledSoundBuffs;
-			}
-		} else if (ToPlayLen == 0) {
-			/* under run */
+		c = ProgMain_InstrCount();
+		Instrs += (ui5r)(c - c0);
+		c0 = c;
+#if IncludeMemStats
+		MemStatsFold();
+#endif
+		++n;
+	}
+	Secs = (double)(SDL_GetPerformanceCounter() - t0)
+		/ (double)SDL_GetPerformanceFrequency();
 
-			/* fprintf(stderr, "under run\n"); */
+	BenchReport(n, Secs, Instrs);
+	ForceMacOff = trueblnr;
+}
 
-			for (i = 0; i < len; ++i) {
-				*stream++ = 0x80;
-			}
-			MinFilledSoundBuffs = 0;
-		} else {
-			ui4b PlayBuffContig = kAllBuffLen
-				- (ThePlayOffset & kAllBuffMask);
-			tpSoundSamp p = TheSoundBuffer
-				+ (ThePlayOffset & kAllBuffMask);
+#define kMicroBenchChunk 0x00100000
+	/* cycles between looking for a quit event */
 
-			if (ToPlayLen > PlayBuffContig) {
-				ToPlayLen = PlayBuffContig;
-			}
-			if (ToPlayLen > len) {
-				ToPlayLen = len;
-			}
+typedef struct {
+	double Instrs;
+	double Cycles;
+	blnr Done;
+	ui3p Block; /* memory of an instance on a thread of its own */
+} MicroBenchInstR;
 
-			for (i = 0; i < ToPlayLen; ++i) {
-				*stream++ = *p++;
+LOCALPROC MicroBenchLoop(MicroBenchInstR *r, blnr Polling)
+{
+	SDL_Event event;
+	ui5r Ran;
+	ui5r c;
+	ui5r c0;
+	blnr Done;
+
+	ProgMain_InstrCountSet(trueblnr);
+	c0 = ProgMain_InstrCount();
+	do {
+		Done = MicroBench_Run(kMicroBenchChunk, &Ran);
+		r->Cycles += Ran;
+		c = ProgMain_InstrCount();
+		r->Instrs += (ui5r)(c - c0);
+		c0 = c;
+		if (Polling) {
+			while (SDL_PollEvent(&event)) {
+				if (SDL_QUIT == event.type) {
+					ForceMacOff = trueblnr;
+				}
 			}
-
-			ThePlayOffset += ToPlayLen;
-			len -= ToPlayLen;
-
-			goto label_retry;
 		}
-	}
+	} while ((! Done) && ! ForceMacOff);
+	r->Done = Done;
 }
 
-LOCALFUNC blnr MySound_Init(void)
+#if EmMultiInstance
+LOCALVAR SDL_mutex *MicroBenchLock = NULL;
+
+LOCALFUNC int SDLCALL MicroBenchThreadMain(void *data)
 {
-	SDL_AudioSpec desired;
+	/*
+		Another Mac, with the core state of this thread (see
+		EmMultiInstance), RAM of its own, and the stub ROM and
+		dispatch table shared with the rest. ReserveAllocOneBlock
+		works on variables of the glue, and the glue's own block
+		must be kept for UnallocMyMemory, hence the lock.
+	*/
+	MicroBenchInstR *r = (MicroBenchInstR *)data;
+	ui3p SaveBlock;
+	uimr n;
+	blnr IsOk = falseblnr;
 
-	desired.freq = SOUND_SAMPLERATE;
-	desired.format = AUDIO_U8;
-	desired.channels = 1;
-	desired.samples = 1024;
-	desired.callback = my_audio_callback;
-	desired.userdata = NULL;
+	SDL_LockMutex(MicroBenchLock);
+	SaveBlock = ReserveAllocBigBlock;
+	ReserveAllocOffset = 0;
+	ReserveAllocBigBlock = nullpr;
+	EmulationReserveAlloc();
+	n = ReserveAllocOffset;
+	r->Block = (ui3p)calloc(1, n);
+	if (NULL != r->Block) {
+		ReserveAllocOffset = 0;
+		ReserveAllocBigBlock = r->Block;
+		EmulationReserveAlloc();
+		IsOk = InitEmulation();
+	}
+	ReserveAllocBigBlock = SaveBlock;
+	SDL_UnlockMutex(MicroBenchLock);
 
-	/* Open the audio device */
-	if (SDL_OpenAudio(&desired, NULL) < 0) {
-		fprintf(stderr, "Couldn't open audio: %s\n", SDL_GetError());
-	} else {
-		HaveSoundOut = trueblnr;
+	if (IsOk) {
+		MicroBenchLoop(r, falseblnr);
 	}
 
-	return trueblnr; /* keep going, even if no sound */
+	return 0;
 }
+#endif
 
-LOCALPROC MySound_UnInit(void)
+LOCALPROC MicroBenchRun(void)
 {
-	if (HaveSoundOut) {
-		SDL_CloseAudio();
-	}
-}
+	FILE *f;
+	Uint64 t0;
+	double Secs;
+	double Instrs = 0;
+	double Cycles = 0;
+	blnr Done = trueblnr;
+	int nInsts = 1;
+	int i;
+#if EmMultiInstance
+	MicroBenchInstR Insts[kMaxMicroBenchInsts];
+	SDL_Thread *Threads[kMaxMicroBenchInsts];
+#else
+	MicroBenchInstR Insts[1];
+#endif
 
-GLOBALPROC MySound_EndWrite(ui4r actL)
-{
-	if (MySound_EndWrite0(actL)) {
+	t0 = SDL_GetPerformanceCounter();
+	Insts[0].Instrs = 0;
+	Insts[0].Cycles = 0;
+	Insts[0].Done = falseblnr;
+#if EmMultiInstance
+	if ((MicroBenchInsts > 1)
+		&& (NULL != (MicroBenchLock = SDL_CreateMutex())))
+	{
+		for (; nInsts < MicroBenchInsts; ++nInsts) {
+			Insts[nInsts] = Insts[0];
+			Insts[nInsts].Block = nullpr;
+			Threads[nInsts] = SDL_CreateThread(MicroBenchThreadMain,
+				"microbench", (void *)&Insts[nInsts]);
+			if (NULL == Threads[nInsts]) {
+				break;
+			}
+		}
+	}
+#endif
+	MicroBenchLoop(&Insts[0], trueblnr);
+#if EmMultiInstance
+	for (i = 1; i < nInsts; ++i) {
+		SDL_WaitThread(Threads[i], NULL);
+		if (nullpr != Insts[i].Block) {
+			free(Insts[i].Block);
+		}
+	}
+	if (NULL != MicroBenchLock) {
+		SDL_DestroyMutex(MicroBenchLock);
+		MicroBenchLock = NULL;
+	}
+#endif
+	Secs = (double)(SDL_GetPerformanceCounter() - t0)
+		/ (double)SDL_GetPerformanceFrequency();
+	if (Secs <= 0.0) {
+		Secs = 1e-9;
+	}
+	for (i = 0; i < nInsts; ++i) {
+		Instrs += Insts[i].Instrs;
+		Cycles += Insts[i].Cycles;
+		if (! Insts[i].Done) {
+			Done = falseblnr;
+		}
 	}
-}
 
-LOCALPROC MySound_SecondNotify(void)
-{
-	if (HaveSoundOut) {
-		MySound_SecondNotify0();
+	if (NULL != (f = BenchOpen())) {
+		fprintf(f, "{\n");
+		fprintf(f, "  \"microbench\": \"%s\",\n",
+			MicroBench_Name(MicroBenchKind));
+		fprintf(f, "  \"instances\": %d,\n", nInsts);
+		fprintf(f, "  \"completed\": %s,\n", Done ? "true" : "false");
+		fprintf(f, "  \"host_seconds\": %.6f,\n", Secs);
+		fprintf(f, "  \"instructions\": %.0f,\n", Instrs);
+		fprintf(f, "  \"mips\": %.3f,\n", Instrs / Secs / 1e6);
+		fprintf(f, "  \"cycles\": %.0f,\n", Cycles);
+		fprintf(f, "  \"cycles_per_second\": %.0f\n", Cycles / Secs);
+		fprintf(f, "}\n");
+		BenchClose(f);
 	}
+	ForceMacOff = trueblnr;
 }
-
 #endif
 
-/* --- basic dialogs --- */
+#if IncludeCPUTest
+#define kCPUTestSig 0x6D764354 /* 'mvCT' */
+#define kCPUTestVersion 1
+#define kCPUTestHdrSize 24
+#define kCPUTestRecSize (2 * kCPUTestCodeLen \
+	+ 4 * (kCPUTestNRegs + kCPUTestNWrites + 2))
 
-LOCALPROC CheckSavedMacMsg(void)
-{
-	/* called only on quit, if error saved but not yet reported */
+LOCALVAR char *CPUTestRegNames[kCPUTestNRegs] = {
+	"d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7",
+	"a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7",
+	"pc", "sr", "other_sp"
+};
 
-	if (nullpr != SavedBriefMsg) {
-		char briefMsg0[ClStrMaxLength + 1];
-		char longMsg0[ClStrMaxLength + 1];
+LOCALPROC CPUTestPack(CPUTestR *r, ui3p p)
+{
+	/* big endian, the same on every host */
+	int i;
 
-		NativeStrFromCStr(briefMsg0, SavedBriefMsg);
-		NativeStrFromCStr(longMsg0, SavedLongMsg);
+	for (i = 0; i < kCPUTestCodeLen; ++i) {
+		do_put_mem_word(p, r->Code[i]);
+		p += 2;
+	}
+	for (i = 0; i < kCPUTestNRegs; ++i) {
+		do_put_mem_long(p, r->Regs[i]);
+		p += 4;
+	}
+	do_put_mem_long(p, r->NWrites);
+	p += 4;
+	for (i = 0; i < kCPUTestNWrites; ++i) {
+		do_put_mem_long(p, r->Writes[i]);
+		p += 4;
+	}
+	do_put_mem_long(p, r->MemHash);
+}
 
-		fprintf(stderr, "%s\n", briefMsg0);
-		fprintf(stderr, "%s\n", longMsg0);
+LOCALPROC CPUTestUnpack(ui3p p, CPUTestR *r)
+{
+	int i;
 
-		SavedBriefMsg = nullpr;
+	for (i = 0; i < kCPUTestCodeLen; ++i) {
+		r->Code[i] = do_get_mem_word(p);
+		p += 2;
+	}
+	for (i = 0; i < kCPUTestNRegs; ++i) {
+		r->Regs[i] = do_get_mem_long(p);
+		p += 4;
 	}
+	r->NWrites = do_get_mem_long(p);
+	p += 4;
+	for (i = 0; i < kCPUTestNWrites; ++i) {
+		r->Writes[i] = do_get_mem_long(p);
+		p += 4;
+	}
+	r->MemHash = do_get_mem_long(p);
 }
 
-/* --- clipboard --- */
-
-#define UseMotionEvents 1
+LOCALPROC CPUTestPutRegs(FILE *f, char *Name, ui5r *Regs, ui5r *Other)
+{
+	/* the registers, or only those different from Other */
+	int i;
+	char *Sep = "";
+
+	fprintf(f, "    \"%s\": {", Name);
+	for (i = 0; i < kCPUTestNRegs; ++i) {
+		if ((NULL == Other) || (Regs[i] != Other[i])) {
+			fprintf(f, "%s\"%s\": \"0x%08lX\"", Sep,
+				CPUTestRegNames[i], (unsigned long)Regs[i]);
+			Sep = ", ";
+		}
+	}
+	fprintf(f, "}");
+}
 
-#if UseMotionEvents
-LOCALVAR blnr CaughtMouse = falseblnr;
-#endif
+LOCALPROC CPUTestPutMem(FILE *f, char *Name, CPUTestR *r)
+{
+	int i;
 
-/* --- event handling for main window --- */
+	fprintf(f, "    \"%s\": {\"writes\": %lu, \"first\": [",
+		Name, (unsigned long)r->NWrites);
+	for (i = 0; (i < kCPUTestNWrites) && (i < (int)r->NWrites); ++i) {
+		fprintf(f, "%s\"0x%04lX=0x%02lX\"", (0 == i) ? "" : ", ",
+			(unsigned long)(r->Writes[i] >> 8),
+			(unsigned long)(r->Writes[i] & 0xFF));
+	}
+	fprintf(f, "], \"hash\": \"0x%08lX\"}",
+		(unsigned long)r->MemHash);
+}
 
-LOCALPROC HandleTheEvent(SDL_Event *event)
+LOCALPROC CPUTestDivergence(FILE *f, ui5r Case, ui5r Step,
+	ui5r *Before, CPUTestR *Want, CPUTestR *Got)
 {
-	switch (event->type) {
-		case SDL_QUIT:
-			RequestMacOff = trueblnr;
-			break;
-		case SDL_WINDOWEVENT:
-			switch (event->window.event) {
-				case SDL_WINDOWEVENT_FOCUS_GAINED:
-					// Window window gained keyboard focus
-					//gTrueBackgroundFlag = (0 == event->active.gain);
-					gTrueBackgroundFlag = 0;
-					break;
-				case SDL_WINDOWEVENT_FOCUS_LOST:
-					// Window window gained keyboard focus
-					//gTrueBackgroundFlag = (0 == event->active.gain);
-					gTrueBackgroundFlag = 0;
-					break;
-				case SDL_WINDOWEVENT_ENTER:
-					// Mouse has entered the window Window
-					CaughtMouse = 1;
-					break;
-				case SDL_WINDOWEVENT_LEAVE:
-					// Mouse has entered the window Window
-					CaughtMouse = 1;
-					break;
-			}
-			break;
-		case SDL_MOUSEMOTION:
-			MousePositionNotifyRelative(
-				event->motion.xrel, event->motion.yrel);
-			break;
-		case SDL_MOUSEBUTTONDOWN:
-			/* any mouse button, we don't care which */
-			MyMouseButtonSet(trueblnr);
-			break;
-		case SDL_MOUSEBUTTONUP:
-			MyMouseButtonSet(falseblnr);
-			break;
-		case SDL_KEYDOWN:
-			DoKeyCode(event->key.keysym.sym, trueblnr);
-			break;
-		case SDL_KEYUP:
-			DoKeyCode(event->key.keysym.sym, falseblnr);
-			break;
-#if 0
-		case Expose: /* SDL doesn't have an expose event */
-			int x0 = event->expose.x;
-			int y0 = event->expose.y;
-			int x1 = x0 + event->expose.width;
-			int y1 = y0 + event->expose.height;
+	int i;
+	ui4r op = Got->Code[0];
+
+	fprintf(f, "  \"divergence\": {\n");
+	fprintf(f, "    \"case\": %lu,\n", (unsigned long)Case);
+	fprintf(f, "    \"step\": %lu,\n", (unsigned long)Step);
+	fprintf(f, "    \"code\": \"");
+	for (i = 0; i < kCPUTestCodeLen; ++i) {
+		fprintf(f, "%s%04X", (0 == i) ? "" : " ", (unsigned)Got->Code[i]);
+	}
+	fprintf(f, "\",\n");
+	fprintf(f, "    \"decode\": \"%s %s,%s\",\n",
+		CPUTest_KindName(op), CPUTest_SrcModeName(op),
+		CPUTest_DstModeName(op));
+	CPUTestPutRegs(f, "before", Before, NULL);
+	fprintf(f, ",\n");
+	CPUTestPutRegs(f, "expected", Want->Regs, Got->Regs);
+	fprintf(f, ",\n");
+	CPUTestPutRegs(f, "got", Got->Regs, Want->Regs);
+	fprintf(f, ",\n");
+	CPUTestPutMem(f, "expected_memory", Want);
+	fprintf(f, ",\n");
+	CPUTestPutMem(f, "got_memory", Got);
+	fprintf(f, "\n  },\n");
+}
 
-			if (x0 < 0) {
-				x0 = 0;
-			}
-			if (x1 > vMacScreenWidth) {
-				x1 = vMacScreenWidth;
+LOCALPROC CPUTestRun(void)
+{
+	SDL_Event event;
+	FILE *f;
+	FILE *tf = NULL;
+	ui3b Hdr[kCPUTestHdrSize];
+	ui3b Buf[kCPUTestRecSize];
+	ui3b WantBuf[kCPUTestRecSize];
+	ui5r Before[kCPUTestNRegs];
+	CPUTestR r;
+	CPUTestR Want;
+	ui5r Seed = CPUTestSeed;
+	ui5r Cases = CPUTestCases;
+	ui5r Steps = CPUTestSteps;
+	ui5r Case = 0;
+	ui5r Step = 0;
+	ui5r Total = 0;
+	blnr Checking = (NULL != CPUTestCheckPath);
+	blnr Diverged = falseblnr;
+	char *Err = NULL;
+
+	if (Checking) {
+		if (NULL == (tf = fopen(CPUTestCheckPath, "rb"))) {
+			Err = "can't open trace";
+		} else if ((1 != fread(Hdr, kCPUTestHdrSize, 1, tf))
+			|| (kCPUTestSig != do_get_mem_long(Hdr))
+			|| (kCPUTestVersion != do_get_mem_long(Hdr + 4))
+			|| (kCPUTestRecSize != do_get_mem_long(Hdr + 20)))
+		{
+			Err = "not a trace from this version";
+		} else {
+			Seed = do_get_mem_long(Hdr + 8);
+			if ((0 == Cases) || (Cases > do_get_mem_long(Hdr + 12))) {
+				Cases = do_get_mem_long(Hdr + 12);
 			}
-			if (y0 < 0) {
-				y0 = 0;
+			Steps = do_get_mem_long(Hdr + 16);
+		}
+	} else if (NULL != CPUTestRecordPath) {
+		do_put_mem_long(Hdr, kCPUTestSig);
+		do_put_mem_long(Hdr + 4, kCPUTestVersion);
+		do_put_mem_long(Hdr + 8, Seed);
+		do_put_mem_long(Hdr + 12, Cases);
+		do_put_mem_long(Hdr + 16, Steps);
+		do_put_mem_long(Hdr + 20, kCPUTestRecSize);
+		if ((NULL == (tf = fopen(CPUTestRecordPath, "wb")))
+			|| (1 != fwrite(Hdr, kCPUTestHdrSize, 1, tf)))
+		{
+			Err = "can't write trace";
+		}
+	}
+
+	if (NULL == Err) {
+		CPUTest_Setup();
+	}
+	for (Case = 0; (Case < Cases) && (NULL == Err); ++Case) {
+		CPUTest_Start(Seed, Case);
+		for (Step = 0; Step < Steps; ++Step) {
+			if (Checking) {
+				if (1 != fread(WantBuf, kCPUTestRecSize, 1, tf)) {
+					Err = "trace too short";
+					break;
+				}
+				CPUTestUnpack(WantBuf, &Want);
+				MyMoveBytes((anyp)Want.Code, (anyp)r.Code,
+					sizeof(r.Code));
 			}
-			if (y1 > vMacScreenHeight) {
-				y1 = vMacScreenHeight;
+			CPUTest_GetRegs(Before);
+			CPUTest_Step(&r, Checking);
+			++Total;
+			CPUTestPack(&r, Buf);
+			if (Checking) {
+				if (0 != memcmp(Buf, WantBuf, kCPUTestRecSize)) {
+					Diverged = trueblnr;
+					break;
+				}
+			} else if (NULL != tf) {
+				if (1 != fwrite(Buf, kCPUTestRecSize, 1, tf)) {
+					Err = "can't write trace";
+					break;
+				}
 			}
-			if ((x0 < x1) && (y0 < y1)) {
-				HaveChangedScreenBuff(y0, x0, y1, x1);
+		}
+		if (0 == (Case & 0xFF)) {
+			while (SDL_PollEvent(&event)) {
+				if (SDL_QUIT == event.type) {
+					Err = "quit";
+				}
 			}
+		}
+		if (Diverged) {
 			break;
-#endif
+		}
+	}
+	if ((NULL != tf) && (0 != fclose(tf)) && (NULL == Err)) {
+		Err = "can't write trace";
+	}
+
+	if (NULL != (f = BenchOpen())) {
+		fprintf(f, "{\n");
+		fprintf(f, "  \"cpu_test\": \"%s\",\n",
+			Checking ? "check"
+				: (NULL != CPUTestRecordPath) ? "record" : "run");
+		fprintf(f, "  \"seed\": %lu,\n", (unsigned long)Seed);
+		fprintf(f, "  \"cases\": %lu,\n",
+			(unsigned long)(Diverged ? Case + 1 : Case));
+		fprintf(f, "  \"instructions\": %lu,\n", (unsigned long)Total);
+		if (Diverged) {
+			CPUTestDivergence(f, Case, Step, Before, &Want, &r);
+		}
+		if (NULL != Err) {
+			fprintf(f, "  \"error\": \"%s\",\n", Err);
+		}
+		fprintf(f, "  \"result\": \"%s\"\n",
+			(NULL != Err) ? "error"
+				: Diverged ? "diverged"
+				: Checking ? "match" : "ok");
+		fprintf(f, "}\n");
+		BenchClose(f);
+	}
+#if IncludeForkServer
+	if (Diverged || (NULL != Err)) {
+		ForkExitStatus = 1; /* the exit status of the program */
 	}
+#endif
+	ForceMacOff = trueblnr;
 }
+#endif
 
-/* --- main window creation and disposal --- */
+#if IncludeProfile
+#define kProfileTopN 64
+	/* lines of each table in the report */
 
-LOCALVAR int my_argc;
-LOCALVAR char **my_argv;
+struct ProfileSymR {
+	ui5r Key;
+	ui5r Count;
+};
+typedef struct ProfileSymR ProfileSymR;
 
-LOCALFUNC blnr Screen_Init(void)
+LOCALFUNC ui5r ProfileRangeKey(ui5r pc)
 {
-	blnr v = falseblnr;
-
-	InitKeyCodes();
+	/*
+		the routine of a ROM trap, else a 256 byte block, so
+		samples from the same code go together
+	*/
+	ui4r trap;
+	ui5r offset;
 
-	if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0)
-	{
-		fprintf(stderr, "Unable to init SDL: %s\n", SDL_GetError());
+	if (Profile_RomTrap(pc, &trap, &offset)) {
+		return 0x80000000 | trap;
 	} else {
-		//SDL_WM_SetCaption(kStrAppName, NULL);
-		v = trueblnr;
+		return pc & 0x00FFFF00;
 	}
-
-	return v;
 }
 
-#if MayFullScreen
-LOCALVAR blnr GrabMachine = falseblnr;
-#endif
-
-#if MayFullScreen
-LOCALPROC GrabTheMachine(void)
+LOCALPROC ProfileSymbol(char *s, ui5r pc, blnr IsKey)
 {
-	//(void) SDL_WM_GrabInput(SDL_GRAB_ON);
-	SDL_SetWindowGrab(window, SDL_TRUE);
+	/* s must have room for 48 characters */
+	ui4r trap;
+	ui5r offset;
+	char *name;
 
-
-#if EnableMouseMotion
-	/*
-		if magnification changes, need to reset,
-		even if HaveMouseMotion already true
-	*/
-	if (MyMoveMouse(ViewHStart + (ViewHSize / 2),
-		ViewVStart + (ViewVSize / 2)))
+	if (IsKey ? (0 != (pc & 0x80000000))
+		: Profile_RomTrap(pc, &trap, &offset))
 	{
-		SavedMouseH = ViewHStart + (ViewHSize / 2);
-		SavedMouseV = ViewVStart + (ViewVSize / 2);
-		HaveMouseMotion = trueblnr;
+		if (IsKey) {
+			trap = pc & 0xFFFF;
+		}
+		name = Profile_TrapName(trap);
+		if (NULL != name) {
+			sprintf(s, "ROM:%s", name);
+		} else {
+			sprintf(s, "ROM:%04X", (unsigned)trap);
+		}
+		if (! IsKey) {
+			sprintf(s + strlen(s), "+0x%lX", (unsigned long)offset);
+		}
+	} else {
+		switch (Profile_Where(pc, &offset)) {
+			case kProfWhereROM:
+				sprintf(s, "ROM:0x%05lX", (unsigned long)offset);
+				break;
+			case kProfWhereRAM:
+				sprintf(s, "RAM:0x%06lX", (unsigned long)offset);
+				break;
+			default:
+				sprintf(s, "0x%06lX", (unsigned long)offset);
+				break;
+		}
 	}
-#endif
 }
-#endif
 
-#if MayFullScreen
-LOCALPROC UngrabMachine(void)
+LOCALFUNC int ProfileSymCmp(const void *a, const void *b)
 {
-#if EnableMouseMotion
-	if (HaveMouseMotion) {
-		(void) MyMoveMouse(CurMouseH, CurMouseV);
-		HaveMouseMotion = falseblnr;
-	}
-#endif
+	/* most first, then by key, so the order is the same each run */
+	const ProfileSymR *x = (const ProfileSymR *)a;
+	const ProfileSymR *y = (const ProfileSymR *)b;
 
-	//(void) SDL_WM_GrabInput(SDL_GRAB_OFF);
-	SDL_SetWindowGrab(window, SDL_FALSE);
+	if (x->Count != y->Count) {
+		return (x->Count > y->Count) ? -1 : 1;
+	}
+	return (x->Key < y->Key) ? -1 : (x->Key > y->Key) ? 1 : 0;
 }
-#endif
 
-#if EnableMouseMotion && MayFullScreen
-LOCALPROC MyMouseConstrain(void)
+LOCALPROC ProfilePutTable(FILE *f, char *Name, ProfileSymR *t, ui5r n,
+	blnr IsKey, blnr Last)
 {
-	si4b shiftdh;
-	si4b shiftdv;
-
-	if (SavedMouseH < ViewHStart + (ViewHSize / 4)) {
-		shiftdh = ViewHSize / 2;
-	} else if (SavedMouseH > ViewHStart + ViewHSize - (ViewHSize / 4)) {
-		shiftdh = - ViewHSize / 2;
-	} else {
-		shiftdh = 0;
-	}
-	if (SavedMouseV < ViewVStart + (ViewVSize / 4)) {
-		shiftdv = ViewVSize / 2;
-	} else if (SavedMouseV > ViewVStart + ViewVSize - (ViewVSize / 4)) {
-		shiftdv = - ViewVSize / 2;
-	} else {
-		shiftdv = 0;
-	}
-	if ((shiftdh != 0) || (shiftdv != 0)) {
-		SavedMouseH += shiftdh;
-		SavedMouseV += shiftdv;
-		if (! MyMoveMouse(SavedMouseH, SavedMouseV)) {
-			HaveMouseMotion = falseblnr;
-		}
+	char s[48];
+	ui5r Samples = Profile_Samples();
+	ui5r i;
+
+	fprintf(f, "  \"%s\": [\n", Name);
+	for (i = 0; (i < n) && (i < kProfileTopN); ++i) {
+		ProfileSymbol(s, t[i].Key, IsKey);
+		fprintf(f, "    {\"%s\": \"0x%06lX\", \"symbol\": \"%s\", "
+			"\"count\": %lu, \"percent\": %.2f}%s\n",
+			IsKey ? "key" : "pc", (unsigned long)(t[i].Key & 0x00FFFFFF),
+			s, (unsigned long)t[i].Count,
+			100.0 * t[i].Count / ((0 == Samples) ? 1 : Samples),
+			((i + 1 < n) && (i + 1 < kProfileTopN)) ? "," : "");
 	}
+	fprintf(f, "  ]%s\n", Last ? "" : ",");
 }
-#endif
 
-LOCALFUNC blnr CreateMainWindow(void)
+LOCALPROC ProfileWriteReport(FILE *f)
 {
-	int NewWindowHeight = vMacScreenHeight;
-	int NewWindowWidth = vMacScreenWidth;
-	Uint32 flags = SDL_SWSURFACE;
-	blnr v = falseblnr;
-
-#if EnableMagnify && 1
-	if (UseMagnify) {
-		NewWindowHeight *= MyWindowScale;
-		NewWindowWidth *= MyWindowScale;
-	}
-#endif
-
-#if VarFullScreen
-	if (UseFullScreen)
-#endif
-#if MayFullScreen
-	{
-		/* We don't want physical screen mode to be changed in modern displays,
-		 * so we pass this _DESKTOP flag. */
-		flags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
+	ui5r nSlots = Profile_NumPCSlots();
+	ProfileSymR *t = (ProfileSymR *)malloc(
+		(nSlots + 0x1000) * sizeof(ProfileSymR));
+	ProfileSymR *r;
+	ui5r n = 0;
+	ui5r nr = 0;
+	ui5r i;
+	ui5r j;
+	ui5r c;
+	ui5r pc;
+	char *name;
+
+	if (NULL == t) {
+		return;
 	}
-#endif
 
-	ViewHStart = 0;
-	ViewVStart = 0;
-	ViewHSize = vMacScreenWidth;
-	ViewVSize = vMacScreenHeight;
+	fprintf(f, "{\n");
+	fprintf(f, "  \"samples\": %lu,\n", (unsigned long)Profile_Samples());
+	fprintf(f, "  \"lost\": %lu,\n", (unsigned long)Profile_Lost());
+	fprintf(f, "  \"every_cycles\": %lu,\n", (unsigned long)ProfileEvery);
 
-	/* We support 8bpp too: on SDL1.x, we would create a 8bpp surface here using SetVideoMode(),
-	 * but now we create a 32bpp surface that WILL be used to render 8bpp graphics using this trick.
-	 * Reminder: 8bpp is active when vMacScreenDepth is 0, defined in CNFGGLOB.h.
-	 * So setting a different mask we can do 32bpp or 8bpp using a 32bpp surface, and there will be
-	 * no conversion before uploading texture because we are already using a 32bpp texture.*/
-	my_surface= SDL_CreateRGBSurface(0, vMacScreenWidth, vMacScreenHeight, 32,
-#if 0 != vMacScreenDepth
-		0,0,0,0
-#else
-		0x00FF0000,
-                0x0000FF00,
-                0x000000FF,
-                0xFF000000
-#endif
-		);
-	
-	if (NULL == my_surface) {
-		fprintf(stderr, "SDL_CreateRGBSurface fails: %s\n",
-			SDL_GetError());
-	} else {
-#if 0 != vMacScreenDepth
-		ColorModeWorks = trueblnr;
-#endif
-		v = trueblnr;
+	for (i = 0; i < nSlots; ++i) {
+		if (0 != (c = Profile_GetPC(i, &pc))) {
+			t[n].Key = pc;
+			t[n].Count = c;
+			++n;
+		}
 	}
+	qsort(t, n, sizeof(ProfileSymR), ProfileSymCmp);
+	ProfilePutTable(f, "hot_pcs", t, n, falseblnr, falseblnr);
 
-#if VarFullScreen
-	if (UseFullScreen)
-#endif
-#if MayFullScreen
-	{
-		SDL_DisplayMode info;
-		SDL_GetCurrentDisplayMode(0, &info);
-		
-		displayWidth  = info.w; 
-		displayHeight = info.h;
+	/* the same samples, by routine or block */
+	r = t + n;
+	for (i = 0; i < n; ++i) {
+		ui5r k = ProfileRangeKey(t[i].Key);
 
-		dst_rect.w = displayHeight * ((float)vMacScreenWidth / (float)vMacScreenHeight);
-		dst_rect.h = displayHeight;
-		dst_rect.x = (displayWidth - dst_rect.w) / 2;
-		dst_rect.y = 0;
+		for (j = 0; j < nr; ++j) {
+			if (k == r[j].Key) {
+				break;
+			}
+		}
+		if (j == nr) {
+			if (nr >= nSlots) {
+				continue;
+			}
+			r[nr].Key = k;
+			r[nr].Count = 0;
+			++nr;
+		}
+		r[j].Count += t[i].Count;
+	}
+	qsort(r, nr, sizeof(ProfileSymR), ProfileSymCmp);
+	ProfilePutTable(f, "hot_ranges", r, nr, trueblnr, falseblnr);
 
-		/* We don't want physical screen mode to be changed in modern displays,
-		 * so we pass this _DESKTOP flag. */
-		flags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
+	n = 0;
+	for (i = 0xA000; i < 0xB000; ++i) {
+		if ((i == Profile_TrapOf(i))
+			&& (0 != (c = Profile_TrapCount(i))))
+		{
+			t[n].Key = i;
+			t[n].Count = c;
+			++n;
+		}
 	}
-	else {
-		dst_rect.w = vMacScreenWidth;
-		dst_rect.h = vMacScreenHeight;
-		dst_rect.x = 0;
-		dst_rect.y = 0;
+	qsort(t, n, sizeof(ProfileSymR), ProfileSymCmp);
+	fprintf(f, "  \"traps\": [\n");
+	for (i = 0; i < n; ++i) {
+		name = Profile_TrapName(t[i].Key);
+		fprintf(f, "    {\"trap\": \"%04lX\", \"name\": \"%s\", "
+			"\"count\": %lu}%s\n",
+			(unsigned long)t[i].Key, (NULL != name) ? name : "",
+			(unsigned long)t[i].Count, (i + 1 < n) ? "," : "");
 	}
-#else
-	dst_rect.w = vMacScreenWidth;
-	dst_rect.h = vMacScreenHeight;
-	dst_rect.x = 0;
-	dst_rect.y = 0;
-#endif
+	fprintf(f, "  ]\n");
+	fprintf(f, "}\n");
 
-	src_rect.w = vMacScreenWidth;
-	src_rect.h = vMacScreenHeight;	
-	src_rect.x = 0;
-	src_rect.y = 0;
+	free(t);
+}
 
-	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear"); 
-	SDL_ShowCursor(SDL_DISABLE);
-	SDL_SetRelativeMouseMode(SDL_ENABLE);
+#define kProfileLineSz (kProfMaxDepth * 48)
 
-	/* Remember: width and height values will be ignored when we use fullscreen. */
-	window = SDL_CreateWindow(
-        	"Mini vMac", 0, 0, NewWindowWidth, NewWindowHeight, 
-        	flags);
+LOCALPROC ProfileWriteFolded(FILE *f)
+{
+	/*
+		outermost caller first, as flamegraph.pl wants, with
+		stacks the same once put down to routines counted once
+	*/
+	ui5r pcs[kProfMaxDepth];
+	ui5r n = Profile_NumStackSlots();
+	char *Lines = (char *)malloc(n * kProfileLineSz);
+	ui5r *Counts = (ui5r *)malloc(n * sizeof(ui5r));
+	char *s;
+	ui5r nLines = 0;
+	ui5r i;
+	ui5r k;
+	ui5r c;
+	int depth;
+	int j;
 
-	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED|SDL_RENDERER_PRESENTVSYNC);
-	
-	texture = SDL_CreateTexture(renderer,
-                               SDL_PIXELFORMAT_ARGB8888,
-                               SDL_TEXTUREACCESS_STREAMING,
-                               vMacScreenWidth, vMacScreenHeight);
+	if ((NULL != Lines) && (NULL != Counts)) {
+		for (i = 0; i < n; ++i) {
+			if (0 != (c = Profile_GetStack(i, pcs, &depth))) {
+				s = Lines + nLines * kProfileLineSz;
+				*s = 0;
+				for (j = depth; --j >= 0; ) {
+					ProfileSymbol(s + strlen(s),
+						ProfileRangeKey(pcs[j]), trueblnr);
+					if (0 != j) {
+						strcat(s, ";");
+					}
+				}
+				for (k = 0; k < nLines; ++k) {
+					if (0 == strcmp(s, Lines + k * kProfileLineSz)) {
+						break;
+					}
+				}
+				if (k == nLines) {
+					Counts[nLines++] = c;
+				} else {
+					Counts[k] += c;
+				}
+			}
+		}
+		for (k = 0; k < nLines; ++k) {
+			fprintf(f, "%s %lu\n", Lines + k * kProfileLineSz,
+				(unsigned long)Counts[k]);
+		}
+	}
 
-	return v;
+	free(Counts);
+	free(Lines);
 }
 
-LOCALFUNC blnr ReCreateMainWindow(void)
+LOCALPROC ProfileWrite(void)
 {
-	ForceShowCursor(); /* hide/show cursor api is per window */
+	FILE *f;
 
-#if MayFullScreen
-	if (GrabMachine) {
-		GrabMachine = falseblnr;
-		UngrabMachine();
+	Profile_FindRoutines();
+	if (NULL != ProfileOutPath) {
+		if (NULL == (f = fopen(ProfileOutPath, "w"))) {
+			MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+		} else {
+			ProfileWriteReport(f);
+			fclose(f);
+		}
 	}
+	if (NULL != ProfileFoldedPath) {
+		if (NULL == (f = fopen(ProfileFoldedPath, "w"))) {
+			MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+		} else {
+			ProfileWriteFolded(f);
+			fclose(f);
+		}
+	}
+}
 #endif
 
-#if EnableMagnify
-	UseMagnify = WantMagnify;
-#endif
-#if VarFullScreen
-	UseFullScreen = WantFullScreen;
-#endif
-
-	/* First things first, we destroy the window before creating a new one. 
-	   We're not in SetVideoMode() land anymore. */
-	SDL_DestroyTexture(texture);
-	SDL_DestroyRenderer(renderer);
-	SDL_DestroyWindow(window);
+#if IncludeOpStats
+#define kOpStatsTopPairs 256
 
-	(void) CreateMainWindow();
+struct OpStatsPairR {
+	double Count;
+	ui5r Kind;
+	ui5r Next;
+};
+typedef struct OpStatsPairR OpStatsPairR;
 
-	if (HaveCursorHidden) {
-		(void) MyMoveMouse(CurMouseH, CurMouseV);
-	}
+LOCALFUNC double OpStatsCount(int What, ui5r a, ui5r b, ui5r c)
+{
+	ui5r Hi;
+	ui5r Lo = m68k_OpStatsGet(What, a, b, c, &Hi);
 
-	return trueblnr;
+	return Hi * 4294967296.0 + Lo;
 }
 
-LOCALPROC ZapWinStateVars(void)
+LOCALFUNC int OpStatsPairCmp(const void *a, const void *b)
 {
+	/* most frequent first */
+	const OpStatsPairR *x = (const OpStatsPairR *)a;
+	const OpStatsPairR *y = (const OpStatsPairR *)b;
+
+	return (x->Count < y->Count) ? 1 : (x->Count > y->Count) ? -1 : 0;
 }
 
-#if VarFullScreen
-LOCALPROC ToggleWantFullScreen(void)
+LOCALPROC OpStatsWriteReport(FILE *f)
 {
-	WantFullScreen = ! WantFullScreen;
-}
-#endif
+	ui5r nKinds = m68k_OpStatsNumKinds();
+	ui5r nModes = m68k_OpStatsNumModes();
+	double Scale = m68k_OpStatsCycleScale();
+	double Total = 0;
+	double c;
+	ui5r k;
+	ui5r s;
+	ui5r d;
+	ui5r n = 0;
+	blnr First;
+	OpStatsPairR *t = (OpStatsPairR *)malloc(
+		nKinds * nKinds * sizeof(OpStatsPairR));
+
+	for (k = 0; k < nKinds; ++k) {
+		Total += OpStatsCount(kOpStatKind, k, 0, 0);
+	}
 
-/* --- SavedTasks --- */
+	fprintf(f, "{\n");
+	fprintf(f, "  \"instructions\": %.0f,\n", Total);
+	fprintf(f, "  \"kinds\": [");
+	First = trueblnr;
+	for (k = 0; k < nKinds; ++k) {
+		if (0 != (c = OpStatsCount(kOpStatKind, k, 0, 0))) {
+			fprintf(f, "%s\n    {\"kind\": \"%s\", \"count\": %.0f,"
+				" \"cycles\": %.0f, \"modes\": [",
+				First ? "" : ",", m68k_OpStatsKindName(k), c,
+				OpStatsCount(kOpStatCycles, k, 0, 0) / Scale);
+			First = falseblnr;
+			n = 0;
+			for (s = 0; s < nModes; ++s) {
+				for (d = 0; d < nModes; ++d) {
+					if (0 != (c = OpStatsCount(kOpStatModes, k, s, d))) {
+						fprintf(f, "%s\n      {\"src\": \"%s\","
+							" \"dst\": \"%s\", \"count\": %.0f}",
+							(0 == n) ? "" : ",",
+							m68k_OpStatsModeName(s),
+							m68k_OpStatsModeName(d), c);
+						++n;
+					}
+				}
+			}
+			fprintf(f, "%s]}", (0 == n) ? "" : "\n    ");
+		}
+	}
+	fprintf(f, "\n  ],\n");
+
+	n = 0;
+	if (NULL != t) {
+		for (k = 0; k < nKinds; ++k) {
+			for (s = 0; s < nKinds; ++s) {
+				if (0 != (c = OpStatsCount(kOpStatPair, k, s, 0))) {
+					t[n].Count = c;
+					t[n].Kind = k;
+					t[n].Next = s;
+					++n;
+				}
+			}
+		}
+		qsort(t, n, sizeof(OpStatsPairR), OpStatsPairCmp);
+	}
+	fprintf(f, "  \"pairs\": [");
+	for (k = 0; (k < n) && (k < kOpStatsTopPairs); ++k) {
+		fprintf(f, "%s\n    {\"kind\": \"%s\", \"next\": \"%s\","
+			" \"count\": %.0f}",
+			(0 == k) ? "" : ",",
+			m68k_OpStatsKindName(t[k].Kind),
+			m68k_OpStatsKindName(t[k].Next), t[k].Count);
+	}
+	fprintf(f, "%s]\n", (0 == n) ? "" : "\n  ");
+	fprintf(f, "}\n");
 
-LOCALPROC LeaveBackground(void)
-{
-	ReconnectKeyCodes3();
-	DisableKeyRepeat();
+	free(t);
 }
 
-LOCALPROC EnterBackground(void)
+LOCALPROC OpStatsWrite(void)
 {
-	RestoreKeyRepeat();
-	DisconnectKeyCodes3();
+	FILE *f;
 
-	ForceShowCursor();
+	if (NULL == (f = fopen(OpStatsOutPath, "w"))) {
+		MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+	} else {
+		OpStatsWriteReport(f);
+		fclose(f);
+	}
 }
+#endif
 
-LOCALPROC LeaveSpeedStopped(void)
+#if IncludeHostTime
+LOCALVAR Uint64 HostTimeLast;
+LOCALVAR int HostTimeCur = kHostTimeOther;
+LOCALVAR Uint64 HostTimeSum[kNumHostTimes];
+LOCALVAR Uint64 HostTimeMark[kNumHostTimes]; /* sums a second ago */
+LOCALVAR Uint64 HostTimeSecond[kNumHostTimes]; /* in the last second */
+LOCALVAR ui5r HostTimeSeconds = 0;
+
+LOCALVAR char *HostTimeNames[kNumHostTimes] = {
+	"other",
+	"cpu",
+	"ict",
+	"sound",
+	"screen_diff",
+	"convert",
+	"present",
+	"sony",
+	"events",
+	"wait"
+};
+
+GLOBALFUNC int HostTime_Switch(int Phase)
 {
-#if MySoundEnabled
-	MySound_Start();
-#endif
+	Uint64 Now = SDL_GetPerformanceCounter();
+	int Prev = HostTimeCur;
 
-	StartUpTimeAdjust();
+	HostTimeSum[Prev] += Now - HostTimeLast;
+	HostTimeLast = Now;
+	HostTimeCur = Phase;
+
+	return Prev;
 }
 
-LOCALPROC EnterSpeedStopped(void)
+LOCALFUNC double HostTimeMs(Uint64 t)
 {
-#if MySoundEnabled
-	MySound_Stop();
-#endif
+	return (double)t * 1000.0 / (double)SDL_GetPerformanceFrequency();
 }
 
-LOCALPROC CheckForSavedTasks(void)
+LOCALPROC HostTimeLine(int Phase, char *s)
 {
-	if (MyEvtQNeedRecover) {
-		MyEvtQNeedRecover = falseblnr;
-
-		/* attempt cleanup, MyEvtQNeedRecover may get set again */
-		MyEvtQTryRecoverFromFull();
-	}
+	sprintf(s, "%s: %.1f ms", HostTimeNames[Phase],
+		HostTimeMs(HostTimeSecond[Phase]));
+}
 
-#if EnableMouseMotion && MayFullScreen
-	if (HaveMouseMotion) {
-		MyMouseConstrain();
+#if IncludeMemStats
+#define kMemStatsMaxDevs 16
+#define kMemStatsNumATT 3 /* finds, steps and moves */
+#define kMemStatsNumCore (2 * kNumMemStatMATCs + kMemStatsNumATT \
+	+ kMemStatWalkBuckets)
+#define kMemStatsNum (kMemStatsNumCore + kMemStatsMaxDevs)
+
+LOCALVAR ui5r MemStatsLast[kMemStatsNum];
+LOCALVAR Uint64 MemStatsTotal[kMemStatsNum];
+
+LOCALVAR char *MemStatsMATCNames[kNumMemStatMATCs] = {
+	"rdB",
+	"wrB",
+	"rdW",
+	"wrW",
+	"ex"
+};
+
+LOCALFUNC ui5r MemStatsRead(int j)
+{
+	/* the j'th count, in the order of MemStatsTotal */
+	ui5r v;
+
+	if (j < kNumMemStatMATCs) {
+		v = m68k_MemStatGet(kMemStatHit, j);
+	} else if ((j -= kNumMemStatMATCs) < kNumMemStatMATCs) {
+		v = m68k_MemStatGet(kMemStatMiss, j);
+	} else if ((j -= kNumMemStatMATCs) < kMemStatsNumATT) {
+		v = m68k_MemStatGet(kMemStatFind + j, 0);
+	} else if ((j -= kMemStatsNumATT) < kMemStatWalkBuckets) {
+		v = m68k_MemStatGet(kMemStatWalk, j);
+	} else if ((j -= kMemStatWalkBuckets) < MMDV_StatNum()) {
+		v = MMDV_StatCount(j);
+	} else {
+		v = 0;
 	}
-#endif
 
-	if (RequestMacOff) {
-		RequestMacOff = falseblnr;
-		if (AnyDiskInserted()) {
-			MacMsgOverride(kStrQuitWarningTitle,
-				kStrQuitWarningMessage);
-		} else {
-			ForceMacOff = trueblnr;
-		}
-	}
+	return v;
+}
 
-	if (ForceMacOff) {
-		return;
-	}
+LOCALPROC MemStatsFold(void)
+{
+	/* the counts in the core wrap, so add up what changed */
+	int j;
+	ui5r v;
 
-	if (gTrueBackgroundFlag != gBackgroundFlag) {
-		gBackgroundFlag = gTrueBackgroundFlag;
-		if (gTrueBackgroundFlag) {
-			EnterBackground();
-		} else {
-			LeaveBackground();
-		}
+	for (j = 0; j < kMemStatsNum; ++j) {
+		v = MemStatsRead(j);
+		MemStatsTotal[j] += (v - MemStatsLast[j]) & 0xFFFFFFFF;
+		MemStatsLast[j] = v;
 	}
+}
 
-	if (CurSpeedStopped != (SpeedStopped ||
-		(gBackgroundFlag && ! RunInBackground
-#if EnableAutoSlow && 0
-			&& (QuietSubTicks >= 4092)
-#endif
-		)))
-	{
-		CurSpeedStopped = ! CurSpeedStopped;
-		if (CurSpeedStopped) {
-			EnterSpeedStopped();
-		} else {
-			LeaveSpeedStopped();
-		}
+LOCALPROC MemStatsWriteReport(FILE *f)
+{
+	int i;
+	Uint64 *t = MemStatsTotal;
+
+	fprintf(f, "  \"memory\": {\n");
+	fprintf(f, "    \"matc\": [");
+	for (i = 0; i < kNumMemStatMATCs; ++i) {
+		fprintf(f, "%s\n      {\"name\": \"%s\", \"hits\": %llu,"
+			" \"misses\": %llu}",
+			(0 == i) ? "" : ",", MemStatsMATCNames[i],
+			(unsigned long long)t[i],
+			(unsigned long long)t[kNumMemStatMATCs + i]);
 	}
-
-	if ((nullpr != SavedBriefMsg) & ! MacMsgDisplayed) {
-		MacMsgDisplayOn();
+	fprintf(f, "\n    ],\n");
+	t += 2 * kNumMemStatMATCs;
+	fprintf(f, "    \"att\": {\"finds\": %llu, \"steps\": %llu,"
+		" \"moves\": %llu, \"walks\": [",
+		(unsigned long long)t[0], (unsigned long long)t[1],
+		(unsigned long long)t[2]);
+	t += kMemStatsNumATT;
+	for (i = 0; i < kMemStatWalkBuckets; ++i) {
+		fprintf(f, "%s%llu", (0 == i) ? "" : ", ",
+			(unsigned long long)t[i]);
 	}
-
-#if EnableMagnify || VarFullScreen
-	if (0
-#if EnableMagnify
-		|| (UseMagnify != WantMagnify)
-#endif
-#if VarFullScreen
-		|| (UseFullScreen != WantFullScreen)
-#endif
-		)
-	{
-		(void) ReCreateMainWindow();
+	fprintf(f, "]},\n");
+	t += kMemStatWalkBuckets;
+	fprintf(f, "    \"devices\": [");
+	for (i = 0; (i < MMDV_StatNum()) && (i < kMemStatsMaxDevs); ++i) {
+		fprintf(f, "%s\n      {\"name\": \"%s\", \"accesses\": %llu}",
+			(0 == i) ? "" : ",", MMDV_StatName(i),
+			(unsigned long long)t[i]);
 	}
+	fprintf(f, "\n    ]\n");
+	fprintf(f, "  },\n");
+}
 #endif
 
-#if MayFullScreen
-	if (GrabMachine != (
-#if VarFullScreen
-		UseFullScreen &&
+LOCALPROC HostTimeWrite(void)
+{
+	FILE *f;
+	int i;
+	char TempPath[1024];
+
+	/* write then rename, so a reader never sees half a file */
+	sprintf(TempPath, "%.1000s.tmp", HostTimeOutPath);
+	if (NULL == (f = fopen(TempPath, "w"))) {
+		MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+		HostTimeOutPath = NULL;
+	} else {
+		fprintf(f, "{\n");
+		fprintf(f, "  \"seconds\": %lu,\n",
+			(unsigned long)HostTimeSeconds);
+#if IncludeMemStats
+		MemStatsWriteReport(f);
 #endif
-		! (gTrueBackgroundFlag || CurSpeedStopped)))
-	{
-		GrabMachine = ! GrabMachine;
-		if (GrabMachine) {
-			GrabTheMachine();
-		} else {
-			UngrabMachine();
+		fprintf(f, "  \"phases\": [");
+		for (i = 0; i < kNumHostTimes; ++i) {
+			fprintf(f, "%s\n    {\"name\": \"%s\", \"total_ms\": %.3f,"
+				" \"last_second_ms\": %.3f}",
+				(0 == i) ? "" : ",", HostTimeNames[i],
+				HostTimeMs(HostTimeSum[i]),
+				HostTimeMs(HostTimeSecond[i]));
 		}
-	}
-#endif
-
-	if (NeedWholeScreenDraw) {
-		NeedWholeScreenDraw = falseblnr;
-		ScreenChangedAll();
-	}
-
-	MyDrawChangesAndClear();
-
-	if (HaveCursorHidden != (WantCursorHidden
-		&& ! (gTrueBackgroundFlag || CurSpeedStopped)))
-	{
-		HaveCursorHidden = ! HaveCursorHidden;
-		(void) SDL_ShowCursor(
-			HaveCursorHidden ? SDL_DISABLE : SDL_ENABLE);
+		fprintf(f, "\n  ]\n");
+		fprintf(f, "}\n");
+		fclose(f);
+		(void) rename(TempPath, HostTimeOutPath);
 	}
 }
 
-/* --- command line parsing --- */
-
-LOCALFUNC blnr ScanCommandLine(void)
+LOCALPROC HostTimeSecondNotify(void)
 {
-	char *pa;
-	int i = 1;
+	int i;
 
-label_retry:
-	if (i < my_argc) {
-		pa = my_argv[i++];
-		if ('-' == pa[0]) {
-			if ((0 == strcmp(pa, "--rom"))
-				|| (0 == strcmp(pa, "-r")))
-			{
-				if (i < my_argc) {
-					rom_path = my_argv[i++];
-					goto label_retry;
-				}
-			} else
-			{
-				MacMsg(kStrBadArgTitle, kStrBadArgMessage, falseblnr);
-			}
-		} else {
-			(void) Sony_Insert1(pa, falseblnr);
-			goto label_retry;
-		}
+	(void) HostTime_Switch(HostTimeCur);
+	for (i = 0; i < kNumHostTimes; ++i) {
+		HostTimeSecond[i] = HostTimeSum[i] - HostTimeMark[i];
+		HostTimeMark[i] = HostTimeSum[i];
 	}
+	++HostTimeSeconds;
+#if IncludeMemStats
+	MemStatsFold();
+#endif
 
-	return trueblnr;
-}
-
-/* --- main program flow --- */
-
-LOCALVAR ui5b OnTrueTime = 0;
-
-GLOBALFUNC blnr ExtraTimeNotOver(void)
-{
-	UpdateTrueEmulatedTime();
-	return TrueEmulatedTime == OnTrueTime;
+	if ((NULL != HostTimeOutPath) && (0 != HostTimeEvery)
+		&& (0 == HostTimeSeconds % HostTimeEvery))
+	{
+		HostTimeWrite();
+	}
+#if UseControlKeys
+	if (kCntrlMsgHostTime == ControlMessage) {
+		/* keep the page up to date */
+		NeedWholeScreenDraw = trueblnr;
+	}
+#endif
 }
-
-/* --- platform independent code can be thought of as going here --- */
-
-#include "PROGMAIN.h"
+#endif
 
 LOCALPROC RunEmulatedTicksToTrueTime(void)
 {
 	si3b n = OnTrueTime - CurEmulatedTime;
 
+#if IncludeSaveState
+	if (WantLoadState) {
+		/* once the emulated machine has been set up */
+		WantLoadState = falseblnr;
+		(void) LoadStateNow();
+	}
+#endif
+
+#if IncludeForkServer
+	if ((0 != ForkCount) && ((si5b)(CurEmulatedTime - ForkAtTime) >= 0))
+	{
+		ForkServer();
+		if (ForceMacOff) {
+			return;
+		}
+	}
+#endif
+
 	if (n > 0) {
 		if (CheckDateTime()) {
 #if MySoundEnabled
 			MySound_SecondNotify();
+#endif
+#if IncludeHostTime
+			HostTimeSecondNotify();
 #endif
 		}
 
@@ -2041,9 +6420,35 @@ LOCALPROC RunEmulatedTicksToTrueTime(void)
 
 LOCALPROC RunOnEndOfSixtieth(void)
 {
+#if EnableIdleSkip
+	SDL_Event event;
+#endif
+
+#if IncludeHostTime
+	(void) HostTime_Switch(kHostTimeWait);
+#endif
 	while (ExtraTimeNotOver()) {
-		(void) SDL_Delay(NextIntTime - LastTime);
+#if EnableIdleSkip
+		if (GuestIdle) {
+			/* waiting for input, so take it as soon as it comes */
+			if (SDL_WaitEventTimeout(&event, NextIntTime - LastTime)) {
+#if IncludeHostTime
+				(void) HostTime_Switch(kHostTimeEvents);
+#endif
+				HandleTheEvent(&event);
+#if IncludeHostTime
+				(void) HostTime_Switch(kHostTimeWait);
+#endif
+			}
+		} else
+#endif
+		{
+			(void) SDL_Delay(NextIntTime - LastTime);
+		}
 	}
+#if IncludeHostTime
+	(void) HostTime_Switch(kHostTimeOther);
+#endif
 
 	OnTrueTime = TrueEmulatedTime;
 	RunEmulatedTicksToTrueTime();
@@ -2053,9 +6458,18 @@ LOCALPROC WaitForTheNextEvent(void)
 {
 	SDL_Event event;
 
+#if IncludeHostTime
+	(void) HostTime_Switch(kHostTimeWait);
+#endif
 	if (SDL_WaitEvent(&event)) {
+#if IncludeHostTime
+		(void) HostTime_Switch(kHostTimeEvents);
+#endif
 		HandleTheEvent(&event);
 	}
+#if IncludeHostTime
+	(void) HostTime_Switch(kHostTimeOther);
+#endif
 }
 
 LOCALPROC CheckForSystemEvents(void)
@@ -2063,13 +6477,49 @@ LOCALPROC CheckForSystemEvents(void)
 	SDL_Event event;
 	int i = 10;
 
+#if IncludeHostTime
+	(void) HostTime_Switch(kHostTimeEvents);
+#endif
 	while ((--i >= 0) && SDL_PollEvent(&event)) {
 		HandleTheEvent(&event);
 	}
+#if IncludeHostTime
+	(void) HostTime_Switch(kHostTimeOther);
+#endif
 }
 
 LOCALPROC MainEventLoop(void)
 {
+#if IncludeProfile
+	if (ProfileWanted()) {
+		Profile_Start(ProfileEvery);
+		ProfileStarted = trueblnr;
+	}
+#endif
+#if IncludeOpStats
+	if (NULL != OpStatsOutPath) {
+		m68k_OpStatsSet(trueblnr);
+	}
+#endif
+#if IncludeHostTime
+	HostTimeLast = SDL_GetPerformanceCounter();
+#endif
+#if IncludeCoverage
+	if ((NULL != CovOutPath) && ! CovStart()) {
+		CovOutPath = NULL;
+		MacMsg(kStrOutOfMemTitle, kStrOutOfMemMessage, falseblnr);
+	}
+#endif
+#if IncludeTrace
+	if ((NULL != TraceOutPath) && ! TraceStart()) {
+		TraceStop();
+		MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+	}
+#endif
+#if IncludeWatch
+	ControlStart();
+#endif
+
 	for (; ; ) {
 		CheckForSystemEvents();
 		CheckForSavedTasks();
@@ -2077,6 +6527,24 @@ LOCALPROC MainEventLoop(void)
 			return;
 		}
 
+#if IncludeForkServer
+		if (ForkCtlFd >= 0) {
+			ForkRunQuantum();
+		} else
+#endif
+#if IncludeCPUTest
+		if (CPUTestWanted()) {
+			CPUTestRun();
+		} else
+#endif
+#if IncludeBench
+		if (MicroBenchKind >= 0) {
+			MicroBenchRun();
+		} else
+		if (0 != BenchTicks) {
+			BenchRun();
+		} else
+#endif
 		if (CurSpeedStopped) {
 			WaitForTheNextEvent();
 		} else {
@@ -2150,6 +6618,9 @@ LOCALPROC UnallocMyMemory(void)
 LOCALFUNC blnr InitOSGLU(void)
 {
 	if (AllocMyMemory())
+#if IncludeSonyWriteBack
+	if (WbInit())
+#endif
 #if dbglog_HAVE
 	if (dbglog_open())
 #endif
@@ -2175,6 +6646,41 @@ LOCALPROC UnInitOSGLU(void)
 		MacMsgDisplayOff();
 	}
 
+#if IncludeProfile
+	if (ProfileStarted) {
+		ProfileWrite();
+	}
+#endif
+#if IncludeOpStats
+	if (NULL != OpStatsOutPath) {
+		m68k_OpStatsSet(falseblnr);
+		OpStatsWrite();
+	}
+#endif
+#if IncludeHostTime
+	if (NULL != HostTimeOutPath) {
+		(void) HostTime_Switch(HostTimeCur);
+#if IncludeMemStats
+		MemStatsFold();
+#endif
+		HostTimeWrite();
+	}
+#endif
+#if IncludeTrace
+	TraceStop();
+#endif
+#if IncludeCoverage
+	if (NULL != CovOutPath) {
+		CovWrite();
+	}
+#endif
+#if IncludeWatch
+	if (ControlFd >= 0) {
+		(void) close(ControlFd);
+		ControlFd = -1;
+	}
+#endif
+
 	RestoreKeyRepeat();
 #if MayFullScreen
 	UngrabMachine();
@@ -2189,6 +6695,12 @@ LOCALPROC UnInitOSGLU(void)
 	UnInitPbufs();
 #endif
 	UnInitDrives();
+#if IncludeSonyWriteBack
+	WbUnInit();
+#endif
+#if IncludeHostFS
+	HostFS_UnInit();
+#endif
 
 	ForceShowCursor();
 
@@ -2214,5 +6726,9 @@ int main(int argc, char **argv)
 	}
 	UnInitOSGLU();
 
+#if IncludeForkServer
+	return ForkExitStatus;
+#else
 	return 0;
+#endif
 }
@@ -37,6 +37,9 @@
 EXPORTPROC WarnMsgCorruptedROM(void);
 EXPORTPROC WarnMsgUnsupportedROM(void);
 EXPORTPROC WarnMsgAbnormal(void);
+#if EnableTrapAccel && WantTrapAccelVerify
+EXPORTPROC WarnMsgTrapAccel(void);
+#endif
 
 #if dbglog_HAVE
 EXPORTPROC dbglog_writeCStr(char *s);
@@ -126,6 +129,14 @@ EXPORTVAR(ui5b, vSonyInsertedMask)
 #define vSonyIsInserted(Drive_No) \
 	((vSonyInsertedMask & ((ui5b)1 << (Drive_No))) != 0)
 
+#if IncludeSCSIDisks
+EXPORTVAR(ui5b, vSCSIDriveMask)
+	/* disk images attached to the SCSI bus, not the Sony driver */
+
+#define vSonyIsSCSI(Drive_No) \
+	((vSCSIDriveMask & ((ui5b)1 << (Drive_No))) != 0)
+#endif
+
 EXPORTFUNC tMacErr vSonyTransfer(blnr IsWrite, ui3p Buffer,
 	tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count,
 	ui5r *Sony_ActCount);
@@ -158,6 +169,43 @@ EXPORTFUNC tMacErr HTCEexport(tPbuf i);
 EXPORTFUNC tMacErr HTCEimport(tPbuf *r);
 #endif
 
+#if IncludeHostFS
+
+#define kHostFSRootID 2
+
+/* layout of the information returned for a file or directory */
+#define kHostFSInfo_Name 0 /* Str31 */
+#define kHostFSInfo_Flags 32
+#define kHostFSInfo_Parent 36
+#define kHostFSInfo_NodeID 40
+#define kHostFSInfo_DataLen 44 /* valence for a directory */
+#define kHostFSInfo_RsrcLen 48
+#define kHostFSInfo_CrDat 52
+#define kHostFSInfo_MdDat 56
+#define kHostFSInfo_FInfo 60 /* FInfo and FXInfo */
+#define kHostFSInfoSz 92
+
+#define kHostFSFInfoSz 32
+
+#define kHostFSFlagDir 0x0001
+#define kHostFSFlagLocked 0x0002
+
+EXPORTFUNC blnr HostFS_Present(void);
+EXPORTFUNC blnr HostFS_IsWritable(void);
+EXPORTFUNC tMacErr HostFS_Lookup(ui5r DirID, ui3p Name, ui5r *NodeID);
+EXPORTFUNC tMacErr HostFS_GetInfo(ui5r DirID, ui4r Index,
+	ui5r *NodeID, ui3p Info);
+EXPORTFUNC tMacErr HostFS_SetInfo(ui5r NodeID, ui3p FInfo);
+EXPORTFUNC tMacErr HostFS_Transfer(blnr IsWrite, ui3p Buffer,
+	ui5r NodeID, blnr IsRsrc, ui5r Start, ui5r Count,
+	ui5r *ActCount);
+EXPORTFUNC tMacErr HostFS_SetEOF(ui5r NodeID, blnr IsRsrc, ui5r Size);
+EXPORTFUNC tMacErr HostFS_Create(ui5r DirID, ui3p Name, blnr IsDir,
+	ui5r *NodeID);
+EXPORTFUNC tMacErr HostFS_Delete(ui5r NodeID);
+
+#endif
+
 EXPORTVAR(ui5b, CurMacDateInSeconds)
 EXPORTVAR(ui5b, CurMacLatitude)
 EXPORTVAR(ui5b, CurMacLongitude)
@@ -226,6 +274,56 @@ EXPORTVAR(ui5r, QuietSubTicks)
 #define QuietEnds()
 #endif
 
+#if EnableTrapAccel
+#define kTrapAccelOff 0
+#define kTrapAccelOn 1
+#define kTrapAccelVerify 2
+
+EXPORTFUNC ui3r TrapAccelWantMode(ui4r Trap);
+	/* how the user wants Trap done, such as 0xA02E (_BlockMove) */
+#endif
+
+#if EnableIdleSkip
+EXPORTVAR(blnr, GuestIdle)
+	/* emulated machine was waiting for events in the last tick */
+#endif
+
+#if IncludeHostTime
+enum {
+	kHostTimeOther, /* anything not below */
+	kHostTimeCPU,
+	kHostTimeICT, /* scheduled device tasks */
+	kHostTimeSound,
+	kHostTimeScreenDiff, /* finding what changed in the frame */
+	kHostTimeConvert, /* to host pixels */
+	kHostTimePresent,
+	kHostTimeSony,
+	kHostTimeEvents,
+	kHostTimeWait, /* sleeping until the next tick */
+
+	kNumHostTimes
+};
+
+EXPORTFUNC int HostTime_Switch(int Phase);
+	/*
+		charge the host time since the last switch to the
+		current phase, and make Phase current. returns the
+		phase that was current, to switch back to.
+	*/
+#endif
+
+#if IncludeTrace
+EXPORTVAR(blnr, TraceOn)
+EXPORTPROC Trace_Put(ui5r Time, ui5r Info, ui5r Addr, ui5r Data,
+	ui5r PC);
+	/*
+		add a record, as described in TRACE.h, to the ring of
+		the calling thread. dropped if the ring is full.
+	*/
+EXPORTFUNC ui5r Trace_NameId(char *s);
+	/* id for a string that lasts, giving its name the first time */
+#endif
+
 #if 3 == kLn2SoundSampSz
 #define trSoundSamp ui3r
 #define tbSoundSamp ui3b
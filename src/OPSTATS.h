@@ -0,0 +1,41 @@
+/*
+	OPSTATS.h
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+#ifdef OPSTATS_H
+#error "header already included"
+#else
+#define OPSTATS_H
+#endif
+
+/*
+	counts of instructions run, by kind and addressing modes,
+	kept in MINEM68K.c
+*/
+
+EXPORTPROC m68k_OpStatsSet(blnr On);
+EXPORTFUNC ui5r m68k_OpStatsNumKinds(void);
+EXPORTFUNC ui5r m68k_OpStatsNumModes(void);
+EXPORTFUNC char *m68k_OpStatsKindName(ui5r k);
+EXPORTFUNC char *m68k_OpStatsModeName(ui5r m);
+EXPORTFUNC ui5r m68k_OpStatsCycleScale(void);
+
+#define kOpStatKind 0 /* a is the kind */
+#define kOpStatCycles 1 /* scaled cycles, a is the kind */
+#define kOpStatModes 2 /* a is the kind, b and c source and dest modes */
+#define kOpStatPair 3 /* a is the kind, b the kind run next */
+EXPORTFUNC ui5r m68k_OpStatsGet(int What, ui5r a, ui5r b, ui5r c,
+	ui5r *Hi);
+	/* low 32 bits of a count, and the high in *Hi */
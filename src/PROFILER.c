@@ -0,0 +1,580 @@
+/*
+	PROFILER.c
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	PROFILEr of the emulated program
+
+	A scheduled task takes the PC every so many cycles, counting
+	it in a fixed size table, along with the chain of return
+	addresses found by following A6 through the LINK frames,
+	which is only a guess at the calls, since not every routine
+	makes a frame. The A-line traps run are counted as well.
+
+	For the report, a ROM address is put down to the trap whose
+	routine, as found in the trap dispatch tables, starts nearest
+	below it.
+*/
+
+#ifndef AllFiles
+#include "SYSDEPNS.h"
+#include "MYOSGLUE.h"
+#include "ENDIANAC.h"
+#include "EMCONFIG.h"
+#include "GLOBGLUE.h"
+#include "MINEM68K.h"
+#endif
+
+#include "PROFILER.h"
+
+#if IncludeProfile
+
+#define kProfPCSlots 0x4000
+#define kProfStackSlots 0x1000
+#define kProfTraps 0x1000
+
+struct ProfStackR {
+	ui5r Count;
+	int Depth;
+	CPTR PCs[kProfMaxDepth];
+};
+typedef struct ProfStackR ProfStackR;
+
+LOCALINSTVAR ui5r ProfileEvery = 0; /* 0 if not profiling */
+LOCALINSTVAR ui5r ProfileSamples = 0;
+LOCALINSTVAR ui5r ProfileLost = 0;
+LOCALINSTVAR CPTR ProfilePCs[kProfPCSlots];
+LOCALINSTVAR ui5r ProfilePCCounts[kProfPCSlots];
+LOCALINSTVAR ProfStackR ProfileStacks[kProfStackSlots];
+LOCALINSTVAR ui5r ProfileTrapCounts[kProfTraps];
+
+GLOBALPROC Profile_Start(ui5r Every)
+{
+	ProfileEvery = (0 == Every) ? 1 : Every;
+}
+
+GLOBALPROC Profile_TickNtfy(void)
+{
+	/* start the task again, after a reset or loading a state */
+	if ((0 != ProfileEvery)
+		&& (0 == (ICTactive & (1 << kICT_Profile))))
+	{
+		ICT_add(kICT_Profile, ProfileEvery * kCycleScale);
+	}
+}
+
+LOCALFUNC blnr ProfGetLong(CPTR addr, ui5r *v)
+{
+	/* only plain memory, never a device */
+	ATTep p = FindATTel(addr);
+
+	if ((0 != (addr & 1))
+		|| (0 == (p->Access & kATTA_readreadymask))
+		|| (((addr + 3) & p->usemask) < (addr & p->usemask)))
+	{
+		return falseblnr;
+	}
+	*v = do_get_mem_long(p->usebase + (addr & p->usemask));
+	return trueblnr;
+}
+
+LOCALPROC ProfileCountPC(CPTR pc)
+{
+	ui5r i = ((pc >> 1) * 0x9E3779B1) & 0xFFFFFFFF;
+	ui5r n;
+
+	for (n = kProfPCSlots; n != 0; --n) {
+		i &= kProfPCSlots - 1;
+		if (0 == ProfilePCCounts[i]) {
+			ProfilePCs[i] = pc;
+			ProfilePCCounts[i] = 1;
+			return;
+		} else if (pc == ProfilePCs[i]) {
+			++ProfilePCCounts[i];
+			return;
+		}
+		++i;
+	}
+	++ProfileLost;
+}
+
+LOCALPROC ProfileCountStack(CPTR *PCs, int Depth)
+{
+	ProfStackR *s;
+	ui5r h = 2166136261UL;
+	ui5r n;
+	int j;
+
+	for (j = 0; j < Depth; ++j) {
+		h = ((h ^ PCs[j]) * 16777619UL) & 0xFFFFFFFF;
+	}
+	for (n = kProfStackSlots; n != 0; --n) {
+		h &= kProfStackSlots - 1;
+		s = &ProfileStacks[h];
+		if (0 == s->Count) {
+			s->Count = 1;
+			s->Depth = Depth;
+			for (j = 0; j < Depth; ++j) {
+				s->PCs[j] = PCs[j];
+			}
+			return;
+		}
+		if (Depth == s->Depth) {
+			for (j = 0; j < Depth; ++j) {
+				if (PCs[j] != s->PCs[j]) {
+					break;
+				}
+			}
+			if (j == Depth) {
+				++s->Count;
+				return;
+			}
+		}
+		++h;
+	}
+	++ProfileLost;
+}
+
+GLOBALPROC Profile_Task(void)
+{
+	CPTR PCs[kProfMaxDepth];
+	int Depth = 1;
+	ui5r fp = m68k_SampleAReg(6);
+	ui5r next;
+	ui5r ret;
+
+	if (0 == ProfileEvery) {
+		/* from a state saved while profiling */
+		return;
+	}
+
+	PCs[0] = m68k_SamplePC() & 0x00FFFFFF;
+	while ((Depth < kProfMaxDepth)
+		&& ProfGetLong(fp, &next)
+		&& ProfGetLong(fp + 4, &ret)
+		&& (next > fp) && (next - fp < 0x10000)
+		&& (0 == (ret & 1)))
+	{
+		PCs[Depth++] = ret & 0x00FFFFFF;
+		fp = next;
+	}
+
+	++ProfileSamples;
+	ProfileCountPC(PCs[0]);
+	ProfileCountStack(PCs, Depth);
+
+	ICT_add(kICT_Profile, ProfileEvery * kCycleScale);
+}
+
+GLOBALFUNC ui4r Profile_TrapOf(ui4r opcode)
+{
+	return (0 != (opcode & 0x0800))
+		? (opcode & 0xFBFF) /* not the auto pop bit */
+		: (opcode & 0xF8FF); /* not the flag bits */
+}
+
+GLOBALPROC Profile_TrapNtfy(ui4r opcode)
+{
+	if (0 != ProfileEvery) {
+		++ProfileTrapCounts[Profile_TrapOf(opcode) & (kProfTraps - 1)];
+	}
+}
+
+GLOBALFUNC ui5r Profile_Samples(void)
+{
+	return ProfileSamples;
+}
+
+GLOBALFUNC ui5r Profile_Lost(void)
+{
+	return ProfileLost;
+}
+
+GLOBALFUNC ui5r Profile_NumPCSlots(void)
+{
+	return kProfPCSlots;
+}
+
+GLOBALFUNC ui5r Profile_GetPC(ui5r i, ui5r *pc)
+{
+	*pc = ProfilePCs[i];
+	return ProfilePCCounts[i];
+}
+
+GLOBALFUNC ui5r Profile_NumStackSlots(void)
+{
+	return kProfStackSlots;
+}
+
+GLOBALFUNC ui5r Profile_GetStack(ui5r i, ui5r *pcs, int *depth)
+{
+	ProfStackR *s = &ProfileStacks[i];
+	int j;
+
+	for (j = 0; j < s->Depth; ++j) {
+		pcs[j] = s->PCs[j];
+	}
+	*depth = s->Depth;
+	return s->Count;
+}
+
+GLOBALFUNC ui5r Profile_TrapCount(ui4r trap)
+{
+	return ProfileTrapCounts[trap & (kProfTraps - 1)];
+}
+
+GLOBALFUNC int Profile_Where(ui5r pc, ui5r *offset)
+{
+	if ((pc & 0x00F00000) == kROM_Base) {
+		*offset = pc & (kROM_Size - 1);
+		return kProfWhereROM;
+	} else if (pc < kRAM_Size) {
+		*offset = pc;
+		return kProfWhereRAM;
+	} else {
+		*offset = pc;
+		return kProfWhereOther;
+	}
+}
+
+/* trap dispatch tables, as on the Mac Plus */
+#define kProfOSTrapTab 0x0400
+#define kProfOSTraps 0x100
+#define kProfTBTrapTab 0x0E00
+#define kProfTBTraps 0x200
+
+LOCALINSTVAR ui5r ProfileRoutines[kProfOSTraps + kProfTBTraps];
+	/* ROM offset of each trap's routine, or (ui5r) -1 */
+
+GLOBALPROC Profile_FindRoutines(void)
+{
+	ui5r i;
+	ui5r a;
+
+	for (i = 0; i < kProfOSTraps + kProfTBTraps; ++i) {
+		a = get_ram_long((i < kProfOSTraps)
+			? kProfOSTrapTab + 4 * i
+			: kProfTBTrapTab + 4 * (i - kProfOSTraps));
+		ProfileRoutines[i] = ((a & 0x00F00000) == kROM_Base)
+			? (a & (kROM_Size - 1)) : (ui5r) -1;
+	}
+}
+
+GLOBALFUNC blnr Profile_RomTrap(ui5r pc, ui4r *trap, ui5r *offset)
+{
+	ui5r x = pc & (kROM_Size - 1);
+	ui5r best = (ui5r) -1;
+	ui5r a;
+	ui5r i;
+
+	if ((pc & 0x00F00000) != kROM_Base) {
+		return falseblnr;
+	}
+	for (i = 0; i < kProfOSTraps + kProfTBTraps; ++i) {
+		a = ProfileRoutines[i];
+		if ((a <= x) && ((best == (ui5r) -1) || (a > best))) {
+			best = a;
+			*trap = (i < kProfOSTraps)
+				? (0xA000 | i) : (0xA800 | (i - kProfOSTraps));
+		}
+	}
+	if (best == (ui5r) -1) {
+		return falseblnr;
+	}
+	*offset = x - best;
+	return trueblnr;
+}
+
+struct ProfTrapNameR {
+	ui4r Trap;
+	char *Name;
+};
+typedef struct ProfTrapNameR ProfTrapNameR;
+
+LOCALVAR const ProfTrapNameR ProfTrapNames[] = {
+	{ 0xA000, "_Open" },
+	{ 0xA001, "_Close" },
+	{ 0xA002, "_Read" },
+	{ 0xA003, "_Write" },
+	{ 0xA004, "_Control" },
+	{ 0xA005, "_Status" },
+	{ 0xA006, "_KillIO" },
+	{ 0xA007, "_GetVolInfo" },
+	{ 0xA008, "_Create" },
+	{ 0xA009, "_Delete" },
+	{ 0xA00A, "_OpenRF" },
+	{ 0xA00B, "_Rename" },
+	{ 0xA00C, "_GetFileInfo" },
+	{ 0xA00D, "_SetFileInfo" },
+	{ 0xA00E, "_UnmountVol" },
+	{ 0xA00F, "_MountVol" },
+	{ 0xA010, "_Allocate" },
+	{ 0xA011, "_GetEOF" },
+	{ 0xA012, "_SetEOF" },
+	{ 0xA013, "_FlushVol" },
+	{ 0xA014, "_GetVol" },
+	{ 0xA015, "_SetVol" },
+	{ 0xA016, "_InitQueue" },
+	{ 0xA017, "_Eject" },
+	{ 0xA018, "_GetFPos" },
+	{ 0xA019, "_InitZone" },
+	{ 0xA01A, "_GetZone" },
+	{ 0xA01B, "_SetZone" },
+	{ 0xA01C, "_FreeMem" },
+	{ 0xA01D, "_MaxMem" },
+	{ 0xA01E, "_NewPtr" },
+	{ 0xA01F, "_DisposPtr" },
+	{ 0xA020, "_SetPtrSize" },
+	{ 0xA021, "_GetPtrSize" },
+	{ 0xA022, "_NewHandle" },
+	{ 0xA023, "_DisposHandle" },
+	{ 0xA024, "_SetHandleSize" },
+	{ 0xA025, "_GetHandleSize" },
+	{ 0xA026, "_HandleZone" },
+	{ 0xA027, "_ReallocHandle" },
+	{ 0xA028, "_RecoverHandle" },
+	{ 0xA029, "_HLock" },
+	{ 0xA02A, "_HUnlock" },
+	{ 0xA02B, "_EmptyHandle" },
+	{ 0xA02C, "_InitApplZone" },
+	{ 0xA02D, "_SetApplLimit" },
+	{ 0xA02E, "_BlockMove" },
+	{ 0xA02F, "_PostEvent" },
+	{ 0xA030, "_OSEventAvail" },
+	{ 0xA031, "_GetOSEvent" },
+	{ 0xA032, "_FlushEvents" },
+	{ 0xA033, "_VInstall" },
+	{ 0xA034, "_VRemove" },
+	{ 0xA035, "_OffLine" },
+	{ 0xA036, "_MoreMasters" },
+	{ 0xA038, "_WriteParam" },
+	{ 0xA039, "_ReadDateTime" },
+	{ 0xA03A, "_SetDateTime" },
+	{ 0xA03B, "_Delay" },
+	{ 0xA03C, "_CmpString" },
+	{ 0xA03D, "_DrvrInstall" },
+	{ 0xA03E, "_DrvrRemove" },
+	{ 0xA03F, "_InitUtil" },
+	{ 0xA040, "_ResrvMem" },
+	{ 0xA041, "_SetFilLock" },
+	{ 0xA042, "_RstFilLock" },
+	{ 0xA043, "_SetFilType" },
+	{ 0xA044, "_SetFPos" },
+	{ 0xA045, "_FlushFile" },
+	{ 0xA046, "_GetTrapAddress" },
+	{ 0xA047, "_SetTrapAddress" },
+	{ 0xA048, "_PtrZone" },
+	{ 0xA049, "_HPurge" },
+	{ 0xA04A, "_HNoPurge" },
+	{ 0xA04B, "_SetGrowZone" },
+	{ 0xA04C, "_CompactMem" },
+	{ 0xA04D, "_PurgeMem" },
+	{ 0xA04E, "_AddDrive" },
+	{ 0xA04F, "_RDrvrInstall" },
+	{ 0xA050, "_RelString" },
+	{ 0xA054, "_UprString" },
+	{ 0xA055, "_StripAddress" },
+	{ 0xA060, "_FSDispatch" },
+	{ 0xA061, "_MaxBlock" },
+	{ 0xA062, "_PurgeSpace" },
+	{ 0xA063, "_MaxApplZone" },
+	{ 0xA064, "_MoveHHi" },
+	{ 0xA065, "_StackSpace" },
+	{ 0xA066, "_NewEmptyHandle" },
+	{ 0xA067, "_HSetRBit" },
+	{ 0xA068, "_HClrRBit" },
+	{ 0xA069, "_HGetState" },
+	{ 0xA06A, "_HSetState" },
+	{ 0xA850, "_InitCursor" },
+	{ 0xA851, "_SetCursor" },
+	{ 0xA852, "_HideCursor" },
+	{ 0xA853, "_ShowCursor" },
+	{ 0xA855, "_ShieldCursor" },
+	{ 0xA856, "_ObscureCursor" },
+	{ 0xA860, "_WaitNextEvent" },
+	{ 0xA861, "_Random" },
+	{ 0xA862, "_ForeColor" },
+	{ 0xA863, "_BackColor" },
+	{ 0xA864, "_ColorBit" },
+	{ 0xA865, "_GetPixel" },
+	{ 0xA866, "_StuffHex" },
+	{ 0xA867, "_LongMul" },
+	{ 0xA868, "_FixMul" },
+	{ 0xA869, "_FixRatio" },
+	{ 0xA86A, "_HiWord" },
+	{ 0xA86B, "_LoWord" },
+	{ 0xA86C, "_FixRound" },
+	{ 0xA86D, "_InitPort" },
+	{ 0xA86E, "_InitGraf" },
+	{ 0xA86F, "_OpenPort" },
+	{ 0xA870, "_LocalToGlobal" },
+	{ 0xA871, "_GlobalToLocal" },
+	{ 0xA872, "_GrafDevice" },
+	{ 0xA873, "_SetPort" },
+	{ 0xA874, "_GetPort" },
+	{ 0xA875, "_SetPBits" },
+	{ 0xA876, "_PortSize" },
+	{ 0xA877, "_MovePortTo" },
+	{ 0xA878, "_SetOrigin" },
+	{ 0xA879, "_SetClip" },
+	{ 0xA87A, "_GetClip" },
+	{ 0xA87B, "_ClipRect" },
+	{ 0xA87C, "_BackPat" },
+	{ 0xA87D, "_ClosePort" },
+	{ 0xA87E, "_AddPt" },
+	{ 0xA87F, "_SubPt" },
+	{ 0xA880, "_SetPt" },
+	{ 0xA881, "_EqualPt" },
+	{ 0xA882, "_StdText" },
+	{ 0xA883, "_DrawChar" },
+	{ 0xA884, "_DrawString" },
+	{ 0xA885, "_DrawText" },
+	{ 0xA886, "_TextWidth" },
+	{ 0xA887, "_TextFont" },
+	{ 0xA888, "_TextFace" },
+	{ 0xA889, "_TextMode" },
+	{ 0xA88A, "_TextSize" },
+	{ 0xA88B, "_GetFontInfo" },
+	{ 0xA88C, "_StringWidth" },
+	{ 0xA88D, "_CharWidth" },
+	{ 0xA88E, "_SpaceExtra" },
+	{ 0xA890, "_StdLine" },
+	{ 0xA891, "_LineTo" },
+	{ 0xA892, "_Line" },
+	{ 0xA893, "_MoveTo" },
+	{ 0xA894, "_Move" },
+	{ 0xA895, "_Shutdown" },
+	{ 0xA896, "_HidePen" },
+	{ 0xA897, "_ShowPen" },
+	{ 0xA898, "_GetPenState" },
+	{ 0xA899, "_SetPenState" },
+	{ 0xA89A, "_GetPen" },
+	{ 0xA89B, "_PenSize" },
+	{ 0xA89C, "_PenMode" },
+	{ 0xA89D, "_PenPat" },
+	{ 0xA89E, "_PenNormal" },
+	{ 0xA8A0, "_StdRect" },
+	{ 0xA8A1, "_FrameRect" },
+	{ 0xA8A2, "_PaintRect" },
+	{ 0xA8A3, "_EraseRect" },
+	{ 0xA8A4, "_InverRect" },
+	{ 0xA8A5, "_FillRect" },
+	{ 0xA8A6, "_EqualRect" },
+	{ 0xA8A7, "_SetRect" },
+	{ 0xA8A8, "_OffsetRect" },
+	{ 0xA8A9, "_InsetRect" },
+	{ 0xA8AA, "_SectRect" },
+	{ 0xA8AB, "_UnionRect" },
+	{ 0xA8AC, "_Pt2Rect" },
+	{ 0xA8AD, "_PtInRect" },
+	{ 0xA8AE, "_EmptyRect" },
+	{ 0xA8D8, "_NewRgn" },
+	{ 0xA8D9, "_DisposRgn" },
+	{ 0xA8DA, "_OpenRgn" },
+	{ 0xA8DB, "_CloseRgn" },
+	{ 0xA8DC, "_CopyRgn" },
+	{ 0xA8DD, "_SetEmptyRgn" },
+	{ 0xA8DE, "_SetRecRgn" },
+	{ 0xA8DF, "_RectRgn" },
+	{ 0xA8E0, "_OfsetRgn" },
+	{ 0xA8E1, "_InsetRgn" },
+	{ 0xA8E2, "_EmptyRgn" },
+	{ 0xA8E3, "_EqualRgn" },
+	{ 0xA8E4, "_SectRgn" },
+	{ 0xA8E5, "_UnionRgn" },
+	{ 0xA8E6, "_DiffRgn" },
+	{ 0xA8E7, "_XorRgn" },
+	{ 0xA8E8, "_PtInRgn" },
+	{ 0xA8E9, "_RectInRgn" },
+	{ 0xA8EA, "_SetStdProcs" },
+	{ 0xA8EB, "_StdBits" },
+	{ 0xA8EC, "_CopyBits" },
+	{ 0xA8ED, "_StdTxMeas" },
+	{ 0xA8EE, "_StdGetPic" },
+	{ 0xA8EF, "_ScrollRect" },
+	{ 0xA8F0, "_StdPutPic" },
+	{ 0xA8F1, "_StdComment" },
+	{ 0xA8F2, "_PicComment" },
+	{ 0xA8F3, "_OpenPicture" },
+	{ 0xA8F4, "_ClosePicture" },
+	{ 0xA8F5, "_KillPicture" },
+	{ 0xA8F6, "_DrawPicture" },
+	{ 0xA910, "_GetWMgrPort" },
+	{ 0xA911, "_CheckUpDate" },
+	{ 0xA912, "_InitWindows" },
+	{ 0xA913, "_NewWindow" },
+	{ 0xA914, "_DisposWindow" },
+	{ 0xA915, "_ShowWindow" },
+	{ 0xA916, "_HideWindow" },
+	{ 0xA917, "_GetWRefCon" },
+	{ 0xA918, "_SetWRefCon" },
+	{ 0xA919, "_GetWTitle" },
+	{ 0xA91A, "_SetWTitle" },
+	{ 0xA91B, "_MoveWindow" },
+	{ 0xA91C, "_HiliteWindow" },
+	{ 0xA91D, "_SizeWindow" },
+	{ 0xA91E, "_TrackGoAway" },
+	{ 0xA91F, "_SelectWindow" },
+	{ 0xA920, "_BringToFront" },
+	{ 0xA921, "_SendBehind" },
+	{ 0xA922, "_BeginUpDate" },
+	{ 0xA923, "_EndUpDate" },
+	{ 0xA924, "_FrontWindow" },
+	{ 0xA925, "_DragWindow" },
+	{ 0xA926, "_DragTheRgn" },
+	{ 0xA927, "_InvalRgn" },
+	{ 0xA928, "_InvalRect" },
+	{ 0xA929, "_ValidRgn" },
+	{ 0xA92A, "_ValidRect" },
+	{ 0xA92B, "_GrowWindow" },
+	{ 0xA92C, "_FindWindow" },
+	{ 0xA92D, "_CloseWindow" },
+	{ 0xA970, "_GetNextEvent" },
+	{ 0xA971, "_EventAvail" },
+	{ 0xA972, "_GetMouse" },
+	{ 0xA973, "_StillDown" },
+	{ 0xA974, "_Button" },
+	{ 0xA975, "_TickCount" },
+	{ 0xA976, "_GetKeys" },
+	{ 0xA977, "_WaitMouseUp" },
+	{ 0xA9A0, "_GetResource" },
+	{ 0xA9A2, "_LoadResource" },
+	{ 0xA9A3, "_ReleaseResource" },
+	{ 0xA9B2, "_SystemEvent" },
+	{ 0xA9B3, "_SystemClick" },
+	{ 0xA9B4, "_SystemTask" },
+	{ 0xA9C8, "_SysBeep" },
+	{ 0xA9C9, "_SysError" },
+	{ 0xA9F0, "_LoadSeg" },
+	{ 0xA9F1, "_UnloadSeg" },
+	{ 0xA9F4, "_ExitToShell" },
+	{ 0xA9FF, "_Debugger" }
+};
+
+#define kProfNumTrapNames (sizeof(ProfTrapNames) / sizeof(ProfTrapNameR))
+
+GLOBALFUNC char *Profile_TrapName(ui4r trap)
+{
+	int i;
+
+	for (i = 0; i < kProfNumTrapNames; ++i) {
+		if (trap == ProfTrapNames[i].Trap) {
+			return ProfTrapNames[i].Name;
+		}
+	}
+	return nullpr;
+}
+
+#endif /* IncludeProfile */
@@ -0,0 +1,54 @@
+/*
+	PROFILER.h
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+#ifdef PROFILER_H
+#error "header already included"
+#else
+#define PROFILER_H
+#endif
+
+#define kProfMaxDepth 16
+
+EXPORTPROC Profile_Start(ui5r Every);
+	/* sample the PC every so many emulated cycles */
+EXPORTPROC Profile_TickNtfy(void);
+EXPORTPROC Profile_Task(void);
+EXPORTPROC Profile_TrapNtfy(ui4r opcode);
+
+/* for the platform glue, to write a report */
+
+EXPORTFUNC ui5r Profile_Samples(void);
+EXPORTFUNC ui5r Profile_Lost(void);
+	/* samples not counted, because the tables were full */
+EXPORTFUNC ui5r Profile_NumPCSlots(void);
+EXPORTFUNC ui5r Profile_GetPC(ui5r i, ui5r *pc);
+	/* count for slot i, 0 if unused */
+EXPORTFUNC ui5r Profile_NumStackSlots(void);
+EXPORTFUNC ui5r Profile_GetStack(ui5r i, ui5r *pcs, int *depth);
+	/* count for slot i, pcs from the leaf outwards */
+EXPORTFUNC ui5r Profile_TrapCount(ui4r trap);
+EXPORTFUNC ui4r Profile_TrapOf(ui4r opcode);
+	/* the trap word, without flag bits */
+EXPORTFUNC char *Profile_TrapName(ui4r trap);
+#define kProfWhereOther 0
+#define kProfWhereROM 1
+#define kProfWhereRAM 2
+EXPORTFUNC int Profile_Where(ui5r pc, ui5r *offset);
+	/* which memory, and the offset into it */
+EXPORTPROC Profile_FindRoutines(void);
+	/* read the trap dispatch tables, for Profile_RomTrap */
+EXPORTFUNC blnr Profile_RomTrap(ui5r pc, ui4r *trap, ui5r *offset);
+	/* the ROM routine of a trap nearest below pc */
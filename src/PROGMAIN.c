@@ -57,6 +57,15 @@
 #endif
 #endif
 #include "MOUSEMDV.h"
+#if IncludeSaveState
+#include "SAVESTAT.h"
+#endif
+#if IncludeProfile
+#include "PROFILER.h"
+#endif
+#if IncludeTrace
+#include "TRACE.h"
+#endif
 #endif
 
 
@@ -110,7 +119,14 @@ LOCALPROC SubTickNotify(int SubTick)
 	dbglog_writeReturn();
 #endif
 #if MySoundEnabled && (CurEmMd != kEmMd_PB100)
+#if IncludeHostTime
+	int PrevHostTime = HostTime_Switch(kHostTimeSound);
+#endif
+
 	MacSound_SubTick(SubTick);
+#if IncludeHostTime
+	(void) HostTime_Switch(PrevHostTime);
+#endif
 #else
 	UnusedParam(SubTick);
 #endif
@@ -119,7 +135,7 @@ LOCALPROC SubTickNotify(int SubTick)
 #define CyclesScaledPerTick (130240UL * kMyClockMult * kCycleScale)
 #define CyclesScaledPerSubTick (CyclesScaledPerTick / kNumSubTicks)
 
-LOCALVAR ui4r SubTickCounter;
+LOCALINSTVAR ui4r SubTickCounter;
 
 LOCALPROC SubTickTaskDo(void)
 {
@@ -147,12 +163,42 @@ LOCALPROC SubTickTaskEnd(void)
 	SubTickNotify(kNumSubTicks - 1);
 }
 
+#if IncludeSaveState
+GLOBALPROC ProgMain_StateXfer(void)
+{
+	StateXferVar(SubTickCounter);
+}
+#endif
+
+#if IncludeBench
+GLOBALFUNC ui5r ProgMain_InstrCount(void)
+{
+	return m68k_InstrCount();
+}
+
+GLOBALPROC ProgMain_InstrCountSet(blnr On)
+{
+	m68k_InstrCountSet(On);
+}
+
+GLOBALFUNC ui5r ProgMain_CyclesPerTick(void)
+{
+	/* emulated cycles in one DoEmulateOneTick */
+	return CyclesScaledPerTick / kCycleScale;
+}
+#endif
+
 LOCALPROC SixtiethSecondNotify(void)
 {
 #if dbglog_HAVE && 0
 	dbglog_StartLine();
 	dbglog_writeCStr("begin new Sixtieth");
 	dbglog_writeReturn();
+#endif
+#if IncludeTrace
+	if (TraceOn) {
+		Trace_Event(kTraceTick, 0, 0, 0, 0);
+	}
 #endif
 	Mouse_Update();
 	InterruptReset_Update();
@@ -180,6 +226,9 @@ LOCALPROC SixtiethSecondNotify(void)
 #endif
 
 	SubTickTaskStart();
+#if IncludeProfile
+	Profile_TickNtfy();
+#endif
 }
 
 LOCALPROC SixtiethEndNotify(void)
@@ -232,6 +281,9 @@ GLOBALPROC EmulationReserveAlloc(void)
 #if SmallGlobals
 	MINEM68K_ReserveAlloc();
 #endif
+#if IncludeRewind
+	Rewind_ReserveAlloc();
+#endif
 }
 
 GLOBALFUNC blnr InitEmulation(void)
@@ -288,6 +340,11 @@ LOCALPROC ICT_DoTask(int taskid)
 		case kICT_VIA2_Timer2Check:
 			VIA2_DoTimer2Check();
 			break;
+#endif
+#if IncludeProfile
+		case kICT_Profile:
+			Profile_Task();
+			break;
 #endif
 		default:
 			ReportAbnormal("unknown taskid in ICT_DoTask");
@@ -362,6 +419,9 @@ LOCALPROC m68k_go_nCycles_1(ui5b n)
 	ui5b n2;
 	ui5b StopiCount = NextiCount + n;
 	do {
+#if IncludeHostTime
+		(void) HostTime_Switch(kHostTimeICT);
+#endif
 		ICT_DoCurrentTasks();
 		n2 = ICT_DoGetNext(n);
 #if dbglog_HAVE && 0
@@ -375,15 +435,24 @@ LOCALPROC m68k_go_nCycles_1(ui5b n)
 		dbglog_writeReturn();
 #endif
 		NextiCount += n2;
+#if IncludeHostTime
+		(void) HostTime_Switch(kHostTimeCPU);
+#endif
 		m68k_go_nCycles(n2);
 		n = StopiCount - NextiCount;
 	} while (n != 0);
+#if IncludeHostTime
+	(void) HostTime_Switch(kHostTimeOther);
+#endif
 }
 
-LOCALVAR ui5b ExtraSubTicksToDo = 0;
+LOCALINSTVAR ui5b ExtraSubTicksToDo = 0;
 
 GLOBALPROC DoEmulateOneTick(void)
 {
+#if EnableIdleSkip
+	GuestIdle = falseblnr;
+#endif
 #if EnableAutoSlow
 	{
 		ui5r NewQuietTime = QuietTime + 1;
@@ -405,6 +474,10 @@ GLOBALPROC DoEmulateOneTick(void)
 	}
 #endif
 
+#if IncludeRewind
+	Rewind_Tick();
+#endif
+
 	SixtiethSecondNotify();
 
 	m68k_go_nCycles_1(CyclesScaledPerTick);
@@ -429,6 +502,12 @@ LOCALFUNC blnr MoreSubTicksToDo(void)
 	blnr v = falseblnr;
 
 	if (ExtraTimeNotOver() && (ExtraSubTicksToDo > 0)) {
+#if EnableIdleSkip
+		if (GuestIdle) {
+			/* nothing to be gained by going faster */
+			ExtraSubTicksToDo = 0;
+		} else
+#endif
 #if EnableAutoSlow
 		if ((QuietSubTicks >= 16384)
 			&& (QuietTime >= 34)
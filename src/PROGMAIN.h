@@ -25,3 +25,11 @@ EXPORTPROC EmulationReserveAlloc(void);
 EXPORTFUNC blnr InitEmulation(void);
 EXPORTPROC DoEmulateOneTick(void);
 EXPORTPROC DoEmulateExtraTime(void);
+#if IncludeSaveState
+EXPORTPROC ProgMain_StateXfer(void);
+#endif
+#if IncludeBench
+EXPORTFUNC ui5r ProgMain_InstrCount(void);
+EXPORTPROC ProgMain_InstrCountSet(blnr On);
+EXPORTFUNC ui5r ProgMain_CyclesPerTick(void);
+#endif
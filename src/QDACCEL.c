@@ -0,0 +1,770 @@
+/*
+	QDACCEL.c
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	QuickDraw ACCELeration
+
+	Host native versions of the common cases of the QuickDraw
+	rectangle traps, used by the native trap mechanism in
+	MINEM68K.c. Only the simplest case is handled, a one bit
+	deep bitmap, clipped to rectangles, in a port that isn't
+	being recorded or customized, with the normal colors. For
+	anything else, including a drawing that might touch the
+	cursor on screen, the trap is left to the ROM.
+
+	Works a byte at a time, on bitmaps in the byte order of the
+	emulated machine. Nothing else needs telling about screen
+	changes, the platform glue finds them by comparing frames.
+*/
+
+#ifndef AllFiles
+#include "SYSDEPNS.h"
+#include "MYOSGLUE.h"
+#include "ENDIANAC.h"
+#include "EMCONFIG.h"
+#include "GLOBGLUE.h"
+#include "MINEM68K.h"
+#endif
+
+#include "QDACCEL.h"
+
+#if EnableQDAccel
+
+/* low memory globals */
+#define kQD_ScrnBase 0x0824
+#define kQD_CrsrRect 0x083C
+#define kQD_CrsrVis 0x08CC
+	/* a word, with CrsrBusy in the low byte */
+
+/* offsets in a GrafPort */
+#define kGP_portBits 2
+#define kGP_portRect 16
+#define kGP_visRgn 24
+#define kGP_clipRgn 28
+#define kGP_bkPat 32
+#define kGP_fillPat 40
+#define kGP_pnMode 56
+#define kGP_pnPat 58
+#define kGP_pnVis 66
+#define kGP_fgColor 80
+#define kGP_bkColor 84
+#define kGP_patStretch 90
+#define kGP_picSave 92
+#define kGP_rgnSave 96
+#define kGP_polySave 100
+#define kGP_grafProcs 104
+#define kGP_Size 108
+
+#define kQD_blackColor 33
+#define kQD_whiteColor 30
+
+/* transfer modes */
+#define kQD_srcCopy 0
+#define kQD_patCopy 8
+#define kQD_patXor 10
+#define kQD_notPatBic 15
+
+#define kQDMaxRowBytes 256
+#define kQDMaxRows 0x4000
+
+typedef struct {
+	si5r top;
+	si5r left;
+	si5r bottom;
+	si5r right;
+} QDRect;
+
+typedef struct {
+	CPTR baseAddr;
+	ui5r rowBytes;
+	QDRect bounds;
+} QDBitMap;
+
+LOCALFUNC blnr QDGetLong(CPTR addr, ui5r *v)
+{
+	ui3p p = TrapAccel_Src(addr, 4);
+
+	if (nullpr == p) {
+		return falseblnr;
+	}
+	*v = do_get_mem_long(p);
+	return trueblnr;
+}
+
+LOCALFUNC blnr QDGetWord(CPTR addr, ui5r *v)
+{
+	ui3p p = TrapAccel_Src(addr, 2);
+
+	if (nullpr == p) {
+		return falseblnr;
+	}
+	*v = do_get_mem_word(p);
+	return trueblnr;
+}
+
+LOCALFUNC blnr QDBlockSize(CPTR addr, ui5r *Size)
+{
+	/*
+		logical size of the relocatable block at addr, from its
+		header in the 24 bit heap: a tag byte, the block type in
+		the top two bits and the size correction in the low four,
+		then three bytes of physical size, header included.
+	*/
+	ui5r h;
+	ui5r n;
+	ui5r c;
+
+	if ((addr < 8) || ! QDGetLong(addr - 8, &h)) {
+		return falseblnr;
+	}
+	n = h & 0x00FFFFFF;
+	c = (h >> 24) & 0x0F;
+	if ((2 != (h >> 30)) || (n < 8 + c)) {
+		/* not a relocatable block */
+		return falseblnr;
+	}
+	*Size = n - 8 - c;
+	return trueblnr;
+}
+
+LOCALFUNC blnr QDGetRect(CPTR addr, QDRect *r)
+{
+	ui3p p = TrapAccel_Src(addr, 8);
+
+	if (nullpr == p) {
+		return falseblnr;
+	}
+	r->top = (si4b)do_get_mem_word(p);
+	r->left = (si4b)do_get_mem_word(p + 2);
+	r->bottom = (si4b)do_get_mem_word(p + 4);
+	r->right = (si4b)do_get_mem_word(p + 6);
+	return trueblnr;
+}
+
+LOCALFUNC blnr QDGetBitMap(CPTR addr, QDBitMap *b)
+{
+	ui5r v;
+
+	if (! QDGetLong(addr, &v)) {
+		return falseblnr;
+	}
+	b->baseAddr = v & 0x00FFFFFF;
+	if (! QDGetWord(addr + 4, &v)) {
+		return falseblnr;
+	}
+	if ((0 != (v & 0xC000)) || (v > kQDMaxRowBytes)) {
+		/* a PixMap, or too wide */
+		return falseblnr;
+	}
+	b->rowBytes = v;
+	if (! QDGetRect(addr + 6, &b->bounds)) {
+		return falseblnr;
+	}
+	if ((b->bounds.right - b->bounds.left > (si5r)(v << 3))
+		|| (b->bounds.bottom - b->bounds.top > kQDMaxRows))
+	{
+		return falseblnr;
+	}
+	return trueblnr;
+}
+
+LOCALFUNC blnr QDGetRgnRect(CPTR h, QDRect *r)
+{
+	/* bounding box of a region that is just a rectangle */
+	ui5r p;
+	ui5r n;
+
+	h &= 0x00FFFFFF;
+	if ((0 == h) || (! QDGetLong(h, &p))) {
+		return falseblnr;
+	}
+	p &= 0x00FFFFFF;
+	if ((0 == p) || (! QDGetWord(p, &n)) || (10 != n)) {
+		return falseblnr;
+	}
+	return QDGetRect(p + 2, r);
+}
+
+LOCALFUNC blnr QDSectRect(QDRect *a, QDRect *b, QDRect *r)
+{
+	/* r may be a or b. returns false, and r empty, if no overlap */
+	r->top = (a->top > b->top) ? a->top : b->top;
+	r->left = (a->left > b->left) ? a->left : b->left;
+	r->bottom = (a->bottom < b->bottom) ? a->bottom : b->bottom;
+	r->right = (a->right < b->right) ? a->right : b->right;
+	if ((r->top >= r->bottom) || (r->left >= r->right)) {
+		r->top = r->left = r->bottom = r->right = 0;
+		return falseblnr;
+	}
+	return trueblnr;
+}
+
+LOCALFUNC blnr QDRectEmpty(QDRect *r)
+{
+	return (r->top >= r->bottom) || (r->left >= r->right);
+}
+
+LOCALFUNC blnr QDRectIn(QDRect *a, QDRect *b)
+{
+	/* a (not empty) is inside b */
+	return (a->top >= b->top) && (a->left >= b->left)
+		&& (a->bottom <= b->bottom) && (a->right <= b->right);
+}
+
+LOCALFUNC blnr QDGetPort(CPTR *port, ui3p *pp)
+{
+	/*
+		thePort, if it is a plain port with nothing that
+		would change what the ROM draws.
+	*/
+	ui5r a;
+	ui5r v;
+	ui3p p;
+
+	if ((! QDGetLong(TrapAccel_AReg(5), &a))
+		|| (! QDGetLong(a & 0x00FFFFFF, &a)))
+	{
+		return falseblnr;
+	}
+	a &= 0x00FFFFFF;
+	p = TrapAccel_Src(a, kGP_Size);
+	if (nullpr == p) {
+		return falseblnr;
+	}
+	v = do_get_mem_long(p + kGP_grafProcs)
+		| do_get_mem_long(p + kGP_picSave)
+		| do_get_mem_long(p + kGP_rgnSave)
+		| do_get_mem_long(p + kGP_polySave)
+		| do_get_mem_word(p + kGP_patStretch);
+	if ((0 != v)
+		|| (kQD_blackColor != do_get_mem_long(p + kGP_fgColor))
+		|| (kQD_whiteColor != do_get_mem_long(p + kGP_bkColor)))
+	{
+		return falseblnr;
+	}
+	*port = a;
+	*pp = p;
+	return trueblnr;
+}
+
+LOCALFUNC blnr QDPortClip(ui3p pp, QDRect *r)
+{
+	/*
+		clip r to the visRgn and clipRgn of the port at pp, if
+		both are rectangles. As a check that this is the simple
+		case, the result must be inside the portRect.
+	*/
+	QDRect t;
+
+	if (! QDGetRgnRect(do_get_mem_long(pp + kGP_visRgn), &t)) {
+		return falseblnr;
+	}
+	(void) QDSectRect(r, &t, r);
+	if (! QDGetRgnRect(do_get_mem_long(pp + kGP_clipRgn), &t)) {
+		return falseblnr;
+	}
+	(void) QDSectRect(r, &t, r);
+	t.top = (si4b)do_get_mem_word(pp + kGP_portRect);
+	t.left = (si4b)do_get_mem_word(pp + kGP_portRect + 2);
+	t.bottom = (si4b)do_get_mem_word(pp + kGP_portRect + 4);
+	t.right = (si4b)do_get_mem_word(pp + kGP_portRect + 6);
+	return QDRectEmpty(r) || QDRectIn(r, &t);
+}
+
+LOCALFUNC blnr QDCursorClear(QDBitMap *b, QDRect *r)
+{
+	/* drawing r (local coordinates of b) won't touch the cursor */
+	QDRect g;
+	QDRect c;
+	ui5r v;
+
+	if (QDRectEmpty(r)) {
+		return trueblnr;
+	}
+	if (! QDGetLong(kQD_ScrnBase, &v)) {
+		return falseblnr;
+	}
+	if (b->baseAddr != (v & 0x00FFFFFF)) {
+		return trueblnr;
+	}
+	if (! QDGetWord(kQD_CrsrVis, &v)) {
+		return falseblnr;
+	}
+	if (0 != (v & 0x00FF)) {
+		/* CrsrBusy */
+		return falseblnr;
+	}
+	if (0 == (v >> 8)) {
+		/* not CrsrVis */
+		return trueblnr;
+	}
+	if (! QDGetRect(kQD_CrsrRect, &c)) {
+		return falseblnr;
+	}
+	g.top = r->top - b->bounds.top;
+	g.left = r->left - b->bounds.left;
+	g.bottom = r->bottom - b->bounds.top;
+	g.right = r->right - b->bounds.left;
+	return ! QDSectRect(&g, &c, &g);
+}
+
+LOCALFUNC ui3p QDBitMapRows(QDBitMap *b, QDRect *r, blnr Write)
+{
+	/*
+		host address of the rows of b covered by r, which is
+		not empty and is inside the bounds.
+	*/
+	CPTR a = b->baseAddr + (r->top - b->bounds.top) * b->rowBytes;
+	ui5r n = (r->bottom - r->top) * b->rowBytes;
+
+	return Write ? TrapAccel_Dst(a, n) : TrapAccel_Src(a, n);
+}
+
+LOCALPROC QDBlitRow(ui3p d, si5r x0, si5r x1, ui3p t, ui3r Op)
+{
+	/*
+		combine bits x0 to x1 - 1 of row d with t, where t[0] goes
+		with the byte holding bit x0. Op is the mode mod 4, copy,
+		or, xor, bic.
+	*/
+	ui3p p = d + (x0 >> 3);
+	ui3p pend = d + ((x1 - 1) >> 3);
+	ui3r lmask = 0xFF >> (x0 & 7);
+	ui3r rmask = (0xFF << (7 - ((x1 - 1) & 7))) & 0xFF;
+	ui3r mask = (p == pend) ? (lmask & rmask) : lmask;
+	ui3r v;
+	ui3r s;
+
+	for (;;) {
+		v = *p;
+		s = *t++;
+		switch (Op) {
+			case 0:
+				break;
+			case 1:
+				s |= v;
+				break;
+			case 2:
+				s ^= v;
+				break;
+			default:
+				s = v & ~ s;
+				break;
+		}
+		*p = (v & ~ mask) | (s & mask);
+		if (p == pend) {
+			break;
+		}
+		++p;
+		mask = (p == pend) ? rmask : 0xFF;
+	}
+}
+
+LOCALPROC QDSrcRow(ui3p s, si5r sx0, si5r dx0, si5r w, ui3p t,
+	ui3r Invert)
+{
+	/*
+		bits sx0 to sx0 + w - 1 of row s, lined up for QDBlitRow
+		with destination bits starting at dx0.
+	*/
+	si5r n = ((dx0 + w - 1) >> 3) - (dx0 >> 3) + 1;
+	si5r lo = sx0 >> 3;
+	si5r hi = (sx0 + w - 1) >> 3;
+	si5r b = sx0 - (dx0 & 7) + 8; /* plus 8, to keep it positive */
+	si5r i;
+	ui3r b0;
+	ui3r b1;
+
+	do {
+		i = (b >> 3) - 1;
+		b0 = ((i >= lo) && (i <= hi)) ? s[i] : 0;
+		b1 = ((i + 1 >= lo) && (i + 1 <= hi)) ? s[i + 1] : 0;
+		*t++ = (((((ui5r)b0 << 8) | b1) << (b & 7) >> 8) & 0xFF) ^ Invert;
+		b += 8;
+	} while (0 != --n);
+}
+
+LOCALPROC QDFillBits(ui3p d, ui5r rowBytes, si5r y0, si5r x0,
+	si5r h, si5r w, ui3p pat, ui3r Mode)
+{
+	/*
+		fill h rows from d, bits x0 to x0 + w - 1, with a pattern
+		mode. y0 is the first row number in the bitmap, patterns
+		line up with the bitmap.
+	*/
+	ui3b t[kQDMaxRowBytes];
+	si5r n = ((x0 + w - 1) >> 3) - (x0 >> 3) + 1;
+	ui3r Invert = (0 != (Mode & 4)) ? 0xFF : 0;
+	ui3r v;
+	si5r i;
+
+	do {
+		v = pat[y0 & 7] ^ Invert;
+		for (i = 0; i < n; ++i) {
+			t[i] = v;
+		}
+		QDBlitRow(d, x0, x0 + w, t, Mode & 3);
+		d += rowBytes;
+		++y0;
+	} while (0 != --h);
+}
+
+LOCALPROC QDCopyBits(ui3p s, ui5r sRowBytes, si5r sx0,
+	ui3p d, ui5r dRowBytes, si5r dx0,
+	si5r h, si5r w, ui3r Mode, blnr Upward)
+{
+	/*
+		copy h rows of w bits with a source mode. if Upward,
+		start from the last row, in case source and destination
+		overlap with the source above.
+	*/
+	ui3b t[kQDMaxRowBytes + 1];
+	ui3r Invert = (0 != (Mode & 4)) ? 0xFF : 0;
+
+	if (Upward) {
+		s += (h - 1) * sRowBytes;
+		d += (h - 1) * dRowBytes;
+	}
+	do {
+		QDSrcRow(s, sx0, dx0, w, t, Invert);
+		QDBlitRow(d, dx0, dx0 + w, t, Mode & 3);
+		if (Upward) {
+			s -= sRowBytes;
+			d -= dRowBytes;
+		} else {
+			s += sRowBytes;
+			d += dRowBytes;
+		}
+	} while (0 != --h);
+}
+
+LOCALFUNC ui5r QDCycles(QDRect *r)
+{
+	/* roughly what the ROM would take */
+	return 2000 + 2 * (r->bottom - r->top) * (r->right - r->left);
+}
+
+LOCALFUNC blnr QDRectProc(CPTR port, ui3p pp, ui3p pat, ui5r Mode,
+	ui5r Pop)
+{
+	/*
+		the common part of the rectangle fill traps, for the
+		port at pp, with the Rect pointer the first argument.
+	*/
+	QDBitMap b;
+	QDRect r;
+	ui5r a;
+	ui3p d;
+	ui3b p[8];
+
+	if ((kQD_patCopy > Mode) || (kQD_notPatBic < Mode)) {
+		return falseblnr;
+	}
+	MyMoveBytes((anyp)pat, (anyp)p, 8);
+	if ((! QDGetLong(TrapAccel_AReg(7) + Pop - 4, &a))
+		|| (! QDGetRect(a & 0x00FFFFFF, &r))
+		|| (! QDGetBitMap(port + kGP_portBits, &b)))
+	{
+		return falseblnr;
+	}
+	(void) QDSectRect(&r, &b.bounds, &r);
+	if ((! QDPortClip(pp, &r)) || (! QDCursorClear(&b, &r))) {
+		return falseblnr;
+	}
+	if (! QDRectEmpty(&r)) {
+		d = QDBitMapRows(&b, &r, trueblnr);
+		if (nullpr == d) {
+			return falseblnr;
+		}
+		QDFillBits(d, b.rowBytes, r.top - b.bounds.top,
+			r.left - b.bounds.left,
+			r.bottom - r.top, r.right - r.left, p, Mode);
+	}
+	TrapAccel_Done(Pop, QDCycles(&r));
+	return trueblnr;
+}
+
+GLOBALFUNC blnr QDAccel_FillRect(void)
+{
+	/* FillRect(r: Rect; pat: Pattern), also sets fillPat */
+	CPTR port;
+	ui3p pp;
+	ui5r a;
+	ui3p s;
+	ui3p d;
+
+	if ((! QDGetLong(TrapAccel_AReg(7), &a))
+		|| (nullpr == (s = TrapAccel_Src(a & 0x00FFFFFF, 8)))
+		|| (! QDGetPort(&port, &pp))
+		|| (! QDRectProc(port, pp, s, kQD_patCopy, 8)))
+	{
+		return falseblnr;
+	}
+	/* fillPat last, only the bitmap is checked in verify mode */
+	d = TrapAccel_Dst(port + kGP_fillPat, 8);
+	if (nullpr != d) {
+		MyMoveBytes((anyp)s, (anyp)d, 8);
+	}
+	return trueblnr;
+}
+
+GLOBALFUNC blnr QDAccel_PaintRect(void)
+{
+	/* PaintRect(r: Rect), with pnPat and pnMode */
+	CPTR port;
+	ui3p pp;
+
+	if ((! QDGetPort(&port, &pp))
+		|| (0 != (do_get_mem_word(pp + kGP_pnVis) & 0x8000)))
+	{
+		return falseblnr;
+	}
+	return QDRectProc(port, pp, pp + kGP_pnPat,
+		do_get_mem_word(pp + kGP_pnMode), 4);
+}
+
+GLOBALFUNC blnr QDAccel_EraseRect(void)
+{
+	/* EraseRect(r: Rect), with bkPat */
+	CPTR port;
+	ui3p pp;
+
+	if (! QDGetPort(&port, &pp)) {
+		return falseblnr;
+	}
+	return QDRectProc(port, pp, pp + kGP_bkPat, kQD_patCopy, 4);
+}
+
+GLOBALFUNC blnr QDAccel_InvertRect(void)
+{
+	/* InvertRect(r: Rect) */
+	CPTR port;
+	ui3p pp;
+	ui3b s[8];
+	int i;
+
+	if (! QDGetPort(&port, &pp)) {
+		return falseblnr;
+	}
+	for (i = 0; i < 8; ++i) {
+		s[i] = 0xFF;
+	}
+	return QDRectProc(port, pp, s, kQD_patXor, 4);
+}
+
+GLOBALFUNC blnr QDAccel_ScrollRect(void)
+{
+	/*
+		ScrollRect(r: Rect; dh, dv: INTEGER; updateRgn: RgnHandle),
+		only horizontally or vertically. The area scrolled
+		from is filled with bkPat, and becomes updateRgn. The ROM
+		sizes updateRgn to 10 bytes with SetHandleSize, so only a
+		handle of that size already, as from NewRgn, is done here.
+	*/
+	CPTR port;
+	ui3p pp;
+	ui3p a = TrapAccel_Src(TrapAccel_AReg(7), 12);
+	QDBitMap b;
+	QDRect r;
+	QDRect u;
+	ui5r rgn;
+	ui5r rgnSize;
+	si5r dv;
+	si5r dh;
+	si5r h;
+	si5r w;
+	si5r x;
+	ui3p d;
+	ui3p p;
+
+	if (nullpr == a) {
+		return falseblnr;
+	}
+	dv = (si4b)do_get_mem_word(a + 4);
+	dh = (si4b)do_get_mem_word(a + 6);
+	if (((0 != dh) && (0 != dv))
+		|| (! QDGetPort(&port, &pp))
+		|| (! QDGetRect(do_get_mem_long(a + 8) & 0x00FFFFFF, &r))
+		|| (! QDGetBitMap(port + kGP_portBits, &b))
+		|| (! QDGetLong(do_get_mem_long(a) & 0x00FFFFFF, &rgn))
+		|| (! QDBlockSize(rgn & 0x00FFFFFF, &rgnSize))
+		|| (10 != rgnSize)
+		|| (nullpr == TrapAccel_Src(rgn & 0x00FFFFFF, 10)))
+	{
+		return falseblnr;
+	}
+	(void) QDSectRect(&r, &b.bounds, &r);
+	if ((! QDPortClip(pp, &r)) || (! QDCursorClear(&b, &r))) {
+		return falseblnr;
+	}
+
+	u = r;
+	if (! QDRectEmpty(&r)) {
+		d = QDBitMapRows(&b, &r, trueblnr);
+		if (nullpr == d) {
+			return falseblnr;
+		}
+		h = r.bottom - r.top;
+		w = r.right - r.left;
+		x = r.left - b.bounds.left;
+		if (((dh > 0) ? dh : - dh) >= w) {
+			/* all uncovered */
+		} else if (((dv > 0) ? dv : - dv) >= h) {
+			/* all uncovered */
+		} else if (dv > 0) {
+			QDCopyBits(d, b.rowBytes, x,
+				d + dv * b.rowBytes, b.rowBytes, x,
+				h - dv, w, kQD_srcCopy, trueblnr);
+			u.bottom = r.top + dv;
+		} else if (dv < 0) {
+			QDCopyBits(d - dv * b.rowBytes, b.rowBytes, x,
+				d, b.rowBytes, x,
+				h + dv, w, kQD_srcCopy, falseblnr);
+			u.top = r.bottom + dv;
+		} else if (dh > 0) {
+			QDCopyBits(d, b.rowBytes, x,
+				d, b.rowBytes, x + dh,
+				h, w - dh, kQD_srcCopy, falseblnr);
+			u.right = r.left + dh;
+		} else if (dh < 0) {
+			QDCopyBits(d, b.rowBytes, x - dh,
+				d, b.rowBytes, x,
+				h, w + dh, kQD_srcCopy, falseblnr);
+			u.left = r.right + dh;
+		} else {
+			u.top = u.left = u.bottom = u.right = 0;
+		}
+		if (! QDRectEmpty(&u)) {
+			QDFillBits(d + (u.top - r.top) * b.rowBytes, b.rowBytes,
+				u.top - b.bounds.top, u.left - b.bounds.left,
+				u.bottom - u.top, u.right - u.left,
+				pp + kGP_bkPat, kQD_patCopy);
+		}
+	}
+
+	/* updateRgn last, only the bitmap is checked in verify mode */
+	p = TrapAccel_Dst(rgn & 0x00FFFFFF, 10);
+	if (nullpr != p) {
+		if (QDRectEmpty(&u)) {
+			u.top = u.left = u.bottom = u.right = 0;
+		}
+		do_put_mem_word(p, 10);
+		do_put_mem_word(p + 2, u.top);
+		do_put_mem_word(p + 4, u.left);
+		do_put_mem_word(p + 6, u.bottom);
+		do_put_mem_word(p + 8, u.right);
+	}
+	TrapAccel_Done(12, QDCycles(&r));
+	return trueblnr;
+}
+
+LOCALFUNC blnr QDSameBitMap(QDBitMap *a, QDBitMap *b)
+{
+	return (a->baseAddr == b->baseAddr)
+		&& (a->rowBytes == b->rowBytes)
+		&& (a->bounds.top == b->bounds.top)
+		&& (a->bounds.left == b->bounds.left)
+		&& (a->bounds.bottom == b->bounds.bottom)
+		&& (a->bounds.right == b->bounds.right);
+}
+
+GLOBALFUNC blnr QDAccel_CopyBits(void)
+{
+	/*
+		CopyBits(srcBits, dstBits: BitMap; srcRect, dstRect: Rect;
+			mode: INTEGER; maskRgn: RgnHandle),
+		without stretching or a mask, and with the source all
+		inside its bitmap.
+	*/
+	CPTR port;
+	ui3p pp;
+	ui3p a = TrapAccel_Src(TrapAccel_AReg(7), 22);
+	QDBitMap sb;
+	QDBitMap db;
+	QDBitMap pb;
+	QDRect sr;
+	QDRect dr;
+	QDRect c;
+	QDRect t;
+	ui5r Mode;
+	ui3p s;
+	ui3p d;
+
+	if (nullpr == a) {
+		return falseblnr;
+	}
+	Mode = do_get_mem_word(a + 4);
+	if ((0 != do_get_mem_long(a))
+		|| (Mode > 7)
+		|| (! QDGetPort(&port, &pp))
+		|| (! QDGetRect(do_get_mem_long(a + 6) & 0x00FFFFFF, &dr))
+		|| (! QDGetRect(do_get_mem_long(a + 10) & 0x00FFFFFF, &sr))
+		|| (! QDGetBitMap(do_get_mem_long(a + 14) & 0x00FFFFFF, &db))
+		|| (! QDGetBitMap(do_get_mem_long(a + 18) & 0x00FFFFFF, &sb))
+		|| (! QDGetBitMap(port + kGP_portBits, &pb))
+		|| (dr.bottom - dr.top != sr.bottom - sr.top)
+		|| (dr.right - dr.left != sr.right - sr.left))
+	{
+		return falseblnr;
+	}
+	if (QDRectEmpty(&sr)) {
+		c = sr;
+	} else {
+		if (! QDRectIn(&sr, &sb.bounds)) {
+			return falseblnr;
+		}
+		(void) QDSectRect(&dr, &db.bounds, &c);
+		if (QDSameBitMap(&db, &pb)) {
+			if (! QDPortClip(pp, &c)) {
+				return falseblnr;
+			}
+		} else if (! QDRectEmpty(&c)) {
+			/*
+				drawing to another bitmap, still clipped by the
+				port's regions. Only when they make no difference.
+			*/
+			t = c;
+			if ((! QDPortClip(pp, &t))
+				|| (t.top != c.top) || (t.left != c.left)
+				|| (t.bottom != c.bottom) || (t.right != c.right))
+			{
+				return falseblnr;
+			}
+		}
+	}
+	if (! QDRectEmpty(&c)) {
+		t.top = c.top - dr.top + sr.top;
+		t.left = c.left - dr.left + sr.left;
+		t.bottom = t.top + (c.bottom - c.top);
+		t.right = t.left + (c.right - c.left);
+		if ((! QDCursorClear(&db, &c)) || (! QDCursorClear(&sb, &t))) {
+			return falseblnr;
+		}
+		s = QDBitMapRows(&sb, &t, falseblnr);
+		d = QDBitMapRows(&db, &c, trueblnr);
+		if ((nullpr == s) || (nullpr == d)) {
+			return falseblnr;
+		}
+		QDCopyBits(s, sb.rowBytes, t.left - sb.bounds.left,
+			d, db.rowBytes, c.left - db.bounds.left,
+			c.bottom - c.top, c.right - c.left, Mode,
+			(d > s) && (d < s + (c.bottom - c.top) * sb.rowBytes));
+	}
+	TrapAccel_Done(22, QDCycles(&c));
+	return trueblnr;
+}
+
+#endif /* EnableQDAccel */
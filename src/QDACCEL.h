@@ -0,0 +1,30 @@
+/*
+	QDACCEL.h
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+#ifdef QDACCEL_H
+#error "header already included"
+#else
+#define QDACCEL_H
+#endif
+
+#if EnableQDAccel
+EXPORTFUNC blnr QDAccel_FillRect(void);
+EXPORTFUNC blnr QDAccel_PaintRect(void);
+EXPORTFUNC blnr QDAccel_EraseRect(void);
+EXPORTFUNC blnr QDAccel_InvertRect(void);
+EXPORTFUNC blnr QDAccel_ScrollRect(void);
+EXPORTFUNC blnr QDAccel_CopyBits(void);
+#endif
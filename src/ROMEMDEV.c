@@ -29,6 +29,9 @@
 #include "ENDIANAC.h"
 #include "EMCONFIG.h"
 #include "GLOBGLUE.h"
+#if IncludeBench
+#include "MICROBEN.h"
+#endif
 #endif
 
 #include "ROMEMDEV.h"
@@ -182,6 +185,29 @@ LOCALVAR const ui3b my_disk_icon[] = {
 };
 #endif
 
+#if UseSonyPatch && IncludeExtnHostFS
+LOCALVAR const ui3b hostfs_call[] = {
+/*
+	Entry point for a guest file system that uses the HostFS
+	extension. Called with A0 pointing to an extension parameter
+	block with the command and parameters filled in, returns
+	the result in D0. Trashes A1.
+
+		move.l  template(pc),(a0)
+		movea.l pokeaddr(pc),a1
+		move.l  a0,(a1)
+		move.w  6(a0),d0
+		rts
+	template:
+		dc.w    kcom_callcheck, kExtnHostFS
+	pokeaddr:
+		dc.l    kExtn_Block_Base
+*/
+0x20, 0xBA, 0x00, 0x0E, 0x22, 0x7A, 0x00, 0x0E,
+0x22, 0x88, 0x30, 0x28, 0x00, 0x06, 0x4E, 0x75
+};
+#endif
+
 #if CurEmMd <= kEmMd_128K
 #define Sony_DriverBase 0x1690
 #elif CurEmMd <= kEmMd_Plus
@@ -213,6 +239,18 @@ LOCALPROC Sony_Install(void)
 	MyMoveBytes((anyp)my_disk_icon, (anyp)pto, sizeof(my_disk_icon));
 	pto += sizeof(my_disk_icon);
 
+#if IncludeExtnHostFS
+	my_hostfs_call_addr = (pto - ROM) + kROM_Base;
+	MyMoveBytes((anyp)hostfs_call, (anyp)pto, sizeof(hostfs_call));
+	pto += sizeof(hostfs_call);
+	do_put_mem_word(pto, kcom_callcheck);
+	pto += 2;
+	do_put_mem_word(pto, kExtnHostFS);
+	pto += 2;
+	do_put_mem_long(pto, kExtn_Block_Base); /* pokeaddr */
+	pto += 4;
+#endif
+
 #if UseLargeScreenHack
 	{
 		ui3p patchp = pto;
@@ -240,6 +278,13 @@ GLOBALFUNC blnr ROM_Init(void)
 {
 	ui5r CheckSum = do_get_mem_long(ROM);
 
+#if IncludeBench
+	if (MicroBench_IsStubROM()) {
+		/* nothing to check or patch */
+		return trueblnr;
+	}
+#endif
+
 	if (! Check_Checksum(CheckSum)) {
 		WarnMsgCorruptedROM();
 	} else
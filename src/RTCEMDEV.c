@@ -28,6 +28,9 @@
 #include "ENDIANAC.h"
 #include "EMCONFIG.h"
 #include "GLOBGLUE.h"
+#if IncludeSaveState
+#include "SAVESTAT.h"
+#endif
 #endif
 
 /* define _RTC_Debug */
@@ -74,11 +77,11 @@ typedef struct
 	ui3b PARAMRAM[PARAMRAMSize];
 } RTC_Ty;
 
-LOCALVAR RTC_Ty RTC;
+LOCALINSTVAR RTC_Ty RTC;
 
 /* RTC Functions */
 
-LOCALVAR ui5b LastRealDate;
+LOCALINSTVAR ui5b LastRealDate;
 
 #ifndef RTCinitPRAM
 #define RTCinitPRAM 1
@@ -505,3 +508,11 @@ GLOBALPROC RTCdataLine_ChangeNtfy(void)
 	}
 #endif
 }
+
+#if IncludeSaveState
+GLOBALPROC RTC_StateXfer(void)
+{
+	StateXferVar(RTC);
+	StateXferVar(LastRealDate);
+}
+#endif
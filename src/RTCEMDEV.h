@@ -21,6 +21,9 @@
 #endif
 
 EXPORTFUNC blnr RTC_Init(void);
+#if IncludeSaveState
+EXPORTPROC RTC_StateXfer(void);
+#endif
 EXPORTPROC RTC_Interrupt(void);
 
 EXPORTPROC RTCunEnabled_ChangeNtfy(void);
@@ -0,0 +1,673 @@
+/*
+	SAVESTAT.c
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	SAVE STATe
+
+	Snapshot of the whole emulated machine, taken between
+	ticks. Each device has a state transfer routine, listed
+	in StateSects below, that passes its variables to StateXfer.
+
+	Format (longs in the header are big endian):
+		0  : 'mvSS'
+		4  : version
+		8  : CurEmMd
+		12 : number of sections
+		16 : total size
+		20 : page size
+		24 : reserved (0), 2 longs
+		32 : section table, 16 bytes per section:
+			tag, offset, size, reserved (0)
+	The device sections follow the table, each long aligned, and
+	then, from the next page boundary on, the memory sections
+	(RAM, and video RAM if any), each page aligned. So the file
+	can be written with one writev, the header from a buffer and
+	the memory straight from where it lives, and read back by
+	mapping the file.
+
+	Device sections are in host byte order and layout. A state
+	is only expected to be loaded by the same build, and any
+	difference in a section size makes the load fail.
+*/
+
+#ifndef AllFiles
+#include "SYSDEPNS.h"
+
+#include "MYOSGLUE.h"
+#include "ENDIANAC.h"
+#include "EMCONFIG.h"
+#include "GLOBGLUE.h"
+#include "MINEM68K.h"
+#include "VIAEMDEV.h"
+#if EmVIA2
+#include "VIA2EMDV.h"
+#endif
+#include "IWMEMDEV.h"
+#include "SCCEMDEV.h"
+#if EmRTC
+#include "RTCEMDEV.h"
+#endif
+#include "SCSIEMDV.h"
+#include "SONYEMDV.h"
+#if EmClassicKbrd
+#include "KBRDEMDV.h"
+#endif
+#if MySoundEnabled && (CurEmMd != kEmMd_PB100) && ! EmASC
+#include "SNDEMDEV.h"
+#endif
+#include "PROGMAIN.h"
+#endif
+
+#include "SAVESTAT.h"
+
+#if IncludeSaveState
+
+#define kStateSig 0x6D765353 /* 'mvSS' */
+#define kStateVersion 1
+
+#define kStateOffset_Sig 0
+#define kStateOffset_Version 4
+#define kStateOffset_EmMd 8
+#define kStateOffset_NSects 12
+#define kStateOffset_Size 16
+#define kStateOffset_PageSz 20
+#define kStateOffset_Table 32
+
+#define kStateSectSz 16
+#define kStateSect_Tag 0
+#define kStateSect_Offset 4
+#define kStateSect_Size 8
+
+#if 0 != (kRAM_Size & (kStatePageSz - 1))
+#error "kRAM_Size must be a multiple of the page size"
+#endif
+
+typedef void (*StateXferProc)(void);
+
+struct StateSectR {
+	ui5b Tag;
+	StateXferProc Xfer;
+};
+typedef struct StateSectR StateSectR;
+
+LOCALVAR const StateSectR StateSects[] = {
+	/*
+		memory banks must be set up before the
+		CPU can find its program counter again.
+	*/
+	{ 0x474C5545 /* 'GLUE' */, AddrSpac_StateXfer },
+	{ 0x43505520 /* 'CPU ' */, m68k_StateXfer },
+	{ 0x4D41494E /* 'MAIN' */, ProgMain_StateXfer },
+	{ 0x56494131 /* 'VIA1' */, VIA1_StateXfer },
+#if EmVIA2
+	{ 0x56494132 /* 'VIA2' */, VIA2_StateXfer },
+#endif
+	{ 0x49574D20 /* 'IWM ' */, IWM_StateXfer },
+	{ 0x53434320 /* 'SCC ' */, SCC_StateXfer },
+#if EmRTC
+	{ 0x52544320 /* 'RTC ' */, RTC_StateXfer },
+#endif
+	{ 0x53435349 /* 'SCSI' */, SCSI_StateXfer },
+	{ 0x534F4E59 /* 'SONY' */, Sony_StateXfer },
+#if EmClassicKbrd
+	{ 0x4B425244 /* 'KBRD' */, KeyBoard_StateXfer },
+#endif
+#if MySoundEnabled && (CurEmMd != kEmMd_PB100) && ! EmASC
+	{ 0x534E4420 /* 'SND ' */, MacSound_StateXfer },
+#endif
+};
+
+#define kNumStateDevSects (sizeof(StateSects) / sizeof(StateSectR))
+
+#define kStateTagRAM 0x52414D20 /* 'RAM ' */
+#define kStateTagVidMem 0x564D454D /* 'VMEM' */
+
+#if IncludeVidMem
+#define kNumStateMemSects 2
+#else
+#define kNumStateMemSects 1
+#endif
+
+#define kNumStateSects (kNumStateDevSects + kNumStateMemSects)
+
+#define kStateHeaderSz (kStateOffset_Table + kNumStateSects * kStateSectSz)
+
+enum {
+	kStateModeMeasure,
+	kStateModeSave,
+	kStateModeCheck,
+	kStateModeLoad
+};
+
+LOCALINSTVAR int StateMode;
+LOCALINSTVAR ui3p StateP;
+LOCALINSTVAR ui5r StateLeft;
+LOCALINSTVAR blnr StateOk;
+
+GLOBALINSTVAR blnr StateLoading = falseblnr;
+
+GLOBALPROC StateXfer(anyp p, ui5r n)
+{
+	if (kStateModeMeasure == StateMode) {
+		StateLeft += n;
+	} else if (n > StateLeft) {
+		StateOk = falseblnr;
+	} else {
+		switch (StateMode) {
+			case kStateModeSave:
+				MyMoveBytes(p, (anyp)StateP, n);
+				break;
+			case kStateModeLoad:
+				MyMoveBytes((anyp)StateP, p, n);
+				break;
+			default:
+				break;
+		}
+		StateP += n;
+		StateLeft -= n;
+	}
+}
+
+GLOBALPROC StateXferCheck(ui5r v)
+{
+	ui3b b[4];
+
+	if ((kStateModeCheck == StateMode) && (StateLeft >= 4)
+		&& (do_get_mem_long(StateP) != (ui5b)v))
+	{
+		StateOk = falseblnr;
+	}
+	do_put_mem_long(b, v); /* saved big endian */
+	StateXfer((anyp)b, 4);
+}
+
+LOCALFUNC ui5r StateSectSize(int i)
+{
+	StateMode = kStateModeMeasure;
+	StateLeft = 0;
+	StateSects[i].Xfer();
+
+	return StateLeft;
+}
+
+#define StateRoundUp(x, a) (((x) + ((a) - 1)) & ~ (ui5r)((a) - 1))
+
+LOCALFUNC ui5r StateDevEnd(ui5r *Sizes)
+{
+	/* offset of the end of the device sections */
+	ui5r offset = kStateHeaderSz;
+	int i;
+
+	for (i = 0; i < kNumStateDevSects; ++i) {
+		Sizes[i] = StateSectSize(i);
+		offset = StateRoundUp(offset + Sizes[i], 4);
+	}
+
+	return offset;
+}
+
+GLOBALFUNC ui5r SaveState_HeaderSize(void)
+{
+	ui5r Sizes[kNumStateDevSects];
+
+	return StateRoundUp(StateDevEnd(Sizes), kStatePageSz);
+}
+
+LOCALPROC StatePutSect(ui3p Hdr, int i, ui5b Tag, ui5r offset, ui5r n)
+{
+	ui3p p = Hdr + kStateOffset_Table + i * kStateSectSz;
+
+	do_put_mem_long(p + kStateSect_Tag, Tag);
+	do_put_mem_long(p + kStateSect_Offset, offset);
+	do_put_mem_long(p + kStateSect_Size, n);
+	do_put_mem_long(p + 12, 0);
+}
+
+LOCALPROC StateSaveDevs(ui3p Hdr, ui5r *Sizes, ui5r HdrSz)
+{
+	ui5r offset = kStateHeaderSz;
+	ui5r j;
+	int i;
+
+	for (j = 0; j < HdrSz; ++j) {
+		Hdr[j] = 0;
+	}
+	for (i = 0; i < kNumStateDevSects; ++i) {
+		StatePutSect(Hdr, i, StateSects[i].Tag, offset, Sizes[i]);
+		StateMode = kStateModeSave;
+		StateP = Hdr + offset;
+		StateLeft = Sizes[i];
+		StateOk = trueblnr;
+		StateSects[i].Xfer();
+		offset = StateRoundUp(offset + Sizes[i], 4);
+	}
+}
+
+GLOBALFUNC int SaveState_Save(ui3p Hdr, ui3p *ChunkP, ui5r *ChunkN)
+{
+	/*
+		Hdr must have room for SaveState_HeaderSize bytes. Returns
+		the number of chunks, to be written one after the other.
+	*/
+	ui5r Sizes[kNumStateDevSects];
+	ui5r HdrSz = StateRoundUp(StateDevEnd(Sizes), kStatePageSz);
+	ui5r total;
+	int n = 0;
+	int i = kNumStateDevSects;
+
+	StateSaveDevs(Hdr, Sizes, HdrSz);
+
+	ChunkP[n] = Hdr;
+	ChunkN[n] = HdrSz;
+	++n;
+	total = HdrSz;
+
+	StatePutSect(Hdr, i++, kStateTagRAM, total, kRAM_Size);
+	ChunkP[n] = RAM;
+	ChunkN[n] = kRAM_Size;
+	++n;
+	total += kRAM_Size;
+
+#if IncludeVidMem
+	StatePutSect(Hdr, i++, kStateTagVidMem, total, kVidMemRAM_Size);
+	ChunkP[n] = VidMem;
+	ChunkN[n] = kVidMemRAM_Size;
+	++n;
+	total += kVidMemRAM_Size;
+#endif
+
+	do_put_mem_long(Hdr + kStateOffset_Sig, kStateSig);
+	do_put_mem_long(Hdr + kStateOffset_Version, kStateVersion);
+	do_put_mem_long(Hdr + kStateOffset_EmMd, CurEmMd);
+	do_put_mem_long(Hdr + kStateOffset_NSects, kNumStateSects);
+	do_put_mem_long(Hdr + kStateOffset_Size, total);
+	do_put_mem_long(Hdr + kStateOffset_PageSz, kStatePageSz);
+
+	return n;
+}
+
+LOCALFUNC blnr StateGetSect(ui3p p, ui5r L, int i, ui5b Tag,
+	ui5r n, ui3p *r)
+{
+	ui3p s = p + kStateOffset_Table + i * kStateSectSz;
+	ui5r offset = do_get_mem_long(s + kStateSect_Offset);
+
+	if ((do_get_mem_long(s + kStateSect_Tag) != Tag)
+		|| (do_get_mem_long(s + kStateSect_Size) != n)
+		|| (offset > L) || (n > L - offset))
+	{
+		return falseblnr;
+	}
+	*r = p + offset;
+
+	return trueblnr;
+}
+
+LOCALFUNC blnr StateRunSects(ui3p p, ui5r L, int Mode)
+{
+	ui5r Sizes[kNumStateDevSects];
+	ui3p s;
+	int i;
+
+	(void) StateDevEnd(Sizes);
+	StateOk = trueblnr;
+	for (i = 0; i < kNumStateDevSects; ++i) {
+		if (! StateGetSect(p, L, i, StateSects[i].Tag, Sizes[i], &s)) {
+			return falseblnr;
+		}
+		StateMode = Mode;
+		StateP = s;
+		StateLeft = Sizes[i];
+		StateLoading = (kStateModeLoad == Mode);
+		StateSects[i].Xfer();
+		StateLoading = falseblnr;
+		if (! StateOk) {
+			return falseblnr;
+		}
+	}
+
+	return trueblnr;
+}
+
+#if IncludeRewind
+FORWARDPROC RewindForget(void);
+#endif
+
+GLOBALFUNC blnr SaveState_Load(ui3p p, ui5r L)
+{
+	ui3p sRAM;
+#if IncludeVidMem
+	ui3p sVidMem;
+#endif
+
+	if ((L < kStateHeaderSz)
+		|| (do_get_mem_long(p + kStateOffset_Sig) != kStateSig)
+		|| (do_get_mem_long(p + kStateOffset_Version) != kStateVersion)
+		|| (do_get_mem_long(p + kStateOffset_EmMd) != CurEmMd)
+		|| (do_get_mem_long(p + kStateOffset_NSects) != kNumStateSects)
+		|| (! StateGetSect(p, L, kNumStateDevSects,
+			kStateTagRAM, kRAM_Size, &sRAM))
+#if IncludeVidMem
+		|| (! StateGetSect(p, L, kNumStateDevSects + 1,
+			kStateTagVidMem, kVidMemRAM_Size, &sVidMem))
+#endif
+		/* check everything before changing anything */
+		|| (! StateRunSects(p, L, kStateModeCheck)))
+	{
+		return falseblnr;
+	}
+
+	MyMoveBytes((anyp)sRAM, (anyp)RAM, kRAM_Size);
+#if IncludeVidMem
+	MyMoveBytes((anyp)sVidMem, (anyp)VidMem, kVidMemRAM_Size);
+#endif
+#if IncludeRewind
+	RewindForget();
+#endif
+
+	return StateRunSects(p, L, kStateModeLoad);
+}
+
+#if IncludeRewind
+/*
+	Going back in time. Every RewindEvery ticks a snapshot of
+	the devices is taken, and then, before the first write to
+	each page of memory since the snapshot, the old contents of
+	the page is saved (see Rewind_WriteNtfy). So a record holds
+	the devices at the snapshot, and the pages as they were
+	then, of just the memory since written. Going back applies
+	the records from newest to oldest.
+
+	The records are kept in a ring of page sized slots, taken
+	in order, and the oldest records are dropped when it is
+	full. The device state of a record is in consecutive slots
+	(slots at the end of the ring are skipped if needed).
+
+	Disk images, and a HostFS folder, are not part of a record.
+	Going back after the guest has written to a disk leaves the
+	image as it is, which may not match what the guest had
+	cached at the snapshot, so a warning is shown if any
+	writable disk is mounted.
+*/
+
+#if IncludeVidMem
+#define kRewindNumPages \
+	((kRAM_Size + kVidMemRAM_Size) >> kLn2RewindPageSz)
+#else
+#define kRewindNumPages (kRAM_Size >> kLn2RewindPageSz)
+#endif
+
+#define kRewindNumSlots (kRewindBudget >> kLn2RewindPageSz)
+#define kRewindMaxRecs 256
+#define kRewindNoPage ((ui5b) -1)
+
+GLOBALINSTVAR blnr RewindTracking = falseblnr;
+LOCALINSTVAR ui5r RewindEvery = 60;
+
+LOCALINSTVAR ui3p RewindPool = nullpr;
+LOCALINSTVAR ui5b *RewindSlotPage; /* page in each slot, or kRewindNoPage */
+LOCALINSTVAR ui3p RewindDirty; /* bit for each page saved since snapshot */
+
+LOCALINSTVAR ui5r RewindNextSlot = 0;
+LOCALINSTVAR ui5r RewindSlotsUsed = 0;
+
+LOCALINSTVAR ui5r RecFirstSlot[kRewindMaxRecs];
+LOCALINSTVAR ui5r RecNSlots[kRewindMaxRecs];
+LOCALINSTVAR ui5r RecHdrSlots[kRewindMaxRecs];
+	/* slots skipped, then slots of device state */
+LOCALINSTVAR ui5r RecDevSize[kRewindMaxRecs];
+LOCALINSTVAR ui5r RecOldest = 0;
+LOCALINSTVAR ui5r RecCount = 0;
+
+LOCALINSTVAR blnr RewindCapturing = falseblnr;
+	/* false if the newest record could not be kept */
+LOCALINSTVAR ui5r RewindTicks = 0; /* since the newest record */
+
+#define RewindSlotPtr(s) (RewindPool + ((s) << kLn2RewindPageSz))
+#define RecNewest ((RecOldest + RecCount - 1) % kRewindMaxRecs)
+
+GLOBALPROC Rewind_ReserveAlloc(void)
+{
+	ReserveAllocOneBlock(&RewindPool, kRewindBudget, 12, falseblnr);
+	ReserveAllocOneBlock((ui3p *)&RewindSlotPage,
+		kRewindNumSlots * sizeof(ui5b), 5, falseblnr);
+	ReserveAllocOneBlock(&RewindDirty,
+		(kRewindNumPages + 7) >> 3, 5, falseblnr);
+}
+
+LOCALPROC RewindClearDirty(void)
+{
+	ui5r i;
+
+	for (i = 0; i < ((kRewindNumPages + 7) >> 3); ++i) {
+		RewindDirty[i] = 0;
+	}
+
+	/* so the next write to each page comes through here */
+	m68k_WriteMATCsReset();
+}
+
+LOCALPROC RewindForget(void)
+{
+	RecCount = 0;
+	RewindSlotsUsed = 0;
+	RewindNextSlot = 0;
+	RewindCapturing = falseblnr;
+	RewindTicks = RewindEvery; /* new snapshot next tick */
+}
+
+LOCALPROC RewindDropOldest(void)
+{
+	RewindSlotsUsed -= RecNSlots[RecOldest];
+	RecOldest = (RecOldest + 1) % kRewindMaxRecs;
+	--RecCount;
+}
+
+LOCALFUNC blnr RewindAllocSlots(ui5r n, ui5r *r)
+{
+	/* n consecutive slots, added to the newest record */
+	ui5r skip = 0;
+
+	if (RewindNextSlot + n > kRewindNumSlots) {
+		skip = kRewindNumSlots - RewindNextSlot;
+	}
+	while (RewindSlotsUsed + skip + n > kRewindNumSlots) {
+		if (RecCount <= 1) {
+			/* the newest record doesn't fit on its own */
+			RewindForget();
+			return falseblnr;
+		}
+		RewindDropOldest();
+	}
+
+	while (0 != skip) {
+		RewindSlotPage[RewindNextSlot] = kRewindNoPage;
+		RewindNextSlot = 0;
+		++RewindSlotsUsed;
+		++RecNSlots[RecNewest];
+		--skip;
+	}
+	*r = RewindNextSlot;
+	RewindNextSlot += n;
+	if (RewindNextSlot == kRewindNumSlots) {
+		RewindNextSlot = 0;
+	}
+	RewindSlotsUsed += n;
+	RecNSlots[RecNewest] += n;
+
+	return trueblnr;
+}
+
+LOCALFUNC ui3p RewindPagePtr(ui5r page)
+{
+#if IncludeVidMem
+	if (page >= (kRAM_Size >> kLn2RewindPageSz)) {
+		return VidMem + ((page << kLn2RewindPageSz) - kRAM_Size);
+	}
+#endif
+	return RAM + (page << kLn2RewindPageSz);
+}
+
+GLOBALFUNC blnr Rewind_WriteNtfy(ui3p m)
+{
+	ui5r page;
+	ui3b bit;
+	ui5r s;
+
+	if ((m >= RAM) && (m < RAM + kRAM_Size)) {
+		page = (m - RAM) >> kLn2RewindPageSz;
+	} else
+#if IncludeVidMem
+	if ((m >= VidMem) && (m < VidMem + kVidMemRAM_Size)) {
+		page = (kRAM_Size + (m - VidMem)) >> kLn2RewindPageSz;
+	} else
+#endif
+	{
+		return falseblnr;
+	}
+
+	bit = 1 << (page & 7);
+	if (0 == (RewindDirty[page >> 3] & bit)) {
+		RewindDirty[page >> 3] |= bit;
+		if (RewindCapturing && RewindAllocSlots(1, &s)) {
+			RewindSlotPage[s] = page;
+			MyMoveBytes((anyp)RewindPagePtr(page),
+				(anyp)RewindSlotPtr(s), kRewindPageSz);
+		}
+	}
+
+	return trueblnr;
+}
+
+LOCALPROC RewindSnapshot(void)
+{
+	ui5r Sizes[kNumStateDevSects];
+	ui5r n = StateDevEnd(Sizes);
+	ui5r nSlots = (n + kRewindPageSz - 1) >> kLn2RewindPageSz;
+	ui5r r;
+	ui5r s;
+	ui5r i;
+
+	if (kRewindMaxRecs == RecCount) {
+		RewindDropOldest();
+	}
+	++RecCount;
+	r = RecNewest;
+	RecFirstSlot[r] = RewindNextSlot;
+	RecNSlots[r] = 0;
+	RecDevSize[r] = n;
+
+	RewindCapturing = RewindAllocSlots(nSlots, &s);
+	if (RewindCapturing) {
+		RecHdrSlots[r] = RecNSlots[r];
+		for (i = 0; i < nSlots; ++i) {
+			RewindSlotPage[s + i] = kRewindNoPage;
+		}
+		StateSaveDevs(RewindSlotPtr(s), Sizes, n);
+	}
+
+	RewindTicks = 0;
+	RewindClearDirty();
+}
+
+GLOBALPROC Rewind_Start(ui5r Every)
+{
+	if (0 != Every) {
+		RewindEvery = Every;
+	}
+	RewindTracking = trueblnr;
+	RewindForget();
+}
+
+GLOBALPROC Rewind_Tick(void)
+{
+	/* called at the start of each tick */
+	if (RewindTracking) {
+		if (RewindTicks >= RewindEvery) {
+			RewindSnapshot();
+		}
+		++RewindTicks;
+	}
+}
+
+LOCALPROC RewindUndo(ui5r r)
+{
+	/* put back the pages saved in record r */
+	ui5r s = RecFirstSlot[r];
+	ui5r i;
+	ui5b page;
+
+	for (i = 0; i < RecNSlots[r]; ++i) {
+		page = RewindSlotPage[s];
+		if (kRewindNoPage != page) {
+			MyMoveBytes((anyp)RewindSlotPtr(s),
+				(anyp)RewindPagePtr(page), kRewindPageSz);
+		}
+		if (++s == kRewindNumSlots) {
+			s = 0;
+		}
+	}
+}
+
+GLOBALFUNC blnr Rewind_Back(void)
+{
+	/*
+		back to the newest snapshot, or, if that was only
+		just taken, to the one before.
+	*/
+	ui5r r;
+	ui3p p;
+	blnr GoFurther;
+
+	if (! RewindCapturing || (0 == RecCount)) {
+		return falseblnr;
+	}
+
+	GoFurther = (RewindTicks < (RewindEvery >> 1)) && (RecCount > 1);
+	r = GoFurther ? (RecNewest + kRewindMaxRecs - 1) % kRewindMaxRecs
+		: RecNewest;
+	p = RewindSlotPtr((RecFirstSlot[r] + RecHdrSlots[r]
+		- ((RecDevSize[r] + kRewindPageSz - 1) >> kLn2RewindPageSz))
+		% kRewindNumSlots);
+
+	/* for instance, if disks have since been ejected */
+	if (! StateRunSects(p, RecDevSize[r], kStateModeCheck)) {
+		return falseblnr;
+	}
+
+	RewindUndo(RecNewest);
+	if (GoFurther) {
+		RewindSlotsUsed -= RecNSlots[RecNewest];
+		--RecCount;
+		RewindUndo(r);
+	}
+
+	/* r is the newest record again, with no pages saved yet */
+	RewindSlotsUsed -= RecNSlots[r] - RecHdrSlots[r];
+	RecNSlots[r] = RecHdrSlots[r];
+	RewindNextSlot = (RecFirstSlot[r] + RecHdrSlots[r])
+		% kRewindNumSlots;
+
+	(void) StateRunSects(p, RecDevSize[r], kStateModeLoad);
+
+	RewindTicks = 0;
+	RewindClearDirty();
+
+	return trueblnr;
+}
+#endif
+
+#endif /* IncludeSaveState */
@@ -0,0 +1,54 @@
+/*
+	SAVESTAT.h
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+#ifdef SAVESTAT_H
+#error "header already included"
+#else
+#define SAVESTAT_H
+#endif
+
+/*
+	for the state transfer routine of each device. The same
+	routine is used to measure, save, check and load the state,
+	so the order of fields can't get out of step.
+*/
+
+EXPORTPROC StateXfer(anyp p, ui5r n);
+#define StateXferVar(v) StateXfer((anyp)&(v), sizeof(v))
+EXPORTPROC StateXferCheck(ui5r v);
+	/* saved, and on load must match or the load fails */
+
+EXPORTINSTVAR(blnr, StateLoading)
+	/* true while loading, so a device can fix itself up after */
+
+/* for the platform glue */
+
+#define kLn2StatePageSz 12
+#define kStatePageSz (1 << kLn2StatePageSz)
+
+#define kStateMaxChunks 3
+
+EXPORTFUNC ui5r SaveState_HeaderSize(void);
+EXPORTFUNC int SaveState_Save(ui3p Hdr, ui3p *ChunkP, ui5r *ChunkN);
+EXPORTFUNC blnr SaveState_Load(ui3p p, ui5r L);
+
+#if IncludeRewind
+EXPORTPROC Rewind_Start(ui5r Every);
+	/* start tracking, with Every ticks between snapshots */
+EXPORTPROC Rewind_ReserveAlloc(void);
+EXPORTPROC Rewind_Tick(void);
+EXPORTFUNC blnr Rewind_Back(void);
+#endif
@@ -44,6 +44,9 @@
 #include "MYOSGLUE.h"
 #include "EMCONFIG.h"
 #include "GLOBGLUE.h"
+#if IncludeSaveState
+#include "SAVESTAT.h"
+#endif
 #endif
 
 #include "SCCEMDEV.h"
@@ -238,15 +241,15 @@ typedef struct {
 #endif
 } SCC_Ty;
 
-LOCALVAR SCC_Ty SCC;
+LOCALINSTVAR SCC_Ty SCC;
 
 #if 0
-LOCALVAR int ReadPrint;
-LOCALVAR int ReadModem;
+LOCALINSTVAR int ReadPrint;
+LOCALINSTVAR int ReadModem;
 #endif
 
 #if EmLocalTalk
-static int rx_data_offset = 0;
+LOCALINSTVAR int rx_data_offset = 0;
 	/* when data pending, this is used */
 #endif
 
@@ -588,9 +591,9 @@ GLOBALPROC SCC_Reset(void)
 
 #if EmLocalTalk
 
-LOCALVAR blnr CTSpacketPending = falseblnr;
-LOCALVAR ui3r CTSpacketRxDA;
-LOCALVAR ui3r CTSpacketRxSA;
+LOCALINSTVAR blnr CTSpacketPending = falseblnr;
+LOCALINSTVAR ui3r CTSpacketRxDA;
+LOCALINSTVAR ui3r CTSpacketRxSA;
 
 /*
 	Function used when all the tx data is sent to the SCC as indicated
@@ -636,7 +639,7 @@ LOCALPROC SCC_TxBuffPut(ui3r Data)
 	}
 }
 
-LOCALVAR ui3b MyCTSBuffer[4];
+LOCALINSTVAR ui3b MyCTSBuffer[4];
 
 LOCALPROC GetCTSpacket(void)
 {
@@ -717,7 +720,7 @@ LOCALPROC SCC_RxBuffAdvance(void)
 }
 
 /* LLAP/SDLC address */
-LOCALVAR ui3b my_node_address = 0;
+LOCALINSTVAR ui3b my_node_address = 0;
 
 LOCALPROC GetNextPacketForMe(void)
 {
@@ -2790,3 +2793,11 @@ GLOBALFUNC ui5b SCC_Access(ui5b Data, blnr WriteMem, CPTR addr)
 
 	return Data;
 }
+
+#if IncludeSaveState
+GLOBALPROC SCC_StateXfer(void)
+{
+	/* LocalTalk packets in flight are host state, not saved */
+	StateXferVar(SCC);
+}
+#endif
@@ -21,6 +21,9 @@
 #endif
 
 EXPORTPROC SCC_Reset(void);
+#if IncludeSaveState
+EXPORTPROC SCC_StateXfer(void);
+#endif
 
 EXPORTFUNC ui5b SCC_Access(ui5b Data, blnr WriteMem, CPTR addr);
 
@@ -17,7 +17,8 @@
 /*
 	Small Computer System Interface EMulated DeVice
 
-	Emulates the SCSI found in the Mac Plus.
+	Emulates the SCSI found in the Mac Plus, an NCR 5380,
+	with disk images as targets.
 
 	This code adapted from "SCSI.c" in vMac by Philip Cummins.
 */
@@ -31,125 +32,899 @@
 #include "MYOSGLUE.h"
 #include "EMCONFIG.h"
 #include "GLOBGLUE.h"
+#if IncludeSaveState
+#include "SAVESTAT.h"
+#endif
+#if EnableSCSIAccel
+#include "MINEM68K.h"
+#endif
 #endif
 
 #include "SCSIEMDV.h"
 
-#define scsiRd   0x00
-#define scsiWr   0x01
+/* register numbers, as passed to SCSI_Access */
 
 #define sCDR     0x00 /* current scsi data register  (r/o) */
 #define sODR     0x00 /* output data register        (w/o) */
-#define sICR     0x02 /* initiator command register  (r/w) */
-#define sMR      0x04 /* mode register               (r/w) */
-#define sTCR     0x06 /* target command register     (r/w) */
-#define sCSR     0x08 /* current SCSI bus status     (r/o) */
-#define sSER     0x08 /* select enable register      (w/o) */
-#define sBSR     0x0A /* bus and status register     (r/o) */
-#define sDMAtx   0x0A /* start DMA send              (w/o) */
-#define sIDR     0x0C /* input data register         (r/o) */
-#define sTDMArx  0x0C /* start DMA target receive    (w/o) */
-#define sRESET   0x0E /* reset parity/interrupt      (r/o) */
-#define sIDMArx  0x0E /* start DMA initiator receive (w/o) */
-
-#define kSCSI_Size 0x00010
-
-LOCALVAR ui3b SCSI[kSCSI_Size];
+#define sICR     0x01 /* initiator command register  (r/w) */
+#define sMR      0x02 /* mode register               (r/w) */
+#define sTCR     0x03 /* target command register     (r/w) */
+#define sCSR     0x04 /* current SCSI bus status     (r/o) */
+#define sSER     0x04 /* select enable register      (w/o) */
+#define sBSR     0x05 /* bus and status register     (r/o) */
+#define sDMAtx   0x05 /* start DMA send              (w/o) */
+#define sIDR     0x06 /* input data register         (r/o) */
+#define sTDMArx  0x06 /* start DMA target receive    (w/o) */
+#define sRESET   0x07 /* reset parity/interrupt      (r/o) */
+#define sIDMArx  0x07 /* start DMA initiator receive (w/o) */
 
-GLOBALPROC SCSI_Reset(void)
+#define kSCSI_dack 0x08 /* pseudo DMA access */
+
+/* bits of initiator command register */
+#define kICR_RST  0x80
+#define kICR_AIP  0x40 /* arbitration in progress, read only */
+#define kICR_LA   0x20 /* lost arbitration, read only */
+#define kICR_ACK  0x10
+#define kICR_BSY  0x08
+#define kICR_SEL  0x04
+#define kICR_ATN  0x02
+#define kICR_DBUS 0x01
+
+/* bits of mode register */
+#define kMR_DMA   0x02
+#define kMR_ARB   0x01
+
+/* bits of current SCSI bus status */
+#define kCSR_RST  0x80
+#define kCSR_BSY  0x40
+#define kCSR_REQ  0x20
+#define kCSR_MSG  0x10
+#define kCSR_CD   0x08
+#define kCSR_IO   0x04
+#define kCSR_SEL  0x02
+
+/* bits of bus and status register */
+#define kBSR_DRQ  0x40
+#define kBSR_PHSM 0x08
+#define kBSR_ATN  0x02
+#define kBSR_ACK  0x01
+
+/*
+	The emulated disks. Target n is the n-th disk image
+	marked for SCSI by the platform glue (see vSCSIDriveMask),
+	and is otherwise an ordinary disk image, accessed with
+	vSonyTransfer.
+*/
+
+#define kSCSI_OwnID 7 /* the Mac */
+#define kSCSI_NumTargets 7
+
+/*
+	Bus phases, as driven by the target. The low three bits
+	are MSG, C/D and I/O, as in the CSR and TCR.
+*/
+
+#define kPhaseDataOut  0x00
+#define kPhaseDataIn   0x01
+#define kPhaseCommand  0x02
+#define kPhaseStatus   0x03
+#define kPhaseMsgOut   0x06
+#define kPhaseMsgIn    0x07
+#define kPhaseSelected 0x10 /* BSY, waiting for SEL to go away */
+#define kPhaseBusFree  0x11
+
+#define PhaseBits(phase) (((phase) & 0x07) << 2)
+
+/* status bytes */
+#define kStatusGood  0x00
+#define kStatusCheck 0x02
+
+/* sense keys */
+#define kSenseNone          0x00
+#define kSenseNotReady      0x02
+#define kSenseMediumError   0x03
+#define kSenseIllegalRqst   0x05
+#define kSenseDataProtect   0x07
+
+#define kSCSI_ln2BlockSz 9
+#define kSCSI_BufSz 0x00010000
+	/*
+		data phases go through this buffer, so host disk
+		access is in large transfers, not a byte at a time.
+	*/
+
+LOCALINSTVAR ui3b SCSI_ODR;
+LOCALINSTVAR ui3b SCSI_ICR;
+LOCALINSTVAR ui3b SCSI_MR;
+LOCALINSTVAR ui3b SCSI_TCR;
+LOCALINSTVAR blnr SCSI_DMAActive;
+
+LOCALINSTVAR ui3b SCSI_Phase;
+LOCALINSTVAR tDrive SCSI_Drive; /* of selected target */
+LOCALINSTVAR ui3b SCSI_Cmd[12];
+LOCALINSTVAR ui3b SCSI_CmdLen;
+LOCALINSTVAR ui3b SCSI_Status;
+LOCALINSTVAR ui3b SCSI_SenseKey;
+LOCALINSTVAR ui3b SCSI_Buf[kSCSI_BufSz];
+LOCALINSTVAR ui5r SCSI_BufLen; /* bytes in phase, up to kSCSI_BufSz */
+LOCALINSTVAR ui5r SCSI_BufPos;
+LOCALINSTVAR ui5r SCSI_XferOffset; /* position in disk image */
+LOCALINSTVAR ui5r SCSI_XferLeft; /* bytes after the buffer */
+
+#define vSonyIsWritable(Drive_No) \
+	((vSonyWritableMask & ((ui5b)1 << (Drive_No))) != 0)
+
+#if IncludeSCSIDisks
+LOCALFUNC blnr SCSI_FindDrive(ui3r id, tDrive *Drive_No)
 {
-	int i;
+	/* disk for a target ID, if any */
+	tDrive i;
+	ui3r n = 0;
 
-	for (i = 0; i < kSCSI_Size; i++) {
-		SCSI[i] = 0;
+	for (i = 0; i < NumDrives; ++i) {
+		if (vSonyIsSCSI(i)) {
+			if (n == id) {
+				*Drive_No = i;
+				return trueblnr;
+			}
+			++n;
+		}
 	}
+
+	return falseblnr;
 }
+#endif
 
-LOCALPROC SCSI_BusReset(void)
+LOCALPROC SCSI_GoPhase(ui3r phase)
 {
-	SCSI[scsiRd + sCDR] = 0;
-	SCSI[scsiWr + sODR] = 0;
-	SCSI[scsiRd + sICR] = 0x80;
-	SCSI[scsiWr + sICR] &= 0x80;
-	SCSI[scsiRd + sMR] &= 0x40;
-	SCSI[scsiWr + sMR] &= 0x40;
-	SCSI[scsiRd + sTCR] = 0;
-	SCSI[scsiWr + sTCR] = 0;
-	SCSI[scsiRd + sCSR] = 0x80;
-	SCSI[scsiWr + sSER] = 0;
-	SCSI[scsiRd + sBSR] = 0x10;
-	SCSI[scsiWr + sDMAtx] = 0;
-	SCSI[scsiRd + sIDR] = 0;
-	SCSI[scsiWr + sTDMArx] = 0;
-	SCSI[scsiRd + sRESET] = 0;
-	SCSI[scsiWr + sIDMArx] = 0;
-#if 0
-	SCSI[scsiRd + sODR + dackWr] = 0;
-	SCSI[scsiWr + sIDR + dackRd] = 0;
-#endif
+	SCSI_Phase = phase;
+	SCSI_BufPos = 0;
+}
 
-	/* The missing piece of the puzzle.. :) */
-	put_ram_word(0xb22, get_ram_word(0xb22) | 0x8000);
+LOCALPROC SCSI_GoStatus(ui3r status, ui3r sensekey)
+{
+	SCSI_Status = status;
+	SCSI_SenseKey = sensekey;
+	SCSI_GoPhase(kPhaseStatus);
+}
+
+LOCALPROC SCSI_GoDataIn(ui5r n)
+{
+	/* SCSI_Buf already holds n bytes */
+	if (0 == n) {
+		SCSI_GoStatus(kStatusGood, kSenseNone);
+	} else {
+		SCSI_BufLen = n;
+		SCSI_GoPhase(kPhaseDataIn);
+	}
+}
+
+LOCALFUNC ui5r SCSI_NumBlocks(void)
+{
+	ui5r Count;
+
+	if (mnvm_noErr != vSonyGetSize(SCSI_Drive, &Count)) {
+		Count = 0;
+	}
+
+	return Count >> kSCSI_ln2BlockSz;
+}
+
+LOCALFUNC blnr SCSI_FillBuf(void)
+{
+	/* read the next part of a READ into SCSI_Buf */
+	ui5r n = SCSI_XferLeft;
+
+	if (n > kSCSI_BufSz) {
+		n = kSCSI_BufSz;
+	}
+	if (mnvm_noErr != vSonyTransfer(falseblnr, SCSI_Buf, SCSI_Drive,
+		SCSI_XferOffset, n, nullpr))
+	{
+		return falseblnr;
+	}
+	SCSI_XferOffset += n;
+	SCSI_XferLeft -= n;
+	SCSI_BufLen = n;
+	SCSI_BufPos = 0;
+
+	return trueblnr;
+}
+
+LOCALFUNC blnr SCSI_FlushBuf(void)
+{
+	/* write what has been received for a WRITE */
+	if (mnvm_noErr != vSonyTransfer(trueblnr, SCSI_Buf, SCSI_Drive,
+		SCSI_XferOffset, SCSI_BufPos, nullpr))
+	{
+		return falseblnr;
+	}
+	SCSI_XferOffset += SCSI_BufPos;
+	SCSI_XferLeft -= SCSI_BufPos;
+	SCSI_BufPos = 0;
+	SCSI_BufLen = (SCSI_XferLeft > kSCSI_BufSz)
+		? kSCSI_BufSz : SCSI_XferLeft;
+
+	return trueblnr;
+}
+
+LOCALPROC SCSI_StartXfer(blnr IsWrite, ui5r block, ui5r nBlocks)
+{
+	if ((block > SCSI_NumBlocks())
+		|| (nBlocks > SCSI_NumBlocks() - block))
+	{
+		SCSI_GoStatus(kStatusCheck, kSenseIllegalRqst);
+	} else if (0 == nBlocks) {
+		SCSI_GoStatus(kStatusGood, kSenseNone);
+	} else if (IsWrite && ! vSonyIsWritable(SCSI_Drive)) {
+		SCSI_GoStatus(kStatusCheck, kSenseDataProtect);
+	} else {
+		SCSI_XferOffset = block << kSCSI_ln2BlockSz;
+		SCSI_XferLeft = nBlocks << kSCSI_ln2BlockSz;
+		if (IsWrite) {
+			SCSI_BufPos = 0;
+			SCSI_BufLen = (SCSI_XferLeft > kSCSI_BufSz)
+				? kSCSI_BufSz : SCSI_XferLeft;
+			SCSI_Phase = kPhaseDataOut;
+		} else if (SCSI_FillBuf()) {
+			SCSI_Phase = kPhaseDataIn;
+		} else {
+			SCSI_GoStatus(kStatusCheck, kSenseMediumError);
+		}
+	}
+}
+
+LOCALPROC SCSI_DoCommand(void)
+{
+	ui5r i;
+	ui5r n;
+
+	SCSI_XferLeft = 0;
+
+	switch (SCSI_Cmd[0]) {
+		case 0x00: /* TEST UNIT READY */
+		case 0x01: /* REZERO UNIT */
+		case 0x04: /* FORMAT UNIT */
+		case 0x0B: /* SEEK */
+		case 0x15: /* MODE SELECT */
+		case 0x1B: /* START STOP UNIT */
+		case 0x1E: /* PREVENT ALLOW MEDIUM REMOVAL */
+		case 0x2F: /* VERIFY */
+			SCSI_GoStatus(kStatusGood, kSenseNone);
+			break;
+		case 0x03: /* REQUEST SENSE */
+			n = (0 == SCSI_Cmd[4]) ? 4 : SCSI_Cmd[4];
+			if (n > 18) {
+				n = 18;
+			}
+			for (i = 0; i < 18; ++i) {
+				SCSI_Buf[i] = 0;
+			}
+			SCSI_Buf[0] = 0x70; /* current error */
+			SCSI_Buf[2] = SCSI_SenseKey;
+			SCSI_Buf[7] = 10; /* additional length */
+			SCSI_SenseKey = kSenseNone;
+			SCSI_GoDataIn(n);
+			break;
+		case 0x08: /* READ(6) */
+		case 0x0A: /* WRITE(6) */
+			n = SCSI_Cmd[4];
+			SCSI_StartXfer(0x0A == SCSI_Cmd[0],
+				((SCSI_Cmd[1] & 0x1F) << 16)
+					| (SCSI_Cmd[2] << 8) | SCSI_Cmd[3],
+				(0 == n) ? 256 : n);
+			break;
+		case 0x28: /* READ(10) */
+		case 0x2A: /* WRITE(10) */
+			SCSI_StartXfer(0x2A == SCSI_Cmd[0],
+				do_get_mem_long(&SCSI_Cmd[2]),
+				do_get_mem_word(&SCSI_Cmd[7]));
+			break;
+		case 0x12: /* INQUIRY */
+			for (i = 0; i < 36; ++i) {
+				SCSI_Buf[i] = ' ';
+			}
+			SCSI_Buf[0] = 0x00; /* direct access device */
+			SCSI_Buf[1] = 0x00; /* not removable */
+			SCSI_Buf[2] = 0x01; /* SCSI-1 */
+			SCSI_Buf[3] = 0x01; /* CCS response format */
+			SCSI_Buf[4] = 31; /* additional length */
+			SCSI_Buf[5] = 0;
+			SCSI_Buf[6] = 0;
+			SCSI_Buf[7] = 0;
+			MyMoveBytes((ui3p)"MINIVMAC", &SCSI_Buf[8], 8);
+			MyMoveBytes((ui3p)"EMULATED DISK", &SCSI_Buf[16], 13);
+			MyMoveBytes((ui3p)"1.0 ", &SCSI_Buf[32], 4);
+			n = SCSI_Cmd[4];
+			SCSI_GoDataIn((n > 36) ? 36 : n);
+			break;
+		case 0x1A: /* MODE SENSE(6) */
+			n = SCSI_NumBlocks();
+			for (i = 0; i < 12; ++i) {
+				SCSI_Buf[i] = 0;
+			}
+			SCSI_Buf[0] = 11; /* mode data length */
+			SCSI_Buf[2] = vSonyIsWritable(SCSI_Drive) ? 0x00 : 0x80;
+			SCSI_Buf[3] = 8; /* block descriptor length */
+			do_put_mem_long(&SCSI_Buf[4], n & 0x00FFFFFF);
+			do_put_mem_long(&SCSI_Buf[8], 1 << kSCSI_ln2BlockSz);
+			n = SCSI_Cmd[4];
+			SCSI_GoDataIn((n > 12) ? 12 : n);
+			break;
+		case 0x25: /* READ CAPACITY */
+			do_put_mem_long(&SCSI_Buf[0], SCSI_NumBlocks() - 1);
+			do_put_mem_long(&SCSI_Buf[4], 1 << kSCSI_ln2BlockSz);
+			SCSI_GoDataIn(8);
+			break;
+		default:
+			ReportAbnormal("unknown SCSI command");
+			SCSI_GoStatus(kStatusCheck, kSenseIllegalRqst);
+			break;
+	}
 }
 
-LOCALPROC SCSI_Check(void)
+LOCALFUNC ui3r SCSI_CmdLength(ui3r opcode)
+{
+	switch (opcode >> 5) {
+		case 1:
+		case 2:
+			return 10;
+		case 5:
+			return 12;
+		default:
+			return 6;
+	}
+}
+
+LOCALFUNC ui3r SCSI_TargetData(void)
+{
+	/* byte the target is putting on the bus */
+	switch (SCSI_Phase) {
+		case kPhaseDataIn:
+			return SCSI_Buf[SCSI_BufPos];
+		case kPhaseStatus:
+			return SCSI_Status;
+		case kPhaseMsgIn:
+			return 0x00; /* command complete */
+		default:
+			return 0;
+	}
+}
+
+LOCALPROC SCSI_DataInNext(void)
+{
+	/* all of SCSI_Buf has been sent */
+	if (0 == SCSI_XferLeft) {
+		SCSI_GoStatus(kStatusGood, kSenseNone);
+	} else if (! SCSI_FillBuf()) {
+		SCSI_GoStatus(kStatusCheck, kSenseMediumError);
+	}
+}
+
+LOCALPROC SCSI_DataOutNext(void)
+{
+	/* SCSI_Buf is full */
+	if (! SCSI_FlushBuf()) {
+		SCSI_GoStatus(kStatusCheck, kSenseMediumError);
+	} else if (0 == SCSI_XferLeft) {
+		SCSI_GoStatus(kStatusGood, kSenseNone);
+	}
+}
+
+LOCALPROC SCSI_TransferByte(ui3r v)
 {
 	/*
-		The arbitration select/reselect scenario
-		[stub.. doesn't really work...]
+		REQ/ACK handshake for one byte. v is the byte from the
+		initiator, for phases where it sends.
 	*/
-	if ((SCSI[scsiWr + sODR] >> 7) == 1) {
-		/* Check if the Mac tries to be an initiator */
-		if ((SCSI[scsiWr + sMR] & 1) == 1) {
-			/* the Mac set arbitration in progress */
-			/*
-				stub! tell the mac that there
-				is arbitration in progress...
-			*/
-			SCSI[scsiRd + sICR] |= 0x40;
-			/* ... that we didn't lose arbitration ... */
-			SCSI[scsiRd + sICR] &= ~ 0x20;
-			/*
-				... and that there isn't a higher priority ID present...
-			*/
-			SCSI[scsiRd + sCDR] = 0x00;
-
-			/*
-				... the arbitration and selection/reselection is
-				complete. the initiator tries to connect to the SCSI
-				device, fails and returns after timeout.
-			*/
+	switch (SCSI_Phase) {
+		case kPhaseMsgOut:
+			/* accept IDENTIFY or anything else, then command */
+			SCSI_CmdLen = 0;
+			SCSI_GoPhase(kPhaseCommand);
+			break;
+		case kPhaseCommand:
+			SCSI_Cmd[SCSI_CmdLen++] = v;
+			if (SCSI_CmdLen == SCSI_CmdLength(SCSI_Cmd[0])) {
+				SCSI_DoCommand();
+			}
+			break;
+		case kPhaseDataIn:
+			if (++SCSI_BufPos == SCSI_BufLen) {
+				SCSI_DataInNext();
+			}
+			break;
+		case kPhaseDataOut:
+			SCSI_Buf[SCSI_BufPos++] = v;
+			if (SCSI_BufPos == SCSI_BufLen) {
+				SCSI_DataOutNext();
+			}
+			break;
+		case kPhaseStatus:
+			SCSI_GoPhase(kPhaseMsgIn);
+			break;
+		case kPhaseMsgIn:
+			SCSI_GoPhase(kPhaseBusFree);
+			break;
+		default:
+			break;
+	}
+}
+
+#define SCSI_TargetConnected() (SCSI_Phase < kPhaseBusFree)
+#define SCSI_REQ() \
+	(SCSI_TargetConnected() && (0 == (SCSI_ICR & kICR_ACK)))
+#define SCSI_PhaseMatch() \
+	(SCSI_TargetConnected() && ((SCSI_TCR & 0x07) == SCSI_Phase))
+
+LOCALPROC SCSI_CheckSelection(void)
+{
+	/* selection, with SEL asserted and BSY released */
+	if ((kPhaseBusFree == SCSI_Phase)
+		&& (0 != (SCSI_ICR & kICR_SEL))
+		&& (0 == (SCSI_ICR & kICR_BSY))
+		&& (0 == (SCSI_MR & kMR_ARB)))
+	{
+#if IncludeSCSIDisks
+		ui3r id;
+
+		for (id = 0; id < kSCSI_NumTargets; ++id) {
+			if ((0 != (SCSI_ODR & (1 << id)))
+				&& SCSI_FindDrive(id, &SCSI_Drive))
+			{
+				SCSI_Phase = kPhaseSelected;
+				break;
+			}
 		}
+#endif
+	}
+}
+
+LOCALPROC SCSI_BusReset(void)
+{
+	SCSI_Phase = kPhaseBusFree;
+	SCSI_DMAActive = falseblnr;
+	SCSI_SenseKey = kSenseNone;
+
+	/* The missing piece of the puzzle.. :) */
+	put_ram_word(0xb22, get_ram_word(0xb22) | 0x8000);
+}
+
+GLOBALPROC SCSI_Reset(void)
+{
+	SCSI_ODR = 0;
+	SCSI_ICR = 0;
+	SCSI_MR = 0;
+	SCSI_TCR = 0;
+	SCSI_DMAActive = falseblnr;
+	SCSI_Phase = kPhaseBusFree;
+	SCSI_SenseKey = kSenseNone;
+}
+
+LOCALFUNC ui3r SCSI_ReadReg(ui3r reg)
+{
+	ui3r v = 0;
+
+	switch (reg) {
+		case sCDR:
+			if (SCSI_TargetConnected() && (0 != (SCSI_Phase & 0x01))) {
+				v = SCSI_TargetData();
+			} else if (0 != (SCSI_ICR & kICR_DBUS)
+				|| (0 != (SCSI_MR & kMR_ARB)))
+			{
+				v = SCSI_ODR;
+			}
+			break;
+		case sICR:
+			v = SCSI_ICR;
+			if (0 != (SCSI_MR & kMR_ARB)) {
+				/* always win arbitration, no one else there */
+				v |= kICR_AIP;
+			}
+			break;
+		case sMR:
+			v = SCSI_MR;
+			break;
+		case sTCR:
+			v = SCSI_TCR;
+			break;
+		case sCSR:
+			if (0 != (SCSI_ICR & kICR_RST)) {
+				v |= kCSR_RST;
+			}
+			if (SCSI_TargetConnected()
+				|| (0 != (SCSI_ICR & kICR_BSY)))
+			{
+				v |= kCSR_BSY;
+			}
+			if (0 != (SCSI_ICR & kICR_SEL)) {
+				v |= kCSR_SEL;
+			}
+			if ((kPhaseSelected != SCSI_Phase) && SCSI_TargetConnected())
+			{
+				v |= PhaseBits(SCSI_Phase);
+				if (SCSI_REQ()) {
+					v |= kCSR_REQ;
+				}
+			}
+			break;
+		case sBSR:
+			if (SCSI_PhaseMatch() && (kPhaseSelected != SCSI_Phase)) {
+				v |= kBSR_PHSM;
+				if (SCSI_DMAActive && SCSI_REQ()) {
+					v |= kBSR_DRQ;
+				}
+			}
+			if (0 != (SCSI_ICR & kICR_ATN)) {
+				v |= kBSR_ATN;
+			}
+			if (0 != (SCSI_ICR & kICR_ACK)) {
+				v |= kBSR_ACK;
+			}
+			break;
+		case sIDR:
+			v = SCSI_TargetData();
+			break;
+		case sRESET:
+		default:
+			break;
 	}
 
-	/* check the chip registers, AS SET BY THE CPU */
-	if ((SCSI[scsiWr + sICR] >> 7) == 1) {
-		/* Check Assert RST */
-		SCSI_BusReset();
-	} else {
-		SCSI[scsiRd + sICR] &= ~ 0x80;
-		SCSI[scsiRd + sCSR] &= ~ 0x80;
+	return v;
+}
+
+LOCALPROC SCSI_WriteReg(ui3r reg, ui3r v)
+{
+	switch (reg) {
+		case sODR:
+			SCSI_ODR = v;
+			break;
+		case sICR:
+			{
+				ui3r old = SCSI_ICR;
+
+				SCSI_ICR = v & ~ (kICR_AIP | kICR_LA);
+				if (0 != (v & kICR_RST)) {
+					SCSI_BusReset();
+				}
+				if ((0 == (old & kICR_ACK)) && (0 != (v & kICR_ACK))
+					&& SCSI_PhaseMatch()
+					&& (kPhaseSelected != SCSI_Phase))
+				{
+					SCSI_TransferByte(SCSI_ODR);
+				}
+				if ((kPhaseSelected == SCSI_Phase)
+					&& (0 == (v & kICR_SEL)))
+				{
+					/* selection complete */
+					SCSI_CmdLen = 0;
+					SCSI_GoPhase((0 != (v & kICR_ATN))
+						? kPhaseMsgOut : kPhaseCommand);
+				}
+				SCSI_CheckSelection();
+			}
+			break;
+		case sMR:
+			SCSI_MR = v;
+			if (0 == (v & kMR_DMA)) {
+				SCSI_DMAActive = falseblnr;
+			}
+			SCSI_CheckSelection();
+			break;
+		case sTCR:
+			SCSI_TCR = v;
+			break;
+		case sDMAtx:
+		case sIDMArx:
+			if (0 != (SCSI_MR & kMR_DMA)) {
+				SCSI_DMAActive = trueblnr;
+			}
+			break;
+		case sSER:
+		case sTDMArx:
+		default:
+			break;
 	}
+}
 
-	if ((SCSI[scsiWr + sICR] >> 2) == 1) {
-		/* Check Assert SEL */
-		SCSI[scsiRd + sCSR] |= 0x02;
-		SCSI[scsiRd + sBSR] = 0x10;
+LOCALFUNC ui3r SCSI_DMAAccess(ui3r v, blnr WriteMem)
+{
+	/* pseudo DMA, a byte with the whole handshake */
+	if (SCSI_DMAActive && SCSI_PhaseMatch() && SCSI_REQ()
+		&& (kPhaseSelected != SCSI_Phase))
+	{
+		if (WriteMem) {
+			SCSI_TransferByte(v);
+		} else {
+			v = SCSI_TargetData();
+			SCSI_TransferByte(0);
+		}
 	} else {
-		SCSI[scsiRd + sCSR] &= ~ 0x02;
+		ReportAbnormal("SCSI DMA access when not ready");
 	}
+
+	return v;
 }
 
 GLOBALFUNC ui5b SCSI_Access(ui5b Data, blnr WriteMem, CPTR addr)
 {
-	addr *= 2;
-	if (addr < kSCSI_Size) {
-		if (WriteMem) {
-			SCSI[addr + 1] = Data;
-			SCSI_Check();
+	if (0 != (addr & kSCSI_dack)) {
+		Data = SCSI_DMAAccess(Data, WriteMem);
+	} else if (WriteMem) {
+		SCSI_WriteReg(addr & 0x07, Data);
+	} else {
+		Data = SCSI_ReadReg(addr & 0x07);
+	}
+
+	return Data;
+}
+
+#if EnableSCSIAccel
+
+/*
+	The SCSI Manager's blind transfers, SCSIRBlind and SCSIWBlind,
+	follow a transfer instruction block (TIB), with a pseudo DMA
+	access per byte. Done natively, each instruction is one copy
+	between SCSI_Buf and guest memory. Only scInc, scNoInc, scLoop,
+	scNop and scStop are handled. A TIB with anything else, or that
+	wants more bytes than the data phase has left, is left to
+	the ROM.
+*/
+
+#define kSCSI_scInc 1
+#define kSCSI_scNoInc 2
+#define kSCSI_scLoop 5
+#define kSCSI_scNop 6
+#define kSCSI_scStop 7
+
+#define kSCSI_scPhaseErr 5
+
+#define kSCSI_TIBInstrSz 10
+#define kSCSI_TIBMax 32 /* instructions */
+#define kSCSI_TIBMaxSteps 0x00010000
+
+typedef struct {
+	ui4r op;
+	ui5r p1;
+	ui5r p2;
+} SCSI_TIBInstr;
+
+LOCALFUNC ui5r SCSI_BlindLeft(blnr IsWrite)
+{
+	/* bytes left in the data phase, if it goes the right way */
+	ui5r n = 0;
+
+	if (SCSI_REQ()) {
+		if (IsWrite) {
+			if (kPhaseDataOut == SCSI_Phase) {
+				n = SCSI_XferLeft - SCSI_BufPos;
+			}
 		} else {
-			Data = SCSI[addr];
+			if (kPhaseDataIn == SCSI_Phase) {
+				n = SCSI_BufLen - SCSI_BufPos + SCSI_XferLeft;
+			}
 		}
 	}
-	return Data;
+
+	return n;
+}
+
+LOCALFUNC ui5r SCSI_BlindXfer(blnr IsWrite, ui3p p, ui5r n, blnr Inc)
+{
+	/*
+		n bytes of the data phase, to or from p, or over and over
+		at p if not Inc. Returns how many were moved, fewer than n
+		only if the disk image gave an error.
+	*/
+	ui5r k;
+	ui5r i;
+	ui5r done = 0;
+	ui3r phase = IsWrite ? kPhaseDataOut : kPhaseDataIn;
+
+	while ((done < n) && (phase == SCSI_Phase)) {
+		k = SCSI_BufLen - SCSI_BufPos;
+		if (k > n - done) {
+			k = n - done;
+		}
+		if (Inc) {
+			if (IsWrite) {
+				MyMoveBytes((anyp)p, (anyp)(SCSI_Buf + SCSI_BufPos), k);
+			} else {
+				MyMoveBytes((anyp)(SCSI_Buf + SCSI_BufPos), (anyp)p, k);
+			}
+			p += k;
+		} else {
+			if (IsWrite) {
+				for (i = 0; i < k; ++i) {
+					SCSI_Buf[SCSI_BufPos + i] = *p;
+				}
+			} else {
+				*p = SCSI_Buf[SCSI_BufPos + k - 1];
+			}
+		}
+		SCSI_BufPos += k;
+		done += k;
+		if (SCSI_BufPos == SCSI_BufLen) {
+			if (IsWrite) {
+				SCSI_DataOutNext();
+			} else {
+				SCSI_DataInNext();
+			}
+		}
+	}
+
+	return done;
+}
+
+LOCALFUNC blnr SCSI_TIBRun(SCSI_TIBInstr *t, ui5r nt,
+	blnr IsWrite, blnr Doit, ui5r *Count)
+{
+	/*
+		Follows the copy t of the TIB, changing it as the ROM
+		would change the real one. Without Doit only checks that
+		it can be done and counts the bytes, so that nothing has
+		happened if the ROM has to do it after all.
+	*/
+	ui5r i = 0;
+	ui5r steps = 0;
+	ui5r total = 0;
+	ui5r Left = SCSI_BlindLeft(IsWrite);
+	ui5r n;
+	si5r j;
+	ui3p p;
+	blnr Inc;
+	SCSI_TIBInstr *c;
+	blnr IsOk = falseblnr;
+
+	while ((i < nt) && (++steps <= kSCSI_TIBMaxSteps)) {
+		c = &t[i];
+		if (kSCSI_scStop == c->op) {
+			IsOk = trueblnr;
+			break;
+		} else if (kSCSI_scNop == c->op) {
+			++i;
+		} else if ((kSCSI_scInc == c->op) || (kSCSI_scNoInc == c->op)) {
+			n = c->p2;
+			if (0 != n) {
+				Inc = (kSCSI_scInc == c->op);
+				if (n > Left - total) {
+					break;
+				}
+				p = IsWrite
+					? TrapAccel_Src(c->p1 & 0x00FFFFFF, Inc ? n : 1)
+					: TrapAccel_Dst(c->p1 & 0x00FFFFFF, Inc ? n : 1);
+				if (nullpr == p) {
+					break;
+				}
+				if (Doit && (n != SCSI_BlindXfer(IsWrite, p, n, Inc))) {
+					break;
+				}
+				total += n;
+				if (Inc) {
+					c->p1 += n;
+				}
+			}
+			++i;
+		} else if (kSCSI_scLoop == c->op) {
+			/* p1 is a byte offset from this instruction */
+			if ((si5r)--c->p2 > 0) {
+				j = (si5r)c->p1;
+				if (0 != (j % kSCSI_TIBInstrSz)) {
+					break;
+				}
+				j = (si5r)i + j / kSCSI_TIBInstrSz;
+				if ((j < 0) || (j >= (si5r)nt)) {
+					break;
+				}
+				i = j;
+			} else {
+				++i;
+			}
+		} else {
+			break;
+		}
+	}
+
+	*Count = total;
+	return IsOk;
 }
+
+GLOBALFUNC blnr SCSI_AccelDispatch(void)
+{
+	/*
+		_SCSIDispatch, with the selector word on the stack, then
+		the TIB pointer, then room for the OSErr result.
+	*/
+	SCSI_TIBInstr t[kSCSI_TIBMax];
+	SCSI_TIBInstr t0[kSCSI_TIBMax];
+	ui3p a = TrapAccel_Dst(TrapAccel_AReg(7), 8);
+	ui3p p;
+	CPTR tib;
+	ui5r nt;
+	ui5r i;
+	ui5r total;
+	ui4r sel;
+	ui4r err = 0;
+	blnr IsWrite;
+
+	if (nullpr == a) {
+		return falseblnr;
+	}
+	sel = do_get_mem_word(a);
+	if (8 == sel) { /* SCSIRBlind */
+		IsWrite = falseblnr;
+	} else if (9 == sel) { /* SCSIWBlind */
+		IsWrite = trueblnr;
+	} else {
+		return falseblnr;
+	}
+	tib = do_get_mem_long(a + 2) & 0x00FFFFFF;
+
+	/* copy the TIB, up to scStop */
+	nt = 0;
+	do {
+		if (nt >= kSCSI_TIBMax) {
+			return falseblnr;
+		}
+		p = TrapAccel_Dst(tib + nt * kSCSI_TIBInstrSz, kSCSI_TIBInstrSz);
+		if (nullpr == p) {
+			return falseblnr;
+		}
+		t[nt].op = do_get_mem_word(p);
+		t[nt].p1 = do_get_mem_long(p + 2);
+		t[nt].p2 = do_get_mem_long(p + 6);
+	} while (kSCSI_scStop != t[nt++].op);
+
+	for (i = 0; i < nt; ++i) {
+		t0[i] = t[i];
+	}
+	if (! SCSI_TIBRun(t0, nt, IsWrite, falseblnr, &total)) {
+		return falseblnr;
+	}
+
+	/* the registers as the ROM leaves them */
+	SCSI_TCR = (SCSI_TCR & ~ 0x07) | SCSI_Phase;
+	if (! SCSI_TIBRun(t, nt, IsWrite, trueblnr, &total)) {
+		err = kSCSI_scPhaseErr;
+	}
+	SCSI_MR &= ~ kMR_DMA;
+	SCSI_DMAActive = falseblnr;
+
+	for (i = 0; i < nt; ++i) {
+		p = TrapAccel_Dst(tib + i * kSCSI_TIBInstrSz, kSCSI_TIBInstrSz);
+		do_put_mem_long(p + 2, t[i].p1);
+		do_put_mem_long(p + 6, t[i].p2);
+	}
+
+	do_put_mem_word(a + 6, err);
+	TrapAccel_Done(6, 200 + 20 * total);
+
+	return trueblnr;
+}
+
+#endif /* EnableSCSIAccel */
+
+#if IncludeSaveState
+GLOBALPROC SCSI_StateXfer(void)
+{
+	StateXferVar(SCSI_ODR);
+	StateXferVar(SCSI_ICR);
+	StateXferVar(SCSI_MR);
+	StateXferVar(SCSI_TCR);
+	StateXferVar(SCSI_DMAActive);
+	StateXferVar(SCSI_Phase);
+	StateXferVar(SCSI_Drive);
+	StateXferVar(SCSI_Cmd);
+	StateXferVar(SCSI_CmdLen);
+	StateXferVar(SCSI_Status);
+	StateXferVar(SCSI_SenseKey);
+	StateXferVar(SCSI_BufLen);
+	StateXferVar(SCSI_BufPos);
+	StateXferVar(SCSI_XferOffset);
+	StateXferVar(SCSI_XferLeft);
+	if ((kPhaseDataIn == SCSI_Phase) || (kPhaseDataOut == SCSI_Phase)) {
+		/* the rest of SCSI_Buf means nothing outside a data phase */
+		StateXfer((anyp)SCSI_Buf, SCSI_BufLen);
+	}
+}
+#endif
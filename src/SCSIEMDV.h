@@ -21,5 +21,12 @@
 #endif
 
 EXPORTPROC SCSI_Reset(void);
+#if IncludeSaveState
+EXPORTPROC SCSI_StateXfer(void);
+#endif
 
 EXPORTFUNC ui5b SCSI_Access(ui5b Data, blnr WriteMem, CPTR addr);
+
+#if EnableSCSIAccel
+EXPORTFUNC blnr SCSI_AccelDispatch(void);
+#endif
@@ -28,6 +28,9 @@
 #include "MYOSGLUE.h"
 #include "EMCONFIG.h"
 #include "GLOBGLUE.h"
+#if IncludeSaveState
+#include "SAVESTAT.h"
+#endif
 #endif
 
 #include "SNDEMDEV.h"
@@ -98,8 +101,8 @@ LOCALVAR const ui3r SubTick_n[kNumSubTicks] = {
 	writing offset 0 before it is read.
 */
 
-LOCALVAR ui5b SoundInvertPhase = 0;
-LOCALVAR ui4b SoundInvertState = 0;
+LOCALINSTVAR ui5b SoundInvertPhase = 0;
+LOCALINSTVAR ui4b SoundInvertState = 0;
 
 IMPORTFUNC ui4b GetSoundInvertTime(void);
 
@@ -211,3 +214,11 @@ label_retry:
 }
 
 #endif
+
+#if IncludeSaveState
+GLOBALPROC MacSound_StateXfer(void)
+{
+	StateXferVar(SoundInvertPhase);
+	StateXferVar(SoundInvertState);
+}
+#endif
@@ -22,4 +22,7 @@
 
 #if MySoundEnabled
 EXPORTPROC MacSound_SubTick(int SubTick);
+#if IncludeSaveState
+EXPORTPROC MacSound_StateXfer(void);
+#endif
 #endif
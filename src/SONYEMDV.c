@@ -35,12 +35,15 @@
 #include "EMCONFIG.h"
 #include "GLOBGLUE.h"
 #include "MINEM68K.h"
+#if IncludeSaveState
+#include "SAVESTAT.h"
+#endif
 #endif
 
 #include "SONYEMDV.h"
 
 
-LOCALVAR ui5b vSonyMountedMask = 0;
+LOCALINSTVAR ui5b vSonyMountedMask = 0;
 
 #define vSonyIsLocked(Drive_No) \
 	((vSonyWritableMask & ((ui5b)1 << (Drive_No))) == 0)
@@ -51,6 +54,9 @@ LOCALFUNC blnr vSonyNextPendingInsert0(tDrive *Drive_No)
 {
 	/* find next drive to Mount */
 	ui5b MountPending = vSonyInsertedMask & (~ vSonyMountedMask);
+#if IncludeSCSIDisks
+	MountPending &= ~ vSCSIDriveMask;
+#endif
 	if (MountPending != 0) {
 		tDrive i;
 		for (i = 0; i < NumDrives; ++i) {
@@ -147,13 +153,13 @@ label_1:
 	}
 }
 
-LOCALVAR ui5r ImageDataOffset[NumDrives];
+LOCALINSTVAR ui5r ImageDataOffset[NumDrives];
 	/* size of any header in disk image file */
-LOCALVAR ui5r ImageDataSize[NumDrives];
+LOCALINSTVAR ui5r ImageDataSize[NumDrives];
 	/* size of disk image file contents */
 
 #if Sony_SupportTags
-LOCALVAR ui5r ImageTagOffset[NumDrives];
+LOCALINSTVAR ui5r ImageTagOffset[NumDrives];
 	/* offset to disk image file tags */
 #endif
 
@@ -171,14 +177,43 @@ LOCALVAR ui5r ImageTagOffset[NumDrives];
 
 #define ChecksumBlockSize 1024
 
-#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+#if Sony_SupportDC42 && (Sony_WantChecksumsUpdated || Sony_VerifyChecksums)
+LOCALFUNC ui5b DC42SumWords(ui5b sum, ui3p p, ui5r n)
+{
+	/*
+		add n words to Checksum. each step depends on the
+		last, so this can't be done in parallel, but unrolling
+		at least saves the loop overhead.
+	*/
+#define DC42SumWord(i) \
+	sum += do_get_mem_word(p + (i)); \
+	sum = (sum >> 1) | ((sum & 1) << 31); /* ROR.l sum+word */
+
+	while (n >= 4) {
+		DC42SumWord(0)
+		DC42SumWord(2)
+		DC42SumWord(4)
+		DC42SumWord(6)
+		p += 8;
+		n -= 4;
+	}
+	while (0 != n) {
+		DC42SumWord(0)
+		p += 2;
+		--n;
+	}
+
+	return sum;
+}
+#endif
+
+#if Sony_SupportDC42 && Sony_VerifyChecksums
 LOCALFUNC tMacErr DC42BlockChecksum(tDrive Drive_No,
 	ui5r Sony_Start, ui5r Sony_Count, ui5r *r)
 {
 	tMacErr result;
 	ui5r n;
 	ui3b Buffer[ChecksumBlockSize];
-	ui3b *p;
 	ui5b sum = 0;
 	ui5r offset = Sony_Start;
 	ui5r remaining = Sony_Count;
@@ -200,16 +235,7 @@ LOCALFUNC tMacErr DC42BlockChecksum(tDrive Drive_No,
 		offset += n;
 		remaining -= n;
 
-		/* add to Checksum */
-		p = Buffer;
-		n >>= 1; /* n = number of words */
-		while (0 != n) {
-			--n;
-			/* ROR.l sum+word */
-			sum += do_get_mem_word(p);
-			p += 2;
-			sum = (sum >> 1) | ((sum & 1) << 31);
-		}
+		sum = DC42SumWords(sum, Buffer, n >> 1);
 	}
 
 	*r = sum;
@@ -217,6 +243,151 @@ LOCALFUNC tMacErr DC42BlockChecksum(tDrive Drive_No,
 }
 #endif
 
+#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+/*
+	Keeping the Checksums up to date. The Checksum can't be
+	updated for just the words written, since the rotate doesn't
+	distribute over the add. Instead, after the first write, the
+	Checksum is recomputed a little at a time in Sony_Update,
+	saving the running sum at the start of each of up to
+	kDC42CkNChunks chunks. A write then only needs the sum redone
+	from the start of the chunk it is in. Whatever is left to do
+	at eject is done then, and if nothing was written, nothing
+	needs doing.
+*/
+
+#define kDC42CkNChunks 64
+#define kDC42CkBlocksPerTick 16
+	/* ChecksumBlockSize blocks summed per tick */
+
+enum {
+	kDC42CkData,
+#if Sony_SupportTags
+	kDC42CkTags,
+#endif
+	kNumDC42CkAreas
+};
+
+LOCALINSTVAR blnr DC42CkOn[NumDrives];
+LOCALINSTVAR blnr DC42CkDirty[NumDrives];
+LOCALINSTVAR ui5r DC42CkStart[NumDrives][kNumDC42CkAreas];
+	/* file offset of checksummed area */
+LOCALINSTVAR ui5r DC42CkSize[NumDrives][kNumDC42CkAreas];
+LOCALINSTVAR ui5r DC42CkChunkSz[NumDrives][kNumDC42CkAreas];
+	/* a multiple of ChecksumBlockSize */
+LOCALINSTVAR ui5r DC42CkDone[NumDrives][kNumDC42CkAreas];
+	/* bytes summed so far */
+LOCALINSTVAR ui5b DC42CkSum[NumDrives][kNumDC42CkAreas];
+	/* sum of first DC42CkDone bytes */
+LOCALINSTVAR ui5b DC42CkState[NumDrives][kNumDC42CkAreas][kDC42CkNChunks];
+	/* sum at start of each chunk summed so far */
+
+LOCALPROC DC42CkSetArea(tDrive Drive_No, int area,
+	ui5r Start, ui5r Size)
+{
+	ui5r ChunkSz = Size / kDC42CkNChunks + 1;
+
+	ChunkSz = (ChunkSz + ChecksumBlockSize - 1)
+		& ~ (ui5r)(ChecksumBlockSize - 1);
+
+	DC42CkStart[Drive_No][area] = Start;
+	DC42CkSize[Drive_No][area] = Size;
+	DC42CkChunkSz[Drive_No][area] = ChunkSz;
+	DC42CkDone[Drive_No][area] = 0;
+	DC42CkSum[Drive_No][area] = 0;
+}
+
+LOCALPROC DC42CkNoteWrite(tDrive Drive_No,
+	ui5r Sony_Start, ui5r Sony_Count)
+{
+	/* Sony_Start is offset in image file */
+	if (DC42CkOn[Drive_No] && (0 != Sony_Count)) {
+		int area;
+
+		DC42CkDirty[Drive_No] = trueblnr;
+		for (area = 0; area < kNumDC42CkAreas; ++area) {
+			ui5r Start = DC42CkStart[Drive_No][area];
+
+			if ((Sony_Start + Sony_Count > Start)
+				&& (Sony_Start < Start + DC42CkSize[Drive_No][area]))
+			{
+				ui5r chunk = (Sony_Start <= Start) ? 0
+					: (Sony_Start - Start)
+						/ DC42CkChunkSz[Drive_No][area];
+				ui5r offset = chunk * DC42CkChunkSz[Drive_No][area];
+
+				if (DC42CkDone[Drive_No][area] > offset) {
+					DC42CkDone[Drive_No][area] = offset;
+					DC42CkSum[Drive_No][area] =
+						DC42CkState[Drive_No][area][chunk];
+				}
+			}
+		}
+	}
+}
+
+LOCALFUNC tMacErr DC42CkAdvance(tDrive Drive_No, int area,
+	ui5r nBlocks)
+{
+	/* sum up to nBlocks more blocks, all if nBlocks is 0 */
+	tMacErr result = mnvm_noErr;
+	ui3b Buffer[ChecksumBlockSize];
+	ui5r Size = DC42CkSize[Drive_No][area];
+	ui5r ChunkSz = DC42CkChunkSz[Drive_No][area];
+	ui5r Done = DC42CkDone[Drive_No][area];
+	ui5b sum = DC42CkSum[Drive_No][area];
+	ui5r n;
+
+	while (Done < Size) {
+		if (0 == (Done % ChunkSz)) {
+			DC42CkState[Drive_No][area][Done / ChunkSz] = sum;
+		}
+
+		n = Size - Done;
+		if (n > ChecksumBlockSize) {
+			n = ChecksumBlockSize;
+		}
+		result = vSonyTransfer(falseblnr, Buffer, Drive_No,
+			DC42CkStart[Drive_No][area] + Done, n, nullpr);
+		if (mnvm_noErr != result) {
+			break;
+		}
+		sum = DC42SumWords(sum, Buffer, n >> 1);
+		Done += n;
+
+		if (1 == nBlocks) {
+			break;
+		} else if (0 != nBlocks) {
+			--nBlocks;
+		}
+	}
+
+	DC42CkDone[Drive_No][area] = Done;
+	DC42CkSum[Drive_No][area] = sum;
+
+	return result;
+}
+
+LOCALPROC DC42CkUpdate(void)
+{
+	/* called each tick, to keep up with writes */
+	tDrive i;
+	int area;
+
+	for (i = 0; i < NumDrives; ++i) {
+		if (DC42CkOn[i] && DC42CkDirty[i]) {
+			for (area = 0; area < kNumDC42CkAreas; ++area) {
+				if (DC42CkDone[i][area] < DC42CkSize[i][area]) {
+					(void) DC42CkAdvance(i, area,
+						kDC42CkBlocksPerTick);
+					return;
+				}
+			}
+		}
+	}
+}
+#endif
+
 #if Sony_SupportDC42 && Sony_WantChecksumsUpdated
 #if Sony_SupportTags
 #define SizeCheckSumsToUpdate 8
@@ -228,56 +399,31 @@ LOCALFUNC tMacErr DC42BlockChecksum(tDrive Drive_No,
 #if Sony_WantChecksumsUpdated
 LOCALPROC Drive_UpdateChecksums(tDrive Drive_No)
 {
-	if (! vSonyIsLocked(Drive_No)) {
-		ui5r DataOffset = ImageDataOffset[Drive_No];
 #if Sony_SupportDC42
-		if (kDC42offset_userData == DataOffset) {
-			/* a disk copy 4.2 image */
-			tMacErr result;
-			ui5r dataChecksum;
+	if (DC42CkOn[Drive_No]) {
+		DC42CkOn[Drive_No] = falseblnr;
+		if (DC42CkDirty[Drive_No] && ! vSonyIsLocked(Drive_No)) {
+			/* a disk copy 4.2 image, that has been written to */
 			ui3b Buffer[SizeCheckSumsToUpdate];
 			ui5r Sony_Count = SizeCheckSumsToUpdate;
-			ui5r DataSize = ImageDataSize[Drive_No];
+			ui5b sum;
+			int area;
 
-			/* Checksum image data */
-			result = DC42BlockChecksum(Drive_No,
-				DataOffset, DataSize, &dataChecksum);
-			if (mnvm_noErr != result) {
-				ReportAbnormal("Failed to find dataChecksum");
-				dataChecksum = 0;
-			}
-			do_put_mem_long(Buffer, dataChecksum);
-#if Sony_SupportTags
-			{
-				ui5r tagChecksum;
-				ui5r TagOffset = ImageTagOffset[Drive_No];
-				ui5r TagSize =
-					(0 == TagOffset) ? 0 : ((DataSize >> 9) * 12);
-				if (TagSize < 12) {
-					tagChecksum = 0;
+			for (area = 0; area < kNumDC42CkAreas; ++area) {
+				if (mnvm_noErr == DC42CkAdvance(Drive_No, area, 0)) {
+					sum = DC42CkSum[Drive_No][area];
 				} else {
-					/*
-						Checksum of tags doesn't include first block.
-						presumably because of bug in original disk
-						copy program.
-					*/
-					result = DC42BlockChecksum(Drive_No,
-						TagOffset + 12, TagSize - 12, &tagChecksum);
-					if (mnvm_noErr != result) {
-						ReportAbnormal("Failed to find tagChecksum");
-						tagChecksum = 0;
-					}
+					ReportAbnormal("Failed to find Checksum");
+					sum = 0;
 				}
-				do_put_mem_long(Buffer + 4, tagChecksum);
+				do_put_mem_long(Buffer + 4 * area, sum);
 			}
-#endif
-
 			/* write Checksums */
 			vSonyTransfer(trueblnr, Buffer, Drive_No,
 				kDC42offset_dataChecksum, Sony_Count, nullpr);
 		}
-#endif
 	}
+#endif
 }
 #endif
 
@@ -304,6 +450,10 @@ LOCALFUNC tMacErr vSonyNextPendingInsert(tDrive *Drive_No)
 			ui5r TagOffset = 0;
 #endif
 
+#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+			DC42CkOn[i] = falseblnr;
+#endif
+
 #if Sony_SupportOtherFormats
 #if IncludeSonyRawMode
 			if (! vSonyRawMode)
@@ -378,6 +528,26 @@ LOCALFUNC tMacErr vSonyNextPendingInsert(tDrive *Drive_No)
 								TagOffset =
 									(0 == TagSize0) ? 0 : TagOffset0;
 #endif
+#if Sony_WantChecksumsUpdated
+								DC42CkOn[i] = trueblnr;
+								DC42CkDirty[i] = falseblnr;
+								DC42CkSetArea(i, kDC42CkData,
+									DataOffset0, DataSize0);
+#if Sony_SupportTags
+								/*
+									Checksum of tags doesn't include
+									first block. presumably because of
+									bug in original disk copy program.
+								*/
+								if (TagSize0 >= 12) {
+									DC42CkSetArea(i, kDC42CkTags,
+										TagOffset0 + 12, TagSize0 - 12);
+								} else {
+									DC42CkSetArea(i, kDC42CkTags,
+										TagOffset0, 0);
+								}
+#endif
+#endif
 
 #if (! Sony_SupportTags) || (! Sony_WantChecksumsUpdated)
 								if (! vSonyIsLocked(i)) {
@@ -425,13 +595,17 @@ LOCALFUNC tMacErr vSonyNextPendingInsert(tDrive *Drive_No)
 		if call PostEvent too frequently, insert events seem to get lost
 	*/
 
-LOCALVAR ui4r DelayUntilNextInsert;
+LOCALINSTVAR ui4r DelayUntilNextInsert;
 
-LOCALVAR CPTR MountCallBack = 0;
+LOCALINSTVAR CPTR MountCallBack = 0;
 
 /* This checks to see if a disk (image) has been inserted */
 GLOBALPROC Sony_Update (void)
 {
+#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+	DC42CkUpdate();
+#endif
+
 	if (DelayUntilNextInsert != 0) {
 		--DelayUntilNextInsert;
 	} else {
@@ -484,6 +658,12 @@ LOCALFUNC tMacErr Drive_Transfer(blnr IsWrite, CPTR Buffera,
 				result = vSonyTransferVM(IsWrite, Buffera, Drive_No,
 					ImageDataOffset[Drive_No] + Sony_Start, L,
 					Sony_ActCount);
+#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+				if (IsWrite) {
+					DC42CkNoteWrite(Drive_No,
+						ImageDataOffset[Drive_No] + Sony_Start, L);
+				}
+#endif
 				if ((mnvm_noErr == result) && hit_eof) {
 					result = mnvm_eofErr;
 				}
@@ -494,7 +674,7 @@ LOCALFUNC tMacErr Drive_Transfer(blnr IsWrite, CPTR Buffera,
 	return result;
 }
 
-LOCALVAR blnr QuitOnEject = falseblnr;
+LOCALINSTVAR blnr QuitOnEject = falseblnr;
 
 GLOBALPROC Sony_SetQuitOnEject(void)
 {
@@ -547,7 +727,13 @@ GLOBALPROC Sony_EjectAllDisks(void)
 
 	vSonyMountedMask = 0;
 	for (i = 0; i < NumDrives; ++i) {
-		if (vSonyIsInserted(i)) {
+		if (vSonyIsInserted(i)
+#if IncludeSCSIDisks
+			&& ! vSonyIsSCSI(i)
+				/* hard disks stay attached through reset */
+#endif
+			)
+		{
 #if Sony_WantChecksumsUpdated
 			Drive_UpdateChecksums(i);
 #endif
@@ -892,7 +1078,7 @@ typedef struct MyDriverDat_R MyDriverDat_R;
 #define kcom_checkval 0x841339E2
 
 #if Sony_SupportTags
-LOCALVAR CPTR TheTagBuffer;
+LOCALINSTVAR CPTR TheTagBuffer;
 #endif
 
 LOCALFUNC ui5b DriveVarsLocation(tDrive Drive_No)
@@ -978,6 +1164,11 @@ LOCALFUNC tMacErr Sony_PrimeTags(tDrive Drive_No,
 			ui5r count = 12 * n;
 			result = vSonyTransferVM(IsWrite, TheTagBuffer, Drive_No,
 				TagOffset, count, nullpr);
+#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+			if (IsWrite) {
+				DC42CkNoteWrite(Drive_No, TagOffset, count);
+			}
+#endif
 			if (mnvm_noErr == result) {
 				MyMoveBytesVM(TheTagBuffer + count - 12, 0x02FC, 12);
 			}
@@ -995,6 +1186,9 @@ LOCALFUNC tMacErr Sony_PrimeTags(tDrive Drive_No,
 					put_vm_word(0x0302, BufTgFBkNum);
 					result = vSonyTransferVM(trueblnr, 0x02FC, Drive_No,
 						TagOffset, count, nullpr);
+#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+					DC42CkNoteWrite(Drive_No, TagOffset, count);
+#endif
 					if (mnvm_noErr != result) {
 						goto label_fail;
 					}
@@ -1458,3 +1652,49 @@ GLOBALPROC ExtnSony_Access(CPTR p)
 
 	put_vm_word(p + ExtnDat_result, result);
 }
+
+#if IncludeSaveState
+GLOBALPROC Sony_StateXfer(void)
+{
+	tDrive i;
+	ui5r Sony_Count;
+
+	/*
+		the disk images themselves aren't saved, so the same
+		ones must be inserted, as far as can be told.
+	*/
+	StateXferCheck(vSonyInsertedMask);
+	for (i = 0; i < NumDrives; ++i) {
+		if (! vSonyIsInserted(i)
+			|| (mnvm_noErr != vSonyGetSize(i, &Sony_Count)))
+		{
+			Sony_Count = 0;
+		}
+		StateXferCheck(Sony_Count);
+	}
+#if IncludeSCSIDisks
+	StateXferCheck(vSCSIDriveMask);
+#endif
+
+	StateXferVar(vSonyMountedMask);
+	StateXferVar(ImageDataOffset);
+	StateXferVar(ImageDataSize);
+#if Sony_SupportTags
+	StateXferVar(ImageTagOffset);
+	StateXferVar(TheTagBuffer);
+#endif
+#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+	StateXferVar(DC42CkOn);
+	StateXferVar(DC42CkDirty);
+	StateXferVar(DC42CkStart);
+	StateXferVar(DC42CkSize);
+	StateXferVar(DC42CkChunkSz);
+	StateXferVar(DC42CkDone);
+	StateXferVar(DC42CkSum);
+	StateXferVar(DC42CkState);
+#endif
+	StateXferVar(DelayUntilNextInsert);
+	StateXferVar(MountCallBack);
+	StateXferVar(QuitOnEject);
+}
+#endif
@@ -27,5 +27,8 @@ EXPORTPROC Sony_SetQuitOnEject(void);
 
 EXPORTPROC Sony_EjectAllDisks(void);
 EXPORTPROC Sony_Reset(void);
+#if IncludeSaveState
+EXPORTPROC Sony_StateXfer(void);
+#endif
 
 EXPORTPROC Sony_Update(void);
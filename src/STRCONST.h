@@ -53,9 +53,30 @@
 #define kStrBadArgTitle "Unknown argument"
 #define kStrBadArgMessage "I did not understand one of the command line arguments, and ignored it."
 
+#define kStrRamDiskSizeMessage "The size of a RAM disk must be more than zero and at most 2048M."
+
 #define kStrOpenFailTitle "Open failed"
 #define kStrOpenFailMessage "I could not open the disk image."
 
+#define kStrWriteBackFailTitle "Unable to write disk image"
+#define kStrWriteBackFailMessage "Some changes could not be written to the disk image file, and were lost when it was ejected."
+
+#define kStrSaveFailTitle "Save failed"
+#define kStrSaveFailMessage "I could not save the contents of the RAM disk."
+
+#define kStrStateSaveFailTitle "Unable to save state"
+#define kStrStateSaveFailMessage "I could not write the state of the emulated computer to the state file."
+
+#define kStrStateLoadFailTitle "Unable to load state"
+#define kStrStateLoadFailMessage "The state file could not be read, or does not match this emulator and its disk images."
+
+#define kStrForkFailTitle "Unable to fork"
+#define kStrForkFailMessage "I could not start all of the children."
+#define kStrForkDisksMessage "Each disk image must be locked, or have an overlay in memory, to be shared by the children."
+
+#define kStrTrapAccelTitle "Native trap mismatch"
+#define kStrTrapAccelMessage "A trap done natively would have given a different result from the emulated trap."
+
 #define kStrNoReadROMTitle "Unable to read ROM image"
 #define kStrNoReadROMMessage "I found the ROM image file ;[^r;{, but I can not read it."
 
@@ -95,6 +116,11 @@
 #define kStrCmdReset "Reset"
 #define kStrCmdInterrupt "Interrupt"
 #define kStrCmdHelp "Help (show this page)"
+#define kStrCmdWriteDisks "Write changes to disk images now"
+#define kStrCmdSaveState "Save the state of the emulated computer"
+#define kStrCmdLoadState "Go back to the saved state"
+#define kStrCmdRewind "Go back a little in time"
+#define kStrCmdHostTime "Time spent in each part of the emulation"
 
 /* Speed Control Screen */
 #define kStrCurrentSpeed "Current speed: ^s"
@@ -117,6 +143,14 @@
 
 #define kStrNewCntrlKey "Emulated ;]control;} key ^k."
 
+#define kStrHaveWrittenDisks "Changes have been written to the disk images."
+#define kStrHaveSavedState "The state of the emulated computer has been saved."
+#define kStrHaveLoadedState "The saved state has been loaded."
+#define kStrHaveRewound "Gone back in time."
+#define kStrHaveRewoundDisks "Gone back in time, but writable disk images were not, and may not match."
+#define kStrNoRewind "There is nothing further to go back to."
+#define kStrHostTimeTitle "Host time in the last second:"
+
 #define kStrCmdCancel "cancel"
 
 #define kStrConfirmReset "Are you sure you want to reset the emulated computer? Unsaved changes will be lost, and there is a risk of corrupting the mounted disk image files. Type a letter:"
@@ -60,6 +60,32 @@ typedef si5r simr;
 #define EXPORTVAR(t, v) extern t v;
 #endif
 
+/*
+	State of the emulated machine, as opposed to state of the
+	host program and tables that never change. With
+	EmMultiInstance, each thread that runs the emulation has
+	its own copy of the state kept by the platform independent
+	core. That is the core only: the platform glue, with the
+	disk images, screen, input and timing, is still one per
+	process, so a glue hosting several Macs would need its own
+	state made per instance as well. For now only the
+	microbenchmarks, which need nothing of the glue, are run
+	this way (see --microbench-instances).
+*/
+#if EmMultiInstance
+#define INSTVARQ __thread
+#else
+#define INSTVARQ
+#endif
+#define LOCALINSTVAR LOCALVAR INSTVARQ
+#ifdef AllFiles
+#define GLOBALINSTVAR LOCALINSTVAR
+#define EXPORTINSTVAR(t, v)
+#else
+#define GLOBALINSTVAR INSTVARQ
+#define EXPORTINSTVAR(t, v) extern INSTVARQ t v;
+#endif
+
 #define LOCALFUNC static
 #define FORWARDFUNC LOCALFUNC
 #ifdef AllFiles
@@ -0,0 +1,68 @@
+/*
+	TRACE.h
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	binary TRACE file format, shared by the emulator
+	and by the TRACEDEC decoder.
+
+	A header of kTraceHeadSz bytes: the magic 'mvTR', then
+	kTraceVersion and kTraceRecSz as big endian longs, then a long
+	of zero. Then records of kTraceRecWords big endian longs:
+	the time in emulated cycles (GetCuriCount, wraps), the info
+	word made by TraceInfo, an address, a data value, and the PC.
+*/
+
+#ifdef TRACE_H
+#error "header already included"
+#else
+#define TRACE_H
+#endif
+
+#define kTraceMagic 0x6D765452 /* 'mvTR' */
+#define kTraceVersion 1
+#define kTraceHeadSz 16
+#define kTraceRecWords 5
+#define kTraceRecSz (4 * kTraceRecWords)
+
+#define TraceInfo(kind, sub, id) \
+	((kind) | ((sub) << 8) | ((id) << 16))
+#define TraceInfoKind(x) ((x) & 0xFF)
+#define TraceInfoSub(x) (((x) >> 8) & 0xFF)
+#define TraceInfoId(x) (((x) >> 16) & 0xFFFF)
+
+/* kinds of record, the meaning of sub, id, address and data */
+
+#define kTraceName 1
+	/*
+		part of a name: id is the name, sub the part, the time
+		the length of the whole, address and data the 8 chars
+	*/
+#define kTraceLost 2 /* data is the records dropped, ring full */
+#define kTraceTick 3 /* start of a sixtieth of a second */
+#define kTraceDevice 4
+	/* MMDV_Access: id the device name, sub the kTraceFl flags */
+#define kTraceNote 5 /* dbglog_WriteNote: id the note */
+#define kTraceSetBool 6 /* dbglog_WriteSetBool */
+#define kTraceAccess 7 /* dbglog_Access, sub the kTraceFl flags */
+#define kTraceAddrAccess 8 /* dbglog_AddrAccess */
+#define kTraceWatch 9
+	/*
+		access to watched memory: id the watch, sub the kTraceFl
+		flags. The PC is part way through the instruction.
+	*/
+
+#define kTraceFlWrite 0x01
+#define kTraceFlByte 0x02
@@ -0,0 +1,224 @@
+/*
+	TRACEDEC.c
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	TRACE DECoder
+
+	A program by itself, not part of the emulator. Reads a file
+	written by "minivmac --trace FILE" and prints a line of text
+	for each record:
+
+		tracedec FILE
+
+	Names may be put in the file after the records that use them
+	(each thread has its own ring), so all of the file is read
+	first, and the names collected, before anything is printed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SYSDEPNS.h"
+#include "TRACE.h"
+
+#define kMaxNameLen 2040 /* 255 parts of 8 chars */
+
+LOCALVAR ui3p Dat = NULL;
+LOCALVAR ui5r NRecs = 0;
+LOCALVAR char *Names[0x10000];
+
+LOCALFUNC ui5r GetLong(ui3p p)
+{
+	return ((ui5r)p[0] << 24) | ((ui5r)p[1] << 16)
+		| ((ui5r)p[2] << 8) | (ui5r)p[3];
+}
+
+#define RecWord(i, j) GetLong(Dat + kTraceHeadSz \
+	+ (i) * kTraceRecSz + 4 * (j))
+
+LOCALFUNC blnr ReadTrace(char *path)
+{
+	FILE *f;
+	long n;
+	blnr IsOk = falseblnr;
+
+	if (NULL == (f = fopen(path, "rb"))) {
+		fprintf(stderr, "tracedec: can't open %s\n", path);
+	} else {
+		if ((0 != fseek(f, 0, SEEK_END))
+			|| ((n = ftell(f)) < kTraceHeadSz)
+			|| (0 != fseek(f, 0, SEEK_SET))
+			|| (NULL == (Dat = (ui3p)malloc(n)))
+			|| (1 != fread(Dat, n, 1, f)))
+		{
+			fprintf(stderr, "tracedec: can't read %s\n", path);
+		} else
+		if ((kTraceMagic != GetLong(Dat))
+			|| (kTraceVersion != GetLong(Dat + 4))
+			|| (kTraceRecSz != GetLong(Dat + 8)))
+		{
+			fprintf(stderr, "tracedec: %s is not a trace\n", path);
+		} else {
+			NRecs = (n - kTraceHeadSz) / kTraceRecSz;
+			if (0 != (n - kTraceHeadSz) % kTraceRecSz) {
+				fprintf(stderr, "tracedec: last record cut short\n");
+			}
+			IsOk = trueblnr;
+		}
+		fclose(f);
+	}
+
+	return IsOk;
+}
+
+LOCALPROC PutNameChars(char *s, ui5r v)
+{
+	s[0] = (v >> 24) & 0xFF;
+	s[1] = (v >> 16) & 0xFF;
+	s[2] = (v >> 8) & 0xFF;
+	s[3] = v & 0xFF;
+}
+
+LOCALPROC CollectNames(void)
+{
+	ui5r i;
+	ui5r Info;
+	ui5r Id;
+	ui5r Len;
+	ui5r At;
+
+	for (i = 0; i < NRecs; ++i) {
+		Info = RecWord(i, 1);
+		if (kTraceName == TraceInfoKind(Info)) {
+			Id = TraceInfoId(Info);
+			Len = RecWord(i, 0);
+			At = 8 * TraceInfoSub(Info);
+			if (Len <= kMaxNameLen) {
+				if (NULL == Names[Id]) {
+					Names[Id] = (char *)calloc(1, kMaxNameLen + 8 + 1);
+				}
+				if (NULL != Names[Id]) {
+					PutNameChars(Names[Id] + At, RecWord(i, 2));
+					PutNameChars(Names[Id] + At + 4, RecWord(i, 3));
+					Names[Id][Len] = 0;
+				}
+			}
+		}
+	}
+}
+
+LOCALFUNC char *NameOf(ui5r Id)
+{
+	return (NULL != Names[Id]) ? Names[Id] : "?";
+}
+
+LOCALPROC PrintRecords(void)
+{
+	ui5r i;
+	ui5r Time;
+	ui5r Info;
+	ui5r Addr;
+	ui5r Data;
+	ui5r PC;
+	ui5r Sub;
+	char *Name;
+
+	for (i = 0; i < NRecs; ++i) {
+		Time = RecWord(i, 0);
+		Info = RecWord(i, 1);
+		Addr = RecWord(i, 2);
+		Data = RecWord(i, 3);
+		PC = RecWord(i, 4);
+		Sub = TraceInfoSub(Info);
+		Name = NameOf(TraceInfoId(Info));
+
+		switch (TraceInfoKind(Info)) {
+			case kTraceName:
+				break;
+			case kTraceLost:
+				printf("%10lu %08lX lost %lu\n", (unsigned long)Time,
+					(unsigned long)PC, (unsigned long)Data);
+				break;
+			case kTraceTick:
+				printf("%10lu %08lX tick\n", (unsigned long)Time,
+					(unsigned long)PC);
+				break;
+			case kTraceDevice:
+				printf("%10lu %08lX %s %s.%c %06lX %0*lX\n",
+					(unsigned long)Time, (unsigned long)PC, Name,
+					(0 != (Sub & kTraceFlWrite)) ? "W" : "R",
+					(0 != (Sub & kTraceFlByte)) ? 'B' : 'W',
+					(unsigned long)Addr,
+					(0 != (Sub & kTraceFlByte)) ? 2 : 4,
+					(unsigned long)Data);
+				break;
+			case kTraceNote:
+				printf("%10lu %08lX note %s\n", (unsigned long)Time,
+					(unsigned long)PC, Name);
+				break;
+			case kTraceSetBool:
+				printf("%10lu %08lX set %s <- %s\n",
+					(unsigned long)Time, (unsigned long)PC, Name,
+					(0 != Data) ? "true" : "false");
+				break;
+			case kTraceAccess:
+				printf("%10lu %08lX %s %s %lX\n",
+					(unsigned long)Time, (unsigned long)PC, Name,
+					(0 != (Sub & kTraceFlWrite)) ? "<-" : "->",
+					(unsigned long)Data);
+				break;
+			case kTraceAddrAccess:
+				printf("%10lu %08lX %s @%lX %s %lX\n",
+					(unsigned long)Time, (unsigned long)PC, Name,
+					(unsigned long)Addr,
+					(0 != (Sub & kTraceFlWrite)) ? "<-" : "->",
+					(unsigned long)Data);
+				break;
+			case kTraceWatch:
+				printf("%10lu %08lX watch %lu %s.%c %06lX %0*lX\n",
+					(unsigned long)Time, (unsigned long)PC,
+					(unsigned long)TraceInfoId(Info),
+					(0 != (Sub & kTraceFlWrite)) ? "W" : "R",
+					(0 != (Sub & kTraceFlByte)) ? 'B' : 'W',
+					(unsigned long)Addr,
+					(0 != (Sub & kTraceFlByte)) ? 2 : 4,
+					(unsigned long)Data);
+				break;
+			default:
+				printf("%10lu %08lX kind %lu %08lX %08lX\n",
+					(unsigned long)Time, (unsigned long)PC,
+					(unsigned long)TraceInfoKind(Info),
+					(unsigned long)Addr, (unsigned long)Data);
+				break;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (2 != argc) {
+		fprintf(stderr, "usage: tracedec FILE\n");
+		return 2;
+	}
+	if (! ReadTrace(argv[1])) {
+		return 1;
+	}
+	CollectNames();
+	PrintRecords();
+
+	return 0;
+}
@@ -28,6 +28,9 @@
 #include "MYOSGLUE.h"
 #include "EMCONFIG.h"
 #include "GLOBGLUE.h"
+#if IncludeSaveState
+#include "SAVESTAT.h"
+#endif
 #endif
 
 #include "VIAEMDEV.h"
@@ -221,7 +224,7 @@ typedef struct {
 	ui3b ORA;    /* Buffer A */
 } VIA1_Ty;
 
-LOCALVAR VIA1_Ty VIA1_D;
+LOCALINSTVAR VIA1_Ty VIA1_D;
 
 #define kIntCA2 0 /* One_Second */
 #define kIntCA1 1 /* Vertical_Blanking */
@@ -566,10 +569,10 @@ LOCALPROC VIA1_CheckInterruptFlag(void)
 }
 
 
-LOCALVAR ui3b VIA1_T1_Active = 0;
-LOCALVAR ui3b VIA1_T2_Active = 0;
+LOCALINSTVAR ui3b VIA1_T1_Active = 0;
+LOCALINSTVAR ui3b VIA1_T2_Active = 0;
 
-LOCALVAR blnr VIA1_T1IntReady = falseblnr;
+LOCALINSTVAR blnr VIA1_T1IntReady = falseblnr;
 
 LOCALPROC VIA1_Clear(void)
 {
@@ -657,8 +660,8 @@ GLOBALFUNC ui3b VIA1_ShiftOutData(void)
 #define CyclesPerViaTime (10 * kMyClockMult)
 #define CyclesScaledPerViaTime (kCycleScale * CyclesPerViaTime)
 
-LOCALVAR blnr VIA1_T1Running = trueblnr;
-LOCALVAR iCountt VIA1_T1LastTime = 0;
+LOCALINSTVAR blnr VIA1_T1Running = trueblnr;
+LOCALINSTVAR iCountt VIA1_T1LastTime = 0;
 
 GLOBALPROC VIA1_DoTimer1Check(void)
 {
@@ -768,9 +771,9 @@ GLOBALFUNC ui4b VIA1_GetT1InvertTime(void)
 	return v;
 }
 
-LOCALVAR blnr VIA1_T2Running = trueblnr;
-LOCALVAR blnr VIA1_T2C_ShortTime = falseblnr;
-LOCALVAR iCountt VIA1_T2LastTime = 0;
+LOCALINSTVAR blnr VIA1_T2Running = trueblnr;
+LOCALINSTVAR blnr VIA1_T2C_ShortTime = falseblnr;
+LOCALINSTVAR iCountt VIA1_T2LastTime = 0;
 
 GLOBALPROC VIA1_DoTimer2Check(void)
 {
@@ -1213,3 +1216,18 @@ GLOBALPROC VIA1_iCB2_PulseNtfy(void)
 	VIA1_SetInterruptFlag(kIntCB2);
 }
 #endif
+
+#if IncludeSaveState
+GLOBALPROC VIA1_StateXfer(void)
+{
+	StateXferVar(VIA1_D);
+	StateXferVar(VIA1_T1_Active);
+	StateXferVar(VIA1_T2_Active);
+	StateXferVar(VIA1_T1IntReady);
+	StateXferVar(VIA1_T1Running);
+	StateXferVar(VIA1_T1LastTime);
+	StateXferVar(VIA1_T2Running);
+	StateXferVar(VIA1_T2C_ShortTime);
+	StateXferVar(VIA1_T2LastTime);
+}
+#endif
@@ -22,6 +22,9 @@
 
 EXPORTPROC VIA1_Zap(void);
 EXPORTPROC VIA1_Reset(void);
+#if IncludeSaveState
+EXPORTPROC VIA1_StateXfer(void);
+#endif
 
 EXPORTFUNC ui5b VIA1_Access(ui5b Data, blnr WriteMem, CPTR addr);
 
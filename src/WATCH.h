@@ -0,0 +1,34 @@
+/*
+	WATCH.h
+
+	Copyright (C) 2026 the minivmac_sdl2 contributors
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+#ifdef WATCH_H
+#error "header already included"
+#else
+#define WATCH_H
+#endif
+
+/*
+	WATCHpoints on emulated memory, kept in GLOBGLUE.c. Each
+	access of a kind watched is put in the binary trace, as a
+	kTraceWatch record. To be called between instructions.
+*/
+
+#define kWatchRead 0x01
+#define kWatchWrite 0x02
+
+EXPORTFUNC blnr Watch_Add(ui5r Addr, ui5r Len, ui3r Kind);
+	/* false if there are too many */
+EXPORTPROC Watch_ClearAll(void);